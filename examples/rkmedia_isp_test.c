@@ -177,6 +177,7 @@ restart:
   venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum = 30;
 
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = "rkispp_scale0";
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = 1920;
@@ -157,6 +157,7 @@ int main(int argc, char *argv[]) {
   }
 
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = pcVideoNode;
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = u32SrcWidth;
@@ -291,6 +291,7 @@ int main(int argc, char *argv[]) {
   g_stVencChn.s32ChnId = 0;
 
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = device_name;
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = demo_arg.vi_width;
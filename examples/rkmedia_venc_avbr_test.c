@@ -60,6 +60,7 @@ static int avbrStreamOn(int width, int height, int vi_chn, int venc_chn) {
          vi_chn, venc_chn, width, height);
 
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = "rkispp_scale0";
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = width;
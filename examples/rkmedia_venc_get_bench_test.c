@@ -0,0 +1,255 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Throughput of RK_MPI_SYS_GetMediaBuffer: small frames are sent to VENC at
+// a high rate, a thread gets the packets either blocked in the get or by
+// polling the fd of RK_MPI_VENC_GetFd, and prints every second the packets
+// got, the cpu time and the context switches per packet.
+// With -n, the packets are got by batches with RK_MPI_SYS_GetMediaBuffers,
+// the channel keeping as many; a burst of that many packets must first come
+// back in one call.
+
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "rkmedia_api.h"
+#include "rkmedia_venc.h"
+
+static bool quit = false;
+static bool use_poll = true;
+static int batch = 1;
+static volatile unsigned long got_cnt = 0;
+
+static void sigterm_handler(int sig) {
+  fprintf(stderr, "signal %d\n", sig);
+  quit = true;
+}
+
+static long long now_us() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void *GetMediaBuffer(void *arg) {
+  (void)arg;
+  struct pollfd pfd;
+  pfd.fd = RK_MPI_VENC_GetFd(0);
+  pfd.events = POLLIN;
+  if (use_poll && pfd.fd <= 0) {
+    printf("ERROR: venc has no fd, get blocked instead\n");
+    use_poll = false;
+  }
+  while (!quit) {
+    if (use_poll) {
+      if (poll(&pfd, 1, 100) <= 0)
+        continue;
+    }
+    if (batch > 1) {
+      MEDIA_BUFFER mbs[batch];
+      int cnt = RK_MPI_SYS_GetMediaBuffers(RK_ID_VENC, 0, mbs, batch,
+                                           use_poll ? 0 : 100);
+      if (cnt > 0) {
+        got_cnt += cnt;
+        RK_MPI_MB_ReleaseBuffers(mbs, cnt);
+      }
+      continue;
+    }
+    // drain what is queued, one wakeup may bring several packets
+    MEDIA_BUFFER mb =
+        RK_MPI_SYS_GetMediaBuffer(RK_ID_VENC, 0, use_poll ? 0 : 100);
+    while (mb) {
+      got_cnt++;
+      RK_MPI_MB_ReleaseBuffer(mb);
+      mb = RK_MPI_SYS_GetMediaBuffer(RK_ID_VENC, 0, 0);
+    }
+  }
+  return NULL;
+}
+
+// Queue batch packets without getting them, then check that a single
+// RK_MPI_SYS_GetMediaBuffers returns them all.
+static bool CheckBurst(MEDIA_BUFFER frame) {
+  if (RK_MPI_SYS_StartGetMediaBuffer(RK_ID_VENC, 0)) {
+    printf("ERROR: start get venc buffer failed!\n");
+    return false;
+  }
+  for (int i = 0; i < batch; i++) {
+    RK_MPI_MB_SetTimestamp(frame, i);
+    RK_MPI_SYS_SendMediaBuffer(RK_ID_VENC, 0, frame);
+  }
+  VENC_CHN_STATUS_S status;
+  long long deadline = now_us() + 2000000;
+  do {
+    usleep(10000);
+    memset(&status, 0, sizeof(status));
+    RK_MPI_VENC_QueryStatus(0, &status);
+  } while ((int)status.u32LeftPackets < batch && now_us() < deadline);
+
+  MEDIA_BUFFER mbs[batch];
+  int cnt = RK_MPI_SYS_GetMediaBuffers(RK_ID_VENC, 0, mbs, batch, 1000);
+  if (cnt > 0)
+    RK_MPI_MB_ReleaseBuffers(mbs, cnt);
+  printf("burst: sent %d frames, got %d packets in one call\n", batch, cnt);
+  if (cnt != batch) {
+    printf("ERROR: expect %d packets in one call!\n", batch);
+    return false;
+  }
+  return true;
+}
+
+static RK_CHAR optstr[] = "?:w:h:r:s:n:b";
+static void print_usage(const RK_CHAR *name) {
+  printf("usage example:\n");
+  printf("\t%s [-w 176] [-h 144] [-r 1200] [-s 10] [-n 1] [-b]\n", name);
+  printf("\t-w: Image width, default 176\n");
+  printf("\t-h: Image height, default 144\n");
+  printf("\t-r: frames sent per second, 0 for as fast as possible, "
+         "default 1200\n");
+  printf("\t-s: seconds to run, default 10\n");
+  printf("\t-n: packets got per call at most, default 1\n");
+  printf("\t-b: get blocked in RK_MPI_SYS_GetMediaBuffer instead of poll\n");
+}
+
+int main(int argc, char *argv[]) {
+  RK_U32 u32Width = 176;
+  RK_U32 u32Height = 144;
+  RK_U32 u32Rate = 1200;
+  RK_U32 u32Seconds = 10;
+  int c;
+
+  while ((c = getopt(argc, argv, optstr)) != -1) {
+    switch (c) {
+    case 'w':
+      u32Width = (RK_U32)atoi(optarg);
+      break;
+    case 'h':
+      u32Height = (RK_U32)atoi(optarg);
+      break;
+    case 'r':
+      u32Rate = (RK_U32)atoi(optarg);
+      break;
+    case 's':
+      u32Seconds = (RK_U32)atoi(optarg);
+      break;
+    case 'n':
+      batch = atoi(optarg);
+      break;
+    case 'b':
+      use_poll = false;
+      break;
+    case '?':
+    default:
+      print_usage(argv[0]);
+      return 0;
+    }
+  }
+  printf("#%ux%u, %u frames/s, %us, get by %s, %d per call\n", u32Width,
+         u32Height, u32Rate, u32Seconds, use_poll ? "poll" : "blocking get",
+         batch);
+
+  RK_MPI_SYS_Init();
+  VENC_CHN_ATTR_S venc_chn_attr;
+  memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+  venc_chn_attr.stVencAttr.enType = RK_CODEC_TYPE_MJPEG;
+  venc_chn_attr.stVencAttr.imageType = IMAGE_TYPE_NV12;
+  venc_chn_attr.stVencAttr.u32PicWidth = u32Width;
+  venc_chn_attr.stVencAttr.u32PicHeight = u32Height;
+  venc_chn_attr.stVencAttr.u32VirWidth = u32Width;
+  venc_chn_attr.stVencAttr.u32VirHeight = u32Height;
+  venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_MJPEGCBR;
+  venc_chn_attr.stRcAttr.stMjpegCbr.fr32DstFrameRateDen = 1;
+  venc_chn_attr.stRcAttr.stMjpegCbr.fr32DstFrameRateNum = 30;
+  venc_chn_attr.stRcAttr.stMjpegCbr.u32SrcFrameRateDen = 1;
+  venc_chn_attr.stRcAttr.stMjpegCbr.u32SrcFrameRateNum = 30;
+  venc_chn_attr.stRcAttr.stMjpegCbr.u32BitRate = u32Width * u32Height * 8;
+  if (RK_MPI_VENC_CreateChn(0, &venc_chn_attr)) {
+    printf("ERROR: Create venc failed!\n");
+    return -1;
+  }
+  // room for a whole batch, the channel keeps 2 packets by default
+  if (batch > 1 && RK_MPI_SYS_SetMediaBufferDepth(RK_ID_VENC, 0, batch)) {
+    printf("ERROR: Set venc buffer depth %d failed!\n", batch);
+    RK_MPI_VENC_DestroyChn(0);
+    return -1;
+  }
+
+  MB_IMAGE_INFO_S stImageInfo = {u32Width, u32Height, u32Width, u32Height,
+                                 IMAGE_TYPE_NV12};
+  MEDIA_BUFFER frame =
+      RK_MPI_MB_CreateImageBuffer(&stImageInfo, RK_TRUE, MB_FLAG_NOCACHED);
+  if (!frame) {
+    printf("ERROR: no space left!\n");
+    RK_MPI_VENC_DestroyChn(0);
+    return -1;
+  }
+  memset(RK_MPI_MB_GetPtr(frame), 0x80, RK_MPI_MB_GetSize(frame));
+  if (batch > 1 && !CheckBurst(frame)) {
+    RK_MPI_MB_ReleaseBuffer(frame);
+    RK_MPI_VENC_DestroyChn(0);
+    return -1;
+  }
+
+  signal(SIGINT, sigterm_handler);
+  pthread_t get_thread;
+  pthread_create(&get_thread, NULL, GetMediaBuffer, NULL);
+
+  // the same frame is sent again and again, its content never changes
+  long long period = u32Rate ? 1000000LL / u32Rate : 0;
+  long long begin = now_us();
+  long long next = begin;
+  long long report = begin + 1000000;
+  unsigned long sent = 0, last_got = 0;
+  struct rusage last_ru, ru;
+  getrusage(RUSAGE_SELF, &last_ru);
+  while (!quit) {
+    RK_MPI_MB_SetTimestamp(frame, sent * (period ? period : 1));
+    RK_MPI_SYS_SendMediaBuffer(RK_ID_VENC, 0, frame);
+    sent++;
+    long long now = now_us();
+    if (now >= report) {
+      getrusage(RUSAGE_SELF, &ru);
+      unsigned long got = got_cnt - last_got;
+      long long cpu_us =
+          (ru.ru_utime.tv_sec - last_ru.ru_utime.tv_sec) * 1000000LL +
+          (ru.ru_utime.tv_usec - last_ru.ru_utime.tv_usec) +
+          (ru.ru_stime.tv_sec - last_ru.ru_stime.tv_sec) * 1000000LL +
+          (ru.ru_stime.tv_usec - last_ru.ru_stime.tv_usec);
+      long ctx = (ru.ru_nvcsw - last_ru.ru_nvcsw) +
+                 (ru.ru_nivcsw - last_ru.ru_nivcsw);
+      printf("got %lu packets/s, cpu %.1f%%, %.1f us cpu/packet, "
+             "%.2f context switches/packet\n",
+             got, cpu_us / 10000.0, got ? (double)cpu_us / got : 0.0,
+             got ? (double)ctx / got : 0.0);
+      last_got = got_cnt;
+      last_ru = ru;
+      report += 1000000;
+      if (now - begin >= (long long)u32Seconds * 1000000)
+        quit = true;
+    }
+    if (period) {
+      next += period;
+      if (next > now)
+        usleep(next - now);
+    }
+  }
+
+  pthread_join(get_thread, NULL);
+  // the frames still in the encoder when stopped are lost too
+  printf("sent %lu frames, got %lu packets, %ld lost\n", sent, got_cnt,
+         (long)(sent - got_cnt));
+  RK_MPI_MB_ReleaseBuffer(frame);
+  RK_MPI_VENC_DestroyChn(0);
+
+  return 0;
+}
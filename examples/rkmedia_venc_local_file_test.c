@@ -209,15 +209,29 @@ int main(int argc, char *argv[]) {
   RK_S32 s32ReadSize = 0;
   RK_S32 s32FrameSize = 0;
   RK_U64 u64TimePeriod = 1000000 / u32Fps; // us
-  MB_IMAGE_INFO_S stImageInfo = {u32Width, u32Height, u32Width, u32Height,
-                                 IMAGE_TYPE_NV12};
+  // Pool of dma buffers. Note that mpp encoder only support dma buffer.
+  // As CPU write mb, Encoder IP read buffer, mb should be NOCACHED type.
+  // This can avoid buffer synchronization problems.
+  MB_POOL_PARAM_S stPoolParam;
+  memset(&stPoolParam, 0, sizeof(stPoolParam));
+  stPoolParam.u32Cnt = 3;
+  stPoolParam.enMediaType = MB_TYPE_IMAGE;
+  stPoolParam.bHardWare = RK_TRUE;
+  stPoolParam.u8Flag = MB_FLAG_NOCACHED;
+  stPoolParam.stImageInfo.u32Width = u32Width;
+  stPoolParam.stImageInfo.u32Height = u32Height;
+  stPoolParam.stImageInfo.u32HorStride = u32Width;
+  stPoolParam.stImageInfo.u32VerStride = u32Height;
+  stPoolParam.stImageInfo.enImgType = IMAGE_TYPE_NV12;
+  MEDIA_BUFFER_POOL mb_pool = RK_MPI_MB_POOL_Create(&stPoolParam);
+  if (!mb_pool) {
+    printf("ERROR: create buffer pool failed!\n");
+    exit(0);
+  }
 
   while (!quit) {
-    // Create dma buffer. Note that mpp encoder only support dma buffer.
-    // As CPU write mb, Encoder IP read buffer, mb should be NOCACHED type.
-    // This can avoid buffer synchronization problems.
-    MEDIA_BUFFER mb =
-        RK_MPI_MB_CreateImageBuffer(&stImageInfo, RK_TRUE, MB_FLAG_NOCACHED);
+    // Blocks until the encoder is done with one of the buffers.
+    MEDIA_BUFFER mb = RK_MPI_MB_POOL_GetBuffer(mb_pool, RK_TRUE);
     if (!mb) {
       printf("ERROR: no space left!\n");
       break;
@@ -236,7 +250,7 @@ int main(int argc, char *argv[]) {
            RK_MPI_MB_GetFD(mb));
     RK_MPI_SYS_SendMediaBuffer(RK_ID_VENC, 0, mb);
     // mb must be release. The encoder has internal references to the data sent
-    // in. Therefore, mb cannot be reused directly
+    // in, the buffer goes back to the pool once the encoder is done with it.
     RK_MPI_MB_ReleaseBuffer(mb);
 
     if ((u32FrameCnt > 0) && ((RK_S32)u32FrameId >= u32FrameCnt))
@@ -247,6 +261,7 @@ int main(int argc, char *argv[]) {
 
   printf("%s exit!\n", __func__);
   RK_MPI_VENC_DestroyChn(0);
+  RK_MPI_MB_POOL_Destroy(mb_pool);
 
   return 0;
 }
@@ -0,0 +1,240 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Two encoders get the same frames from the app. VENC[0] is streamed and
+// timed: the longest RK_MPI_SYS_SendMediaBuffer call and the longest gap
+// between two of its packets. A first run measures it alone, a second run
+// while a thread updates the osd and the bitrate of VENC[1] as fast as it
+// can. Both runs should show about the same worst cases, updates of one
+// channel do not wait for the others.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "rkmedia_api.h"
+#include "rkmedia_venc.h"
+
+#define OSD_WIDTH 256
+#define OSD_HEIGHT 64
+
+static bool quit = false;
+static volatile bool hammer = false;
+static volatile unsigned long osd_cnt = 0;
+static volatile unsigned long got_cnt = 0;
+static volatile long long max_gap_us = 0;
+
+static void sigterm_handler(int sig) {
+  fprintf(stderr, "signal %d\n", sig);
+  quit = true;
+}
+
+static long long now_us() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void *GetMediaBuffer(void *arg) {
+  int chn = (int)(long)arg;
+  long long last = 0;
+  while (!quit) {
+    MEDIA_BUFFER mb = RK_MPI_SYS_GetMediaBuffer(RK_ID_VENC, chn, 100);
+    if (!mb)
+      continue;
+    RK_MPI_MB_ReleaseBuffer(mb);
+    if (chn)
+      continue;
+    long long now = now_us();
+    if (last && now - last > max_gap_us)
+      max_gap_us = now - last;
+    last = now;
+    got_cnt++;
+  }
+  return NULL;
+}
+
+static void *HammerOsd(void *arg) {
+  (void)arg;
+  RK_U32 *argb = malloc(OSD_WIDTH * OSD_HEIGHT * 4);
+  if (!argb)
+    return NULL;
+  BITMAP_S BitMap;
+  BitMap.enPixelFormat = PIXEL_FORMAT_ARGB_8888;
+  BitMap.u32Width = OSD_WIDTH;
+  BitMap.u32Height = OSD_HEIGHT;
+  BitMap.pData = argb;
+  OSD_REGION_INFO_S RgnInfo;
+  memset(&RgnInfo, 0, sizeof(RgnInfo));
+  RgnInfo.u32Width = OSD_WIDTH;
+  RgnInfo.u32Height = OSD_HEIGHT;
+  RgnInfo.u8Enable = 1;
+  unsigned long i = 0;
+  while (!quit) {
+    if (!hammer) {
+      usleep(10000);
+      continue;
+    }
+    // new content every time, as a clock or a counter would do
+    for (int j = 0; j < OSD_WIDTH * OSD_HEIGHT; j++)
+      argb[j] = (j + i) & 1 ? 0xFFFFFFFF : 0xFF000000;
+    RgnInfo.enRegionId = (OSD_REGION_ID_E)(i % (REGION_ID_7 + 1));
+    RgnInfo.u32PosY = (i % 4) * OSD_HEIGHT;
+    if (RK_MPI_VENC_RGN_SetBitMap(1, &RgnInfo, &BitMap))
+      printf("ERROR: set osd of VENC[1] failed\n");
+    if (i % 16 == 0)
+      RK_MPI_VENC_SetBitrate(1, (i & 16) ? 1000000 : 2000000, 0, 0);
+    i++;
+    osd_cnt++;
+  }
+  free(argb);
+  return NULL;
+}
+
+static int create_venc(int chn, RK_U32 u32Width, RK_U32 u32Height) {
+  VENC_CHN_ATTR_S venc_chn_attr;
+  memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+  venc_chn_attr.stVencAttr.enType = RK_CODEC_TYPE_H264;
+  venc_chn_attr.stVencAttr.imageType = IMAGE_TYPE_NV12;
+  venc_chn_attr.stVencAttr.u32PicWidth = u32Width;
+  venc_chn_attr.stVencAttr.u32PicHeight = u32Height;
+  venc_chn_attr.stVencAttr.u32VirWidth = u32Width;
+  venc_chn_attr.stVencAttr.u32VirHeight = u32Height;
+  venc_chn_attr.stVencAttr.u32Profile = 77;
+  venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
+  venc_chn_attr.stRcAttr.stH264Cbr.u32Gop = 30;
+  venc_chn_attr.stRcAttr.stH264Cbr.u32BitRate = 2000000;
+  venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateDen = 1;
+  venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateNum = 30;
+  venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateDen = 1;
+  venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum = 30;
+  if (RK_MPI_VENC_CreateChn(chn, &venc_chn_attr)) {
+    printf("ERROR: Create VENC[%d] failed!\n", chn);
+    return -1;
+  }
+  return 0;
+}
+
+// Send frames to both encoders for u32Seconds, then print VENC[0] timings.
+static void run(const char *name, MEDIA_BUFFER frame, RK_U32 u32Rate,
+                RK_U32 u32Seconds) {
+  long long period = 1000000LL / u32Rate;
+  long long begin = now_us();
+  long long next = begin;
+  long long max_send_us = 0;
+  unsigned long sent = 0;
+  unsigned long got = got_cnt;
+  unsigned long osd = osd_cnt;
+  max_gap_us = 0;
+  while (!quit && now_us() - begin < (long long)u32Seconds * 1000000) {
+    RK_MPI_MB_SetTimestamp(frame, sent * period);
+    long long start = now_us();
+    RK_MPI_SYS_SendMediaBuffer(RK_ID_VENC, 0, frame);
+    long long cost = now_us() - start;
+    if (cost > max_send_us)
+      max_send_us = cost;
+    RK_MPI_SYS_SendMediaBuffer(RK_ID_VENC, 1, frame);
+    sent++;
+    next += period;
+    long long now = now_us();
+    if (next > now)
+      usleep(next - now);
+  }
+  printf("%s: sent %lu, got %lu packets, max send %lld us, max packet gap "
+         "%lld us (period %lld us), %lu osd updates\n",
+         name, sent, got_cnt - got, max_send_us, max_gap_us, period,
+         osd_cnt - osd);
+}
+
+static RK_CHAR optstr[] = "?:w:h:r:s:";
+static void print_usage(const RK_CHAR *name) {
+  printf("usage example:\n");
+  printf("\t%s [-w 640] [-h 480] [-r 30] [-s 5]\n", name);
+  printf("\t-w: Image width, default 640\n");
+  printf("\t-h: Image height, default 480\n");
+  printf("\t-r: frames sent per second, default 30\n");
+  printf("\t-s: seconds of each run, default 5\n");
+}
+
+int main(int argc, char *argv[]) {
+  RK_U32 u32Width = 640;
+  RK_U32 u32Height = 480;
+  RK_U32 u32Rate = 30;
+  RK_U32 u32Seconds = 5;
+  int c;
+
+  while ((c = getopt(argc, argv, optstr)) != -1) {
+    switch (c) {
+    case 'w':
+      u32Width = (RK_U32)atoi(optarg);
+      break;
+    case 'h':
+      u32Height = (RK_U32)atoi(optarg);
+      break;
+    case 'r':
+      u32Rate = (RK_U32)atoi(optarg);
+      break;
+    case 's':
+      u32Seconds = (RK_U32)atoi(optarg);
+      break;
+    case '?':
+    default:
+      print_usage(argv[0]);
+      return 0;
+    }
+  }
+  if (!u32Rate || u32Width < OSD_WIDTH || u32Height < OSD_HEIGHT * 4) {
+    print_usage(argv[0]);
+    return -1;
+  }
+  printf("#%ux%u, %u frames/s, %us per run\n", u32Width, u32Height, u32Rate,
+         u32Seconds);
+
+  RK_MPI_SYS_Init();
+  if (create_venc(0, u32Width, u32Height))
+    return -1;
+  if (create_venc(1, u32Width, u32Height)) {
+    RK_MPI_VENC_DestroyChn(0);
+    return -1;
+  }
+  RK_MPI_VENC_RGN_Init(1, NULL);
+
+  MB_IMAGE_INFO_S stImageInfo = {u32Width, u32Height, u32Width, u32Height,
+                                 IMAGE_TYPE_NV12};
+  MEDIA_BUFFER frame =
+      RK_MPI_MB_CreateImageBuffer(&stImageInfo, RK_TRUE, MB_FLAG_NOCACHED);
+  if (!frame) {
+    printf("ERROR: no space left!\n");
+    RK_MPI_VENC_DestroyChn(1);
+    RK_MPI_VENC_DestroyChn(0);
+    return -1;
+  }
+  memset(RK_MPI_MB_GetPtr(frame), 0x80, RK_MPI_MB_GetSize(frame));
+
+  signal(SIGINT, sigterm_handler);
+  pthread_t get_thread[2], osd_thread;
+  pthread_create(&get_thread[0], NULL, GetMediaBuffer, (void *)0);
+  pthread_create(&get_thread[1], NULL, GetMediaBuffer, (void *)1);
+  pthread_create(&osd_thread, NULL, HammerOsd, NULL);
+
+  run("VENC[0] alone      ", frame, u32Rate, u32Seconds);
+  hammer = true;
+  run("VENC[1] osd updated", frame, u32Rate, u32Seconds);
+
+  quit = true;
+  pthread_join(osd_thread, NULL);
+  pthread_join(get_thread[0], NULL);
+  pthread_join(get_thread[1], NULL);
+  RK_MPI_MB_ReleaseBuffer(frame);
+  RK_MPI_VENC_DestroyChn(1);
+  RK_MPI_VENC_DestroyChn(0);
+
+  return 0;
+}
@@ -130,6 +130,7 @@ int StreamOn(int width, int height, const char *video_node, int vi_chn,
 
   CODEC_TYPE_E codec_type = RK_CODEC_TYPE_H264;
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = video_node;
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = width;
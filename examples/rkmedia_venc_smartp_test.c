@@ -118,6 +118,7 @@ int main(int argc, char *argv[]) {
 
   RK_MPI_SYS_Init();
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = "rkispp_scale0";
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = 1920;
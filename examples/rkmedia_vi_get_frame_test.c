@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -185,6 +186,7 @@ int main(int argc, char *argv[]) {
 
   RK_MPI_SYS_Init();
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = pDeviceName;
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = u32Width;
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -96,6 +97,7 @@ int main(int argc, char *argv[]) {
 
   RK_MPI_SYS_Init();
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = "rkispp_scale0";
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = 640;
@@ -110,6 +112,7 @@ int main(int argc, char *argv[]) {
   }
 
   ALGO_MD_ATTR_S md_chn_attr;
+  memset(&md_chn_attr, 0, sizeof(md_chn_attr));
   md_chn_attr.imageType = IMAGE_TYPE_NV12;
   md_chn_attr.u16Sensitivity = 70;
   md_chn_attr.u32Width = 640;
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -100,6 +101,7 @@ int main(int argc, char *argv[]) {
 
   RK_MPI_SYS_Init();
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = "rkispp_scale0";
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = video_width;
@@ -113,6 +115,7 @@ int main(int argc, char *argv[]) {
     return -1;
   }
   RGA_ATTR_S stRgaAttr;
+  memset(&stRgaAttr, 0, sizeof(stRgaAttr));
   stRgaAttr.bEnBufPool = RK_TRUE;
   stRgaAttr.u16BufPoolCnt = 2;
   stRgaAttr.u16Rotaion = 90;
@@ -150,6 +153,7 @@ int main(int argc, char *argv[]) {
   }
 
   ALGO_OD_ATTR_S stOdChnAttr;
+  memset(&stOdChnAttr, 0, sizeof(stOdChnAttr));
   stOdChnAttr.enImageType = IMAGE_TYPE_NV12;
   stOdChnAttr.u32Width = 1920;
   stOdChnAttr.u32Height = 1080;
@@ -765,6 +765,7 @@ static RK_S32 SAMPLE_COMMON_VI_Start(struct Session *session,
                                      VI_CHN_WORK_MODE mode) {
   RK_S32 ret = 0;
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
 
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = session->u32Width;
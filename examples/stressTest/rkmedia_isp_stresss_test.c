@@ -99,6 +99,7 @@ static void StreamOnOff(RK_BOOL start) {
     venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum = 30;
 
     VI_CHN_ATTR_S vi_chn_attr;
+    memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
     vi_chn_attr.pcVideoNode = g_video_node;
     vi_chn_attr.u32BufCnt = 3;
     vi_chn_attr.u32Width = g_width;
@@ -139,6 +140,7 @@ static void StreamOnOffVI(RK_BOOL start) {
   stSrcChn.s32ChnId = 1;
   if (start) {
     VI_CHN_ATTR_S vi_chn_attr;
+    memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
     vi_chn_attr.pcVideoNode = g_video_node;
     vi_chn_attr.u32BufCnt = 3;
     vi_chn_attr.u32Width = g_width;
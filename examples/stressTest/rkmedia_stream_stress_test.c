@@ -127,6 +127,7 @@ int StreamOn(StreamInfo *info) {
   DumpStreamInfo(info);
 
   VI_CHN_ATTR_S vi_chn_attr;
+  memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
   vi_chn_attr.pcVideoNode = info->video_node;
   vi_chn_attr.u32BufCnt = 3;
   vi_chn_attr.u32Width = info->width;
@@ -2,15 +2,28 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+// Without option, walk through the pool usage step by step.
+// With -b, run a contention benchmark: producers take buffers from the pool
+// and queue them, consumers release them, then report the throughput and
+// how long GetBuffer blocked. With -M above -m, the pool is elastic.
+
 #include <assert.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "buffer.h"
 #include "utils.h"
@@ -31,9 +44,145 @@ void release_pool_buffer(easymedia::BufferPool *pool) {
   }
 }
 
-int main() {
+static std::deque<std::shared_ptr<easymedia::MediaBuffer>> g_queue;
+static std::mutex g_queue_mtx;
+static std::condition_variable g_queue_cond;
+static int g_producing = 0;
+static std::atomic<int64_t> g_get_wait_sum(0);
+static std::atomic<int64_t> g_get_wait_max(0);
+
+static void bench_producer(easymedia::BufferPool *pool, int num) {
+  for (int i = 0; i < num; i++) {
+    int64_t begin = easymedia::gettimeofday();
+    auto mb = pool->GetBuffer(true);
+    int64_t wait = easymedia::gettimeofday() - begin;
+    g_get_wait_sum += wait;
+    int64_t old = g_get_wait_max;
+    while (wait > old && !g_get_wait_max.compare_exchange_weak(old, wait))
+      ;
+    if (!mb) {
+      RKMEDIA_LOGE("producer: get buffer failed!\n");
+      break;
+    }
+    std::lock_guard<std::mutex> lg(g_queue_mtx);
+    g_queue.push_back(mb);
+    g_queue_cond.notify_one();
+  }
+  std::lock_guard<std::mutex> lg(g_queue_mtx);
+  if (--g_producing == 0)
+    g_queue_cond.notify_all();
+}
+
+static void bench_consumer() {
+  while (true) {
+    std::shared_ptr<easymedia::MediaBuffer> mb;
+    {
+      std::unique_lock<std::mutex> lk(g_queue_mtx);
+      g_queue_cond.wait(lk, [] { return !g_queue.empty() || !g_producing; });
+      if (g_queue.empty())
+        return;
+      mb = g_queue.front();
+      g_queue.pop_front();
+    }
+    // touch the buffer, then put it back to the pool out of the queue lock
+    memset(mb->GetPtr(), 0, 64);
+    mb.reset();
+  }
+}
+
+static int run_bench(int producers, int consumers, int num, int cnt,
+                     int max_cnt, int grow_ms, int size) {
+  easymedia::BufferPoolParam bp_param;
+  bp_param.min_cnt = cnt;
+  bp_param.max_cnt = std::max(cnt, max_cnt);
+  bp_param.low_watermark = 0;
+  bp_param.high_watermark = cnt;
+  bp_param.idle_ms = 1000;
+  bp_param.grow_ms = grow_ms;
+  easymedia::BufferPool pool(bp_param, size,
+                             easymedia::MediaBuffer::MemType::MEM_COMMON);
+  std::vector<std::thread> threads;
+  g_producing = producers;
+  int64_t begin = easymedia::gettimeofday();
+  for (int i = 0; i < consumers; i++)
+    threads.emplace_back(bench_consumer);
+  for (int i = 0; i < producers; i++)
+    threads.emplace_back(bench_producer, &pool, num);
+  for (auto &th : threads)
+    th.join();
+  int64_t cost = easymedia::gettimeofday() - begin;
+  int64_t total = (int64_t)producers * num;
+  printf("producers:%d, consumers:%d, pool cnt:%d, size:%d\n", producers,
+         consumers, cnt, size);
+  printf("  %lld buffers in %lld us, %.0f buffers/s\n", (long long)total,
+         (long long)cost, cost ? total * 1000000.0 / cost : 0.0);
+  printf("  GetBuffer wait(us): avg:%lld, max:%lld\n",
+         (long long)(total ? g_get_wait_sum / total : 0),
+         (long long)g_get_wait_max.load());
+  easymedia::BufferPoolStats st;
+  pool.GetStats(st);
+  printf("  pool: hit:%llu, miss:%llu, wait:%llu, grow:%llu, peak cnt:%d, "
+         "peak busy:%d\n",
+         (unsigned long long)st.hit_cnt, (unsigned long long)st.miss_cnt,
+         (unsigned long long)st.wait_cnt, (unsigned long long)st.grow_cnt,
+         st.peak_buf_cnt, st.peak_busy_cnt);
+  return 0;
+}
+
+static void usage(char *name) {
+  printf("Usage: %s [-b [-p producers] [-c consumers] [-n buffers_per_producer]"
+         " [-m pool_cnt] [-M pool_max_cnt] [-g grow_ms] [-s size]]\n",
+         name);
+}
+
+int main(int argc, char **argv) {
   LOG_INIT();
 
+  bool bench = false;
+  int producers = 4, consumers = 4, num = 100000, cnt = 8, max_cnt = 0;
+  int grow_ms = 0;
+  int size = 1024;
+  int c;
+  while ((c = getopt(argc, argv, "bp:c:n:m:M:g:s:h")) != -1) {
+    switch (c) {
+    case 'b':
+      bench = true;
+      break;
+    case 'p':
+      producers = atoi(optarg);
+      break;
+    case 'c':
+      consumers = atoi(optarg);
+      break;
+    case 'n':
+      num = atoi(optarg);
+      break;
+    case 'm':
+      cnt = atoi(optarg);
+      break;
+    case 'M':
+      max_cnt = atoi(optarg);
+      break;
+    case 'g':
+      grow_ms = atoi(optarg);
+      break;
+    case 's':
+      size = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 0;
+    }
+  }
+  if (bench) {
+    if (producers <= 0 || consumers <= 0 || num <= 0 || cnt <= 0 ||
+        grow_ms < 0 || size < 64) {
+      usage(argv[0]);
+      return -1;
+    }
+    return run_bench(producers, consumers, num, cnt, max_cnt, grow_ms, size);
+  }
+
   easymedia::BufferPool pool(10, 1024,
                              easymedia::MediaBuffer::MemType::MEM_COMMON);
   ;
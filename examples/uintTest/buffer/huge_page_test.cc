@@ -0,0 +1,156 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Run a cpu image kernel over common memory NV12 frames, on 4K pages then
+// on huge pages (MEM_FLAG_HUGE_PAGE), and report per frame the time, the
+// minor page faults and, if perf events are allowed, the dTLB misses.
+// Without -p, each frame is a fresh buffer, as FileReadFlow allocates them;
+// with -p, the frames come from a BufferPool of 3 buffers, prefaulted when
+// the pool is created.
+// For hugetlbfs pages, reserve some first: echo 64 > /proc/sys/vm/nr_hugepages
+// else the transparent huge pages are used, if enabled.
+
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "slab_allocator.h"
+#include "utils.h"
+
+static int open_dtlb_counter() {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long minor_faults() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+// Write the frame row by row, then sum the luma column by column: the
+// column walk crosses a 4K page every row or two, the worst case for the
+// TLB, as rotations and vertical filters are.
+static uint64_t image_kernel(uint8_t *ptr, int width, int height, int frame) {
+  size_t size = width * height * 3 / 2;
+  for (size_t i = 0; i < size; i++)
+    ptr[i] = (uint8_t)(i + frame);
+  uint64_t sum = 0;
+  for (int x = 0; x < width; x += 16)
+    for (int y = 0; y < height; y++)
+      sum += ptr[y * width + x];
+  return sum;
+}
+
+static void run(const char *name, int width, int height, int frames,
+                bool use_pool, unsigned int flag, int dtlb_fd) {
+  const easymedia::MediaBuffer::MemType type =
+      easymedia::MediaBuffer::MemType::MEM_COMMON;
+  size_t size = width * height * 3 / 2;
+  std::shared_ptr<easymedia::BufferPool> pool;
+  if (use_pool)
+    pool = std::make_shared<easymedia::BufferPool>(3, size, type, flag);
+  uint64_t sum = 0;
+  long faults = minor_faults();
+  if (dtlb_fd >= 0) {
+    ioctl(dtlb_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(dtlb_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  int64_t begin = easymedia::gettimeofday();
+  for (int i = 0; i < frames; i++) {
+    auto mb = pool ? pool->GetBuffer(true)
+                   : easymedia::MediaBuffer::Alloc(size, type, flag);
+    if (!mb) {
+      fprintf(stderr, "%s: alloc frame %d failed\n", name, i);
+      return;
+    }
+    sum += image_kernel((uint8_t *)mb->GetPtr(), width, height, i);
+  }
+  int64_t cost = easymedia::gettimeofday() - begin;
+  long long dtlb = -1;
+  if (dtlb_fd >= 0) {
+    ioctl(dtlb_fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(dtlb_fd, &dtlb, sizeof(dtlb)) != sizeof(dtlb))
+      dtlb = -1;
+  }
+  faults = minor_faults() - faults;
+  printf("%-10s: %7.2f ms/frame, %8.1f faults/frame", name,
+         cost / 1000.0 / frames, (double)faults / frames);
+  if (dtlb >= 0)
+    printf(", %10.1f dTLB misses/frame", (double)dtlb / frames);
+  printf(" (sum %llu)\n", (unsigned long long)sum);
+}
+
+static void usage(char *name) {
+  printf("Usage: %s [-w width] [-h height] [-n frames] [-p]\n", name);
+  printf("\t-p: frames from a buffer pool, else fresh buffers\n");
+  printf("\tdefault: 3840x2160, 100 frames\n");
+}
+
+int main(int argc, char **argv) {
+  int width = 3840;
+  int height = 2160;
+  int frames = 100;
+  bool use_pool = false;
+  int c;
+
+  while ((c = getopt(argc, argv, "w:h:n:p?")) != -1) {
+    switch (c) {
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'h':
+      height = atoi(optarg);
+      break;
+    case 'n':
+      frames = atoi(optarg);
+      break;
+    case 'p':
+      use_pool = true;
+      break;
+    case '?':
+    default:
+      usage(argv[0]);
+      exit(0);
+    }
+  }
+  if (width <= 0 || height <= 0 || frames <= 0) {
+    usage(argv[0]);
+    exit(-1);
+  }
+
+  int dtlb_fd = open_dtlb_counter();
+  if (dtlb_fd < 0)
+    printf("dTLB misses are not counted, perf events are not allowed\n");
+  printf("%dx%d NV12, %d frames, %s\n", width, height, frames,
+         use_pool ? "pooled buffers" : "fresh buffers");
+  run("4K pages", width, height, frames, use_pool, 0, dtlb_fd);
+  run("huge pages", width, height, frames, use_pool,
+      easymedia::MEM_FLAG_HUGE_PAGE, dtlb_fd);
+  if (dtlb_fd >= 0)
+    close(dtlb_fd);
+
+  easymedia::SlabStats st;
+  easymedia::SlabAllocator::GetStats(st);
+  printf("huge page blocks: hugetlb %llu, thp %llu\n",
+         (unsigned long long)st.hugetlb_cnt, (unsigned long long)st.thp_cnt);
+
+  return 0;
+}
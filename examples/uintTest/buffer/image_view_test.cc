@@ -0,0 +1,177 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Crop a NV12 image whose pixels hold their coordinates, then check that
+// the planes of the view, of a view of it and of a plain copy of it point at
+// the pixels of the rect, and that a flow gets the view or a plain copy.
+// Return 0 if all of them read the crop.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "flow.h"
+
+using namespace easymedia;
+
+static const int kWidth = 64;
+static const int kHeight = 32;
+
+static uint8_t luma(int x, int y) { return (uint8_t)(x + y * 3); }
+// chroma pair of the pixel (x, y), u then v
+static uint8_t chroma(int x, int y, int v) {
+  return (uint8_t)(0x80 + x / 2 + (y / 2) * 7 + v);
+}
+
+// Compare the image of ib at its planes with the rect at (x0, y0) of the
+// source.
+static bool check_pixels(const char *name, ImageBuffer &ib, int x0, int y0) {
+  ImagePlane planes[MAX_IMAGE_PLANE_NUM];
+  if (ib.GetPlanes(planes) != 2) {
+    printf("FAIL: %s: NV12 should have 2 planes\n", name);
+    return false;
+  }
+  const uint8_t *ptr = (const uint8_t *)ib.GetPtr();
+  for (int y = 0; y < ib.GetHeight(); y++) {
+    for (int x = 0; x < ib.GetWidth(); x++) {
+      uint8_t got = ptr[planes[0].offset + (size_t)y * planes[0].stride + x];
+      if (got != luma(x0 + x, y0 + y)) {
+        printf("FAIL: %s: luma of (%d,%d) is %u, expect %u\n", name, x, y,
+               got, luma(x0 + x, y0 + y));
+        return false;
+      }
+    }
+  }
+  for (int y = 0; y < ib.GetHeight() / 2; y++) {
+    for (int x = 0; x < ib.GetWidth(); x++) {
+      uint8_t got =
+          ptr[planes[1].offset + (size_t)y * planes[1].stride + x];
+      uint8_t expect = chroma(x0 + x, y0 + y * 2, x & 1);
+      if (got != expect) {
+        printf("FAIL: %s: chroma byte (%d,%d) is %u, expect %u\n", name, x,
+               y, got, expect);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static std::shared_ptr<ImageBuffer> create_image() {
+  ImageInfo info = {PIX_FMT_NV12, kWidth, kHeight, kWidth, kHeight};
+  auto mb = MediaBuffer::Alloc(CalPixFmtSize(info));
+  if (!mb)
+    return nullptr;
+  auto ib = std::make_shared<ImageBuffer>(*mb, info);
+  uint8_t *ptr = (uint8_t *)ib->GetPtr();
+  for (int y = 0; y < kHeight; y++)
+    for (int x = 0; x < kWidth; x++)
+      ptr[y * kWidth + x] = luma(x, y);
+  uint8_t *uv = ptr + kWidth * kHeight;
+  for (int y = 0; y < kHeight; y += 2)
+    for (int x = 0; x < kWidth; x++)
+      uv[y / 2 * kWidth + x] = chroma(x, y, x & 1);
+  return ib;
+}
+
+static std::shared_ptr<MediaBuffer> g_got;
+
+static bool keep_input(Flow *f _UNUSED, MediaBufferVector &input_vector) {
+  g_got = input_vector[0];
+  return true;
+}
+
+class SinkFlow : public Flow {
+public:
+  SinkFlow(bool views) {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    sm.process = keep_input;
+    sm.thread_model = Model::SYNC;
+    sm.mode_when_full = InputMode::DROPFRONT;
+    sm.input_maxcachenum.push_back(0);
+    if (!InstallSlotMap(sm, "image_view_sink", 0))
+      SetError(-EINVAL);
+    SetAcceptImageViews(views);
+  }
+  virtual ~SinkFlow() { StopAllThread(); }
+};
+
+int main() {
+  auto image = create_image();
+  if (!image) {
+    printf("FAIL: no memory\n");
+    return -1;
+  }
+
+  // odd corner, aligned down to 2 for NV12
+  ImageRect rect = {11, 7, 21, 13};
+  auto view = std::make_shared<ImageBuffer>(image, rect);
+  if (view->GetOriginX() != 10 || view->GetOriginY() != 6 ||
+      view->GetWidth() != 20 || view->GetHeight() != 12 ||
+      view->GetVirWidth() != kWidth || view->GetPtr() != image->GetPtr()) {
+    printf("FAIL: view at (%d,%d) %dx%d\n", view->GetOriginX(),
+           view->GetOriginY(), view->GetWidth(), view->GetHeight());
+    return -1;
+  }
+  ImagePlane planes[MAX_IMAGE_PLANE_NUM];
+  view->GetPlanes(planes);
+  if (planes[0].offset != 6 * kWidth + 10 || planes[0].stride != kWidth ||
+      planes[1].offset != kWidth * kHeight + 3 * kWidth + 10 ||
+      planes[1].stride != kWidth) {
+    printf("FAIL: planes at %zu/%d, %zu/%d\n", planes[0].offset,
+           planes[0].stride, planes[1].offset, planes[1].stride);
+    return -1;
+  }
+  if (!check_pixels("view", *view, 10, 6))
+    return -1;
+
+  // views of views add up
+  ImageRect sub = {4, 2, 8, 6};
+  auto view2 = std::make_shared<ImageBuffer>(view, sub);
+  if (view2->GetOriginX() != 14 || view2->GetOriginY() != 8 ||
+      !check_pixels("view of view", *view2, 14, 8))
+    return -1;
+
+  // a wrapper of the view with its info keeps the origin
+  ImageBuffer wrapper(*std::static_pointer_cast<MediaBuffer>(view),
+                      view->GetImageInfo());
+  if (!wrapper.HasOrigin() || !check_pixels("wrapper", wrapper, 10, 6))
+    return -1;
+
+  auto copy = ImageBuffer::Materialize(view);
+  if (!copy || copy->HasOrigin() || copy->GetPtr() == view->GetPtr()) {
+    printf("FAIL: no plain copy of the view\n");
+    return -1;
+  }
+  auto plain = std::static_pointer_cast<ImageBuffer>(copy);
+  if (plain->GetVirWidth() != 20 || plain->GetVirHeight() != 12 ||
+      plain->GetValidSize() != 20 * 12 * 3 / 2 ||
+      !check_pixels("copy", *plain, 10, 6))
+    return -1;
+  if (ImageBuffer::Materialize(image) != image) {
+    printf("FAIL: an image without origin should not be copied\n");
+    return -1;
+  }
+
+  // flows which do not read the origin get a copy
+  std::shared_ptr<MediaBuffer> in = view;
+  auto sink = std::make_shared<SinkFlow>(false);
+  sink->SendInput(in, 0);
+  if (!g_got || g_got->HasOrigin() ||
+      !check_pixels("flow input",
+                    *std::static_pointer_cast<ImageBuffer>(g_got), 10, 6))
+    return -1;
+  g_got.reset();
+  auto aware = std::make_shared<SinkFlow>(true);
+  aware->SendInput(in, 0);
+  if (g_got != in) {
+    printf("FAIL: the view should be given as is\n");
+    return -1;
+  }
+  g_got.reset();
+
+  printf("PASS\n");
+  return 0;
+}
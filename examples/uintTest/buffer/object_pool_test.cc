@@ -0,0 +1,105 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Create and drop the per-frame buffer wrappers as the flows do, first for a
+// warm-up, then for -n iterations on 1 and -t threads. Once the pool is
+// warm, every wrapper and control block must come from the free lists.
+// Return 0 if ObjectPool took nothing from the heap after the warm-up and
+// all the blocks came back.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "object_pool.h"
+
+using namespace easymedia;
+
+static int nop_delete(void *arg _UNUSED) { return 0; }
+
+// What a frame costs: a wrapper with its userdata, an image view of it and
+// a shared copy handed to a second consumer.
+static void one_frame(int i) {
+  static char frame[64];
+  void *data = frame;
+  auto mb = MakePooled<MediaBuffer>(data, sizeof(frame), -1, data, nop_delete);
+  mb->SetUSTimeStamp(i);
+  ImageInfo info = {PIX_FMT_NV12, 4, 4, 4, 4};
+  auto ib = MakePooled<ImageBuffer>(*mb, info);
+  std::shared_ptr<MediaBuffer> copy = ib;
+  mb->SetUserData(data, nullptr);
+  copy.reset();
+}
+
+static void loop(int num) {
+  for (int i = 0; i < num; i++)
+    one_frame(i);
+}
+
+static void run(int threads, int num) {
+  std::vector<std::thread> ths;
+  for (int i = 0; i < threads; i++)
+    ths.emplace_back(loop, num);
+  for (auto &th : ths)
+    th.join();
+}
+
+static bool check(int threads, int num) {
+  // warm up with the same parallelism, the peak of blocks in use
+  // depends on how many threads hold a frame at once
+  run(threads, 100);
+  ObjectPoolStats before, after;
+  ObjectPool::GetStats(before);
+  run(threads, num);
+  ObjectPool::GetStats(after);
+  printf("%d thread(s): %llu allocs, %llu from heap, %llu in use, %llu bytes reserved\n",
+         threads, (unsigned long long)(after.allocs - before.allocs),
+         (unsigned long long)(after.heap_allocs - before.heap_allocs),
+         (unsigned long long)after.in_use,
+         (unsigned long long)after.reserved);
+  if (after.allocs - before.allocs < (uint64_t)threads * num) {
+    printf("FAIL: the wrappers do not come from the pool\n");
+    return false;
+  }
+  if (after.heap_allocs != before.heap_allocs ||
+      after.reserved != before.reserved) {
+    printf("FAIL: new heap allocations after the warm-up\n");
+    return false;
+  }
+  if (after.in_use != before.in_use) {
+    printf("FAIL: %lld blocks not given back\n",
+           (long long)(after.in_use - before.in_use));
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int num = 100000, threads = 4;
+  int c;
+  while ((c = getopt(argc, argv, "n:t:h")) != -1) {
+    switch (c) {
+    case 'n':
+      num = atoi(optarg);
+      break;
+    case 't':
+      threads = atoi(optarg);
+      break;
+    default:
+      printf("Usage: %s [-n iterations] [-t threads]\n", argv[0]);
+      return 0;
+    }
+  }
+  if (num <= 0 || threads <= 0)
+    return -1;
+
+  if (!check(1, num) || !check(threads, num))
+    return -1;
+  printf("PASS\n");
+  return 0;
+}
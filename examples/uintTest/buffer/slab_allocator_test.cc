@@ -0,0 +1,108 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Allocate blocks of -s bytes under a memory cap of -c bytes until one
+// fails, free them all, then trim.
+// Return 0 if an allocation failed once the cap was reached, without going
+// above it, the freed blocks were kept for reuse and Trim gave them back.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "slab_allocator.h"
+
+using namespace easymedia;
+
+static void print_stats(const char *step, const SlabStats &st) {
+  printf("%s: in use:%llu, cached:%llu, reserved:%llu, fail:%llu\n", step,
+         (unsigned long long)st.in_use_bytes,
+         (unsigned long long)st.cached_bytes,
+         (unsigned long long)st.reserved_bytes,
+         (unsigned long long)st.fail_cnt);
+}
+
+int main(int argc, char **argv) {
+  size_t cap = 4 << 20, size = 64 << 10;
+  int c;
+  while ((c = getopt(argc, argv, "c:s:h")) != -1) {
+    switch (c) {
+    case 'c':
+      cap = strtoul(optarg, nullptr, 0);
+      break;
+    case 's':
+      size = strtoul(optarg, nullptr, 0);
+      break;
+    default:
+      printf("Usage: %s [-c cap_bytes] [-s block_bytes]\n", argv[0]);
+      return 0;
+    }
+  }
+  if (!size || cap < size * 4)
+    return -1;
+
+  SlabStats st, before;
+  // keep all the freed blocks, to see them go on Trim
+  SlabAllocator::SetCacheMax(cap);
+  SlabAllocator::SetMemCap(cap);
+  SlabAllocator::GetStats(before);
+
+  std::vector<void *> blocks;
+  size_t limit = cap / size + 1;
+  while (blocks.size() < limit) {
+    void *ptr = SlabAllocator::Allocate(size);
+    if (!ptr)
+      break;
+    blocks.push_back(ptr);
+  }
+  SlabAllocator::GetStats(st);
+  print_stats("capped", st);
+  if (blocks.size() == limit || st.fail_cnt == before.fail_cnt) {
+    printf("FAIL: %zu blocks of %zu bytes allocated under a cap of %zu\n",
+           blocks.size(), size, cap);
+    return -1;
+  }
+  if (st.reserved_bytes > cap || st.peak_reserved_bytes > cap) {
+    printf("FAIL: reserved %llu bytes, peak %llu, above the cap\n",
+           (unsigned long long)st.reserved_bytes,
+           (unsigned long long)st.peak_reserved_bytes);
+    return -1;
+  }
+  if (blocks.size() < cap / size / 2) {
+    printf("FAIL: only %zu blocks allocated\n", blocks.size());
+    return -1;
+  }
+
+  for (auto ptr : blocks)
+    SlabAllocator::Deallocate(ptr);
+  SlabAllocator::GetStats(st);
+  print_stats("freed", st);
+  if (st.in_use_bytes != before.in_use_bytes || !st.cached_bytes) {
+    printf("FAIL: the freed blocks are not kept for reuse\n");
+    return -1;
+  }
+
+  uint64_t sys_free = st.sys_free_cnt;
+  SlabAllocator::Trim();
+  SlabAllocator::GetStats(st);
+  print_stats("trimmed", st);
+  if (st.cached_bytes || st.reserved_bytes != st.in_use_bytes ||
+      st.sys_free_cnt - sys_free < blocks.size()) {
+    printf("FAIL: Trim did not give the memory back\n");
+    return -1;
+  }
+
+  // the room is back
+  void *ptr = SlabAllocator::Allocate(size);
+  if (!ptr) {
+    printf("FAIL: cannot allocate after Trim\n");
+    return -1;
+  }
+  SlabAllocator::Deallocate(ptr);
+  SlabAllocator::SetMemCap(0);
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Copy on write: a flow sends its output to a keeper, which may hold the
+// buffer, and to a writer, which draws into it in place after
+// MakeWritable. The writer must copy the buffer only while the keeper holds
+// it or has not got it yet.
+// Return 0 if every frame was copied when, and only when, it was shared.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "flow.h"
+
+using namespace easymedia;
+
+static bool g_keep = false;
+static std::shared_ptr<MediaBuffer> g_kept;
+static bool g_copied = false;
+
+static bool keep_input(Flow *f _UNUSED, MediaBufferVector &input_vector) {
+  if (g_keep)
+    g_kept = input_vector[0];
+  return true;
+}
+
+static bool pass_input(Flow *f, MediaBufferVector &input_vector);
+
+static bool write_input(Flow *f _UNUSED, MediaBufferVector &input_vector) {
+  auto mb = input_vector[0];
+  void *ptr = mb->GetPtr();
+  if (!MediaBuffer::MakeWritable(mb))
+    return false;
+  g_copied = mb->GetPtr() != ptr;
+  memset(mb->GetPtr(), 0xFF, mb->GetValidSize());
+  return true;
+}
+
+class TestFlow : public Flow {
+public:
+  TestFlow(FunctionProcess func, bool output) {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    if (output)
+      sm.output_slots.push_back(0);
+    sm.process = func;
+    sm.thread_model = Model::SYNC;
+    sm.mode_when_full = InputMode::DROPFRONT;
+    sm.input_maxcachenum.push_back(0);
+    if (!InstallSlotMap(sm, "cow_test", 0))
+      SetError(-EINVAL);
+  }
+  virtual ~TestFlow() { StopAllThread(); }
+
+private:
+  friend bool pass_input(Flow *f, MediaBufferVector &input_vector);
+};
+
+bool pass_input(Flow *f, MediaBufferVector &input_vector) {
+  return static_cast<TestFlow *>(f)->SetOutput(input_vector[0], 0);
+}
+
+static std::shared_ptr<MediaBuffer> new_frame() {
+  auto mb = MediaBuffer::Alloc(64);
+  memset(mb->GetPtr(), 0, 64);
+  mb->SetValidSize(64);
+  return mb;
+}
+
+// Send a frame, return false if the writer did not copy as expected.
+static bool run(const char *name, std::shared_ptr<Flow> &source, bool keep,
+                bool expect_copy) {
+  g_keep = keep;
+  g_copied = false;
+  auto mb = new_frame();
+  source->SendInput(mb, 0);
+  bool ok = true;
+  printf("%s: %s\n", name, g_copied ? "copied" : "written in place");
+  if (g_copied != expect_copy) {
+    printf("FAIL: %s: expect %s\n", name, expect_copy ? "a copy" : "no copy");
+    ok = false;
+  }
+  if (keep && (!g_kept || ((uint8_t *)g_kept->GetPtr())[0] != 0)) {
+    printf("FAIL: %s: the kept buffer was written\n", name);
+    ok = false;
+  }
+  g_kept.reset();
+  return ok;
+}
+
+int main() {
+  std::shared_ptr<Flow> source = std::make_shared<TestFlow>(pass_input, true);
+  std::shared_ptr<Flow> keeper = std::make_shared<TestFlow>(keep_input, false);
+  std::shared_ptr<Flow> writer =
+      std::make_shared<TestFlow>(write_input, false);
+  if (source->GetError() || keeper->GetError() || writer->GetError()) {
+    printf("create flows failed\n");
+    return -1;
+  }
+  CowStats before, after;
+  MediaBuffer::GetCowStats(before);
+
+  bool ok = true;
+  // a single consumer
+  source->AddDownFlow(writer, 0, 0);
+  ok = run("alone", source, false, false) && ok;
+
+  // the keeper runs first
+  source->RemoveDownFlow(writer);
+  source->AddDownFlow(keeper, 0, 0);
+  source->AddDownFlow(writer, 0, 0);
+  ok = run("kept", source, true, true) && ok;
+  ok = run("released", source, false, false) && ok;
+  ok = run("kept again", source, true, true) && ok;
+
+  // the writer runs first, the keeper has not got it yet
+  source->RemoveDownFlow(keeper);
+  source->AddDownFlow(keeper, 0, 0);
+  ok = run("not received yet", source, false, true) && ok;
+  source->RemoveDownFlow(keeper);
+  source->RemoveDownFlow(writer);
+
+  // shares out of the flows
+  auto mb = new_frame();
+  auto first = MediaBuffer::Share(mb);
+  auto second = MediaBuffer::Share(mb);
+  auto copy = first;
+  if (!MediaBuffer::MakeWritable(first) || first.get() == mb.get()) {
+    printf("FAIL: a buffer with two shares is not copied\n");
+    ok = false;
+  }
+  copy.reset();
+  if (!MediaBuffer::MakeWritable(second) || second.get() != mb.get()) {
+    printf("FAIL: the last share is copied\n");
+    ok = false;
+  }
+
+  MediaBuffer::GetCowStats(after);
+  printf("MakeWritable: %llu, copies: %llu\n",
+         (unsigned long long)(after.write_cnt - before.write_cnt),
+         (unsigned long long)(after.clone_cnt - before.clone_cnt));
+  if (after.clone_cnt - before.clone_cnt != 4) {
+    printf("FAIL: expect 4 copies\n");
+    ok = false;
+  }
+  if (!ok)
+    return -1;
+  printf("PASS\n");
+  return 0;
+}
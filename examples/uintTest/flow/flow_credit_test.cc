@@ -0,0 +1,151 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Credit-based flow control: a fast producer feeds a costly stage, which
+// feeds a slow sink with a short input queue. Without credit control the
+// stage processes every frame and the sink drops most of them. With it, the
+// stage skips the frames the sink has no room for.
+// Return 0 if the stage works about as much as the sink can take.
+
+#include <atomic>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "flow.h"
+#include "utils.h"
+
+namespace easymedia {
+
+static std::atomic_int g_staged(0);
+static std::atomic_int g_sunk(0);
+static int g_sink_ms = 20;
+
+static bool credit_stage(Flow *f, MediaBufferVector &input_vector);
+
+class CreditStageFlow : public Flow {
+public:
+  CreditStageFlow(bool credit) {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    sm.output_slots.push_back(0);
+    sm.process = credit_stage;
+    sm.thread_model = Model::ASYNCCOMMON;
+    sm.mode_when_full = InputMode::DROPFRONT;
+    sm.input_maxcachenum.push_back(0);
+    if (!InstallSlotMap(sm, "credit_stage", 0))
+      SetError(-EINVAL);
+    SetCreditControl(credit);
+  }
+  virtual ~CreditStageFlow() { StopAllThread(); }
+
+private:
+  friend bool credit_stage(Flow *f, MediaBufferVector &input_vector);
+};
+
+bool credit_stage(Flow *f, MediaBufferVector &input_vector) {
+  auto &mb = input_vector[0];
+  if (!mb)
+    return false;
+  g_staged++;
+  return static_cast<CreditStageFlow *>(f)->SetOutput(mb, 0);
+}
+
+static bool credit_sink(Flow *f _UNUSED, MediaBufferVector &input_vector) {
+  if (!input_vector[0])
+    return false;
+  msleep(g_sink_ms);
+  g_sunk++;
+  return true;
+}
+
+class CreditSinkFlow : public Flow {
+public:
+  CreditSinkFlow() {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    sm.process = credit_sink;
+    sm.thread_model = Model::ASYNCCOMMON;
+    sm.mode_when_full = InputMode::DROPFRONT;
+    sm.input_maxcachenum.push_back(2);
+    if (!InstallSlotMap(sm, "credit_sink", 0))
+      SetError(-EINVAL);
+  }
+  virtual ~CreditSinkFlow() { StopAllThread(); }
+};
+
+} // namespace easymedia
+
+using namespace easymedia;
+
+// Push frames every interval_us, return the number of staged frames.
+static int run(bool credit, int frames, int interval_us, uint64_t &skipped) {
+  g_staged = 0;
+  g_sunk = 0;
+  auto stage = std::make_shared<CreditStageFlow>(credit);
+  std::shared_ptr<Flow> sink = std::make_shared<CreditSinkFlow>();
+  if (stage->GetError() || sink->GetError()) {
+    printf("create flows failed\n");
+    return -1;
+  }
+  stage->AddDownFlow(sink, 0, 0);
+  auto mb = std::make_shared<MediaBuffer>();
+  for (int i = 0; i < frames; i++) {
+    stage->SendInput(mb, 0);
+    easymedia::usleep(interval_us);
+  }
+  // let the stage drain its queue
+  for (int i = 0; i < 100 && !stage->IsAllBuffEmpty(); i++)
+    msleep(10);
+  FlowStats stats;
+  stage->GetStats(stats);
+  skipped = stats.credit_skipped;
+  printf("credit %s: pushed %d, staged %d, sunk %d, skipped %llu\n",
+         credit ? "on " : "off", frames, (int)g_staged, (int)g_sunk,
+         (unsigned long long)skipped);
+  stage->RemoveDownFlow(sink);
+  return g_staged;
+}
+
+int main(int argc, char **argv) {
+  int frames = 200, interval_us = 1000;
+  int c;
+  while ((c = getopt(argc, argv, "n:i:s:h")) != -1) {
+    switch (c) {
+    case 'n':
+      frames = atoi(optarg);
+      break;
+    case 'i':
+      interval_us = atoi(optarg);
+      break;
+    case 's':
+      g_sink_ms = atoi(optarg);
+      break;
+    default:
+      printf("Usage: %s [-n frames] [-i interval_us] [-s sink_ms]\n",
+             argv[0]);
+      return 0;
+    }
+  }
+  if (frames <= 0 || interval_us < 0 || g_sink_ms <= 0)
+    return -1;
+
+  uint64_t skipped = 0;
+  int without = run(false, frames, interval_us, skipped);
+  if (without != frames || skipped) {
+    printf("FAIL: without credit, every frame should be staged\n");
+    return -1;
+  }
+  int with = run(true, frames, interval_us, skipped);
+  // the sink takes one frame per g_sink_ms plus what its queue holds
+  int sink_can = (int)((int64_t)frames * interval_us / 1000 / g_sink_ms) + 4;
+  if (with < 0 || with > sink_can * 2 || (int)skipped + with != frames) {
+    printf("FAIL: with credit, staged %d, expect at most %d\n", with,
+           sink_can * 2);
+    return -1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,227 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compare the thread-per-flow model (asynccommon) with the shared executor
+// model (asyncpool): build several chains of pass-through flows, push frames
+// at a fixed fps, then report the end-to-end latency and the context
+// switches of the whole process.
+// With -q N the inputs are bounded to N buffers and use the lock-free ring,
+// otherwise they use the unbounded deque.
+
+#include <atomic>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "buffer.h"
+#include "flow.h"
+#include "key_string.h"
+#include "utils.h"
+
+namespace easymedia {
+
+static bool bench_src(Flow *f, MediaBufferVector &input_vector);
+
+class BenchSourceFlow : public Flow {
+public:
+  BenchSourceFlow() {
+    if (!SetAsSource(std::vector<int>({0}), bench_src, "bench_src"))
+      SetError(-EINVAL);
+  }
+  virtual ~BenchSourceFlow() { StopAllThread(); }
+  void Push(std::shared_ptr<MediaBuffer> &mb) { SendInput(mb, 0); }
+
+private:
+  friend bool bench_src(Flow *f, MediaBufferVector &input_vector);
+};
+
+bool bench_src(Flow *f, MediaBufferVector &input_vector) {
+  BenchSourceFlow *flow = static_cast<BenchSourceFlow *>(f);
+  return flow->SetOutput(input_vector[0], 0);
+}
+
+static volatile int g_work_loops = 2000;
+static int g_cache_num = 0;
+
+static bool bench_stage(Flow *f, MediaBufferVector &input_vector);
+
+class BenchStageFlow : public Flow {
+public:
+  BenchStageFlow(Model model) {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    sm.output_slots.push_back(0);
+    sm.process = bench_stage;
+    sm.thread_model = model;
+    sm.mode_when_full = InputMode::BLOCKING;
+    sm.input_maxcachenum.push_back(g_cache_num);
+    if (!InstallSlotMap(sm, "bench_stage", 0))
+      SetError(-EINVAL);
+  }
+  virtual ~BenchStageFlow() { StopAllThread(); }
+
+private:
+  friend bool bench_stage(Flow *f, MediaBufferVector &input_vector);
+};
+
+bool bench_stage(Flow *f, MediaBufferVector &input_vector) {
+  auto &mb = input_vector[0];
+  if (!mb)
+    return false;
+  // a tiny amount of cpu work, like a lightweight filter
+  volatile uint32_t acc = 0;
+  for (int i = 0; i < g_work_loops; i++)
+    acc += i * 2654435761U;
+  return static_cast<BenchStageFlow *>(f)->SetOutput(mb, 0);
+}
+
+static std::atomic<int64_t> g_latency_sum(0);
+static std::atomic<int64_t> g_latency_max(0);
+static std::atomic_int g_frames(0);
+
+static bool bench_sink(Flow *f _UNUSED, MediaBufferVector &input_vector) {
+  auto &mb = input_vector[0];
+  if (!mb)
+    return false;
+  int64_t delta = gettimeofday() - mb->GetAtomicClock();
+  g_latency_sum += delta;
+  int64_t old = g_latency_max;
+  while (delta > old && !g_latency_max.compare_exchange_weak(old, delta))
+    ;
+  g_frames++;
+  return true;
+}
+
+class BenchSinkFlow : public Flow {
+public:
+  BenchSinkFlow(Model model) {
+    SlotMap sm;
+    sm.input_slots.push_back(0);
+    sm.process = bench_sink;
+    sm.thread_model = model;
+    sm.mode_when_full = InputMode::BLOCKING;
+    sm.input_maxcachenum.push_back(g_cache_num);
+    if (!InstallSlotMap(sm, "bench_sink", 0))
+      SetError(-EINVAL);
+  }
+  virtual ~BenchSinkFlow() { StopAllThread(); }
+};
+
+} // namespace easymedia
+
+using namespace easymedia;
+
+static void usage(char *name) {
+  printf("Usage: %s [-m asynccommon|asyncpool] [-c chains] [-s stages] "
+         "[-n frames] [-f fps] [-w work_loops] [-q cache_num]\n",
+         name);
+}
+
+int main(int argc, char **argv) {
+  std::string model_str = KEY_ASYNCPOOL;
+  int chains = 8, stages = 4, frames = 300, fps = 30;
+  int c;
+
+  while ((c = getopt(argc, argv, "m:c:s:n:f:w:q:h")) != -1) {
+    switch (c) {
+    case 'm':
+      model_str = optarg;
+      break;
+    case 'c':
+      chains = atoi(optarg);
+      break;
+    case 's':
+      stages = atoi(optarg);
+      break;
+    case 'n':
+      frames = atoi(optarg);
+      break;
+    case 'f':
+      fps = atoi(optarg);
+      break;
+    case 'w':
+      g_work_loops = atoi(optarg);
+      break;
+    case 'q':
+      g_cache_num = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 0;
+    }
+  }
+  Model model;
+  if (model_str == KEY_ASYNCCOMMON) {
+    model = Model::ASYNCCOMMON;
+  } else if (model_str == KEY_ASYNCPOOL) {
+    model = Model::POOL;
+  } else {
+    usage(argv[0]);
+    return -1;
+  }
+  if (chains <= 0 || stages <= 0 || frames <= 0 || fps <= 0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  std::vector<std::shared_ptr<BenchSourceFlow>> sources;
+  std::vector<std::shared_ptr<Flow>> flows;
+  for (int i = 0; i < chains; i++) {
+    auto src = std::make_shared<BenchSourceFlow>();
+    std::shared_ptr<Flow> up = src;
+    for (int j = 0; j < stages; j++) {
+      std::shared_ptr<Flow> stage = std::make_shared<BenchStageFlow>(model);
+      if (stage->GetError()) {
+        printf("create stage flow failed\n");
+        return -1;
+      }
+      up->AddDownFlow(stage, 0, 0);
+      flows.push_back(stage);
+      up = stage;
+    }
+    std::shared_ptr<Flow> sink = std::make_shared<BenchSinkFlow>(model);
+    if (sink->GetError()) {
+      printf("create sink flow failed\n");
+      return -1;
+    }
+    up->AddDownFlow(sink, 0, 0);
+    flows.push_back(sink);
+    sources.push_back(src);
+  }
+
+  struct rusage ru_begin, ru_end;
+  getrusage(RUSAGE_SELF, &ru_begin);
+  int64_t interval = 1000000 / fps;
+  int64_t start = gettimeofday();
+  for (int n = 0; n < frames; n++) {
+    for (auto &src : sources) {
+      auto mb = std::make_shared<MediaBuffer>();
+      mb->SetAtomicClock(gettimeofday());
+      src->Push(mb);
+    }
+    int64_t remain = start + interval * (n + 1) - gettimeofday();
+    if (remain > 0)
+      easymedia::usleep(remain);
+  }
+  // wait for the tail frames
+  for (int i = 0; i < 100 && g_frames < frames * chains; i++)
+    msleep(10);
+  getrusage(RUSAGE_SELF, &ru_end);
+
+  int done = g_frames;
+  printf("model: %s, chains: %d, stages: %d, cache: %d, frames: %d/%d\n",
+         model_str.c_str(), chains, stages, g_cache_num, done,
+         frames * chains);
+  printf("latency avg: %.3f ms, max: %.3f ms\n",
+         done ? g_latency_sum / 1000.0 / done : 0.0, g_latency_max / 1000.0);
+  printf("voluntary ctxsw: %ld, involuntary ctxsw: %ld\n",
+         ru_end.ru_nvcsw - ru_begin.ru_nvcsw,
+         ru_end.ru_nivcsw - ru_begin.ru_nivcsw);
+
+  sources.clear();
+  flows.clear();
+  return 0;
+}
@@ -14,12 +14,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <deque>
 #include <string>
 
 #include "buffer.h"
 #include "stream.h"
 
-static char optstr[] = "?i:o:d:w:h:f:c:";
+static char optstr[] = "?i:o:d:w:h:f:c:m:D:s:";
 
 int main(int argc, char **argv) {
   int c;
@@ -30,6 +31,9 @@ int main(int argc, char **argv) {
   std::string output_format;
   bool display = false;
   int dump_frm = 100;
+  std::string mem_type = KEY_V4L2_M_TYPE(MEMORY_DMABUF);
+  int detach_ms = 0;
+  int hold_ms = 0;
 
   opterr = 1;
   while ((c = getopt(argc, argv, optstr)) != -1) {
@@ -65,6 +69,18 @@ int main(int argc, char **argv) {
       dump_frm = atoi(optarg);
       printf("dump frame count: %d\n", dump_frm);
       break;
+    case 'm':
+      if (!strcmp(optarg, "mmap"))
+        mem_type = KEY_V4L2_M_TYPE(MEMORY_MMAP);
+      break;
+    case 'D':
+      detach_ms = atoi(optarg);
+      printf("detach buffers held for %d ms\n", detach_ms);
+      break;
+    case 's':
+      hold_ms = atoi(optarg);
+      printf("slow consumer, hold each frame for %d ms\n", hold_ms);
+      break;
     case '?':
     default:
       printf("usage example: \n");
@@ -72,12 +88,16 @@ int main(int argc, char **argv) {
              "image:yuyv422\n");
       printf("camera_cap_test -d 1 -o output.yuv -w 1920 -h 1080 -f "
              "image:nv16,image:argb8888\n");
+      printf("slow consumer on the vivid driver, fps with and without "
+             "detach:\n");
+      printf("camera_cap_test -i /dev/video0 -m mmap -w 640 -h 360 -f "
+             "image:yuyv422 -s 200 [-D 40]\n");
       exit(0);
     }
   }
   if (input_path.empty())
     exit(EXIT_FAILURE);
-  if (output_path.empty() && !display)
+  if (output_path.empty() && !display && !hold_ms)
     exit(EXIT_FAILURE);
   if (!w || !h)
     exit(EXIT_FAILURE);
@@ -94,8 +114,10 @@ int main(int argc, char **argv) {
   PARAM_STRING_APPEND(param, KEY_DEVICE, input_path);
   // PARAM_STRING_APPEND(param, KEY_SUB_DEVICE, sub_input_path);
   PARAM_STRING_APPEND(param, KEY_V4L2_CAP_TYPE, KEY_V4L2_C_TYPE(VIDEO_CAPTURE));
-  PARAM_STRING_APPEND(param, KEY_V4L2_MEM_TYPE, KEY_V4L2_M_TYPE(MEMORY_DMABUF));
+  PARAM_STRING_APPEND(param, KEY_V4L2_MEM_TYPE, mem_type);
   PARAM_STRING_APPEND_TO(param, KEY_FRAMES, 4); // if not set, default is 2
+  if (detach_ms > 0)
+    PARAM_STRING_APPEND_TO(param, KEY_V4L2_DETACH_MS, detach_ms);
   PARAM_STRING_APPEND(param, KEY_OUTPUTDATATYPE, input_format);
   PARAM_STRING_APPEND_TO(param, KEY_BUFFER_WIDTH, w);
   PARAM_STRING_APPEND_TO(param, KEY_BUFFER_HEIGHT, h);
@@ -115,16 +137,26 @@ int main(int argc, char **argv) {
     PARAM_STRING_APPEND(param, KEY_OPEN_MODE, "we");
     output = easymedia::REFLECTOR(Stream)::Create<easymedia::Stream>(
         stream_name.c_str(), param.c_str());
-  } else {
+  } else if (!hold_ms) {
     fprintf(stderr, "TODO: display to screen");
     exit(EXIT_FAILURE);
   }
-  assert(output);
 
+  // frames kept by the slow consumer, with the time they arrived
+  std::deque<std::pair<std::shared_ptr<easymedia::MediaBuffer>, int64_t>> held;
+  easymedia::AutoDuration ad;
+  int frames = dump_frm;
   while (dump_frm-- > 0) {
     auto buffer = input->Read();
     assert(buffer && buffer->GetValidSize() > 0);
-    output->Write(buffer->GetPtr(), 1, buffer->GetValidSize());
+    if (output)
+      output->Write(buffer->GetPtr(), 1, buffer->GetValidSize());
+    if (hold_ms) {
+      int64_t now = easymedia::gettimeofday();
+      while (!held.empty() && now - held.front().second >= hold_ms * 1000LL)
+        held.pop_front();
+      held.emplace_back(buffer, now);
+    }
     if (buffer->GetType() == Type::Image) {
       // if type image, we can static cast it
       auto img_buffer =
@@ -133,6 +165,8 @@ int main(int argc, char **argv) {
     }
   }
 
+  printf("%d frames, %.2f fps\n", frames, frames * 1000000.0 / ad.Get());
+  held.clear();
   output.reset();
   input.reset();
 
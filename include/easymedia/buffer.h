@@ -9,11 +9,15 @@
 #include <string.h>
 #include <sys/time.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "image.h"
 #include "lock.h"
 #include "media_type.h"
+#include "object_pool.h"
 #include "rknn_user.h"
 #include "sound.h"
 
@@ -33,6 +37,21 @@ enum drm_rockchip_gem_mem_type {
   ROCKCHIP_BO_MASK = ROCKCHIP_BO_CONTIG | ROCKCHIP_BO_CACHABLE | ROCKCHIP_BO_WC
 };
 
+/* common memory only: prefaulted huge pages, for the large frames touched
+ * by the cpu. Falls back to 4K pages, see SlabAllocator. */
+static const unsigned int MEM_FLAG_HUGE_PAGE = 1 << 16;
+
+class BufferPool;
+
+typedef struct {
+  // MakeWritable calls, and how many of them had to copy a shared buffer
+  uint64_t write_cnt;
+  uint64_t clone_cnt;
+  // copies taken from a BufferPool, and copies which failed
+  uint64_t pool_clone_cnt;
+  uint64_t fail_cnt;
+} CowStats;
+
 // wrapping existing buffer
 class _API MediaBuffer {
 public:
@@ -49,18 +68,24 @@ public:
 
   MediaBuffer()
       : ptr(nullptr), size(0), fd(-1), valid_size(0), type(Type::None),
-        user_flag(0), ustimestamp(0), eof(false), tsvc_level(-1) {}
+        user_flag(0), ustimestamp(0), eof(false), tsvc_level(-1),
+        sharers(0) {}
   // Set userdata and delete function if you want free resource when destrut.
   MediaBuffer(void *buffer_ptr, size_t buffer_size, int buffer_fd = -1,
               void *user_data = nullptr, DeleteFun df = nullptr)
       : ptr(buffer_ptr), size(buffer_size), fd(buffer_fd), valid_size(0),
         type(Type::None), user_flag(0), ustimestamp(0), eof(false),
-        tsvc_level(-1) {
+        tsvc_level(-1), sharers(0) {
     SetUserData(user_data, df);
   }
+  // Pins buffer while copying it, see Pin.
+  MediaBuffer(const MediaBuffer &buffer);
+  MediaBuffer &operator=(const MediaBuffer &) = default;
   virtual ~MediaBuffer() = default;
   virtual PixelFormat GetPixelFormat() const { return PIX_FMT_NONE; }
   virtual SampleFormat GetSampleFormat() const { return SAMPLE_FMT_NONE; }
+  // true for the image crop views not starting at GetPtr(), see ImageBuffer
+  virtual bool HasOrigin() const { return false; }
   void BeginCPUAccess(bool readonly);
   void EndCPUAccess(bool readonly);
   int GetFD() const { return fd; }
@@ -95,11 +120,12 @@ public:
   void SetTsvcLevel(int _level) { tsvc_level = _level; }
 
   void SetUserData(void *user_data, DeleteFun df) {
+    // a control block per buffer, take it from the pool
     if (user_data) {
       if (df)
-        userdata.reset(user_data, df);
-      else
-        userdata.reset(user_data, [](void *) {}); // do nothing when delete
+        userdata.reset(user_data, df, PoolAllocator<void>());
+      else // do nothing when delete
+        userdata.reset(user_data, [](void *) {}, PoolAllocator<void>());
     } else {
       userdata.reset();
     }
@@ -147,6 +173,43 @@ public:
   static std::shared_ptr<MediaBuffer>
   Clone(MediaBuffer &src, MemType dst_type = MemType::MEM_COMMON);
 
+  // Copy on write. A buffer sent to several consumers at once is shared:
+  // each of them gets a Share of it, and a consumer writing into it in place
+  // must call MakeWritable first. It keeps mb if no other share is held any
+  // more, else replaces mb by a private copy, of the same kind and
+  // attributes, taken from pool if given and possible.
+  // Return false if the copy failed.
+  static bool MakeWritable(std::shared_ptr<MediaBuffer> &mb,
+                           BufferPool *pool = nullptr);
+  // A pointer to mb which counts as one more holder of it until it and its
+  // copies are all dropped.
+  static std::shared_ptr<MediaBuffer>
+  Share(const std::shared_ptr<MediaBuffer> &mb);
+  void AddSharers(int n) { __atomic_add_fetch(&sharers, n, __ATOMIC_RELEASE); }
+  bool IsShared() const {
+    return __atomic_load_n(&sharers, __ATOMIC_ACQUIRE) > 1;
+  }
+  static void GetCowStats(CowStats &stats);
+  // A reader of the memory outside of the flow which holds the buffer pins
+  // it for the time it uses it; the flows pin their inputs during process.
+  // Capture buffers held too long can be moved to other memory, so that
+  // the driver gets them back, but never while pinned. A copy of the
+  // wrapper pins the source while copying it; Slice and the crop views pin
+  // their parent for their lifetime.
+  virtual void Pin() {}
+  virtual void Unpin() {}
+  // A new wrapper of the same kind, with the same attributes, around the
+  // same memory.
+  virtual std::shared_ptr<MediaBuffer> Duplicate() const {
+    return MakePooled<MediaBuffer>(*this);
+  }
+  // A view of length bytes at offset of parent, without copy. The view keeps
+  // the parent alive and takes its attributes. It has no fd, as an offset
+  // into a dma buffer cannot be told through it.
+  static std::shared_ptr<MediaBuffer>
+  Slice(const std::shared_ptr<MediaBuffer> &parent, size_t offset,
+        size_t length);
+
 private:
   // copy attributs except buffer
   void CopyAttribute(MediaBuffer &src_attr);
@@ -161,6 +224,8 @@ private:
   int64_t atomic_clock;
   bool eof;
   int tsvc_level; // for avc/hevc encoder
+  // shares held, atomic
+  int sharers;
   std::shared_ptr<void> userdata;
   std::vector<std::shared_ptr<void>> related_sptrs;
 };
@@ -185,6 +250,10 @@ public:
     return sample_info.fmt;
   }
 
+  virtual std::shared_ptr<MediaBuffer> Duplicate() const override {
+    return MakePooled<SampleBuffer>(*this);
+  }
+
   SampleInfo &GetSampleInfo() { return sample_info; }
   size_t GetSampleSize() const { return ::GetSampleSize(sample_info); }
   void SetSamples(int num) {
@@ -211,52 +280,78 @@ public:
   ImageBuffer(const MediaBuffer &buffer) : MediaBuffer(buffer) {
     ResetValues();
   }
-  ImageBuffer(const MediaBuffer &buffer, const ImageInfo &info)
-      : MediaBuffer(buffer), image_info(info) {
-    SetType(Type::Image);
-    // if set a valid info, set valid size
-    size_t s = CalPixFmtSize(info);
-    if (s > 0)
-      SetValidSize(s);
-  }
+  // A crop view keeps its origin, the memory is the same.
+  ImageBuffer(const MediaBuffer &buffer, const ImageInfo &info);
+  // Crop view of rect of parent, sharing its memory and fd, which it keeps
+  // alive. Width and height are the rect's, vir_width and vir_height stay
+  // the parent's, the origin and the planes locate the rect, so consumers
+  // taking them into account read the crop without copy, the other ones
+  // get a Materialize copy. The rect is clipped to the parent and, for yuv,
+  // aligned to 2. The view is not valid if the format has no plain planes.
+  ImageBuffer(const std::shared_ptr<ImageBuffer> &parent,
+              const ImageRect &rect);
   virtual ~ImageBuffer() = default;
   virtual PixelFormat GetPixelFormat() const override {
     return image_info.pix_fmt;
   }
+  virtual std::shared_ptr<MediaBuffer> Duplicate() const override {
+    return MakePooled<ImageBuffer>(*this);
+  }
   int GetWidth() const { return image_info.width; }
   int GetHeight() const { return image_info.height; }
   int GetVirWidth() const { return image_info.vir_width; }
   int GetVirHeight() const { return image_info.vir_height; }
   ImageInfo &GetImageInfo() { return image_info; }
   std::list<RknnResult> &GetRknnResult() { return nn_result; };
+  // pixel of the buffer where the image starts, not 0 for crop views only
+  int GetOriginX() const { return origin_x; }
+  int GetOriginY() const { return origin_y; }
+  virtual bool HasOrigin() const override { return origin_x || origin_y; }
+  // offsets from GetPtr() and strides of the planes of the image
+  int GetPlanes(ImagePlane planes[MAX_IMAGE_PLANE_NUM]) const {
+    return GetImagePlanes(image_info, origin_x, origin_y, planes);
+  }
+  // A plain copy of an image with an origin, starting at GetPtr() and
+  // strided by its width, for the consumers which ignore the origin.
+  // Other buffers are returned as they are, nullptr if the copy fails.
+  static std::shared_ptr<MediaBuffer>
+  Materialize(const std::shared_ptr<MediaBuffer> &mb);
 
 private:
   void ResetValues() {
     SetType(Type::Image);
     memset(&image_info, 0, sizeof(image_info));
     image_info.pix_fmt = PIX_FMT_NONE;
+    origin_x = 0;
+    origin_y = 0;
   }
   ImageInfo image_info;
   std::list<RknnResult> nn_result;
+  int origin_x;
+  int origin_y;
 };
 
 class MediaGroupBuffer {
 public:
-  MediaGroupBuffer() : pool(nullptr), ptr(nullptr), size(0), fd(-1) {}
+  MediaGroupBuffer()
+      : pool(nullptr), next_free(nullptr), busy(false), index(-1),
+        ptr(nullptr), size(0), fd(-1) {}
   // Set userdata and delete function if you want free resource when destrut.
   MediaGroupBuffer(void *buffer_ptr, size_t buffer_size, int buffer_fd = -1,
                    void *user_data = nullptr, DeleteFun df = nullptr)
-      : pool(nullptr), ptr(buffer_ptr), size(buffer_size), fd(buffer_fd) {
+      : pool(nullptr), next_free(nullptr), busy(false), index(-1),
+        ptr(buffer_ptr), size(buffer_size), fd(buffer_fd) {
     SetUserData(user_data, df);
   }
   virtual ~MediaGroupBuffer() = default;
 
   void SetUserData(void *user_data, DeleteFun df) {
+    // a control block per buffer, take it from the pool
     if (user_data) {
       if (df)
-        userdata.reset(user_data, df);
-      else
-        userdata.reset(user_data, [](void *) {}); // do nothing when delete
+        userdata.reset(user_data, df, PoolAllocator<void>());
+      else // do nothing when delete
+        userdata.reset(user_data, [](void *) {}, PoolAllocator<void>());
     } else {
       userdata.reset();
     }
@@ -270,10 +365,15 @@ public:
 
   static MediaGroupBuffer *
   Alloc(size_t size,
-        MediaBuffer::MemType type = MediaBuffer::MemType::MEM_COMMON);
+        MediaBuffer::MemType type = MediaBuffer::MemType::MEM_COMMON,
+        unsigned int flag = ROCKCHIP_BO_CACHABLE);
 
 public:
   void *pool;
+  // owned by the pool, with its lock held
+  MediaGroupBuffer *next_free;
+  bool busy;
+  int index; // in the buffers of the pool
 
 private:
   void *ptr; // buffer virtual address
@@ -283,22 +383,100 @@ private:
   std::shared_ptr<void> userdata;
 };
 
+typedef struct {
+  // the buffers, min_cnt <= buf_cnt <= max_cnt
+  int min_cnt;
+  int max_cnt;
+  // Elastic only. After a get, buffers are added while fewer than
+  // low_watermark are ready; a get finding none ready adds one.
+  // Both only once the pool has been short for grow_ms, 0 to grow at once:
+  // until then a blocking get waits for a put, a non-blocking one fails.
+  // When more than high_watermark stay ready for idle_ms, the extra ready
+  // buffers are freed.
+  int low_watermark;
+  int high_watermark;
+  int idle_ms;
+  int grow_ms;
+} BufferPoolParam;
+
+typedef struct {
+  uint64_t get_cnt;
+  // served by a ready buffer at once, or not
+  uint64_t hit_cnt;
+  uint64_t miss_cnt;
+  // misses which returned null, and which blocked
+  uint64_t fail_cnt;
+  uint64_t wait_cnt;
+  int64_t wait_time_avg; // us, of the blocked gets
+  int64_t wait_time_max;
+  uint64_t grow_cnt;
+  uint64_t shrink_cnt;
+  int buf_cnt;
+  int busy_cnt;
+  int peak_buf_cnt;
+  int peak_busy_cnt;
+} BufferPoolStats;
+
+// Get and put are O(1): the ready buffers form an intrusive LIFO list, so
+// the lock is only held for a few pointer moves, and the most recently used
+// buffer, likely still in cache, is handed out first. A put wakes a single
+// blocked getter.
+// A pool with max_cnt above min_cnt is elastic: it grows on starvation and
+// shrinks after idle periods, so it can be sized from the observed peaks.
 class _API BufferPool {
 public:
-  BufferPool(int cnt, int size, MediaBuffer::MemType type);
+  // flag: as of MediaBuffer::Alloc, such as MEM_FLAG_HUGE_PAGE, the buffers
+  // are allocated, thus prefaulted, at once
+  BufferPool(int cnt, int size, MediaBuffer::MemType type,
+             unsigned int flag = ROCKCHIP_BO_CACHABLE);
+  BufferPool(const BufferPoolParam &param, int size, MediaBuffer::MemType type,
+             unsigned int flag = ROCKCHIP_BO_CACHABLE);
   ~BufferPool();
 
   std::shared_ptr<MediaBuffer> GetBuffer(bool block = true);
   int PutBuffer(MediaGroupBuffer *mgb);
 
+  void GetStats(BufferPoolStats &stats);
   void DumpInfo();
 
 private:
-  std::list<MediaGroupBuffer *> ready_buffers;
-  std::list<MediaGroupBuffer *> busy_buffers;
-  ConditionLockMutex mtx;
-  int buf_cnt;
+  void Init(const BufferPoolParam &param, int size, MediaBuffer::MemType type,
+            unsigned int flag);
+  // with mtx locked
+  void PushReady(MediaGroupBuffer *mgb);
+  MediaGroupBuffer *PopReady();
+  // Take the ready buffers above the high watermark out if they have been
+  // idle long enough, the caller frees them without the lock.
+  void TakeIdle(std::vector<MediaGroupBuffer *> &idle);
+  // True if the pool is short and has been for grow_ms.
+  bool CanGrow(bool is_short);
+  // without mtx, add a buffer reserved in buf_total, nullptr if it fails
+  MediaGroupBuffer *Grow();
+
+  BufferPoolParam param;
+  MediaBuffer::MemType mem_type;
+  unsigned int mem_flag;
+  // all the buffers, ready or busy
+  std::vector<MediaGroupBuffer *> buffers;
+  MediaGroupBuffer *ready_head;
+  int ready_cnt;
+  int busy_cnt;
+  // buffers, including the ones being allocated
+  int buf_total;
+  // when the ready buffers went above the high watermark, 0 if they are not
+  int64_t idle_since;
+  // when the pool went short of ready buffers, 0 if it is not
+  int64_t short_since;
+  std::mutex mtx;
+  // a buffer is put back, and all buffers are back
+  std::condition_variable ready_cond;
+  std::condition_variable idle_cond;
   int buf_size;
+  BufferPoolStats stats;
+  int64_t wait_time_sum;
+  // module and channel charged for the buffers, see MemAccount
+  int owner_mod;
+  int owner_chn;
 };
 
 } // namespace easymedia
@@ -0,0 +1,38 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_BUFFER_TRACKER_H_
+#define EASYMEDIA_BUFFER_TRACKER_H_
+
+#include <string>
+
+#include "utils.h"
+
+namespace easymedia {
+
+// Opt-in record of the buffers which go back to a producer when released:
+// the ones of the BufferPools and the V4L2 capture buffers. If they are
+// held too long, the producer starves, such as a camera with no buffer
+// queued, which stalls without any error.
+// For each live buffer it keeps where it comes from, the last flow or
+// channel it was handed to, and its age. A watchdog warns once per holder
+// about the buffers held longer than the threshold.
+// Enabled at start by the RKMEDIA_BUFFER_TRACK_MS environment variable, the
+// warning threshold in ms; disabled it costs one atomic load per hook.
+class _API BufferTracker {
+public:
+  // 0 disables, the buffers already recorded are forgotten
+  static void Enable(int warn_ms);
+  static bool IsEnabled();
+  // key: the address of the buffer data, the origin is copied
+  static void Register(const void *key, const char *origin);
+  static void Unregister(const void *key);
+  static void SetHolder(const void *key, const char *holder, int mod, int chn);
+  // the buffers held for min_age_ms at least, oldest first
+  static void Dump(std::string &dump_info, int min_age_ms = 0);
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_BUFFER_TRACKER_H_
@@ -0,0 +1,70 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_EXECUTOR_H_
+#define EASYMEDIA_EXECUTOR_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "lock.h"
+
+namespace easymedia {
+
+// A unit of work which can be submitted to the Executor.
+// The submitter owns the task, and must keep it alive until Execute returns.
+class ExecutorTask {
+public:
+  virtual ~ExecutorTask() = default;
+  virtual void Execute() = 0;
+};
+
+// Fixed-size work-stealing thread pool shared by all flows which select
+// Model::POOL. Each worker owns a queue; submit from a worker goes to its own
+// queue, submit from other threads is spread round robin. An idle worker
+// steals from the tail of the others' queues before going to sleep.
+class Executor {
+public:
+  // thread_num <= 0 means the number of online cpu cores.
+  Executor(int thread_num = 0);
+  ~Executor();
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  static const std::shared_ptr<Executor> &GetInstance();
+
+  void Submit(ExecutorTask *task);
+  // Take back a task which is queued but not started yet.
+  // Return false if no worker queue holds it.
+  bool Cancel(ExecutorTask *task);
+  int GetThreadNum() const { return (int)workers.size(); }
+  // Index of the worker running the caller, -1 if not a worker of this pool.
+  int GetCurrentWorker() const;
+
+private:
+  class Worker {
+  public:
+    Worker() : th(nullptr) {}
+    std::deque<ExecutorTask *> tasks;
+    SpinLockMutex mtx;
+    std::thread *th;
+  };
+  void WorkerRun(int index);
+  ExecutorTask *Pop(int index);
+  ExecutorTask *Steal(int index);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  ConditionLockMutex idle_mtx;
+  std::atomic_int idle_num;
+  std::atomic_int task_num;
+  std::atomic_uint next_worker;
+  volatile bool quit;
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_EXECUTOR_H_
@@ -41,6 +41,8 @@ public:
   // sync or async safe call, depends on specific filter.
   virtual int SendInput(std::shared_ptr<MediaBuffer> input);
   virtual std::shared_ptr<MediaBuffer> FetchOutput();
+  // true if it reads the image crop views at their origin
+  virtual bool AcceptImageViews() { return false; }
 
   virtual int IoCtrl(unsigned long int request _UNUSED, ...) { return -1; }
 
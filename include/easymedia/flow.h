@@ -5,14 +5,17 @@
 #ifndef EASYMEDIA_FLOW_H_
 #define EASYMEDIA_FLOW_H_
 
+#include "flow_stats.h"
 #include "lock.h"
 #include "message.h"
 #include "reflector.h"
+#include "ring_queue.h"
 #include "utils.h"
 
 #include <stdarg.h>
 
 #include <deque>
+#include <memory>
 #include <thread>
 #include <type_traits>
 #include <vector>
@@ -34,14 +37,26 @@ DECLARE_REFLECTOR(Flow)
                               GetError() < 0)
 
 class MediaBuffer;
-enum class Model { NONE, ASYNCCOMMON, ASYNCATOMIC, SYNC };
+// POOL: same input queue as ASYNCCOMMON, but the process function runs as a
+// task on the shared Executor instead of a private thread.
+enum class Model { NONE, ASYNCCOMMON, ASYNCATOMIC, SYNC, POOL };
 // PushMode
 enum class InputMode { NONE, BLOCKING, DROPFRONT, DROPCURRENT };
 enum class HoldInputMode { NONE, HOLD_INPUT, INHERIT_FORM_INPUT };
+// How an ASYNCCOMMON flow with several inputs fetches them.
+// NONE: the head of each slot, whatever its time.
+// PAIR: one buffer of each slot, all within the tolerance, the older ones
+//       which can never be matched are dropped.
+// ORDER: the oldest heads first, so the slots are merged in time order.
+enum class InputSync { NONE, PAIR, ORDER };
 using MediaBufferVector = std::vector<std::shared_ptr<MediaBuffer>>;
 // TODO: outputs ret, outslot index, outslot queue model
 using FunctionProcess =
     std::add_pointer<bool(Flow *f, MediaBufferVector &input_vector)>::type;
+// The inputs of several runs back to back, in_slots.size() buffers per run,
+// a buffer is null if its slot had nothing in that run.
+using FunctionBatchProcess =
+    std::add_pointer<bool(Flow *f, MediaBufferVector &batch)>::type;
 template <int in_index, int out_index>
 bool void_transaction(Flow *f, MediaBufferVector &input_vector);
 using LinkVideoHandler =
@@ -62,21 +77,53 @@ using OutputCallBack = std::add_pointer<void(
     void *handler, std::shared_ptr<MediaBuffer> mb)>::type;
 using EventCallBack = std::add_pointer<void(void *handler, void *data)>::type;
 
+// Scheduling of a thread owned by a flow. Only the threads private to a flow
+// are affected, not the workers of the shared Executor.
+class _API ThreadSchedParam {
+public:
+  ThreadSchedParam() : cpu_mask(0), policy(-1), priority(0), nice(0) {}
+  bool Empty() const { return !cpu_mask && policy < 0 && !nice; }
+  uint64_t cpu_mask; // bit n for cpu n, 0 means not set
+  int policy;        // SCHED_OTHER, SCHED_FIFO or SCHED_RR, -1 means not set
+  int priority;      // for SCHED_FIFO and SCHED_RR
+  int nice;          // 0 means not set
+};
+
 class _API SlotMap {
 public:
   SlotMap()
       : thread_model(Model::SYNC), mode_when_full(InputMode::DROPFRONT),
-        process(nullptr), interval(16.66f) {}
+        process(nullptr), interval(16.66f), batch_process(nullptr),
+        batch_max(0), batch_latency(0), input_sync(InputSync::NONE),
+        sync_tolerance(20), sync_timeout(100), sync_atomic_clock(false) {}
   std::vector<int> input_slots;
   Model thread_model;
   InputMode mode_when_full;
-  std::vector<bool> fetch_block; // if ASYNCCOMMON
+  std::vector<bool> fetch_block; // if ASYNCCOMMON or POOL
   std::vector<int> input_maxcachenum;
   std::vector<int> output_slots;
   // std::vector<DataSetModel> output_ds_model;
   std::vector<HoldInputMode> hold_input;
   FunctionProcess process;
   float interval;
+  ThreadSchedParam sched; // if ASYNCCOMMON or ASYNCATOMIC
+  // Batch mode, if ASYNCCOMMON or POOL and no output holds its input.
+  // One wakeup drains up to batch_max runs of queued inputs and passes them
+  // to batch_process at once, instead of calling process for each run.
+  // ASYNCCOMMON waits at most batch_latency ms after the first input for the
+  // batch to fill, POOL and batch_latency 0 only take what is queued already.
+  FunctionBatchProcess batch_process;
+  int batch_max;
+  int batch_latency;
+  // If ASYNCCOMMON with several inputs. Buffers within sync_tolerance ms
+  // are taken as simultaneous. If some slot is still empty sync_timeout ms
+  // after the first buffer is held, the held buffers go alone, and that slot
+  // is not waited for anymore until it delivers again.
+  InputSync input_sync;
+  int sync_tolerance;
+  int sync_timeout;
+  // compare GetAtomicClock() instead of GetUSTimeStamp()
+  bool sync_atomic_clock;
 };
 
 class FlowCoroutine;
@@ -102,6 +149,20 @@ public:
   void SendInput(std::shared_ptr<MediaBuffer> &input, int in_slot_index);
   void SetDisable() { enable = false; }
 
+  // Credit-based flow control, enabled by the flow param flow_control=credit.
+  // A flow has credit on an input slot if the slot queue is not full and, if
+  // it is credit controlled itself, if any of its down flows has credit.
+  // A credit controlled flow drops its inputs without processing them while
+  // none of its down flows has credit, instead of producing buffers which
+  // would be dropped later.
+  void SetCreditControl(bool on) { credit_control = on; }
+  bool HasCredit(int in_slot_index);
+  bool HasDownCredit();
+
+  // Image crop views with an origin are given as a Materialize copy to the
+  // flows which do not read them at their origin, the default.
+  void SetAcceptImageViews(bool on) { accept_views = on; }
+
   // The Control must be called in the same thread to that create flow
   virtual int Control(unsigned long int request _UNUSED, ...) { return -1; }
   virtual int SubControl(unsigned long int request, void *arg, int size = 0) {
@@ -170,6 +231,20 @@ public:
   bool IsAllBuffEmpty();
   void DumpBase(std::string &dump_info);
   virtual void Dump(std::string &dump_info) { DumpBase(dump_info); }
+  // Always-on runtime counters, see flow_stats.h.
+  void GetStats(FlowStats &stats);
+  void ResetStats();
+
+  // Module and channel charged for the buffers allocated by the flow, see
+  // MemAccount. Defaults to the owner of the thread creating the flow.
+  void SetMemOwner(int mod, int chn) {
+    mem_mod = mod;
+    mem_chn = chn;
+  }
+  void GetMemOwner(int &mod, int &chn) {
+    mod = mem_mod;
+    chn = mem_chn;
+  }
 
   void StartStream();
   int GetCachedBufferNum(unsigned int &total, unsigned int &used);
@@ -190,19 +265,55 @@ protected:
     void SetOutputBehavior(const std::shared_ptr<MediaBuffer> &output);
     void SetOutputToQueueBehavior(const std::shared_ptr<MediaBuffer> &output);
 
+    // replace the snapshot with the content of flows, with list_mtx locked
+    void PublishFlows();
+    // free the replaced snapshots once no reader uses them, with list_mtx
+    // unlocked
+    void ReclaimFlows();
+    // free the replaced snapshots if no reader is left, false otherwise or
+    // if retired_mtx is busy and !block
+    bool FreeRetired(bool block);
+
   public:
-    FlowMap() : valid(false), hold_input(HoldInputMode::NONE) {
+    using FlowList = std::vector<FlowInputMap>;
+    FlowMap()
+        : valid(false), hold_input(HoldInputMode::NONE), snapshot(nullptr),
+          readers(0), has_retired(false) {
       assert(list_mtx.valid);
     }
     FlowMap(FlowMap &&);
+    ~FlowMap();
     void Init(Model m, HoldInputMode hold_in);
     bool valid;
     HoldInputMode hold_input;
     // down flow
     void AddFlow(std::shared_ptr<Flow> flow, int index);
     void RemoveFlow(std::shared_ptr<Flow> flow);
+    // The process thread sends to an immutable snapshot of flows, without
+    // lock nor copy. Return nullptr if there is no down flow yet.
+    // Every AcquireFlows must be paired with a ReleaseFlows.
+    const FlowList *AcquireFlows() {
+      readers.fetch_add(1);
+      return snapshot.load();
+    }
+    // The last reader frees the snapshots its writer could not wait for.
+    void ReleaseFlows() {
+      if (readers.fetch_sub(1) == 1) {
+        readers_event.Notify();
+        if (has_retired.load(std::memory_order_acquire))
+          FreeRetired(false);
+      }
+    }
     std::list<FlowInputMap> flows;
     ReadWriteLockMutex list_mtx;
+    std::atomic<const FlowList *> snapshot;
+    std::atomic_int readers;
+    // signaled when the last reader leaves
+    FutexEvent readers_event;
+    // old snapshots still in use by readers when replaced
+    std::vector<const FlowList *> retired;
+    std::mutex retired_mtx;
+    std::atomic_bool has_retired;
     std::deque<std::shared_ptr<MediaBuffer>> cached_buffers; // never drop
     std::shared_ptr<MediaBuffer> cached_buffer;
     decltype(&FlowMap::SetOutputBehavior) set_output_behavior;
@@ -212,21 +323,40 @@ protected:
     void SyncSendInputBehavior(std::shared_ptr<MediaBuffer> &input);
     void ASyncSendInputCommonBehavior(std::shared_ptr<MediaBuffer> &input);
     void ASyncSendInputAtomicBehavior(std::shared_ptr<MediaBuffer> &input);
+    void ASyncSendInputPoolBehavior(std::shared_ptr<MediaBuffer> &input);
     // behavior when input list exceed max_cache_num
     bool ASyncFullBlockingBehavior(volatile bool &pred);
     bool ASyncFullDropFrontBehavior(volatile bool &pred);
     bool ASyncFullDropCurrentBehavior(volatile bool &pred);
+    // the same behaviors for the ring, called without mtx
+    bool RingFullBlockingBehavior(volatile bool &pred);
+    bool RingFullDropFrontBehavior(volatile bool &pred);
+    bool RingFullDropCurrentBehavior(volatile bool &pred);
+    // queue the input as the full behavior says, false if it is dropped
+    bool Enqueue(std::shared_ptr<MediaBuffer> &input);
 
   public:
     Input() : valid(false), flow(nullptr), fetch_block(true) {}
     Input(Input &&);
     void Init(Flow *f, Model m, int mcn, InputMode im, bool f_block,
               std::shared_ptr<FlowCoroutine> fc);
+    // queue accessors for ASYNCCOMMON and POOL, whatever the backend is
+    bool Pop(std::shared_ptr<MediaBuffer> &output);
+    size_t Size();
+    void Clear();
+    // false if the next input would hit the full behavior
+    bool HasRoom();
+
     bool valid;
     Flow *flow;
     Model thread_model;
     bool fetch_block;
+    // Bounded queues (max_cache_num > 0) live in the lock-free ring,
+    // unbounded ones keep the deque.
     std::deque<std::shared_ptr<MediaBuffer>> cached_buffers;
+    std::unique_ptr<RingQueue<std::shared_ptr<MediaBuffer>>> ring;
+    // wake up the producers blocked on a full ring
+    FutexEvent space_event;
     ConditionLockMutex mtx;
     int max_cache_num;
     InputMode mode_when_full;
@@ -235,6 +365,7 @@ protected:
     decltype(&Input::SyncSendInputBehavior) send_input_behavior;
     decltype(&Input::ASyncFullBlockingBehavior) async_full_behavior;
     std::shared_ptr<FlowCoroutine> coroutine;
+    InputCounter counter;
   };
 
   // Can not change the following values after initialize,
@@ -276,7 +407,20 @@ protected:
 private:
   volatile bool enable;
   volatile bool quit;
-  ConditionLockMutex cond_mtx;
+  // ASYNCCOMMON, signaled when any input is queued
+  FutexEvent input_event;
+
+  LatencyHistogram process_hist;
+  std::atomic<uint64_t> process_overrun;
+  volatile bool credit_control;
+  std::atomic<uint64_t> credit_skipped;
+  bool accept_views;
+  // InputSync, fetches which gave up waiting for some slot
+  std::atomic<uint64_t> sync_timeouts;
+
+  // ASYNCATOMIC, lateness of the pacer ticks
+  LatencyHistogram pace_late;
+  std::atomic<uint64_t> pace_missed;
 
   // event handler
   std::unique_ptr<EventHandler> event_handler_;
@@ -302,6 +446,9 @@ private:
   // Control the number of executions of threads inside Flow
   int run_times;
 
+  int mem_mod;
+  int mem_chn;
+
   DEFINE_ERR_GETSET()
   DECLARE_PART_FINAL_EXPOSE_PRODUCT(Flow)
 };
@@ -309,8 +456,20 @@ private:
 std::string gen_datatype_rule(std::map<std::string, std::string> &params);
 Model GetModelByString(const std::string &model);
 InputMode GetInputModelByString(const std::string &in_model);
-_API void ParseParamToSlotMap(std::map<std::string, std::string> &params,
+// The Parse functions return false if a value is malformed or out of range.
+_API bool ParseParamToSlotMap(std::map<std::string, std::string> &params,
                               SlotMap &sm, int &input_maxcachenum);
+_API bool ParseThreadSchedParam(std::map<std::string, std::string> &params,
+                                ThreadSchedParam &sched);
+// KEY_BATCH_MAX and KEY_BATCH_LATENCY, keep the values of sm if not set
+_API bool ParseBatchParam(std::map<std::string, std::string> &params,
+                          SlotMap &sm);
+// KEY_INPUT_SYNC and the related keys, keep the values of sm if not set
+_API bool ParseInputSyncParam(std::map<std::string, std::string> &params,
+                              SlotMap &sm);
+// apply to the calling thread
+_API void ApplyThreadSchedParam(const ThreadSchedParam &sched,
+                                const char *name);
 size_t FlowOutputHoldInput(std::shared_ptr<MediaBuffer> &out_buffer,
                            const MediaBufferVector &input_vector);
 size_t FlowOutputInheritFromInput(std::shared_ptr<MediaBuffer> &out_buffer,
@@ -0,0 +1,114 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_FLOW_STATS_H_
+#define EASYMEDIA_FLOW_STATS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace easymedia {
+
+// Histogram of durations in microseconds, log-linear buckets.
+// Add is a few relaxed atomic operations, so it is always on.
+// Percentiles are the upper bound of the bucket they fall in.
+class LatencyHistogram {
+public:
+  static const int kBucketNum = 128;
+  LatencyHistogram() { Reset(); }
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+  void Add(int64_t us);
+  void Reset();
+  uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+  int64_t Average() const;
+  int64_t Max() const { return max.load(std::memory_order_relaxed); }
+  // percent in [0, 100]
+  int64_t Percentile(int percent) const;
+
+private:
+  std::atomic<uint32_t> buckets[kBucketNum];
+  std::atomic<uint64_t> count;
+  std::atomic<int64_t> sum;
+  std::atomic<int64_t> max;
+};
+
+// Per input slot counters, updated by the producers of the slot.
+class InputCounter {
+public:
+  InputCounter() { Reset(); }
+  InputCounter(const InputCounter &) = delete;
+  InputCounter &operator=(const InputCounter &) = delete;
+  // called for every buffer sent to the slot
+  void OnArrival(int64_t now_us);
+  void OnQueued(size_t depth);
+  void OnBlocked() { blocked.fetch_add(1, std::memory_order_relaxed); }
+  void OnDropFront() { dropped_front.fetch_add(1, std::memory_order_relaxed); }
+  void OnDropCurrent() {
+    dropped_current.fetch_add(1, std::memory_order_relaxed);
+  }
+  void OnDropUnsynced() {
+    dropped_unsynced.fetch_add(1, std::memory_order_relaxed);
+  }
+  void Reset();
+
+  std::atomic<uint64_t> received;
+  std::atomic<uint64_t> blocked;
+  std::atomic<uint64_t> dropped_front;
+  std::atomic<uint64_t> dropped_current;
+  std::atomic<uint64_t> dropped_unsynced;
+  std::atomic<uint32_t> depth_hwm;
+  std::atomic<int64_t> last_arrival;
+  std::atomic<int64_t> last_interval;
+  // interarrival jitter, smoothed as RFC 3550 does, us * 16
+  std::atomic<int64_t> jitter16;
+};
+
+// Snapshot returned by Flow::GetStats. Times are in microseconds.
+typedef struct {
+  uint64_t received;
+  // times a producer found the queue full with InputMode::BLOCKING
+  uint64_t blocked;
+  // buffers dropped by InputMode::DROPFRONT and InputMode::DROPCURRENT
+  uint64_t dropped_front;
+  uint64_t dropped_current;
+  // buffers too old to be matched by InputSync::PAIR
+  uint64_t dropped_unsynced;
+  uint32_t depth;
+  uint32_t depth_hwm;
+  int max_cache_num;
+  int64_t interval;
+  int64_t jitter;
+} FlowInputStats;
+
+typedef struct {
+  uint64_t process_count;
+  // process calls which took longer than the expected process time
+  uint64_t process_overrun;
+  // inputs dropped unprocessed because no down flow had credit
+  uint64_t credit_skipped;
+  // InputSync, fetches which gave up waiting for some slot
+  uint64_t sync_timeouts;
+  int64_t process_avg;
+  int64_t process_p50;
+  int64_t process_p95;
+  int64_t process_p99;
+  int64_t process_max;
+  // interval-based flows only: ticks served, ticks skipped because the
+  // pacer or the previous run was late, and the lateness of the ticks
+  uint64_t pace_ticks;
+  uint64_t pace_missed;
+  int64_t pace_late_p99;
+  int64_t pace_late_max;
+  std::vector<FlowInputStats> inputs;
+} FlowStats;
+
+void DumpFlowStats(const FlowStats &stats, std::string &dump_info);
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_FLOW_STATS_H_
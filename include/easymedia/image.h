@@ -5,6 +5,8 @@
 #ifndef EASYMEDIA_IMAGE_H_
 #define EASYMEDIA_IMAGE_H_
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,6 +49,13 @@ typedef struct {
   int w, h; // width, height
 } ImageRect;
 
+#define MAX_IMAGE_PLANE_NUM 3
+
+typedef struct {
+  size_t offset; // bytes from the start of the buffer
+  int stride;    // bytes per line
+} ImagePlane;
+
 #ifdef __cplusplus
 }
 #endif
@@ -59,6 +68,12 @@ _API int CalPixFmtSize(const PixelFormat &fmt, const int width,
 _API inline int CalPixFmtSize(const ImageInfo &ii) {
   return CalPixFmtSize(ii.pix_fmt, ii.vir_width, ii.vir_height, 0);
 }
+// Fill the planes of an image laid out by vir_width and vir_height, their
+// offset being the one of the pixel (x, y). Return the number of planes,
+// 0 if the format has no plain planes, such as fbc.
+// x and y are aligned down for the subsampled chroma.
+_API int GetImagePlanes(const ImageInfo &ii, int x, int y,
+                        ImagePlane planes[MAX_IMAGE_PLANE_NUM]);
 _API PixelFormat StringToPixFmt(const char *type);
 _API const char *PixFmtToString(PixelFormat fmt);
 
@@ -128,6 +128,8 @@
 #define KEY_V4L2_COLORSPACE "v4l2_colorspace"
 #define KEY_V4L2_QUANTIZATION "v4l2_quantization"
 #define KEY_V4L2_CS(t) STR(t)
+// ms a capture buffer may be held before it is copied and requeued, 0 never
+#define KEY_V4L2_DETACH_MS "v4l2_detach_ms"
 
 // rtsp
 #define KEY_PORT_NUM "portnum"
@@ -136,10 +138,17 @@
 #define KEY_CHANNEL_NAME "channel_name"
 
 #define KEY_MEM_CNT "mem_cnt"
+// elastic buffer pool, grows up to mem_max_cnt once short of buffers for
+// mem_grow_ms, frees the buffers ready above mem_cnt for mem_idle_ms
+#define KEY_MEM_MAX_CNT "mem_max_cnt"
+#define KEY_MEM_GROW_MS "mem_grow_ms"
+#define KEY_MEM_IDLE_MS "mem_idle_ms"
 #define KEY_MEM_TYPE "mem_type"
 #define KEY_MEM_ION "ion"
 #define KEY_MEM_DRM "drm"
 #define KEY_MEM_HARDWARE "hw_mem"
+// 1: common memory on prefaulted huge pages, for large frames
+#define KEY_MEM_HUGE_PAGE "mem_huge_page"
 
 #define KEY_MEM_SIZE_PERTIME "size_pertime"
 
@@ -150,17 +159,44 @@
 #define KEY_ASYNCCOMMON "asynccommon"
 #define KEY_ASYNCATOMIC "asyncatomic"
 #define KEY_SYNC "sync"
+#define KEY_ASYNCPOOL "asyncpool"
 
 #define KEK_INPUT_MODEL "input_model"
 #define KEY_BLOCKING "blocking"
 #define KEY_DROPFRONT "dropfront"
 #define KEY_DROPCURRENT "dropcurrent"
 
+// scheduling of the threads owned by a flow
+#define KEY_CPU_AFFINITY "cpu_affinity" // cpu bitmask, such as 0xc
+#define KEY_SCHED_POLICY "sched_policy"
+#define KEY_SCHED_OTHER "other"
+#define KEY_SCHED_FIFO "fifo"
+#define KEY_SCHED_RR "rr"
+#define KEY_SCHED_PRIORITY "sched_priority"
+#define KEY_SCHED_NICE "nice"
+
+// batched processing, for the flows which support it
+#define KEY_BATCH_MAX "batch_max"         // max buffers processed per wakeup
+#define KEY_BATCH_LATENCY "batch_latency" // ms waited to fill a batch
+
+// time alignment of the inputs of a multi-input flow
+#define KEY_INPUT_SYNC "input_sync"
+#define KEY_SYNC_PAIR "pair"
+#define KEY_SYNC_ORDER "order"
+#define KEY_SYNC_TOLERANCE "sync_tolerance" // ms
+#define KEY_SYNC_TIMEOUT "sync_timeout"     // ms
+#define KEY_SYNC_CLOCK "sync_clock"
+#define KEY_SYNC_TIMESTAMP "timestamp"
+#define KEY_SYNC_ATOMIC_CLOCK "atomic_clock"
+
 #define KEY_INPUT_CACHE_NUM "input_cache_num"
 #define KEY_OUTPUT_CACHE_NUM "output_cache_num"
 
 #define KEY_OUTPUT_HOLD_INPUT "output_hold_input"
 
+#define KEY_FLOW_CONTROL "flow_control"
+#define KEY_CREDIT "credit"
+
 // muxer flow
 #define KEY_FILE_PREFIX "file_prefix"
 #define KEY_FILE_SUFFIX "file_suffix"
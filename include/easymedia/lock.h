@@ -44,6 +44,8 @@ public:
   virtual void unlock() override;
   virtual void wait() override;
   virtual void notify() override;
+  // wake up only one waiter, for the queues that any waiter can consume
+  void notify_one();
 
 private:
   std::mutex mtx;
@@ -78,6 +80,26 @@ private:
   std::atomic_flag flag;
 };
 
+// Event count on top of futex. A waiter takes a key, re-checks its condition,
+// then sleeps only if nobody notified since the key was taken. Notify costs a
+// single atomic load when there is no waiter, which makes it cheap enough to
+// call on every frame.
+class FutexEvent {
+public:
+  FutexEvent() : seq(0), waiters(0) {}
+  FutexEvent(const FutexEvent &) = delete;
+  FutexEvent &operator=(const FutexEvent &) = delete;
+  int PrepareWait();
+  void CancelWait();
+  // timeout_ms < 0 means wait forever. Return false if timeout.
+  bool Wait(int key, int timeout_ms = -1);
+  void Notify();
+
+private:
+  std::atomic_int seq;
+  std::atomic_int waiters;
+};
+
 class AutoLockMutex {
 public:
   AutoLockMutex(LockMutex &lm) : m_lm(lm) { m_lm.lock(); }
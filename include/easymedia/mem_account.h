@@ -0,0 +1,72 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_MEM_ACCOUNT_H_
+#define EASYMEDIA_MEM_ACCOUNT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "utils.h"
+
+namespace easymedia {
+
+typedef struct {
+  // memory held now by the buffers of the owner
+  uint64_t bytes;
+  uint32_t buffers;
+  uint64_t peak_bytes;
+  uint64_t alloc_cnt;
+  uint64_t fail_cnt;
+  // gets of the buffer pools of the owner which blocked, or returned null
+  uint64_t pool_wait_cnt;
+  uint64_t pool_fail_cnt;
+} MemUsage;
+
+// Memory of the allocated buffers, by owner and by memory type.
+// An owner is a module and a channel, as MOD_ID_E and the channel id of the
+// c api; (0, 0) collects what nobody claimed. Each thread has a current
+// owner: flows capture the one of the thread creating them, and set it on
+// the threads running them, so a buffer is charged to the channel whose
+// flow allocated it, and released from it whichever thread frees it.
+class _API MemAccount {
+public:
+  static const int kModNum = 32;
+  static const int kChnNum = 16;
+  // MediaBuffer::MemType
+  static const int kTypeNum = 2;
+
+  static void SetThreadOwner(int mod, int chn);
+  static void GetThreadOwner(int &mod, int &chn);
+  // Charge size bytes to the owner of the calling thread until the returned
+  // pointer, which keeps mem alive and points to the same object, and all
+  // its copies are released.
+  static std::shared_ptr<void> Track(const std::shared_ptr<void> &mem,
+                                     int type, size_t size);
+  static void OnAllocFail(int type);
+  static void OnPoolWait(int mod, int chn, int type);
+  static void OnPoolFail(int mod, int chn, int type);
+  // false if the owner is out of range
+  static bool GetUsage(int mod, int chn, int type, MemUsage &usage);
+};
+
+// Set the owner of the calling thread for the scope.
+class AutoMemOwner {
+public:
+  AutoMemOwner(int mod, int chn) {
+    MemAccount::GetThreadOwner(saved_mod, saved_chn);
+    MemAccount::SetThreadOwner(mod, chn);
+  }
+  ~AutoMemOwner() { MemAccount::SetThreadOwner(saved_mod, saved_chn); }
+
+private:
+  int saved_mod;
+  int saved_chn;
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_MEM_ACCOUNT_H_
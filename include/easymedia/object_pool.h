@@ -0,0 +1,76 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_OBJECT_POOL_H_
+#define EASYMEDIA_OBJECT_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+#include "utils.h"
+
+namespace easymedia {
+
+typedef struct {
+  // Allocate calls, and how many of them had to go to the heap
+  uint64_t allocs;
+  uint64_t heap_allocs;
+  uint64_t frees;
+  // blocks handed out and not freed yet
+  uint64_t in_use;
+  // bytes taken from the heap for the blocks, never given back
+  uint64_t reserved;
+} ObjectPoolStats;
+
+// Free lists of small fixed size blocks, for the objects created on every
+// frame: the MediaBuffer wrappers and the control blocks of their shared_ptr.
+// Blocks are carved from chunks and recycled, the memory kept is the peak of
+// the blocks in use. Sizes above kMaxSize go to the heap directly.
+class _API ObjectPool {
+public:
+  static const size_t kMaxSize = 512;
+
+  static void *Allocate(size_t size);
+  static void Deallocate(void *ptr, size_t size);
+  static void GetStats(ObjectPoolStats &stats);
+};
+
+template <typename T> class PoolAllocator {
+public:
+  typedef T value_type;
+
+  PoolAllocator() = default;
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(ObjectPool::Allocate(n * sizeof(T)));
+  }
+  void deallocate(T *ptr, size_t n) {
+    ObjectPool::Deallocate(ptr, n * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+  return false;
+}
+
+// As std::make_shared, with the object and its reference counts in one
+// block of the ObjectPool.
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooled(Args &&... args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(),
+                                 std::forward<Args>(args)...);
+}
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_OBJECT_POOL_H_
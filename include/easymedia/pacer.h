@@ -0,0 +1,66 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_PACER_H_
+#define EASYMEDIA_PACER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace easymedia {
+
+class PacedTask {
+public:
+  virtual ~PacedTask() = default;
+  // Called on the pacer thread at every tick, must not block.
+  // late_us is how late the tick is served after its deadline, missed is the
+  // number of ticks skipped since the previous call because we were too late.
+  virtual void OnTick(int64_t late_us, int missed) = 0;
+};
+
+// One thread serving the periodic deadlines of all interval-based flows.
+// Deadlines are absolute on CLOCK_MONOTONIC, computed from the start time and
+// the tick count, so they never drift. The thread sleeps on a timerfd armed
+// with the earliest deadline.
+class Pacer {
+public:
+  Pacer();
+  ~Pacer();
+  Pacer(const Pacer &) = delete;
+  Pacer &operator=(const Pacer &) = delete;
+
+  static const std::shared_ptr<Pacer> &GetInstance();
+
+  bool Add(PacedTask *task, int64_t interval_ns);
+  // After return, OnTick of the task is neither running nor called anymore.
+  void Remove(PacedTask *task);
+
+private:
+  class Entry {
+  public:
+    PacedTask *task;
+    int64_t start;
+    int64_t interval;
+    int64_t ticks;
+  };
+  void Run();
+  // with mtx locked
+  void Arm(int64_t deadline);
+  void ArmFirst();
+
+  std::mutex mtx;
+  // deadline in ns -> entry
+  std::multimap<int64_t, Entry> entries;
+  int timer_fd;
+  std::thread *th;
+  volatile bool quit;
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_PACER_H_
@@ -22,6 +22,8 @@ public:
   static const char *GetFilterName() { return "rkrga"; }
   virtual int Process(std::shared_ptr<MediaBuffer> input,
                       std::shared_ptr<MediaBuffer> &output) override;
+  // rga_blit offsets the rects by the origin
+  virtual bool AcceptImageViews() override { return true; }
 
   void SetRects(std::vector<ImageRect> vec_rect);
   static RockchipRga gRkRga;
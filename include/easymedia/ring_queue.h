@@ -0,0 +1,131 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_RING_QUEUE_H_
+#define EASYMEDIA_RING_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace easymedia {
+
+// Bounded lock-free queue, after Dmitry Vyukov's bounded MPMC queue.
+// Every cell carries a sequence number telling whether it is ready for the
+// producer or the consumer of the current lap, so producers and consumers
+// only contend on their own position counter.
+// Multiple consumers are allowed, which lets a producer drop the oldest
+// element when the queue is full.
+// The algorithm needs at least two cells, a capacity of 1 is enforced by
+// checking the distance to the consumer position instead. The same check
+// lets the capacity change at run time, up to the max_cap cells allocated.
+template <typename T> class RingQueue {
+public:
+  RingQueue(size_t cap, size_t max_cap = 0)
+      : capacity(cap > 0 ? cap : 1),
+        size(std::max<size_t>(std::max(capacity.load(), max_cap), 2)) {
+    cells = new Cell[size];
+    for (size_t i = 0; i < size; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    enqueue_pos.store(0, std::memory_order_relaxed);
+    dequeue_pos.store(0, std::memory_order_relaxed);
+  }
+  ~RingQueue() { delete[] cells; }
+  RingQueue(const RingQueue &) = delete;
+  RingQueue &operator=(const RingQueue &) = delete;
+
+  // Return false if full, the value is untouched.
+  bool TryPush(T &value) {
+    Cell *cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos % size];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+      if (dif == 0) {
+        size_t cap = capacity.load(std::memory_order_relaxed);
+        if (cap < size &&
+            pos - dequeue_pos.load(std::memory_order_acquire) >= cap)
+          return false;
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+          break;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = value;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Return false if empty.
+  bool TryPop(T &value) {
+    Cell *cell;
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos % size];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (dif == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+          break;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data);
+    cell->data = T();
+    cell->seq.store(pos + size, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate while producers or consumers are running.
+  size_t Size() const {
+    size_t head = dequeue_pos.load(std::memory_order_acquire);
+    size_t tail = enqueue_pos.load(std::memory_order_acquire);
+    if (tail <= head)
+      return 0;
+    size_t cap = capacity.load(std::memory_order_relaxed);
+    return (tail - head) > cap ? cap : (tail - head);
+  }
+  bool Empty() const { return Size() == 0; }
+  size_t Capacity() const { return capacity.load(std::memory_order_relaxed); }
+  size_t MaxCapacity() const { return size; }
+  // Clamped to [1, MaxCapacity()]. Once lowered, pushes fail until the
+  // consumers have taken the elements beyond it.
+  void SetCapacity(size_t cap) {
+    capacity.store(std::min(std::max<size_t>(cap, 1), size),
+                   std::memory_order_relaxed);
+  }
+
+private:
+  struct Cell {
+    std::atomic_size_t seq;
+    T data;
+  };
+  // keep the two position counters on different cache lines
+  static const size_t kCacheLine = 64;
+
+  std::atomic_size_t capacity;
+  const size_t size; // number of cells
+  Cell *cells;
+  char pad0[kCacheLine];
+  std::atomic_size_t enqueue_pos;
+  char pad1[kCacheLine - sizeof(std::atomic_size_t)];
+  std::atomic_size_t dequeue_pos;
+  char pad2[kCacheLine - sizeof(std::atomic_size_t)];
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_RING_QUEUE_H_
@@ -0,0 +1,76 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EASYMEDIA_SLAB_ALLOCATOR_H_
+#define EASYMEDIA_SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+namespace easymedia {
+
+typedef struct {
+  uint64_t alloc_cnt;
+  uint64_t free_cnt;
+  // allocations served by a free block of a thread cache or a size class
+  uint64_t cache_hit_cnt;
+  // blocks taken from and given back to the system
+  uint64_t sys_alloc_cnt;
+  uint64_t sys_free_cnt;
+  // allocations above the largest size class, never cached
+  uint64_t large_cnt;
+  // huge page allocations backed by hugetlbfs pages, and by transparent huge
+  // pages when no hugetlbfs page was left
+  uint64_t hugetlb_cnt;
+  uint64_t thp_cnt;
+  // allocations refused by the memory cap, or by the system
+  uint64_t fail_cnt;
+  // bytes asked for by the blocks in use, and the bytes of those blocks:
+  // in_use - requested is the internal fragmentation
+  uint64_t requested_bytes;
+  uint64_t in_use_bytes;
+  // free blocks kept for reuse, the external fragmentation
+  uint64_t cached_bytes;
+  // in_use + cached, what counts against the memory cap
+  uint64_t reserved_bytes;
+  uint64_t peak_reserved_bytes;
+  uint64_t mem_cap; // 0 if none
+  uint64_t cache_max;
+} SlabStats;
+
+// Allocator behind MediaBuffer::MemType::MEM_COMMON.
+// Sizes are rounded up to one of 4 size classes per power of 2, so any mix
+// of packet sizes comes down to a small set of block sizes which are
+// recycled: each thread keeps a few small blocks for itself, the other free
+// blocks go to the lists of their class, until cache_max bytes are cached.
+// Blocks of 128KB and more are mapped directly, they go back to the system
+// as soon as they are freed out of the caches.
+// Large frames touched by the cpu may ask for huge pages instead: the block
+// is mapped on 2MB boundaries, from the hugetlbfs pool if any, else as
+// transparent huge pages, and prefaulted, so that first touches neither
+// fault nor miss the TLB every 4KB. Such blocks are never cached either.
+// The memory cap bounds the blocks in use plus the cached ones. It can be
+// set with the RKMEDIA_COMMON_MEM_CAP and RKMEDIA_COMMON_MEM_CACHE
+// environment variables, in bytes with an optional K or M suffix.
+class _API SlabAllocator {
+public:
+  static void *Allocate(size_t size);
+  // Falls back to Allocate for sizes below half a huge page, which would
+  // waste most of it.
+  static void *AllocateHuge(size_t size);
+  static void Deallocate(void *ptr);
+  // 0 for no cap
+  static void SetMemCap(size_t bytes);
+  static void SetCacheMax(size_t bytes);
+  // give the free blocks of the size classes and of the calling thread back
+  static void Trim();
+  static void GetStats(SlabStats &stats);
+  static void DumpInfo();
+};
+
+} // namespace easymedia
+
+#endif // #ifndef EASYMEDIA_SLAB_ALLOCATOR_H_
@@ -34,6 +34,8 @@ extern "C" {
 #define RGA_MAX_CHN_NUM 16
 #define VO_MAX_CHN_NUM 2
 #define VDEC_MAX_CHN_NUM 16
+// most buffers a channel can keep for RK_MPI_SYS_GetMediaBuffer(s)
+#define RKMEDIA_CHN_BUFFER_DEPTH_MAX 32
 
 typedef RK_S32 VI_PIPE;
 typedef RK_S32 VI_CHN;
@@ -59,6 +61,23 @@ typedef struct rkMPP_CHN_S {
  ********************************************************************/
 _CAPI RK_S32 RK_MPI_SYS_Init();
 _CAPI RK_VOID RK_MPI_SYS_DumpChn(MOD_ID_E enModId);
+// Memory allocated by the flows of the channel and not freed yet.
+// RK_ID_UNKNOW reports the memory allocated out of any channel.
+_CAPI RK_S32 RK_MPI_SYS_GetChnMemUsage(const MPP_CHN_S *pstChn,
+                                       CHN_MEM_USAGE_S *pstUsage);
+// Track the pooled and camera buffers, and warn about the ones held for
+// more than u32WarnMs, 0 to stop. Also enabled by RKMEDIA_BUFFER_TRACK_MS.
+_CAPI RK_VOID RK_MPI_SYS_SetBufferTrack(RK_U32 u32WarnMs);
+// Log the media buffers held per module, and the tracked buffers held for
+// u32MinAgeMs at least, with their holders.
+_CAPI RK_VOID RK_MPI_SYS_DumpBuffers(RK_U32 u32MinAgeMs);
+// Cap the common (not hardware) memory of the media buffers, the buffers in
+// use plus the free ones kept for reuse, 0 for no cap. Allocations which
+// would go above it fail. Also set by RKMEDIA_COMMON_MEM_CAP.
+_CAPI RK_VOID RK_MPI_SYS_SetCommonMemCap(RK_U64 u64Bytes);
+// Give the free common memory kept for reuse back to the system, but for the
+// few small blocks cached by the other threads.
+_CAPI RK_VOID RK_MPI_SYS_TrimCommonMem();
 _CAPI RK_S32 RK_MPI_SYS_Bind(const MPP_CHN_S *pstSrcChn,
                              const MPP_CHN_S *pstDestChn);
 _CAPI RK_S32 RK_MPI_SYS_UnBind(const MPP_CHN_S *pstSrcChn,
@@ -74,6 +93,18 @@ _CAPI RK_S32 RK_MPI_SYS_StartGetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID);
 _CAPI RK_S32 RK_MPI_SYS_StopGetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID);
 _CAPI MEDIA_BUFFER RK_MPI_SYS_GetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID,
                                              RK_S32 s32MilliSec);
+// Get all the buffers queued by the channel, up to s32Max, waiting for the
+// first one as RK_MPI_SYS_GetMediaBuffer does. Return how many were stored
+// in pMbs, 0 on timeout, or a negative error.
+_CAPI RK_S32 RK_MPI_SYS_GetMediaBuffers(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                        MEDIA_BUFFER *pMbs, RK_S32 s32Max,
+                                        RK_S32 s32MilliSec);
+// Set how many buffers the channel keeps for RK_MPI_SYS_GetMediaBuffer(s),
+// from 1 to RKMEDIA_CHN_BUFFER_DEPTH_MAX, 2 by default. The oldest one is
+// dropped when full, so a deeper queue lets a reader catch up on a burst
+// with RK_MPI_SYS_GetMediaBuffers. Back to 2 when the system is reset.
+_CAPI RK_S32 RK_MPI_SYS_SetMediaBufferDepth(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                           RK_S32 s32Depth);
 
 _CAPI RK_S32 RK_MPI_LOG_SetLevelConf(LOG_LEVEL_CONF_S *pstConf);
 _CAPI RK_S32 RK_MPI_LOG_GetLevelConf(LOG_LEVEL_CONF_S *pstConf);
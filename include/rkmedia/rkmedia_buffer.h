@@ -42,6 +42,22 @@ typedef struct rkMB_IMAGE_INFO {
   IMAGE_TYPE_E enImgType;
 } MB_IMAGE_INFO_S;
 
+typedef void *MEDIA_BUFFER_POOL;
+
+typedef struct rkMB_POOL_PARAM_S {
+  // buffers allocated at creation, more are added up to u32MaxCnt if it is
+  // bigger, and freed when unused for a while
+  RK_U32 u32Cnt;
+  RK_U32 u32MaxCnt;
+  // MB_TYPE_IMAGE, MB_TYPE_AUDIO or MB_TYPE_COMMON
+  MB_TYPE_E enMediaType;
+  // buffer size in bytes, computed from stImageInfo for MB_TYPE_IMAGE
+  RK_U32 u32Size;
+  RK_BOOL bHardWare;
+  RK_U8 u8Flag; // MB_FLAG_*, for hardware buffers
+  MB_IMAGE_INFO_S stImageInfo;
+} MB_POOL_PARAM_S;
+
 _CAPI void *RK_MPI_MB_GetPtr(MEDIA_BUFFER mb);
 _CAPI int RK_MPI_MB_GetFD(MEDIA_BUFFER mb);
 _CAPI size_t RK_MPI_MB_GetSize(MEDIA_BUFFER mb);
@@ -49,6 +65,11 @@ _CAPI MOD_ID_E RK_MPI_MB_GetModeID(MEDIA_BUFFER mb);
 _CAPI RK_S16 RK_MPI_MB_GetChannelID(MEDIA_BUFFER mb);
 _CAPI RK_U64 RK_MPI_MB_GetTimestamp(MEDIA_BUFFER mb);
 _CAPI RK_S32 RK_MPI_MB_ReleaseBuffer(MEDIA_BUFFER mb);
+// Release the s32Cnt buffers of pMbs, as got by RK_MPI_SYS_GetMediaBuffers.
+_CAPI RK_S32 RK_MPI_MB_ReleaseBuffers(MEDIA_BUFFER *pMbs, RK_S32 s32Cnt);
+// Media buffers created and not released yet, by the channels of enModID,
+// RK_ID_UNKNOW for the ones created by the app, RK_ID_BUTT for all.
+_CAPI RK_S32 RK_MPI_MB_GetLiveCount(MOD_ID_E enModID);
 _CAPI MEDIA_BUFFER RK_MPI_MB_CreateBuffer(RK_U32 u32Size, RK_BOOL boolHardWare,
                                           RK_U8 u8Flag);
 _CAPI MEDIA_BUFFER RK_MPI_MB_ConvertToImgBuffer(MEDIA_BUFFER mb,
@@ -68,6 +89,14 @@ _CAPI RK_S32 RK_MPI_MB_GetImageInfo(MEDIA_BUFFER mb,
                                     MB_IMAGE_INFO_S *pstImageInfo);
 _CAPI RK_S32 RK_MPI_MB_BeginCPUAccess(MEDIA_BUFFER mb, RK_BOOL bReadonly);
 _CAPI RK_S32 RK_MPI_MB_EndCPUAccess(MEDIA_BUFFER mb, RK_BOOL bReadonly);
+// Recycled buffers: a buffer got from the pool goes back to it once it is
+// released, and once the flows it was sent to are done with it. The pool
+// itself is freed when destroyed and all its buffers are back.
+_CAPI MEDIA_BUFFER_POOL RK_MPI_MB_POOL_Create(MB_POOL_PARAM_S *pstPoolParam);
+_CAPI RK_S32 RK_MPI_MB_POOL_Destroy(MEDIA_BUFFER_POOL MBPHandle);
+// NULL if bIsBlock is RK_FALSE and all the buffers are in use
+_CAPI MEDIA_BUFFER RK_MPI_MB_POOL_GetBuffer(MEDIA_BUFFER_POOL MBPHandle,
+                                            RK_BOOL bIsBlock);
 #ifdef __cplusplus
 }
 #endif
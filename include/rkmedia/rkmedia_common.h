@@ -122,6 +122,27 @@ typedef enum rkMOD_ID_E {
   RK_ID_BUTT,
 } MOD_ID_E;
 
+typedef enum rkTHREAD_SCHED_POLICY_E {
+  THREAD_SCHED_DEFAULT = 0, // keep the inherited policy
+  THREAD_SCHED_OTHER,
+  THREAD_SCHED_FIFO,
+  THREAD_SCHED_RR,
+  THREAD_SCHED_BUTT
+} THREAD_SCHED_POLICY_E;
+
+/* the scheduling of the thread owned by a channel, all 0 means default.
+ * It was added at the end of VI_CHN_ATTR_S, VENC_CHN_ATTR_S, RGA_ATTR_S,
+ * ALGO_MD_ATTR_S and ALGO_OD_ATTR_S, which grew by its size: apps built
+ * with the older headers must be rebuilt, and should memset these structs
+ * to 0 before filling them. Out of range values are ignored with a
+ * warning. */
+typedef struct rkTHREAD_ATTR_S {
+  RK_U32 u32CpuMask; // bit n for cpu n, 0: no affinity.
+  THREAD_SCHED_POLICY_E enPolicy;
+  RK_S32 s32Priority; // [1, 99] for THREAD_SCHED_FIFO/THREAD_SCHED_RR.
+  RK_S32 s32Nice;     // [-20, 19], 0: not set.
+} THREAD_ATTR_S;
+
 enum {
   /***********************************
    * Common error types
@@ -319,6 +340,23 @@ typedef struct rkRECT_S {
   RK_U32 u32Height;
 } RECT_S;
 
+/* memory of one type held by the buffers of a channel */
+typedef struct rkMEM_USAGE_S {
+  RK_U64 u64Bytes; // held now
+  RK_U64 u64PeakBytes;
+  RK_U32 u32BufCnt;
+  RK_U64 u64AllocCnt;
+  RK_U64 u64AllocFailCnt;
+  // gets of the buffer pools of the channel which had to wait, or failed
+  RK_U64 u64PoolWaitCnt;
+  RK_U64 u64PoolFailCnt;
+} MEM_USAGE_S;
+
+typedef struct rkCHN_MEM_USAGE_S {
+  MEM_USAGE_S stCommon;   // heap memory
+  MEM_USAGE_S stHardware; // dma buffers, from drm or ion
+} CHN_MEM_USAGE_S;
+
 typedef struct rkLOG_LEVEL_CONF_S {
   MOD_ID_E enModId;
   RK_S32 s32Level;
@@ -21,6 +21,7 @@ typedef struct rkALGO_MD_ATTR_S {
   RK_U16 u16RoiCnt; // RW; Range:[0, ALGO_MD_ROI_RET_MAX].
   RECT_S stRoiRects[ALGO_MD_ROI_RET_MAX];
   RK_U16 u16Sensitivity; // value 0(sys default) or [1 - 100].
+  THREAD_ATTR_S stThreadAttr;
 } ALGO_MD_ATTR_S;
 
 #ifdef __cplusplus
@@ -21,6 +21,7 @@ typedef struct rkALGO_OD_ATTR_S {
   RK_U16 u16RoiCnt; // RW; Range:[0, ALGO_OD_ROI_RET_MAX].
   RECT_S stRoiRects[ALGO_OD_ROI_RET_MAX];
   RK_U16 u16Sensitivity; // value 0(sys default) or [1 - 100].
+  THREAD_ATTR_S stThreadAttr;
 } ALGO_OD_ATTR_S;
 
 #ifdef __cplusplus
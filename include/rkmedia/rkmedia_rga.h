@@ -27,6 +27,9 @@ typedef struct rkRGA_ATTR_S {
   RK_U16 u16Rotaion;   // support 0/90/180/270.
   RK_BOOL bEnBufPool;
   RK_U16 u16BufPoolCnt;
+  // RGA runs in the thread of its source by default,
+  // setting it gives the channel its own thread.
+  THREAD_ATTR_S stThreadAttr;
 } RGA_ATTR_S;
 
 #ifdef __cplusplus
@@ -205,6 +205,7 @@ typedef struct rkVENC_CHN_ATTR_S {
   VENC_ATTR_S stVencAttr;    // the attribute of video encoder
   VENC_RC_ATTR_S stRcAttr;   // the attribute of rate  ctrl
   VENC_GOP_ATTR_S stGopAttr; // the attribute of gop
+  THREAD_ATTR_S stThreadAttr; // the encoding thread
 } VENC_CHN_ATTR_S;
 
 /* The param of H264e cbr*/
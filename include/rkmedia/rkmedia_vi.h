@@ -23,6 +23,8 @@ typedef enum rkVI_CHN_BUF_TYPE {
   VI_CHN_BUF_TYPE_MMAP,
 } VI_CHN_BUF_TYPE;
 
+#define VI_DETACH_MS_MAX 10000
+
 typedef struct rkVI_CHN_ATTR_S {
   const RK_CHAR *pcVideoNode;
   RK_U32 u32Width;
@@ -31,6 +33,12 @@ typedef struct rkVI_CHN_ATTR_S {
   RK_U32 u32BufCnt;          // VI capture video buffer cnt.
   VI_CHN_BUF_TYPE enBufType; // VI capture video buffer type.
   VI_CHN_WORK_MODE enWorkMode;
+  THREAD_ATTR_S stThreadAttr; // the capture thread
+  // A capture buffer held longer than this (ms) by a slow consumer is
+  // copied, and given back to the driver. 0: held until released.
+  // Values above VI_DETACH_MS_MAX turn it off with a warning. Added with
+  // stThreadAttr at the end of the struct, see THREAD_ATTR_S.
+  RK_U32 u32DetachMs;
 } VI_CHN_ATTR_S;
 
 typedef struct rkVIDEO_REGION_INFO_S {
@@ -11,7 +11,14 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "buffer_tracker.h"
 #include "key_string.h"
+#include "mem_account.h"
+#include "slab_allocator.h"
 #include "utils.h"
 
 namespace easymedia {
@@ -34,20 +41,27 @@ MediaBuffer::MemType StringToMemType(const char *s) {
 
 static int free_common_memory(void *buffer) {
   if (buffer)
-    free(buffer);
+    SlabAllocator::Deallocate(buffer);
 
   return 0;
 }
 
-static MediaBuffer alloc_common_memory(size_t size) {
-  void *buffer = malloc(size);
+static void *slab_allocate(size_t size, unsigned int flag) {
+  if (flag & MEM_FLAG_HUGE_PAGE)
+    return SlabAllocator::AllocateHuge(size);
+  return SlabAllocator::Allocate(size);
+}
+
+static MediaBuffer alloc_common_memory(size_t size, unsigned int flag) {
+  void *buffer = slab_allocate(size, flag);
   if (!buffer)
     return MediaBuffer();
   return MediaBuffer(buffer, size, -1, buffer, free_common_memory);
 }
 
-static MediaGroupBuffer *alloc_common_memory_group(size_t size) {
-  void *buffer = malloc(size);
+static MediaGroupBuffer *alloc_common_memory_group(size_t size,
+                                                   unsigned int flag) {
+  void *buffer = slab_allocate(size, flag);
   if (!buffer)
     return nullptr;
   MediaGroupBuffer *mgb =
@@ -353,14 +367,15 @@ static MediaBuffer alloc_drm_memory(size_t size, unsigned int flag,
   return MediaBuffer();
 }
 
-static MediaGroupBuffer *alloc_drm_memory_group(size_t size, bool map = true) {
+static MediaGroupBuffer *alloc_drm_memory_group(size_t size, unsigned int flag,
+                                                bool map = true) {
   const static std::shared_ptr<DrmDevice> &drm_dev = DrmDevice::GetInstance();
   DrmBuffer *db = nullptr;
 
   do {
     if (!drm_dev || !drm_dev->Valid())
       break;
-    db = new DrmBuffer(drm_dev, size, ROCKCHIP_BO_CACHABLE);
+    db = new DrmBuffer(drm_dev, size, flag);
     if (!db || !db->Valid())
       break;
     if (map && !db->MapToVirtual())
@@ -383,20 +398,21 @@ std::shared_ptr<MediaBuffer> MediaBuffer::Alloc(size_t size, MemType type,
   MediaBuffer &&mb = Alloc2(size, type, flag);
   if (mb.GetSize() == 0)
     return nullptr;
-  return std::make_shared<MediaBuffer>(mb);
+  return MakePooled<MediaBuffer>(mb);
 }
 
-MediaBuffer MediaBuffer::Alloc2(size_t size, MemType type, unsigned int flag) {
+static MediaBuffer alloc_memory(size_t size, MediaBuffer::MemType type,
+                                unsigned int flag) {
   switch (type) {
-  case MemType::MEM_COMMON:
-    return alloc_common_memory(size);
+  case MediaBuffer::MemType::MEM_COMMON:
+    return alloc_common_memory(size, flag);
 #ifdef LIBION
-  case MemType::MEM_HARD_WARE:
+  case MediaBuffer::MemType::MEM_HARD_WARE:
     return alloc_ion_memory(size);
 #endif
 #ifdef LIBDRM
-  case MemType::MEM_HARD_WARE:
-    return alloc_drm_memory(size, flag);
+  case MediaBuffer::MemType::MEM_HARD_WARE:
+    return alloc_drm_memory(size, flag & ~MEM_FLAG_HUGE_PAGE);
 #endif
   default:
     RKMEDIA_LOGI("unknown memtype\n");
@@ -404,6 +420,17 @@ MediaBuffer MediaBuffer::Alloc2(size_t size, MemType type, unsigned int flag) {
   }
 }
 
+MediaBuffer MediaBuffer::Alloc2(size_t size, MemType type, unsigned int flag) {
+  MediaBuffer mb = alloc_memory(size, type, flag);
+  if (mb.GetSize() == 0) {
+    MemAccount::OnAllocFail((int)type);
+    return mb;
+  }
+  // charge the real size, drm rounds it up to pages
+  mb.SetUserData(MemAccount::Track(mb.GetUserData(), (int)type, mb.GetSize()));
+  return mb;
+}
+
 std::shared_ptr<MediaBuffer> MediaBuffer::Clone(MediaBuffer &src,
                                                 MemType dst_type) {
   size_t size = src.GetValidSize();
@@ -422,6 +449,225 @@ std::shared_ptr<MediaBuffer> MediaBuffer::Clone(MediaBuffer &src,
   return new_buffer;
 }
 
+MediaBuffer::MediaBuffer(const MediaBuffer &buffer) : MediaBuffer() {
+  MediaBuffer &src = const_cast<MediaBuffer &>(buffer);
+  src.Pin();
+  *this = buffer;
+  src.Unpin();
+}
+
+namespace {
+
+// Keeps a parent pinned as long as the views of its memory live.
+class PinHolder {
+public:
+  explicit PinHolder(const std::shared_ptr<MediaBuffer> &mb) : buffer(mb) {
+    buffer->Pin();
+  }
+  ~PinHolder() { buffer->Unpin(); }
+
+private:
+  std::shared_ptr<MediaBuffer> buffer;
+};
+
+std::shared_ptr<void> PinParent(const std::shared_ptr<MediaBuffer> &parent) {
+  return MakePooled<PinHolder>(parent);
+}
+
+} // namespace
+
+std::shared_ptr<MediaBuffer>
+MediaBuffer::Slice(const std::shared_ptr<MediaBuffer> &parent, size_t offset,
+                   size_t length) {
+  if (!parent || !parent->GetPtr())
+    return nullptr;
+  // some wrappers only set the valid size
+  size_t size = std::max(parent->GetSize(), parent->GetValidSize());
+  if (offset > size || length > size - offset) {
+    RKMEDIA_LOGE("Slice: [%zu, +%zu) is out of buffer size %zu\n", offset,
+                 length, size);
+    return nullptr;
+  }
+  auto view =
+      MakePooled<MediaBuffer>((uint8_t *)parent->GetPtr() + offset, length);
+  view->SetValidSize(length);
+  view->CopyAttribute(*parent);
+  view->SetAtomicClock(parent->GetAtomicClock());
+  view->SetUserData(PinParent(parent));
+  return view;
+}
+
+ImageBuffer::ImageBuffer(const MediaBuffer &buffer, const ImageInfo &info)
+    : MediaBuffer(buffer), image_info(info), origin_x(0), origin_y(0) {
+  SetType(Type::Image);
+  if (buffer.HasOrigin()) {
+    const ImageBuffer &view = static_cast<const ImageBuffer &>(buffer);
+    origin_x = view.origin_x;
+    origin_y = view.origin_y;
+  }
+  // if set a valid info, set valid size
+  size_t s = CalPixFmtSize(info);
+  if (s > 0)
+    SetValidSize(s);
+}
+
+ImageBuffer::ImageBuffer(const std::shared_ptr<ImageBuffer> &parent,
+                         const ImageRect &rect)
+    : MediaBuffer(*parent), image_info(parent->image_info),
+      origin_x(parent->origin_x), origin_y(parent->origin_y) {
+  SetUserData(PinParent(parent));
+  GetRelatedSPtrs().clear();
+  ImagePlane planes[MAX_IMAGE_PLANE_NUM];
+  int num = GetImagePlanes(image_info, 0, 0, planes);
+  int x = std::max(rect.x, 0);
+  int y = std::max(rect.y, 0);
+  int w = std::min(rect.x + rect.w, image_info.width) - x;
+  int h = std::min(rect.y + rect.h, image_info.height) - y;
+  PixelFormat fmt = image_info.pix_fmt;
+  if (num > 1 || fmt == PIX_FMT_YUYV422 || fmt == PIX_FMT_UYVY422) {
+    x &= ~1;
+    y &= ~1;
+    w &= ~1;
+    h &= ~1;
+  }
+  if (num == 0 || w <= 0 || h <= 0) {
+    RKMEDIA_LOGE("ImageBuffer: can not crop %s (%d,%d,%d,%d) of %dx%d\n",
+                 PixFmtToString(fmt), rect.x, rect.y, rect.w, rect.h,
+                 image_info.width, image_info.height);
+    image_info.width = 0;
+    image_info.height = 0;
+    SetValidSize(0);
+    return;
+  }
+  origin_x += x;
+  origin_y += y;
+  image_info.width = w;
+  image_info.height = h;
+}
+
+std::shared_ptr<MediaBuffer>
+ImageBuffer::Materialize(const std::shared_ptr<MediaBuffer> &mb) {
+  if (!mb || !mb->HasOrigin())
+    return mb;
+  auto view = std::static_pointer_cast<ImageBuffer>(mb);
+  ImageInfo info = view->image_info;
+  info.vir_width = info.width;
+  info.vir_height = info.height;
+  ImagePlane src[MAX_IMAGE_PLANE_NUM], dst[MAX_IMAGE_PLANE_NUM];
+  int num = view->GetPlanes(src);
+  size_t size = CalPixFmtSize(info);
+  if (num == 0 || size == 0) {
+    RKMEDIA_LOGE("ImageBuffer: can not copy invalid view\n");
+    return nullptr;
+  }
+  auto buffer = MediaBuffer::Alloc(size, view->IsHwBuffer()
+                                             ? MemType::MEM_HARD_WARE
+                                             : MemType::MEM_COMMON);
+  if (!buffer) {
+    LOG_NO_MEMORY();
+    return nullptr;
+  }
+  GetImagePlanes(info, 0, 0, dst);
+  view->BeginCPUAccess(true);
+  buffer->BeginCPUAccess(false);
+  for (int i = 0; i < num; i++) {
+    // the planes are packed in the copy, a plane ends where the next starts
+    size_t end = (i + 1 < num) ? dst[i + 1].offset : size;
+    int rows = (end - dst[i].offset) / dst[i].stride;
+    const uint8_t *from = (const uint8_t *)view->GetPtr() + src[i].offset;
+    uint8_t *to = (uint8_t *)buffer->GetPtr() + dst[i].offset;
+    for (int j = 0; j < rows; j++)
+      memcpy(to + (size_t)j * dst[i].stride, from + (size_t)j * src[i].stride,
+             dst[i].stride);
+  }
+  buffer->EndCPUAccess(false);
+  view->EndCPUAccess(true);
+  auto plain = MakePooled<ImageBuffer>(*buffer, info);
+  plain->SetUserFlag(view->GetUserFlag());
+  plain->SetUSTimeStamp(view->GetUSTimeStamp());
+  plain->SetEOF(view->IsEOF());
+  plain->SetAtomicClock(view->GetAtomicClock());
+  return plain;
+}
+
+static std::atomic<uint64_t> cow_write_cnt(0);
+static std::atomic<uint64_t> cow_clone_cnt(0);
+static std::atomic<uint64_t> cow_pool_clone_cnt(0);
+static std::atomic<uint64_t> cow_fail_cnt(0);
+
+bool MediaBuffer::MakeWritable(std::shared_ptr<MediaBuffer> &mb,
+                               BufferPool *pool) {
+  if (!mb)
+    return false;
+  cow_write_cnt++;
+  if (!mb->IsShared())
+    return true;
+
+  size_t size = mb->GetValidSize();
+  std::shared_ptr<MediaBuffer> mem;
+  if (pool) {
+    mem = pool->GetBuffer(false);
+    if (mem && mem->GetSize() < size)
+      mem.reset();
+    if (mem)
+      cow_pool_clone_cnt++;
+  }
+  if (!mem)
+    mem = Alloc(size, mb->IsHwBuffer() ? MemType::MEM_HARD_WARE
+                                       : MemType::MEM_COMMON);
+  if (!mem) {
+    cow_fail_cnt++;
+    LOG_NO_MEMORY();
+    return false;
+  }
+  mb->BeginCPUAccess(true);
+  memcpy(mem->GetPtr(), mb->GetPtr(), size);
+  mb->EndCPUAccess(true);
+
+  // same wrapper, the memory of the copy, not shared by anybody
+  auto copy = mb->Duplicate();
+  copy->SetPtr(mem->GetPtr());
+  copy->SetFD(mem->GetFD());
+  copy->SetSize(mem->GetSize());
+  copy->SetUserData(mem);
+  copy->sharers = 0;
+  // our share goes once the caller drops the other copies of mb
+  mb = copy;
+  cow_clone_cnt++;
+  return true;
+}
+
+namespace {
+
+class ShareHolder {
+public:
+  explicit ShareHolder(const std::shared_ptr<MediaBuffer> &mb) : buffer(mb) {
+    buffer->AddSharers(1);
+  }
+  ~ShareHolder() { buffer->AddSharers(-1); }
+
+private:
+  std::shared_ptr<MediaBuffer> buffer;
+};
+
+} // namespace
+
+std::shared_ptr<MediaBuffer>
+MediaBuffer::Share(const std::shared_ptr<MediaBuffer> &mb) {
+  if (!mb)
+    return nullptr;
+  // the holder, in the control block of the share, goes with its last copy
+  auto holder = MakePooled<ShareHolder>(mb);
+  return std::shared_ptr<MediaBuffer>(holder, mb.get());
+}
+
+void MediaBuffer::GetCowStats(CowStats &stats) {
+  stats.write_cnt = cow_write_cnt.load();
+  stats.clone_cnt = cow_clone_cnt.load();
+  stats.pool_clone_cnt = cow_pool_clone_cnt.load();
+  stats.fail_cnt = cow_fail_cnt.load();
+}
+
 void MediaBuffer::CopyAttribute(MediaBuffer &src_attr) {
   type = src_attr.GetType();
   user_flag = src_attr.GetUserFlag();
@@ -474,14 +720,15 @@ void MediaBuffer::EndCPUAccess(bool readonly) {
     RKMEDIA_LOGI("%s: %s\n", __func__, strerror(errno));
 }
 
-MediaGroupBuffer *MediaGroupBuffer::Alloc(size_t size,
-                                          MediaBuffer::MemType type) {
+static MediaGroupBuffer *alloc_memory_group(size_t size,
+                                            MediaBuffer::MemType type,
+                                            unsigned int flag) {
   switch (type) {
   case MediaBuffer::MemType::MEM_COMMON:
-    return alloc_common_memory_group(size);
+    return alloc_common_memory_group(size, flag);
 #ifdef LIBDRM
   case MediaBuffer::MemType::MEM_HARD_WARE:
-    return alloc_drm_memory_group(size);
+    return alloc_drm_memory_group(size, flag & ~MEM_FLAG_HUGE_PAGE);
 #endif
   default:
     RKMEDIA_LOGI("unknown memtype\n");
@@ -489,16 +736,69 @@ MediaGroupBuffer *MediaGroupBuffer::Alloc(size_t size,
   }
 }
 
-BufferPool::BufferPool(int cnt, int size, MediaBuffer::MemType type) {
+MediaGroupBuffer *MediaGroupBuffer::Alloc(size_t size,
+                                          MediaBuffer::MemType type,
+                                          unsigned int flag) {
+  MediaGroupBuffer *mgb = alloc_memory_group(size, type, flag);
+  if (!mgb) {
+    MemAccount::OnAllocFail((int)type);
+    return nullptr;
+  }
+  mgb->userdata = MemAccount::Track(mgb->userdata, (int)type, mgb->GetSize());
+  return mgb;
+}
+
+static int64_t steady_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+BufferPool::BufferPool(int cnt, int size, MediaBuffer::MemType type,
+                       unsigned int flag) {
+  BufferPoolParam bp_param;
+  bp_param.min_cnt = cnt;
+  bp_param.max_cnt = cnt;
+  bp_param.low_watermark = 0;
+  bp_param.high_watermark = cnt;
+  bp_param.idle_ms = 0;
+  bp_param.grow_ms = 0;
+  Init(bp_param, size, type, flag);
+}
+
+BufferPool::BufferPool(const BufferPoolParam &bp_param, int size,
+                       MediaBuffer::MemType type, unsigned int flag) {
+  Init(bp_param, size, type, flag);
+}
+
+void BufferPool::Init(const BufferPoolParam &bp_param, int size,
+                      MediaBuffer::MemType type, unsigned int flag) {
   bool sucess = true;
 
-  if (cnt <= 0) {
-    RKMEDIA_LOGE("BufferPool: cnt:%d is invalid!\n", cnt);
+  param = bp_param;
+  mem_type = type;
+  mem_flag = flag;
+  ready_head = nullptr;
+  ready_cnt = 0;
+  busy_cnt = 0;
+  buf_total = 0;
+  idle_since = 0;
+  short_since = 0;
+  buf_size = size;
+  memset(&stats, 0, sizeof(stats));
+  wait_time_sum = 0;
+  MemAccount::GetThreadOwner(owner_mod, owner_chn);
+
+  int cnt = param.min_cnt;
+  if (cnt <= 0 || param.max_cnt < cnt) {
+    RKMEDIA_LOGE("BufferPool: cnt:%d, max cnt:%d is invalid!\n", cnt,
+                 param.max_cnt);
     return;
   }
 
+  buffers.reserve(param.max_cnt);
   for (int i = 0; i < cnt; i++) {
-    auto mgb = MediaGroupBuffer::Alloc(size, type);
+    auto mgb = MediaGroupBuffer::Alloc(size, type, flag);
     if (!mgb) {
       sucess = false;
       break;
@@ -506,49 +806,43 @@ BufferPool::BufferPool(int cnt, int size, MediaBuffer::MemType type) {
     mgb->SetBufferPool(this);
     RKMEDIA_LOGD("Create: pool:%p, mgb:%p, ptr:%p, fd:%d, size:%zu\n", this,
                  mgb, mgb->GetPtr(), mgb->GetFD(), mgb->GetSize());
-    ready_buffers.push_back(mgb);
+    mgb->index = buffers.size();
+    buffers.push_back(mgb);
+    PushReady(mgb);
   }
 
   if (!sucess) {
-    while (ready_buffers.size() > 0)
-      ready_buffers.pop_front();
+    for (auto mgb : buffers)
+      delete mgb;
+    buffers.clear();
+    ready_head = nullptr;
+    ready_cnt = 0;
     RKMEDIA_LOGE("BufferPool: Create buffer pool failed! Please check space is "
                  "enough!\n");
     return;
   }
-  buf_cnt = cnt;
-  buf_size = size;
-  RKMEDIA_LOGD("BufferPool: Create buffer pool:%p, size:%d, cnt:%d\n", this,
-               size, cnt);
+  buf_total = cnt;
+  stats.buf_cnt = stats.peak_buf_cnt = cnt;
+  RKMEDIA_LOGD("BufferPool: Create buffer pool:%p, size:%d, cnt:%d, max:%d\n",
+               this, size, cnt, param.max_cnt);
 }
 
 BufferPool::~BufferPool() {
-  int cnt = 0;
-  int wait_times = 30;
-
-  while (busy_buffers.size() > 0) {
-    if (wait_times-- <= 0) {
+  {
+    std::unique_lock<std::mutex> lk(mtx);
+    if (!idle_cond.wait_for(lk, std::chrono::milliseconds(900),
+                            [this] { return busy_cnt == 0; }))
       RKMEDIA_LOGE("BufferPool: waiting bufferpool free for 900ms, TimeOut!\n");
-      break;
-    }
-    easymedia::usleep(30000); // wait 30ms
-  }
-
-  MediaGroupBuffer *mgb = NULL;
-  while (ready_buffers.size() > 0) {
-    mgb = ready_buffers.front();
-    ready_buffers.pop_front();
-    RKMEDIA_LOGD("BufferPool: #%02d Destroy buffer pool(ready):[%p,%p]\n", cnt,
-                 this, mgb);
-    delete mgb;
-    cnt++;
   }
 
-  while (busy_buffers.size() > 0) {
-    mgb = busy_buffers.front();
-    busy_buffers.pop_front();
-    RKMEDIA_LOGW("BufferPool: #%02d Destroy buffer pool(busy):[%p,%p]\n", cnt,
-                 this, mgb);
+  int cnt = 0;
+  for (auto mgb : buffers) {
+    if (mgb->busy)
+      RKMEDIA_LOGW("BufferPool: #%02d Destroy buffer pool(busy):[%p,%p]\n",
+                   cnt, this, mgb);
+    else
+      RKMEDIA_LOGD("BufferPool: #%02d Destroy buffer pool(ready):[%p,%p]\n",
+                   cnt, this, mgb);
     delete mgb;
     cnt++;
   }
@@ -571,66 +865,235 @@ static int __groupe_buffer_free(void *data) {
   return bp->PutBuffer(mgb);
 }
 
+void BufferPool::PushReady(MediaGroupBuffer *mgb) {
+  mgb->next_free = ready_head;
+  ready_head = mgb;
+  ready_cnt++;
+}
+
+MediaGroupBuffer *BufferPool::PopReady() {
+  MediaGroupBuffer *mgb = ready_head;
+  ready_head = mgb->next_free;
+  mgb->next_free = nullptr;
+  ready_cnt--;
+  return mgb;
+}
+
+void BufferPool::TakeIdle(std::vector<MediaGroupBuffer *> &idle) {
+  if (param.idle_ms <= 0 || ready_cnt <= param.high_watermark ||
+      buf_total <= param.min_cnt) {
+    idle_since = 0;
+    return;
+  }
+  int64_t now = steady_us();
+  if (!idle_since) {
+    idle_since = now;
+    return;
+  }
+  if (now - idle_since < (int64_t)param.idle_ms * 1000)
+    return;
+  while (ready_cnt > param.high_watermark && buf_total > param.min_cnt) {
+    MediaGroupBuffer *mgb = PopReady();
+    // swap with the last one, the order does not matter
+    MediaGroupBuffer *last = buffers.back();
+    buffers[mgb->index] = last;
+    last->index = mgb->index;
+    buffers.pop_back();
+    buf_total--;
+    stats.shrink_cnt++;
+    idle.push_back(mgb);
+  }
+  stats.buf_cnt = buffers.size();
+  idle_since = 0;
+}
+
+bool BufferPool::CanGrow(bool is_short) {
+  if (!is_short) {
+    short_since = 0;
+    return false;
+  }
+  if (param.grow_ms <= 0)
+    return true;
+  int64_t now = steady_us();
+  if (!short_since)
+    short_since = now;
+  return now - short_since >= (int64_t)param.grow_ms * 1000;
+}
+
+MediaGroupBuffer *BufferPool::Grow() {
+  MediaGroupBuffer *mgb;
+  {
+    // the getter may run for another channel
+    AutoMemOwner _amo(owner_mod, owner_chn);
+    mgb = MediaGroupBuffer::Alloc(buf_size, mem_type, mem_flag);
+  }
+  std::lock_guard<std::mutex> lg(mtx);
+  if (!mgb) {
+    buf_total--;
+    // memory is short, do not try again and again
+    param.max_cnt = buf_total;
+    RKMEDIA_LOGW("BufferPool: %p fail to grow, capped to %d buffers\n", this,
+                 buf_total);
+    return nullptr;
+  }
+  mgb->SetBufferPool(this);
+  mgb->index = buffers.size();
+  buffers.push_back(mgb);
+  stats.grow_cnt++;
+  stats.buf_cnt = buffers.size();
+  stats.peak_buf_cnt = std::max(stats.peak_buf_cnt, stats.buf_cnt);
+  return mgb;
+}
+
 std::shared_ptr<MediaBuffer> BufferPool::GetBuffer(bool block) {
-  AutoLockMutex _alm(mtx);
-
-  while (1) {
-    if (!ready_buffers.size()) {
-      if (block)
-        mtx.wait();
-      else
-        return nullptr;
+  MediaGroupBuffer *mgb = nullptr;
+  std::vector<MediaGroupBuffer *> idle;
+  int64_t begin = 0;
+  int prefill = 0;
+  std::unique_lock<std::mutex> lk(mtx);
+  stats.get_cnt++;
+  if (ready_head)
+    stats.hit_cnt++;
+  else
+    stats.miss_cnt++;
+  while (!ready_head) {
+    if (buf_total < param.max_cnt && CanGrow(true)) {
+      // allocate one more buffer for ourselves
+      buf_total++;
+      lk.unlock();
+      mgb = Grow();
+      lk.lock();
+      if (mgb)
+        break;
+      // capped now, wait for a put or fail
+      continue;
+    }
+    if (!block) {
+      stats.fail_cnt++;
+      MemAccount::OnPoolFail(owner_mod, owner_chn, (int)mem_type);
+      return nullptr;
     }
-    // mtx.notify wake up all mtx.wait.
-    if (ready_buffers.size() > 0)
+    if (!begin) {
+      stats.wait_cnt++;
+      MemAccount::OnPoolWait(owner_mod, owner_chn, (int)mem_type);
+      begin = steady_us();
+    }
+    if (buf_total < param.max_cnt) {
+      // grow when due, unless a buffer is put back before
+      int64_t due = short_since + (int64_t)param.grow_ms * 1000;
+      ready_cond.wait_until(lk, std::chrono::steady_clock::time_point(
+                                    std::chrono::microseconds(due)));
+    } else {
+      ready_cond.wait(lk);
+    }
+  }
+  if (begin) {
+    int64_t wait = steady_us() - begin;
+    wait_time_sum += wait;
+    stats.wait_time_max = std::max(stats.wait_time_max, wait);
+  }
+  if (!mgb)
+    mgb = PopReady();
+  mgb->busy = true;
+  busy_cnt++;
+  stats.peak_busy_cnt = std::max(stats.peak_busy_cnt, busy_cnt);
+  // short while below the low watermark, or with none left for the next get
+  if (CanGrow(ready_cnt < std::max(param.low_watermark, 1))) {
+    while (ready_cnt + prefill < param.low_watermark &&
+           buf_total < param.max_cnt) {
+      buf_total++;
+      prefill++;
+    }
+  }
+  TakeIdle(idle);
+  lk.unlock();
+  for (auto m : idle)
+    delete m;
+
+  while (prefill-- > 0) {
+    auto extra = Grow();
+    std::lock_guard<std::mutex> lg(mtx);
+    if (!extra) {
+      // give back the other reserved slots
+      buf_total -= prefill;
+      param.max_cnt = buf_total;
       break;
+    }
+    PushReady(extra);
+    ready_cond.notify_one();
   }
 
-  auto mgb = ready_buffers.front();
-  ready_buffers.pop_front();
-  busy_buffers.push_back(mgb);
-
-  auto &&mb = std::make_shared<MediaBuffer>(
-      mgb->GetPtr(), mgb->GetSize(), mgb->GetFD(), mgb, __groupe_buffer_free);
-  return mb;
+  if (BufferTracker::IsEnabled()) {
+    char origin[32];
+    snprintf(origin, sizeof(origin), "pool %p", this);
+    BufferTracker::Register(mgb->GetPtr(), origin);
+  }
+  return MakePooled<MediaBuffer>(mgb->GetPtr(), mgb->GetSize(), mgb->GetFD(),
+                                 mgb, __groupe_buffer_free);
 }
 
 int BufferPool::PutBuffer(MediaGroupBuffer *mgb) {
-  std::list<MediaGroupBuffer *>::iterator it;
-  bool sucess = false;
-  AutoLockMutex _alm(mtx);
-
-  for (it = busy_buffers.begin(); it != busy_buffers.end();) {
-    if (*it == mgb) {
-      sucess = true;
-      it = busy_buffers.erase(it);
-      ready_buffers.push_back(mgb);
-      mtx.notify();
-      break;
+  std::vector<MediaGroupBuffer *> idle;
+  BufferTracker::Unregister(mgb->GetPtr());
+  {
+    std::lock_guard<std::mutex> lg(mtx);
+    if (mgb->pool != this || !mgb->busy) {
+      RKMEDIA_LOGE("BufferPool: Unknow media group buffer:%p\n", mgb);
+      return -1;
     }
-    it++;
+    mgb->busy = false;
+    PushReady(mgb);
+    TakeIdle(idle);
+    // Notify with the lock held: once the last buffer is back, the
+    // destructor may run as soon as the lock is released.
+    // Any getter can take the buffer, wake up only one.
+    ready_cond.notify_one();
+    if (--busy_cnt == 0)
+      idle_cond.notify_all();
   }
+  // not in the pool anymore, safe even if the pool is gone
+  for (auto m : idle)
+    delete m;
 
-  if (!sucess)
-    RKMEDIA_LOGE("BufferPool: Unknow media group buffer:%p\n", mgb);
+  return 0;
+}
 
-  return sucess ? 0 : -1;
+void BufferPool::GetStats(BufferPoolStats &bp_stats) {
+  std::lock_guard<std::mutex> lg(mtx);
+  bp_stats = stats;
+  bp_stats.busy_cnt = busy_cnt;
+  bp_stats.wait_time_avg = stats.wait_cnt ? wait_time_sum / stats.wait_cnt : 0;
 }
 
 void BufferPool::DumpInfo() {
-  int id = 0;
+  BufferPoolStats st;
+  GetStats(st);
+  std::lock_guard<std::mutex> lg(mtx);
   RKMEDIA_LOGI("##BufferPool DumpInfo:%p\n", this);
-  RKMEDIA_LOGI("\tcnt:%d\n", buf_cnt);
-  RKMEDIA_LOGI("\tsize:%zu\n", buf_size);
-  RKMEDIA_LOGI("\tready buffers(%d):\n", ready_buffers.size());
-  for (auto dev : ready_buffers)
-    RKMEDIA_LOGI("\t  #%02d Pool:%p, mgb:%p, ptr:%p\n", id++, dev->pool, dev,
-                 dev->GetPtr());
-  RKMEDIA_LOGI("\tbusy buffers(%d):\n", busy_buffers.size());
+  RKMEDIA_LOGI("\tcnt:%d, min:%d, max:%d, peak:%d\n", st.buf_cnt,
+               param.min_cnt, param.max_cnt, st.peak_buf_cnt);
+  RKMEDIA_LOGI("\tsize:%d\n", buf_size);
+  RKMEDIA_LOGI("\tget:%llu, hit:%llu, miss:%llu, fail:%llu, wait:%llu\n",
+               (unsigned long long)st.get_cnt, (unsigned long long)st.hit_cnt,
+               (unsigned long long)st.miss_cnt,
+               (unsigned long long)st.fail_cnt,
+               (unsigned long long)st.wait_cnt);
+  RKMEDIA_LOGI("\twait time(us): avg:%lld, max:%lld\n",
+               (long long)st.wait_time_avg, (long long)st.wait_time_max);
+  RKMEDIA_LOGI("\tgrow:%llu, shrink:%llu\n", (unsigned long long)st.grow_cnt,
+               (unsigned long long)st.shrink_cnt);
+  RKMEDIA_LOGI("\tready buffers(%d):\n", ready_cnt);
+  int id = 0;
+  for (auto mgb = ready_head; mgb; mgb = mgb->next_free)
+    RKMEDIA_LOGI("\t  #%02d Pool:%p, mgb:%p, ptr:%p\n", id++, mgb->pool, mgb,
+                 mgb->GetPtr());
+  RKMEDIA_LOGI("\tbusy buffers(%d), peak:%d:\n", busy_cnt, st.peak_busy_cnt);
   id = 0;
-  for (auto dev : busy_buffers)
-    RKMEDIA_LOGI("\t  #%02d Pool:%p, mgb:%p, ptr:%p\n", id++, dev->pool, dev,
-                 dev->GetPtr());
+  for (auto mgb : buffers) {
+    if (mgb->busy)
+      RKMEDIA_LOGI("\t  #%02d Pool:%p, mgb:%p, ptr:%p\n", id++, mgb->pool, mgb,
+                   mgb->GetPtr());
+  }
 }
 
 } // namespace easymedia
@@ -0,0 +1,193 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "buffer_tracker.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace easymedia {
+
+namespace {
+
+struct Record {
+  char origin[48];
+  char holder[32];
+  int mod;
+  int chn;
+  int64_t born;       // us
+  int64_t held_since; // us, by the current holder
+  bool warned;
+};
+
+class Tracker {
+public:
+  Tracker() : warn_ms(0), watchdog_started(false) {
+    const char *str = getenv("RKMEDIA_BUFFER_TRACK_MS");
+    if (str)
+      Enable(atoi(str));
+  }
+  void Enable(int ms);
+  void Watch();
+
+  std::atomic<int> warn_ms;
+  std::mutex mtx;
+  std::condition_variable cond;
+  bool watchdog_started;
+  std::unordered_map<const void *, Record> records;
+};
+
+} // namespace
+
+// Never destroyed, buffers may still be released by other static objects
+// after exit.
+static Tracker &GetTracker() {
+  static Tracker *tracker = new Tracker();
+  return *tracker;
+}
+
+static void copy_str(char *dst, size_t size, const char *src) {
+  strncpy(dst, src ? src : "", size - 1);
+  dst[size - 1] = 0;
+}
+
+static void format_record(const void *key, const Record &r, int64_t now,
+                          std::string &dump_info) {
+  char str_line[256];
+  snprintf(str_line, sizeof(str_line),
+           "  buffer %p from %s, held by %s(%d:%d) for %" PRId64
+           " ms, age %" PRId64 " ms\r\n",
+           key, r.origin, r.holder[0] ? r.holder : "producer", r.mod, r.chn,
+           (now - r.held_since) / 1000, (now - r.born) / 1000);
+  dump_info.append(str_line);
+}
+
+void Tracker::Enable(int ms) {
+  std::lock_guard<std::mutex> lg(mtx);
+  warn_ms.store(ms > 0 ? ms : 0, std::memory_order_relaxed);
+  if (ms <= 0) {
+    records.clear();
+    return;
+  }
+  if (!watchdog_started) {
+    watchdog_started = true;
+    std::thread(&Tracker::Watch, this).detach();
+  }
+  cond.notify_one();
+  RKMEDIA_LOGI("BufferTracker: enabled, warn after %d ms\n", ms);
+}
+
+void Tracker::Watch() {
+  std::unique_lock<std::mutex> lk(mtx);
+  while (true) {
+    int ms = warn_ms.load(std::memory_order_relaxed);
+    if (ms <= 0) {
+      cond.wait(lk);
+      continue;
+    }
+    cond.wait_for(lk, std::chrono::milliseconds(std::max(ms / 2, 10)));
+    ms = warn_ms.load(std::memory_order_relaxed);
+    if (ms <= 0)
+      continue;
+    std::string warnings;
+    int64_t now = gettimeofday();
+    for (auto &it : records) {
+      Record &r = it.second;
+      if (r.warned || now - r.held_since < (int64_t)ms * 1000)
+        continue;
+      r.warned = true;
+      format_record(it.first, r, now, warnings);
+    }
+    if (warnings.empty())
+      continue;
+    // log without the lock, the hooks run on every frame
+    lk.unlock();
+    RKMEDIA_LOGW("BufferTracker: held for more than %d ms:\n%s", ms,
+                 warnings.c_str());
+    lk.lock();
+  }
+}
+
+void BufferTracker::Enable(int warn_ms) { GetTracker().Enable(warn_ms); }
+
+bool BufferTracker::IsEnabled() {
+  return GetTracker().warn_ms.load(std::memory_order_relaxed) > 0;
+}
+
+void BufferTracker::Register(const void *key, const char *origin) {
+  if (!IsEnabled() || !key)
+    return;
+  Record r;
+  copy_str(r.origin, sizeof(r.origin), origin);
+  r.holder[0] = 0;
+  r.mod = r.chn = 0;
+  r.born = r.held_since = gettimeofday();
+  r.warned = false;
+  Tracker &tracker = GetTracker();
+  std::lock_guard<std::mutex> lg(tracker.mtx);
+  tracker.records[key] = r;
+}
+
+void BufferTracker::Unregister(const void *key) {
+  if (!IsEnabled() || !key)
+    return;
+  Tracker &tracker = GetTracker();
+  std::lock_guard<std::mutex> lg(tracker.mtx);
+  tracker.records.erase(key);
+}
+
+void BufferTracker::SetHolder(const void *key, const char *holder, int mod,
+                              int chn) {
+  if (!IsEnabled() || !key)
+    return;
+  int64_t now = gettimeofday();
+  Tracker &tracker = GetTracker();
+  std::lock_guard<std::mutex> lg(tracker.mtx);
+  auto it = tracker.records.find(key);
+  if (it == tracker.records.end())
+    return;
+  Record &r = it->second;
+  copy_str(r.holder, sizeof(r.holder), holder);
+  r.mod = mod;
+  r.chn = chn;
+  r.held_since = now;
+  r.warned = false;
+}
+
+void BufferTracker::Dump(std::string &dump_info, int min_age_ms) {
+  std::vector<std::pair<const void *, Record>> held;
+  Tracker &tracker = GetTracker();
+  {
+    std::lock_guard<std::mutex> lg(tracker.mtx);
+    held.assign(tracker.records.begin(), tracker.records.end());
+  }
+  int64_t now = gettimeofday();
+  std::sort(held.begin(), held.end(),
+            [](const std::pair<const void *, Record> &a,
+               const std::pair<const void *, Record> &b) {
+              return a.second.held_since < b.second.held_since;
+            });
+  char str_line[128];
+  snprintf(str_line, sizeof(str_line),
+           "#Dump outstanding buffers(%zu), tracking %s:\r\n", held.size(),
+           IsEnabled() ? "on" : "off");
+  dump_info.append(str_line);
+  for (auto &it : held) {
+    if (now - it.second.held_since < (int64_t)min_age_ms * 1000)
+      break;
+    format_record(it.first, it.second, now, dump_info);
+  }
+}
+
+} // namespace easymedia
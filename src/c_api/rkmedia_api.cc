@@ -3,18 +3,26 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <fcntl.h>
 #include <mutex>
+#include <sched.h>
 #include <string>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
+#include "buffer_tracker.h"
 #include "encoder.h"
 #include "image.h"
 #include "key_string.h"
+#include "lock.h"
 #include "media_config.h"
 #include "media_type.h"
+#include "mem_account.h"
 #include "message.h"
+#include "ring_queue.h"
+#include "slab_allocator.h"
 #include "stream.h"
 #include "utils.h"
 
@@ -71,6 +79,11 @@ typedef VO_CHN_ATTR_S RkmediaVOAttr;
 #define RKMEDIA_CHNNAL_BUFFER_GOD_MODE_LIMIT 1
 
 typedef struct _RkmediaChannel {
+  // State lock of the channel: its flows, attributes and osd. The calls
+  // which open, close or bind channels take the g_xxx_mtx of the module
+  // first, then this one, the others only take this one so a channel
+  // reconfigured does not stall the others.
+  std::mutex chn_mtx;
   MOD_ID_E mode_id;
   RK_U16 chn_id;
   CHN_STATUS status;
@@ -99,12 +112,22 @@ typedef struct _RkmediaChannel {
   };
   RK_S16 bind_ref_pre;
   RK_S16 bind_ref_nxt;
-  std::mutex buffer_list_mtx;
-  std::condition_variable buffer_list_cond;
-  bool buffer_list_quit;
-  int wake_fd[2];
-  std::list<MEDIA_BUFFER> buffer_list;
-  // protect by g_xxx_mtx.
+  // Buffers waiting for RK_MPI_SYS_GetMediaBuffer, the oldest one is dropped
+  // when full. Nothing is locked on the way, and getters blocked on the
+  // event are only woken up if there are some.
+  easymedia::RingQueue<MEDIA_BUFFER> buffer_list{
+      RKMEDIA_CHNNAL_BUFFER_LIMIT, RKMEDIA_CHN_BUFFER_DEPTH_MAX};
+  easymedia::FutexEvent buffer_list_event;
+  std::atomic_bool buffer_list_quit;
+  // Buffers counted in and out of the list. The eventfd, in semaphore mode,
+  // is only written when it goes from 0 to 1 and read when it goes back to
+  // 0, so it stays readable while buffers are queued at the cost of two
+  // syscalls per burst rather than per buffer. It blocks, the read waits
+  // for the write of the 0 to 1 transition it follows. 0 if the channel has
+  // none.
+  std::atomic_int buffer_list_cnt;
+  int wake_fd;
+  // protect by chn_mtx.
   CHN_OUT_CB_STATUS rkmedia_out_cb_status;
 
   // used for venc osd.
@@ -156,48 +179,151 @@ std::mutex g_vo_mtx;
 RkmediaChannel g_vdec_chns[VDEC_MAX_CHN_NUM];
 std::mutex g_vdec_mtx;
 
-static inline void RkmediaPushPipFd(int fd) {
-  int i = 0;
-  ssize_t count = write(fd, &i, sizeof(i));
+// Append the thread scheduling of a channel to its flow param,
+// return false if nothing is set. The attr may come from an app which
+// does not zero its struct, out of range values are ignored.
+static bool ThreadAttrToFlowParam(const THREAD_ATTR_S *pstAttr,
+                                  std::string &flow_param) {
+  bool bSet = false;
+  if (pstAttr->u32CpuMask) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    RK_U32 online = (cpus <= 0 || cpus >= 32) ? ~0U : (1U << cpus) - 1;
+    if (pstAttr->u32CpuMask & ~online) {
+      RKMEDIA_LOGW("invalid thread cpu mask 0x%x, %ld cpus online, ignore\n",
+                   pstAttr->u32CpuMask, cpus);
+    } else {
+      char mask[16];
+      snprintf(mask, sizeof(mask), "0x%x", pstAttr->u32CpuMask);
+      PARAM_STRING_APPEND(flow_param, KEY_CPU_AFFINITY, mask);
+      bSet = true;
+    }
+  }
+  switch (pstAttr->enPolicy) {
+  case THREAD_SCHED_OTHER:
+    PARAM_STRING_APPEND(flow_param, KEY_SCHED_POLICY, KEY_SCHED_OTHER);
+    bSet = true;
+    break;
+  case THREAD_SCHED_FIFO:
+  case THREAD_SCHED_RR:
+    if (pstAttr->s32Priority < 1 || pstAttr->s32Priority > 99) {
+      RKMEDIA_LOGW("invalid thread priority %d, not in [1, 99], ignore the "
+                   "sched policy\n",
+                   pstAttr->s32Priority);
+      break;
+    }
+    PARAM_STRING_APPEND(flow_param, KEY_SCHED_POLICY,
+                        (pstAttr->enPolicy == THREAD_SCHED_FIFO)
+                            ? KEY_SCHED_FIFO
+                            : KEY_SCHED_RR);
+    PARAM_STRING_APPEND_TO(flow_param, KEY_SCHED_PRIORITY,
+                           pstAttr->s32Priority);
+    bSet = true;
+    break;
+  case THREAD_SCHED_DEFAULT:
+    break;
+  default:
+    RKMEDIA_LOGW("invalid thread sched policy %d, ignore\n",
+                 pstAttr->enPolicy);
+    break;
+  }
+  if (pstAttr->s32Nice < -20 || pstAttr->s32Nice > 19) {
+    RKMEDIA_LOGW("invalid thread nice %d, not in [-20, 19], ignore\n",
+                 pstAttr->s32Nice);
+  } else if (pstAttr->s32Nice) {
+    PARAM_STRING_APPEND_TO(flow_param, KEY_SCHED_NICE, pstAttr->s32Nice);
+    bSet = true;
+  }
+  return bSet;
+}
+
+static inline void RkmediaPushWakeFd(int fd) {
+  eventfd_t value = 1;
+  ssize_t count = write(fd, &value, sizeof(value));
   if (count < 0)
     RKMEDIA_LOGE("%s: write(%d) failed: %s\n", __func__, fd, strerror(errno));
 }
 
-static inline void RkmediaPopPipFd(int fd) {
-  int i = 0;
-  ssize_t read_size = (ssize_t)sizeof(i);
-  ssize_t ret = read(fd, &i, sizeof(i));
-  if (ret != read_size)
-    RKMEDIA_LOGE("%s: Read(%d) failed: %s\n", __func__, fd, strerror(errno));
+static inline void RkmediaPopWakeFd(int fd) {
+  eventfd_t value = 0;
+  // The pushing thread may still be between the count and its write, which
+  // pairs with this read: block until it comes.
+  while (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)) {
+    if (errno != EINTR) {
+      RKMEDIA_LOGE("%s: Read(%d) failed: %s\n", __func__, fd, strerror(errno));
+      return;
+    }
+  }
 }
 
-static int RkmediaChnPushBuffer(RkmediaChannel *ptrChn, MEDIA_BUFFER buffer) {
-  if (!ptrChn || !buffer)
-    return -1;
+static void RkmediaChnOpenWakeFd(RkmediaChannel *ptrChn) {
+  ptrChn->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+  if (ptrChn->wake_fd < 0) {
+    ptrChn->wake_fd = 0;
+    RKMEDIA_LOGW("Create eventfd failed!\n");
+  }
+}
+
+static void RkmediaChnCloseWakeFd(RkmediaChannel *ptrChn) {
+  if (ptrChn->wake_fd > 0) {
+    close(ptrChn->wake_fd);
+    ptrChn->wake_fd = 0;
+  }
+}
+
+static void RkmediaTrackHolder(MEDIA_BUFFER buffer, const char *holder) {
+  if (!easymedia::BufferTracker::IsEnabled())
+    return;
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbLookup(buffer, __func__);
+  if (!mb || !mb->rkmedia_mb)
+    return;
+  easymedia::BufferTracker::SetHolder(mb->rkmedia_mb->GetPtr(), holder,
+                                      mb->mode_id, mb->chn_id);
+}
 
-  ptrChn->buffer_list_mtx.lock();
-  if (ptrChn->buffer_list.size() >= RKMEDIA_CHNNAL_BUFFER_LIMIT) {
+static void RkmediaChnQueueBuffer(RkmediaChannel *ptrChn, MEDIA_BUFFER buffer) {
+  while (!ptrChn->buffer_list.TryPush(buffer)) {
+    MEDIA_BUFFER mb = NULL;
+    if (!ptrChn->buffer_list.TryPop(mb))
+      continue;
     if (ptrChn->bind_ref_nxt <= 0) {
       RKMEDIA_LOGW("Mode[%d]:Chn[%d] drop buffer, Please get buffer in time!\n",
                    ptrChn->mode_id, ptrChn->chn_id);
     }
-    MEDIA_BUFFER mb = ptrChn->buffer_list.front();
-    ptrChn->buffer_list.pop_front();
     RK_MPI_MB_ReleaseBuffer(mb);
-    if (ptrChn->wake_fd[0] > 0)
-      RkmediaPopPipFd(ptrChn->wake_fd[0]);
+    if (ptrChn->buffer_list_cnt.fetch_sub(1) == 1 && ptrChn->wake_fd > 0)
+      RkmediaPopWakeFd(ptrChn->wake_fd);
   }
-  if (!ptrChn->buffer_list_quit) {
-    ptrChn->buffer_list.push_back(buffer);
-    if (ptrChn->wake_fd[1] > 0)
-      RkmediaPushPipFd(ptrChn->wake_fd[1]);
-  } else {
+  if (ptrChn->buffer_list_cnt.fetch_add(1) == 0 && ptrChn->wake_fd > 0)
+    RkmediaPushWakeFd(ptrChn->wake_fd);
+}
+
+static bool RkmediaChnTryPopBuffer(RkmediaChannel *ptrChn, MEDIA_BUFFER &mb) {
+  if (!ptrChn->buffer_list.TryPop(mb))
+    return false;
+  if (ptrChn->buffer_list_cnt.fetch_sub(1) == 1 && ptrChn->wake_fd > 0)
+    RkmediaPopWakeFd(ptrChn->wake_fd);
+  return true;
+}
+
+static void RkmediaChnDrainBuffer(RkmediaChannel *ptrChn) {
+  MEDIA_BUFFER mb = NULL;
+  while (RkmediaChnTryPopBuffer(ptrChn, mb))
+    RK_MPI_MB_ReleaseBuffer(mb);
+}
+
+static int RkmediaChnPushBuffer(RkmediaChannel *ptrChn, MEDIA_BUFFER buffer) {
+  if (!ptrChn || !buffer)
+    return -1;
+
+  if (ptrChn->buffer_list_quit) {
     RK_MPI_MB_ReleaseBuffer(buffer);
+    return 0;
   }
-
-  ptrChn->buffer_list_cond.notify_all();
-  ptrChn->buffer_list_mtx.unlock();
-  pthread_yield();
+  RkmediaChnQueueBuffer(ptrChn, buffer);
+  // RkmediaChnClearBuffer may have missed it
+  if (ptrChn->buffer_list_quit)
+    RkmediaChnDrainBuffer(ptrChn);
+  ptrChn->buffer_list_event.Notify();
 
   return 0;
 }
@@ -207,30 +333,34 @@ static MEDIA_BUFFER RkmediaChnPopBuffer(RkmediaChannel *ptrChn,
   if (!ptrChn)
     return NULL;
 
-  std::unique_lock<std::mutex> lck(ptrChn->buffer_list_mtx);
-  if (ptrChn->buffer_list.empty()) {
-    if (s32MilliSec < 0 && !ptrChn->buffer_list_quit) {
-      ptrChn->buffer_list_cond.wait(lck);
-    } else if (s32MilliSec > 0) {
-      if (ptrChn->buffer_list_cond.wait_for(
-              lck, std::chrono::milliseconds(s32MilliSec)) ==
-          std::cv_status::timeout) {
+  MEDIA_BUFFER mb = NULL;
+  int64_t deadline = easymedia::gettimeofday() + (int64_t)s32MilliSec * 1000;
+  while (!RkmediaChnTryPopBuffer(ptrChn, mb)) {
+    if (s32MilliSec == 0 || (s32MilliSec < 0 && ptrChn->buffer_list_quit))
+      return NULL;
+    int key = ptrChn->buffer_list_event.PrepareWait();
+    if (RkmediaChnTryPopBuffer(ptrChn, mb)) {
+      ptrChn->buffer_list_event.CancelWait();
+      break;
+    }
+    if (ptrChn->buffer_list_quit) {
+      ptrChn->buffer_list_event.CancelWait();
+      return NULL;
+    }
+    int wait_ms = -1;
+    if (s32MilliSec > 0) {
+      int64_t left = deadline - easymedia::gettimeofday();
+      if (left <= 0) {
+        ptrChn->buffer_list_event.CancelWait();
         RKMEDIA_LOGI("INFO: %s: Mode[%d]:Chn[%d] get mediabuffer timeout!\n",
                      __func__, ptrChn->mode_id, ptrChn->chn_id);
         return NULL;
       }
-    } else {
-      return NULL;
+      wait_ms = (int)((left + 999) / 1000);
     }
+    ptrChn->buffer_list_event.Wait(key, wait_ms);
   }
-
-  MEDIA_BUFFER mb = NULL;
-  if (!ptrChn->buffer_list.empty()) {
-    if (ptrChn->wake_fd[0] > 0)
-      RkmediaPopPipFd(ptrChn->wake_fd[0]);
-    mb = ptrChn->buffer_list.front();
-    ptrChn->buffer_list.pop_front();
-  }
+  RkmediaTrackHolder(mb, "app");
 
   return mb;
 }
@@ -239,9 +369,7 @@ static void RkmediaChnInitBuffer(RkmediaChannel *ptrChn) {
   if (!ptrChn)
     return;
 
-  ptrChn->buffer_list_mtx.lock();
   ptrChn->buffer_list_quit = false;
-  ptrChn->buffer_list_mtx.unlock();
 }
 
 static void RkmediaChnClearBuffer(RkmediaChannel *ptrChn) {
@@ -250,16 +378,9 @@ static void RkmediaChnClearBuffer(RkmediaChannel *ptrChn) {
 
   RKMEDIA_LOGD("#%p Mode[%d]:Chn[%d] clear media buffer start...\n", ptrChn,
                ptrChn->mode_id, ptrChn->chn_id);
-  MEDIA_BUFFER mb = NULL;
-  ptrChn->buffer_list_mtx.lock();
-  while (!ptrChn->buffer_list.empty()) {
-    mb = ptrChn->buffer_list.front();
-    ptrChn->buffer_list.pop_front();
-    RK_MPI_MB_ReleaseBuffer(mb);
-  }
   ptrChn->buffer_list_quit = true;
-  ptrChn->buffer_list_cond.notify_all();
-  ptrChn->buffer_list_mtx.unlock();
+  RkmediaChnDrainBuffer(ptrChn);
+  ptrChn->buffer_list_event.Notify();
   RKMEDIA_LOGD("#%p Mode[%d]:Chn[%d] clear media buffer end...\n", ptrChn,
                ptrChn->mode_id, ptrChn->chn_id);
 }
@@ -276,6 +397,7 @@ static void Reset_Channel_Table(RkmediaChannel *tbl, int cnt, MOD_ID_E mid) {
     tbl[i].event_cb = nullptr;
     tbl[i].bind_ref_pre = 0;
     tbl[i].bind_ref_nxt = 0;
+    tbl[i].buffer_list.SetCapacity(RKMEDIA_CHNNAL_BUFFER_LIMIT);
     tbl[i].bColorTblInit = RK_FALSE;
     tbl[i].bColorDichotomyEnable = RK_FALSE;
     memset(tbl[i].u32ArgbColorTbl, 0, 0);
@@ -299,21 +421,84 @@ RK_S32 RK_MPI_SYS_Init() {
   return RK_ERR_SYS_OK;
 }
 
+static void get_mem_usage(int mod, int chn, int type, MEM_USAGE_S *pstUsage) {
+  easymedia::MemUsage usage;
+  memset(pstUsage, 0, sizeof(*pstUsage));
+  if (!easymedia::MemAccount::GetUsage(mod, chn, type, usage))
+    return;
+  pstUsage->u64Bytes = usage.bytes;
+  pstUsage->u64PeakBytes = usage.peak_bytes;
+  pstUsage->u32BufCnt = usage.buffers;
+  pstUsage->u64AllocCnt = usage.alloc_cnt;
+  pstUsage->u64AllocFailCnt = usage.fail_cnt;
+  pstUsage->u64PoolWaitCnt = usage.pool_wait_cnt;
+  pstUsage->u64PoolFailCnt = usage.pool_fail_cnt;
+}
+
+static void dump_mem_usage(int mod, int chn, const char *name) {
+  static const char *type_names[] = {"common", "hardware"};
+  for (int type = 0; type < easymedia::MemAccount::kTypeNum; type++) {
+    MEM_USAGE_S usage;
+    get_mem_usage(mod, chn, type, &usage);
+    if (!usage.u64AllocCnt && !usage.u64AllocFailCnt && !usage.u64PoolWaitCnt)
+      continue;
+    RKMEDIA_LOGI("%s->mem(%s): %llu bytes, %u buffers, peak:%llu, "
+                 "alloc:%llu, fail:%llu, pool wait:%llu, pool fail:%llu\n",
+                 name, type_names[type], usage.u64Bytes, usage.u32BufCnt,
+                 usage.u64PeakBytes, usage.u64AllocCnt, usage.u64AllocFailCnt,
+                 usage.u64PoolWaitCnt, usage.u64PoolFailCnt);
+  }
+}
+
 RK_VOID RK_MPI_SYS_DumpChn(MOD_ID_E enModId) {
   RK_U16 u16ChnMaxCnt = 0;
   RkmediaChannel *pChns = NULL;
+  std::mutex *pMutex = NULL;
   switch (enModId) {
   case RK_ID_VI:
     u16ChnMaxCnt = VI_MAX_CHN_NUM;
     pChns = g_vi_chns;
+    pMutex = &g_vi_mtx;
     break;
   case RK_ID_VENC:
     u16ChnMaxCnt = VENC_MAX_CHN_NUM;
     pChns = g_venc_chns;
+    pMutex = &g_venc_mtx;
     break;
   case RK_ID_RGA:
     u16ChnMaxCnt = RGA_MAX_CHN_NUM;
     pChns = g_rga_chns;
+    pMutex = &g_rga_mtx;
+    break;
+  case RK_ID_AI:
+    u16ChnMaxCnt = AI_MAX_CHN_NUM;
+    pChns = g_ai_chns;
+    pMutex = &g_ai_mtx;
+    break;
+  case RK_ID_AENC:
+    u16ChnMaxCnt = AENC_MAX_CHN_NUM;
+    pChns = g_aenc_chns;
+    pMutex = &g_aenc_mtx;
+    break;
+  case RK_ID_AO:
+    u16ChnMaxCnt = AO_MAX_CHN_NUM;
+    pChns = g_ao_chns;
+    pMutex = &g_ao_mtx;
+    break;
+  case RK_ID_ADEC:
+    u16ChnMaxCnt = ADEC_MAX_CHN_NUM;
+    pChns = g_adec_chns;
+    pMutex = &g_adec_mtx;
+    break;
+  case RK_ID_VO:
+    u16ChnMaxCnt = VO_MAX_CHN_NUM;
+    pChns = g_vo_chns;
+    pMutex = &g_vo_mtx;
+    break;
+  case RK_ID_VDEC:
+    u16ChnMaxCnt = VDEC_MAX_CHN_NUM;
+    pChns = g_vdec_chns;
+    pMutex = &g_vdec_mtx;
     break;
   default:
     RKMEDIA_LOGE("To do...\n");
@@ -321,15 +506,87 @@ RK_VOID RK_MPI_SYS_DumpChn(MOD_ID_E enModId) {
   }
 
   RKMEDIA_LOGI("Dump Mode:%d:\n", enModId);
+  dump_mem_usage(RK_ID_UNKNOW, 0, "  Unattributed");
+  pMutex->lock();
   for (RK_U16 i = 0; i < u16ChnMaxCnt; i++) {
     RKMEDIA_LOGI("  Chn[%d]->status:%d\n", i, pChns[i].status);
     RKMEDIA_LOGI("  Chn[%d]->bind_ref_pre:%d\n", i, pChns[i].bind_ref_pre);
     RKMEDIA_LOGI("  Chn[%d]->bind_ref_nxt:%d\n", i, pChns[i].bind_ref_nxt);
     RKMEDIA_LOGI("  Chn[%d]->output_cb:%p\n", i, pChns[i].out_cb);
     RKMEDIA_LOGI("  Chn[%d]->event_cb:%p\n\n", i, pChns[i].event_cb);
+    if (pChns[i].status < CHN_STATUS_OPEN)
+      continue;
+    char chn_name[16];
+    snprintf(chn_name, sizeof(chn_name), "  Chn[%d]", i);
+    dump_mem_usage(enModId, i, chn_name);
+    // flow configuration and runtime stats of the whole channel pipeline
+    std::string dump_info;
+    if (pChns[i].rkmedia_flow) {
+      pChns[i].rkmedia_flow->Dump(dump_info);
+      RKMEDIA_LOGI("%s\n", dump_info.c_str());
+    }
+    for (auto &flow : pChns[i].rkmedia_flow_list) {
+      flow->Dump(dump_info);
+      RKMEDIA_LOGI("%s\n", dump_info.c_str());
+    }
   }
+  pMutex->unlock();
 }
 
+RK_S32 RK_MPI_SYS_GetChnMemUsage(const MPP_CHN_S *pstChn,
+                                 CHN_MEM_USAGE_S *pstUsage) {
+  if (!pstChn || !pstUsage)
+    return -RK_ERR_SYS_NULL_PTR;
+  if (pstChn->enModId < RK_ID_UNKNOW || pstChn->enModId >= RK_ID_BUTT ||
+      pstChn->s32ChnId < 0 ||
+      pstChn->s32ChnId >= easymedia::MemAccount::kChnNum)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  get_mem_usage(pstChn->enModId, pstChn->s32ChnId,
+                (int)easymedia::MediaBuffer::MemType::MEM_COMMON,
+                &pstUsage->stCommon);
+  get_mem_usage(pstChn->enModId, pstChn->s32ChnId,
+                (int)easymedia::MediaBuffer::MemType::MEM_HARD_WARE,
+                &pstUsage->stHardware);
+  return RK_ERR_SYS_OK;
+}
+
+RK_VOID RK_MPI_SYS_SetBufferTrack(RK_U32 u32WarnMs) {
+  easymedia::BufferTracker::Enable((int)u32WarnMs);
+}
+
+RK_VOID RK_MPI_SYS_DumpBuffers(RK_U32 u32MinAgeMs) {
+  std::string dump_info;
+  char str_line[64];
+  snprintf(str_line, sizeof(str_line), "#Dump media buffers held(%d):\r\n",
+           RK_MPI_MB_GetLiveCount(RK_ID_BUTT));
+  dump_info.append(str_line);
+  for (int i = 0; i < RK_ID_BUTT; i++) {
+    RK_S32 cnt = RK_MPI_MB_GetLiveCount((MOD_ID_E)i);
+    if (!cnt)
+      continue;
+    snprintf(str_line, sizeof(str_line), "  mode[%d]: %d\r\n", i, cnt);
+    dump_info.append(str_line);
+  }
+  easymedia::BufferTracker::Dump(dump_info, (int)u32MinAgeMs);
+  RKMEDIA_LOGI("%s\n", dump_info.c_str());
+  easymedia::CowStats cow;
+  easymedia::MediaBuffer::GetCowStats(cow);
+  RKMEDIA_LOGI("#Copy on write: write:%llu, copy:%llu, from pool:%llu, "
+               "fail:%llu\n",
+               (unsigned long long)cow.write_cnt,
+               (unsigned long long)cow.clone_cnt,
+               (unsigned long long)cow.pool_clone_cnt,
+               (unsigned long long)cow.fail_cnt);
+  easymedia::SlabAllocator::DumpInfo();
+}
+
+RK_VOID RK_MPI_SYS_SetCommonMemCap(RK_U64 u64Bytes) {
+  easymedia::SlabAllocator::SetMemCap((size_t)u64Bytes);
+}
+
+RK_VOID RK_MPI_SYS_TrimCommonMem() { easymedia::SlabAllocator::Trim(); }
+
 RK_S32 RK_MPI_SYS_Bind(const MPP_CHN_S *pstSrcChn,
                        const MPP_CHN_S *pstDestChn) {
   std::shared_ptr<easymedia::Flow> src;
@@ -449,6 +706,7 @@ RK_S32 RK_MPI_SYS_Bind(const MPP_CHN_S *pstSrcChn,
   }
 
   src_mutex->lock();
+  src_chn->chn_mtx.lock();
   // Rkmedia flow bind
   src->AddDownFlow(sink, 0, 0);
   if ((src_chn->rkmedia_out_cb_status == CHN_OUT_CB_INIT) ||
@@ -462,11 +720,14 @@ RK_S32 RK_MPI_SYS_Bind(const MPP_CHN_S *pstSrcChn,
   // change status frome OPEN to BIND.
   src_chn->status = CHN_STATUS_BIND;
   src_chn->bind_ref_nxt++;
+  src_chn->chn_mtx.unlock();
   src_mutex->unlock();
 
   dst_mutex->lock();
+  dst_chn->chn_mtx.lock();
   dst_chn->status = CHN_STATUS_BIND;
   dst_chn->bind_ref_pre++;
+  dst_chn->chn_mtx.unlock();
   dst_mutex->unlock();
 
   return RK_ERR_SYS_OK;
@@ -596,6 +857,7 @@ RK_S32 RK_MPI_SYS_UnBind(const MPP_CHN_S *pstSrcChn,
   }
 
   src_mutex->lock();
+  src_chn->chn_mtx.lock();
   // Rkmedia flow unbind
   src->RemoveDownFlow(sink);
   src_chn->bind_ref_nxt--;
@@ -605,9 +867,11 @@ RK_S32 RK_MPI_SYS_UnBind(const MPP_CHN_S *pstSrcChn,
     src_chn->bind_ref_pre = 0;
     src_chn->bind_ref_nxt = 0;
   }
+  src_chn->chn_mtx.unlock();
   src_mutex->unlock();
 
   dst_mutex->lock();
+  dst_chn->chn_mtx.lock();
   dst_chn->bind_ref_pre--;
   // change status frome BIND to OPEN.
   if ((dst_chn->bind_ref_nxt <= 0) && (dst_chn->bind_ref_pre <= 0)) {
@@ -615,6 +879,7 @@ RK_S32 RK_MPI_SYS_UnBind(const MPP_CHN_S *pstSrcChn,
     dst_chn->bind_ref_pre = 0;
     dst_chn->bind_ref_nxt = 0;
   }
+  dst_chn->chn_mtx.unlock();
   dst_mutex->unlock();
 
   return RK_ERR_SYS_OK;
@@ -687,12 +952,16 @@ FlowOutputCallback(void *handle,
       return;
   }
 
-  MEDIA_BUFFER_IMPLE *mb = new MEDIA_BUFFER_IMPLE;
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbAcquire(target_chn->mode_id);
   if (!mb) {
     RKMEDIA_LOGE("%s mode[%d]:chn[%d] no space left for new mb!\n", __func__,
                  target_chn->mode_id, target_chn->chn_id);
     return;
   }
+  // the app uses the memory through mb->ptr and mb->fd until it releases mb
+  rkmedia_mb->Pin();
+  mb->pin.reset(rkmedia_mb.get(),
+                [rkmedia_mb](void *) { rkmedia_mb->Unpin(); });
   mb->ptr = rkmedia_mb->GetPtr();
   mb->fd = rkmedia_mb->GetFD();
   mb->size = rkmedia_mb->GetValidSize();
@@ -722,10 +991,11 @@ FlowOutputCallback(void *handle,
   }
   // RK_MPI_SYS_GetMediaBuffer and output callback function,
   // can only choose one.
+  RkmediaTrackHolder(mb->handle, target_chn->out_cb ? "app" : "chn queue");
   if (target_chn->out_cb)
-    target_chn->out_cb(mb);
+    target_chn->out_cb(mb->handle);
   else
-    RkmediaChnPushBuffer(target_chn, mb);
+    RkmediaChnPushBuffer(target_chn, mb->handle);
 }
 
 RK_S32 RK_MPI_SYS_RegisterOutCb(const MPP_CHN_S *pstChn, OutCbFunc cb) {
@@ -877,318 +1147,261 @@ RK_S32 RK_MPI_SYS_RegisterEventCb(const MPP_CHN_S *pstChn, EventCbFunc cb) {
   return RK_ERR_SYS_OK;
 }
 
-RK_S32 RK_MPI_SYS_StartGetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID) {
+// The channel of a module giving output buffers, NULL if there is none.
+static RkmediaChannel *RkmediaLookupOutputChn(MOD_ID_E enModID,
+                                              RK_S32 s32ChnID,
+                                              const char *func) {
   RkmediaChannel *target_chn = NULL;
-  std::mutex *target_mutex = NULL;
 
   switch (enModID) {
   case RK_ID_VI:
     if (s32ChnID < 0 || s32ChnID >= VI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid VI ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+      RKMEDIA_LOGE("%s invalid VI ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_vi_chns[s32ChnID];
-    target_mutex = &g_vi_mtx;
     break;
   case RK_ID_VENC:
     if (s32ChnID < 0 || s32ChnID >= VENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_venc_chns[s32ChnID];
-    target_mutex = &g_venc_mtx;
     break;
   case RK_ID_AI:
     if (s32ChnID < 0 || s32ChnID >= AI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AI ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+      RKMEDIA_LOGE("%s invalid AI ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_ai_chns[s32ChnID];
-    target_mutex = &g_ai_mtx;
     break;
   case RK_ID_AENC:
-    if (s32ChnID < 0 || s32ChnID > AENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+    if (s32ChnID < 0 || s32ChnID >= AENC_MAX_CHN_NUM) {
+      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_aenc_chns[s32ChnID];
-    target_mutex = &g_aenc_mtx;
     break;
   case RK_ID_RGA:
-    if (s32ChnID < 0 || s32ChnID > RGA_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+    if (s32ChnID < 0 || s32ChnID >= RGA_MAX_CHN_NUM) {
+      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_rga_chns[s32ChnID];
-    target_mutex = &g_rga_mtx;
     break;
   case RK_ID_ADEC:
-    if (s32ChnID < 0 || s32ChnID > ADEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+    if (s32ChnID < 0 || s32ChnID >= ADEC_MAX_CHN_NUM) {
+      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_adec_chns[s32ChnID];
-    target_mutex = &g_adec_mtx;
     break;
   case RK_ID_VDEC:
-    if (s32ChnID < 0 || s32ChnID > VDEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
+    if (s32ChnID < 0 || s32ChnID >= VDEC_MAX_CHN_NUM) {
+      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", func, s32ChnID);
+      return NULL;
     }
     target_chn = &g_vdec_chns[s32ChnID];
-    target_mutex = &g_vdec_mtx;
     break;
   default:
-    RKMEDIA_LOGE("%s invalid modeID[%d]\n", __func__, enModID);
-    return -RK_ERR_SYS_ILLEGAL_PARAM;
+    RKMEDIA_LOGE("%s invalid modeID[%d]\n", func, enModID);
+    return NULL;
   }
 
-  if (target_chn->status < CHN_STATUS_OPEN)
-    return -RK_ERR_SYS_NOT_PERM;
+  return target_chn;
+}
 
-  RkmediaChnInitBuffer(target_chn);
-  target_mutex->lock();
+RK_S32 RK_MPI_SYS_StartGetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID) {
+  RkmediaChannel *target_chn =
+      RkmediaLookupOutputChn(enModID, s32ChnID, __func__);
+  if (!target_chn)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  // the channel may be destroyed meanwhile, its flow with it
+  target_chn->chn_mtx.lock();
+  if (target_chn->status < CHN_STATUS_OPEN) {
+    target_chn->chn_mtx.unlock();
+    return -RK_ERR_SYS_NOT_PERM;
+  }
   if (target_chn->rkmedia_out_cb_status == CHN_OUT_CB_USER) {
-    target_mutex->unlock();
+    // the buffers queued meanwhile are for this get
+    RkmediaChnInitBuffer(target_chn);
+    target_chn->chn_mtx.unlock();
     return RK_ERR_SYS_OK;
   } else if (target_chn->rkmedia_out_cb_status == CHN_OUT_CB_CLOSE) {
+    // left by a producer racing with the last stop
+    RkmediaChnDrainBuffer(target_chn);
     RKMEDIA_LOGD("%s: enable rkmedia output callback!\n", __func__);
     target_chn->rkmedia_flow->SetOutputCallBack(target_chn, FlowOutputCallback);
   }
+  RkmediaChnInitBuffer(target_chn);
   target_chn->rkmedia_out_cb_status = CHN_OUT_CB_USER;
-  target_mutex->unlock();
+  target_chn->chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_SYS_StopGetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID) {
-  RkmediaChannel *target_chn = NULL;
-  std::mutex *target_mutex = NULL;
-
-  switch (enModID) {
-  case RK_ID_VI:
-    if (s32ChnID < 0 || s32ChnID >= VI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid VI ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_vi_chns[s32ChnID];
-    target_mutex = &g_vi_mtx;
-    break;
-  case RK_ID_VENC:
-    if (s32ChnID < 0 || s32ChnID >= VENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_venc_chns[s32ChnID];
-    target_mutex = &g_venc_mtx;
-    break;
-  case RK_ID_AI:
-    if (s32ChnID < 0 || s32ChnID >= AI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AI ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_ai_chns[s32ChnID];
-    target_mutex = &g_ai_mtx;
-    break;
-  case RK_ID_AENC:
-    if (s32ChnID < 0 || s32ChnID > AENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_aenc_chns[s32ChnID];
-    target_mutex = &g_aenc_mtx;
-    break;
-  case RK_ID_RGA:
-    if (s32ChnID < 0 || s32ChnID > RGA_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_rga_chns[s32ChnID];
-    target_mutex = &g_rga_mtx;
-    break;
-  case RK_ID_ADEC:
-    if (s32ChnID < 0 || s32ChnID > ADEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_adec_chns[s32ChnID];
-    target_mutex = &g_adec_mtx;
-    break;
-  case RK_ID_VDEC:
-    if (s32ChnID < 0 || s32ChnID > VDEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return -RK_ERR_SYS_ILLEGAL_PARAM;
-    }
-    target_chn = &g_vdec_chns[s32ChnID];
-    target_mutex = &g_vdec_mtx;
-    break;
-  default:
-    RKMEDIA_LOGE("%s invalid modeID[%d]\n", __func__, enModID);
+  RkmediaChannel *target_chn =
+      RkmediaLookupOutputChn(enModID, s32ChnID, __func__);
+  if (!target_chn)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
-  }
 
-  if (target_chn->status < CHN_STATUS_OPEN)
+  target_chn->chn_mtx.lock();
+  if (target_chn->status < CHN_STATUS_OPEN) {
+    target_chn->chn_mtx.unlock();
     return -RK_ERR_SYS_NOT_PERM;
-
+  }
   RkmediaChnClearBuffer(target_chn);
-  target_mutex->lock();
   target_chn->rkmedia_out_cb_status = CHN_OUT_CB_CLOSE;
   target_chn->rkmedia_flow->SetOutputCallBack(NULL, NULL);
   RKMEDIA_LOGD("%s: disable rkmedia output callback!\n", __func__);
-  target_mutex->unlock();
+  target_chn->chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
-MEDIA_BUFFER RK_MPI_SYS_GetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID,
-                                       RK_S32 s32MilliSec) {
-  RkmediaChannel *target_chn = NULL;
-
-  switch (enModID) {
-  case RK_ID_VI:
-    if (s32ChnID < 0 || s32ChnID >= VI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid VI ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_vi_chns[s32ChnID];
-    break;
-  case RK_ID_VENC:
-    if (s32ChnID < 0 || s32ChnID >= VENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_venc_chns[s32ChnID];
-    break;
-  case RK_ID_AI:
-    if (s32ChnID < 0 || s32ChnID >= AI_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AI ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_ai_chns[s32ChnID];
-    break;
-  case RK_ID_AENC:
-    if (s32ChnID < 0 || s32ChnID > AENC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid AENC ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_aenc_chns[s32ChnID];
-    break;
-  case RK_ID_RGA:
-    if (s32ChnID < 0 || s32ChnID > RGA_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_rga_chns[s32ChnID];
-    break;
-  case RK_ID_ADEC:
-    if (s32ChnID < 0 || s32ChnID > ADEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_adec_chns[s32ChnID];
-    break;
-  case RK_ID_VDEC:
-    if (s32ChnID < 0 || s32ChnID > VDEC_MAX_CHN_NUM) {
-      RKMEDIA_LOGE("%s invalid RGA ChnID[%d]\n", __func__, s32ChnID);
-      return NULL;
-    }
-    target_chn = &g_vdec_chns[s32ChnID];
-    break;
-  default:
-    RKMEDIA_LOGE("%s invalid modeID[%d]\n", __func__, enModID);
+// The channel whose output buffers are got, NULL if it can not give any.
+static RkmediaChannel *RkmediaGetOutputChn(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                           const char *func) {
+  RkmediaChannel *target_chn = RkmediaLookupOutputChn(enModID, s32ChnID, func);
+  if (!target_chn)
     return NULL;
-  }
 
   if (target_chn->status < CHN_STATUS_OPEN) {
     RKMEDIA_LOGE("%s Mode[%d]:Chn[%d] in status[%d], "
                  "this operation is not allowed!\n",
-                 __func__, enModID, s32ChnID, target_chn->status);
+                 func, enModID, s32ChnID, target_chn->status);
     return NULL;
   }
 
   if (RK_MPI_SYS_StartGetMediaBuffer(enModID, s32ChnID)) {
     RKMEDIA_LOGE("%s Mode[%d]:Chn[%d] start get mediabuffer failed!\n",
-                 __func__, enModID, s32ChnID);
+                 func, enModID, s32ChnID);
     return NULL;
   }
 
+  return target_chn;
+}
+
+MEDIA_BUFFER RK_MPI_SYS_GetMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                       RK_S32 s32MilliSec) {
+  RkmediaChannel *target_chn =
+      RkmediaGetOutputChn(enModID, s32ChnID, __func__);
+  if (!target_chn)
+    return NULL;
+
   return RkmediaChnPopBuffer(target_chn, s32MilliSec);
 }
 
+RK_S32 RK_MPI_SYS_GetMediaBuffers(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                  MEDIA_BUFFER *pMbs, RK_S32 s32Max,
+                                  RK_S32 s32MilliSec) {
+  if (!pMbs || s32Max <= 0)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  RkmediaChannel *target_chn =
+      RkmediaGetOutputChn(enModID, s32ChnID, __func__);
+  if (!target_chn)
+    return -RK_ERR_SYS_NOTREADY;
+
+  // only the first one is waited for
+  pMbs[0] = RkmediaChnPopBuffer(target_chn, s32MilliSec);
+  if (!pMbs[0])
+    return 0;
+  RK_S32 s32Cnt = 1;
+  while (s32Cnt < s32Max &&
+         RkmediaChnTryPopBuffer(target_chn, pMbs[s32Cnt])) {
+    RkmediaTrackHolder(pMbs[s32Cnt], "app");
+    s32Cnt++;
+  }
+
+  return s32Cnt;
+}
+
+RK_S32 RK_MPI_SYS_SetMediaBufferDepth(MOD_ID_E enModID, RK_S32 s32ChnID,
+                                      RK_S32 s32Depth) {
+  if (s32Depth <= 0 || s32Depth > RKMEDIA_CHN_BUFFER_DEPTH_MAX) {
+    RKMEDIA_LOGE("%s: depth %d out of [1, %d]\n", __func__, s32Depth,
+                 RKMEDIA_CHN_BUFFER_DEPTH_MAX);
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+  }
+  RkmediaChannel *target_chn =
+      RkmediaLookupOutputChn(enModID, s32ChnID, __func__);
+  if (!target_chn)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  // the buffers beyond a lower depth are dropped by the next push
+  target_chn->buffer_list.SetCapacity(s32Depth);
+  return RK_ERR_SYS_OK;
+}
+
 RK_S32 RK_MPI_SYS_SendMediaBuffer(MOD_ID_E enModID, RK_S32 s32ChnID,
                                   MEDIA_BUFFER buffer) {
   RkmediaChannel *target_chn = NULL;
-  std::mutex *target_mutex = NULL;
 
   switch (enModID) {
   case RK_ID_VENC:
     if (s32ChnID < 0 || s32ChnID >= VENC_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_venc_chns[s32ChnID];
-    target_mutex = &g_venc_mtx;
     break;
   case RK_ID_AENC:
-    if (s32ChnID < 0 || s32ChnID > AENC_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= AENC_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_aenc_chns[s32ChnID];
-    target_mutex = &g_aenc_mtx;
     break;
   case RK_ID_ALGO_MD:
-    if (s32ChnID < 0 || s32ChnID > ALGO_MD_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= ALGO_MD_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_algo_md_chns[s32ChnID];
-    target_mutex = &g_algo_md_mtx;
     break;
   case RK_ID_ALGO_OD:
-    if (s32ChnID < 0 || s32ChnID > ALGO_OD_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= ALGO_OD_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_algo_od_chns[s32ChnID];
-    target_mutex = &g_algo_od_mtx;
     break;
   case RK_ID_ADEC:
-    if (s32ChnID < 0 || s32ChnID > ADEC_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= ADEC_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_adec_chns[s32ChnID];
-    target_mutex = &g_adec_mtx;
     break;
   case RK_ID_AO:
-    if (s32ChnID < 0 || s32ChnID > AO_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= AO_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_ao_chns[s32ChnID];
-    target_mutex = &g_ao_mtx;
     break;
   case RK_ID_RGA:
-    if (s32ChnID < 0 || s32ChnID > RGA_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= RGA_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_rga_chns[s32ChnID];
-    target_mutex = &g_rga_mtx;
     break;
   case RK_ID_VO:
-    if (s32ChnID < 0 || s32ChnID > VO_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= VO_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_vo_chns[s32ChnID];
-    target_mutex = &g_vo_mtx;
     break;
   case RK_ID_VDEC:
-    if (s32ChnID < 0 || s32ChnID > VDEC_MAX_CHN_NUM)
+    if (s32ChnID < 0 || s32ChnID >= VDEC_MAX_CHN_NUM)
       return -RK_ERR_SYS_ILLEGAL_PARAM;
     target_chn = &g_vdec_chns[s32ChnID];
-    target_mutex = &g_vdec_mtx;
     break;
   default:
     return -RK_ERR_SYS_NOT_SUPPORT;
   }
 
-  MEDIA_BUFFER_IMPLE *mb = (MEDIA_BUFFER_IMPLE *)buffer;
-  target_mutex->lock();
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbLookup(buffer, __func__);
+  if (!mb)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+  target_chn->chn_mtx.lock();
   if (target_chn->rkmedia_flow) {
     target_chn->rkmedia_flow->SendInput(mb->rkmedia_mb, 0);
   } else {
-    target_mutex->unlock();
+    target_chn->chn_mtx.unlock();
     return -RK_ERR_SYS_NOT_PERM;
   }
 
-  target_mutex->unlock();
+  target_chn->chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -1200,7 +1413,7 @@ RK_S32 RK_MPI_LOG_SetLevelConf(LOG_LEVEL_CONF_S *pstConf) {
     return RK_ERR_SYS_OK;
   }
 
-  if ((pstConf->enModId < 0) || (pstConf->enModId > LOG_MOD_MAX_NUM))
+  if ((pstConf->enModId < 0) || (pstConf->enModId >= LOG_MOD_MAX_NUM))
     return -RK_ERR_SYS_ILLEGAL_PARAM;
   g_level_list[pstConf->enModId] = pstConf->s32Level;
 
@@ -1208,7 +1421,7 @@ RK_S32 RK_MPI_LOG_SetLevelConf(LOG_LEVEL_CONF_S *pstConf) {
 }
 
 RK_S32 RK_MPI_LOG_GetLevelConf(LOG_LEVEL_CONF_S *pstConf) {
-  if ((pstConf->enModId < 0) || (pstConf->enModId > LOG_MOD_MAX_NUM))
+  if ((pstConf->enModId < 0) || (pstConf->enModId >= LOG_MOD_MAX_NUM))
     return -RK_ERR_SYS_ILLEGAL_PARAM;
   pstConf->s32Level = g_level_list[pstConf->enModId];
   strncpy(pstConf->cModName, mod_tag_list[pstConf->enModId], LOG_MOD_MAX_LEN);
@@ -1221,31 +1434,39 @@ RK_S32 RK_MPI_LOG_GetLevelConf(LOG_LEVEL_CONF_S *pstConf) {
  ********************************************************************/
 RK_S32 RK_MPI_VI_SetChnAttr(VI_PIPE ViPipe, VI_CHN ViChn,
                             const VI_CHN_ATTR_S *pstChnAttr) {
-  if ((ViPipe < 0) || (ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViPipe < 0) || (ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
 
   if (!pstChnAttr || !pstChnAttr->pcVideoNode)
     return -RK_ERR_VI_ILLEGAL_PARAM;
 
   g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].status != CHN_STATUS_CLOSED) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return -RK_ERR_VI_BUSY;
   }
 
   memcpy(&g_vi_chns[ViChn].vi_attr.attr, pstChnAttr, sizeof(VI_CHN_ATTR_S));
   g_vi_chns[ViChn].status = CHN_STATUS_READY;
+  g_vi_chns[ViChn].chn_mtx.unlock();
   g_vi_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
-  if ((ViPipe < 0) || (ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViPipe < 0) || (ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
 
+  // the buffers allocated by the flows of the channel are charged to it
+  easymedia::AutoMemOwner _amo(RK_ID_VI, ViChn);
+
   g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].status != CHN_STATUS_READY) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return (g_vi_chns[ViChn].status > CHN_STATUS_READY) ? -RK_ERR_VI_EXIST
                                                         : -RK_ERR_VI_NOT_CONFIG;
@@ -1261,6 +1482,8 @@ RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
   std::string flow_name = "source_stream";
   std::string flow_param;
   PARAM_STRING_APPEND(flow_param, KEY_NAME, "v4l2_capture_stream");
+  ThreadAttrToFlowParam(&g_vi_chns[ViChn].vi_attr.attr.stThreadAttr,
+                        flow_param);
   std::string stream_param;
   PARAM_STRING_APPEND_TO(stream_param, KEY_USE_LIBV4L2, 1);
   PARAM_STRING_APPEND_TO(stream_param, KEY_CAMERA_ID, ViPipe);
@@ -1284,6 +1507,16 @@ RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
                          g_vi_chns[ViChn].vi_attr.attr.u32Width);
   PARAM_STRING_APPEND_TO(stream_param, KEY_BUFFER_HEIGHT,
                          g_vi_chns[ViChn].vi_attr.attr.u32Height);
+  // the attr may come from an app which does not zero its struct
+  RK_U32 u32DetachMs = g_vi_chns[ViChn].vi_attr.attr.u32DetachMs;
+  if (u32DetachMs > VI_DETACH_MS_MAX) {
+    RKMEDIA_LOGW("VI[%d]: invalid detach time %u ms, not in [0, %d], "
+                 "detach off\n",
+                 ViChn, u32DetachMs, VI_DETACH_MS_MAX);
+    u32DetachMs = 0;
+  }
+  if (u32DetachMs)
+    PARAM_STRING_APPEND_TO(stream_param, KEY_V4L2_DETACH_MS, u32DetachMs);
   flow_param = easymedia::JoinFlowParam(flow_param, 1, stream_param);
   RKMEDIA_LOGD("\n#VI: v4l2 source flow param:\n%s\n", flow_param.c_str());
   RK_S8 s8RetryCnt = 3;
@@ -1301,6 +1534,7 @@ RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
   }
 
   if (!g_vi_chns[ViChn].rkmedia_flow) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return -RK_ERR_VI_BUSY;
   }
@@ -1315,6 +1549,7 @@ RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
                                                    FlowOutputCallback);
   g_vi_chns[ViChn].status = CHN_STATUS_OPEN;
 
+  g_vi_chns[ViChn].chn_mtx.unlock();
   g_vi_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Enable VI[%d:%d]:%s, %dx%d End...\n", LOG_TAG,
                __func__, ViPipe, ViChn,
@@ -1326,11 +1561,13 @@ RK_S32 RK_MPI_VI_EnableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
 }
 
 RK_S32 RK_MPI_VI_DisableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
-  if ((ViPipe < 0) || (ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViPipe < 0) || (ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
   g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].status == CHN_STATUS_BIND) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return -RK_ERR_SYS_NOT_PERM;
   }
@@ -1349,10 +1586,11 @@ RK_S32 RK_MPI_VI_DisableChn(VI_PIPE ViPipe, VI_CHN ViChn) {
   g_vi_chns[ViChn].luma_buf_mtx.unlock();
   // VI flow Should be released last
   g_vi_chns[ViChn].rkmedia_flow.reset();
-  if (!g_vi_chns[ViChn].buffer_list.empty()) {
+  if (!g_vi_chns[ViChn].buffer_list.Empty()) {
     RKMEDIA_LOGI("%s %s: clear buffer list again...\n", LOG_TAG, __func__);
     RkmediaChnClearBuffer(&g_vi_chns[ViChn]);
   }
+  g_vi_chns[ViChn].chn_mtx.unlock();
   g_vi_mtx.unlock();
 
   RKMEDIA_LOGI("%s %s: Disable VI[%d:%d]:%s, %dx%d End...\n", LOG_TAG,
@@ -1400,7 +1638,7 @@ rkmediaCalculateRegionLuma(std::shared_ptr<easymedia::ImageBuffer> &rkmedia_mb,
 }
 
 RK_S32 RK_MPI_VI_StartRegionLuma(VI_CHN ViChn) {
-  if ((ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
   if (g_vi_chns[ViChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VI_NOTREADY;
@@ -1413,20 +1651,20 @@ RK_S32 RK_MPI_VI_StartRegionLuma(VI_CHN ViChn) {
   g_vi_chns[ViChn].luma_buf_start = true;
   g_vi_chns[ViChn].luma_buf_mtx.unlock();
 
-  g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].rkmedia_out_cb_status == CHN_OUT_CB_CLOSE) {
     RKMEDIA_LOGD("%s: luma mode: enable rkmedia out callback\n", __func__);
     g_vi_chns[ViChn].rkmedia_out_cb_status = CHN_OUT_CB_LUMA;
     g_vi_chns[ViChn].rkmedia_flow->SetOutputCallBack(&g_vi_chns[ViChn],
                                                      FlowOutputCallback);
   }
-  g_vi_mtx.unlock();
+  g_vi_chns[ViChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_VI_StopRegionLuma(VI_CHN ViChn) {
-  if ((ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
   if (g_vi_chns[ViChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VI_NOTREADY;
@@ -1436,14 +1674,14 @@ RK_S32 RK_MPI_VI_StopRegionLuma(VI_CHN ViChn) {
   g_vi_chns[ViChn].luma_rkmedia_buf.reset();
   g_vi_chns[ViChn].luma_buf_mtx.unlock();
 
-  g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].rkmedia_out_cb_status == CHN_OUT_CB_LUMA) {
     RKMEDIA_LOGD("%s: luma mode: disable rkmedia out callback\n", __func__);
     g_vi_chns[ViChn].rkmedia_out_cb_status = CHN_OUT_CB_CLOSE;
     g_vi_chns[ViChn].rkmedia_flow->SetOutputCallBack(&g_vi_chns[ViChn],
                                                      FlowOutputCallback);
   }
-  g_vi_mtx.unlock();
+  g_vi_chns[ViChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -1457,7 +1695,7 @@ RK_S32 RK_MPI_VI_GetChnRegionLuma(VI_PIPE ViPipe, VI_CHN ViChn,
   RK_U32 u32YOffset = 0;
   RK_S32 s32Ret = 0;
 
-  if ((ViPipe < 0) || (ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViPipe < 0) || (ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
 
   if (!pstRegionInfo || !pstRegionInfo->u32RegionNum || !pu64LumaData)
@@ -1521,29 +1759,35 @@ RK_S32 RK_MPI_VI_GetChnRegionLuma(VI_PIPE ViPipe, VI_CHN ViChn,
   if (!rkmedia_mb)
     return -RK_ERR_VI_BUF_EMPTY;
 
+  rkmedia_mb->Pin();
   for (RK_U32 i = 0; i < pstRegionInfo->u32RegionNum; i++)
     *(pu64LumaData + i) =
         rkmediaCalculateRegionLuma(rkmedia_mb, (pstRegionInfo->pstRegion + i));
+  rkmedia_mb->Unpin();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_VI_StartStream(VI_PIPE ViPipe, VI_CHN ViChn) {
-  if ((ViPipe < 0) || (ViChn < 0) || (ViChn > VI_MAX_CHN_NUM))
+  if ((ViPipe < 0) || (ViChn < 0) || (ViChn >= VI_MAX_CHN_NUM))
     return -RK_ERR_VI_INVALID_CHNID;
 
   g_vi_mtx.lock();
+  g_vi_chns[ViChn].chn_mtx.lock();
   if (g_vi_chns[ViChn].status < CHN_STATUS_OPEN) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return -RK_ERR_VI_BUSY;
   }
 
   if (!g_vi_chns[ViChn].rkmedia_flow) {
+    g_vi_chns[ViChn].chn_mtx.unlock();
     g_vi_mtx.unlock();
     return -RK_ERR_VI_NOTREADY;
   }
 
   g_vi_chns[ViChn].rkmedia_flow->StartStream();
+  g_vi_chns[ViChn].chn_mtx.unlock();
   g_vi_mtx.unlock();
 
   return RK_ERR_SYS_OK;
@@ -1824,6 +2068,7 @@ static RK_S32 RkmediaCreateJpegSnapPipeline(RkmediaChannel *VenChn) {
   video_encoder_flow->AddDownFlow(video_decoder_flow, 0, 0);
   // Init buffer list.
   RkmediaChnInitBuffer(VenChn);
+  RkmediaChnOpenWakeFd(VenChn);
   video_jpeg_flow->SetOutputCallBack(VenChn, FlowOutputCallback);
 
   VenChn->rkmedia_flow = video_encoder_flow;
@@ -1831,11 +2076,6 @@ static RK_S32 RkmediaCreateJpegSnapPipeline(RkmediaChannel *VenChn) {
   if (bEnableRga)
     VenChn->rkmedia_flow_list.push_back(video_rga_flow);
   VenChn->rkmedia_flow_list.push_back(video_jpeg_flow);
-  if (pipe2(VenChn->wake_fd, O_CLOEXEC) == -1) {
-    VenChn->wake_fd[0] = 0;
-    VenChn->wake_fd[1] = 0;
-    RKMEDIA_LOGW("Create pipe failed!\n");
-  }
   VenChn->status = CHN_STATUS_OPEN;
 
   VenChn->venc_attr.bFullFunc = RK_TRUE;
@@ -1846,11 +2086,15 @@ RK_S32 RK_MPI_VENC_CreateChn(VENC_CHN VeChn, VENC_CHN_ATTR_S *stVencChnAttr) {
   if ((VeChn < 0) || (VeChn >= VENC_MAX_CHN_NUM))
     return -RK_ERR_VENC_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_VENC, VeChn);
+
   if (!stVencChnAttr)
     return -RK_ERR_VENC_NULL_PTR;
 
   g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].status != CHN_STATUS_CLOSED) {
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     return -RK_ERR_VENC_EXIST;
   }
@@ -1874,6 +2118,7 @@ RK_S32 RK_MPI_VENC_CreateChn(VENC_CHN VeChn, VENC_CHN_ATTR_S *stVencChnAttr) {
   if ((stVencChnAttr->stVencAttr.enType == RK_CODEC_TYPE_JPEG) ||
       (stVencChnAttr->stVencAttr.enType == RK_CODEC_TYPE_MJPEG)) {
     RK_S32 ret = RkmediaCreateJpegSnapPipeline(&g_venc_chns[VeChn]);
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     RKMEDIA_LOGI("%s %s: Enable VENC[%d], Type:%d End...\n", LOG_TAG,
                  __func__, VeChn, stVencChnAttr->stVencAttr.enType);
@@ -1887,6 +2132,7 @@ RK_S32 RK_MPI_VENC_CreateChn(VENC_CHN VeChn, VENC_CHN_ATTR_S *stVencChnAttr) {
                       ImageTypeToString(stVencChnAttr->stVencAttr.imageType));
   PARAM_STRING_APPEND(flow_param, KEY_OUTPUTDATATYPE,
                       CodecToString(stVencChnAttr->stVencAttr.enType));
+  ThreadAttrToFlowParam(&stVencChnAttr->stThreadAttr, flow_param);
 
   std::string enc_param;
   PARAM_STRING_APPEND_TO(enc_param, KEY_BUFFER_WIDTH,
@@ -2076,20 +2322,18 @@ RK_S32 RK_MPI_VENC_CreateChn(VENC_CHN VeChn, VENC_CHN_ATTR_S *stVencChnAttr) {
   g_venc_chns[VeChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>("video_enc", flow_param.c_str());
   if (!g_venc_chns[VeChn].rkmedia_flow) {
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     return -RK_ERR_VENC_BUSY;
   }
   // easymedia::video_encoder_enable_statistics(g_venc_chns[VeChn].rkmedia_flow,
   // 1);
   RkmediaChnInitBuffer(&g_venc_chns[VeChn]);
+  RkmediaChnOpenWakeFd(&g_venc_chns[VeChn]);
   g_venc_chns[VeChn].rkmedia_flow->SetOutputCallBack(&g_venc_chns[VeChn],
                                                      FlowOutputCallback);
-  if (pipe2(g_venc_chns[VeChn].wake_fd, O_CLOEXEC) == -1) {
-    g_venc_chns[VeChn].wake_fd[0] = 0;
-    g_venc_chns[VeChn].wake_fd[1] = 0;
-    RKMEDIA_LOGW("Create pipe failed!\n");
-  }
   g_venc_chns[VeChn].status = CHN_STATUS_OPEN;
+  g_venc_chns[VeChn].chn_mtx.unlock();
   g_venc_mtx.unlock();
   if (stVencChnAttr->stGopAttr.enGopMode > VENC_GOPMODE_NORMALP) {
     RK_MPI_VENC_SetGopMode(VeChn, &stVencChnAttr->stGopAttr);
@@ -2108,15 +2352,15 @@ RK_S32 RK_MPI_VENC_GetVencChnAttr(VENC_CHN VeChn,
   if ((VeChn < 0) || (VeChn >= VENC_MAX_CHN_NUM))
     return -RK_ERR_VENC_INVALID_CHNID;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN) {
-    g_venc_mtx.unlock();
+    g_venc_chns[VeChn].chn_mtx.unlock();
     return -RK_ERR_VENC_NOTREADY;
   }
 
   memcpy(stVencChnAttr, &g_venc_chns[VeChn].venc_attr.attr,
          sizeof(VENC_CHN_ATTR_S));
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -2494,6 +2738,8 @@ RK_S32 RK_MPI_VENC_CreateJpegLightChn(VENC_CHN VeChn,
   if ((VeChn < 0) || (VeChn >= VENC_MAX_CHN_NUM))
     return -RK_ERR_VENC_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_VENC, VeChn);
+
   if (!stVencChnAttr)
     return -RK_ERR_VENC_NULL_PTR;
 
@@ -2573,7 +2819,9 @@ RK_S32 RK_MPI_VENC_CreateJpegLightChn(VENC_CHN VeChn,
   }
 
   g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].status != CHN_STATUS_CLOSED) {
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     return -RK_ERR_VENC_EXIST;
   }
@@ -2620,6 +2868,7 @@ RK_S32 RK_MPI_VENC_CreateJpegLightChn(VENC_CHN VeChn,
       flow_name.c_str(), flow_param.c_str());
   if (!video_jpeg_flow) {
     RKMEDIA_LOGE("[%s]: Create flow %s failed\n", __func__, flow_name.c_str());
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     return -RK_ERR_VENC_ILLEGAL_PARAM;
   }
@@ -2627,16 +2876,13 @@ RK_S32 RK_MPI_VENC_CreateJpegLightChn(VENC_CHN VeChn,
   video_jpeg_flow->SetFlowTag("JpegLightEncoder");
   // Init buffer list.
   RkmediaChnInitBuffer(&g_venc_chns[VeChn]);
+  RkmediaChnOpenWakeFd(&g_venc_chns[VeChn]);
   video_jpeg_flow->SetOutputCallBack(&g_venc_chns[VeChn], FlowOutputCallback);
 
   g_venc_chns[VeChn].rkmedia_flow = video_jpeg_flow;
   g_venc_chns[VeChn].rkmedia_flow_list.push_back(video_jpeg_flow);
-  if (pipe2(g_venc_chns[VeChn].wake_fd, O_CLOEXEC) == -1) {
-    g_venc_chns[VeChn].wake_fd[0] = 0;
-    g_venc_chns[VeChn].wake_fd[1] = 0;
-    RKMEDIA_LOGW("Create pipe failed!\n");
-  }
   g_venc_chns[VeChn].status = CHN_STATUS_OPEN;
+  g_venc_chns[VeChn].chn_mtx.unlock();
   g_venc_mtx.unlock();
 
   g_venc_chns[VeChn].venc_attr.bFullFunc = RK_FALSE;
@@ -2651,10 +2897,10 @@ RK_S32 RK_MPI_VENC_GetRcParam(VENC_CHN VeChn, VENC_RC_PARAM_S *pstRcParam) {
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   memcpy(&pstRcParam, &g_venc_chns[VeChn].venc_attr.stRcPara,
          sizeof(VENC_RC_PARAM_S));
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -2666,7 +2912,7 @@ RK_S32 RK_MPI_VENC_SetRcParam(VENC_CHN VeChn,
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
 
   VideoEncoderQp qp;
 
@@ -2696,7 +2942,7 @@ RK_S32 RK_MPI_VENC_SetRcParam(VENC_CHN VeChn,
     memcpy(&g_venc_chns[VeChn].venc_attr.stRcPara, pstRcParam,
            sizeof(VENC_RC_PARAM_S));
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return ret;
 }
 
@@ -2759,7 +3005,7 @@ RK_S32 RK_MPI_VENC_SetRcMode(VENC_CHN VeChn, VENC_RC_MODE_E RcMode) {
   if (!key_value)
     return -RK_ERR_VENC_NOT_SUPPORT;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].rkmedia_flow) {
     ret = video_encoder_set_rc_mode(g_venc_chns[VeChn].rkmedia_flow, key_value);
     ret = ret ? -RK_ERR_VENC_ILLEGAL_PARAM : RK_ERR_SYS_OK;
@@ -2769,7 +3015,7 @@ RK_S32 RK_MPI_VENC_SetRcMode(VENC_CHN VeChn, VENC_RC_MODE_E RcMode) {
   if (!ret) {
     g_venc_chns[VeChn].venc_attr.attr.stRcAttr.enRcMode = RcMode;
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return ret;
 }
@@ -2780,7 +3026,7 @@ RK_S32 RK_MPI_VENC_SetRcQuality(VENC_CHN VeChn, VENC_RC_QUALITY_E RcQuality) {
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   switch (RcQuality) {
   case VENC_RC_QUALITY_HIGHEST:
     video_encoder_set_rc_quality(g_venc_chns[VeChn].rkmedia_flow, KEY_HIGHEST);
@@ -2806,7 +3052,7 @@ RK_S32 RK_MPI_VENC_SetRcQuality(VENC_CHN VeChn, VENC_RC_QUALITY_E RcQuality) {
   default:
     break;
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -2817,7 +3063,7 @@ RK_S32 RK_MPI_VENC_SetBitrate(VENC_CHN VeChn, RK_U32 u32BitRate,
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   std::shared_ptr<easymedia::Flow> target_flow;
   if (!g_venc_chns[VeChn].rkmedia_flow_list.empty())
     target_flow = g_venc_chns[VeChn].rkmedia_flow_list.back();
@@ -2863,7 +3109,7 @@ RK_S32 RK_MPI_VENC_SetBitrate(VENC_CHN VeChn, RK_U32 u32BitRate,
       break;
     }
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -2873,10 +3119,10 @@ RK_S32 RK_MPI_VENC_RequestIDR(VENC_CHN VeChn, RK_BOOL bInstant _UNUSED) {
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   video_encoder_force_idr(g_venc_chns[VeChn].rkmedia_flow);
 
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -2887,7 +3133,7 @@ RK_S32 RK_MPI_VENC_SetFps(VENC_CHN VeChn, RK_U8 u8OutNum, RK_U8 u8OutDen,
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   int ret = video_encoder_set_fps(g_venc_chns[VeChn].rkmedia_flow, u8OutNum,
                                   u8OutDen, u8InNum, u8InDen);
   if (!ret) {
@@ -2976,7 +3222,7 @@ RK_S32 RK_MPI_VENC_SetFps(VENC_CHN VeChn, RK_U8 u8OutNum, RK_U8 u8OutDen,
       break;
     }
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 RK_S32 RK_MPI_VENC_SetGop(VENC_CHN VeChn, RK_U32 u32Gop) {
@@ -2985,7 +3231,7 @@ RK_S32 RK_MPI_VENC_SetGop(VENC_CHN VeChn, RK_U32 u32Gop) {
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   int ret = video_encoder_set_gop_size(g_venc_chns[VeChn].rkmedia_flow, u32Gop);
   if (!ret) {
     g_venc_chns[VeChn].venc_attr.attr.stGopAttr.u32GopSize = u32Gop;
@@ -3016,7 +3262,7 @@ RK_S32 RK_MPI_VENC_SetGop(VENC_CHN VeChn, RK_U32 u32Gop) {
       break;
     }
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -3028,7 +3274,7 @@ RK_S32 RK_MPI_VENC_SetAvcProfile(VENC_CHN VeChn, RK_U32 u32Profile,
     return -RK_ERR_VENC_NOTREADY;
   if (g_venc_chns[VeChn].venc_attr.attr.stVencAttr.enType != RK_CODEC_TYPE_H264)
     return -RK_ERR_VENC_NOT_SUPPORT;
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   int ret = video_encoder_set_avc_profile(g_venc_chns[VeChn].rkmedia_flow,
                                           u32Profile, u32Level);
   if (!ret) {
@@ -3036,7 +3282,7 @@ RK_S32 RK_MPI_VENC_SetAvcProfile(VENC_CHN VeChn, RK_U32 u32Profile,
     g_venc_chns[VeChn].venc_attr.attr.stVencAttr.stAttrH264e.u32Level =
         u32Level;
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return ret;
 }
 
@@ -3048,10 +3294,10 @@ RK_S32 RK_MPI_VENC_InsertUserData(VENC_CHN VeChn, RK_U8 *pu8Data,
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN)
     return -RK_ERR_VENC_NOTREADY;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   video_encoder_set_userdata(g_venc_chns[VeChn].rkmedia_flow, pu8Data, u32Len);
 
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -3066,10 +3312,10 @@ RK_S32 RK_MPI_VENC_GetRoiAttr(VENC_CHN VeChn, VENC_ROI_ATTR_S *pstRoiAttr,
   if (roi_index < 0 || roi_index > 7)
     return -RK_ERR_VENC_ILLEGAL_PARAM;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   memcpy(pstRoiAttr, &g_venc_chns[VeChn].venc_attr.astRoiAttr[roi_index],
          sizeof(VENC_ROI_ATTR_S));
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -3131,7 +3377,7 @@ RK_S32 RK_MPI_VENC_SetRoiAttr(VENC_CHN VeChn, const VENC_ROI_ATTR_S *pstRoiAttr,
     valid_rgn_cnt++;
   }
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   ret = video_encoder_set_roi_regions(g_venc_chns[VeChn].rkmedia_flow, regions,
                                       valid_rgn_cnt);
   if (!ret) {
@@ -3140,7 +3386,7 @@ RK_S32 RK_MPI_VENC_SetRoiAttr(VENC_CHN VeChn, const VENC_ROI_ATTR_S *pstRoiAttr,
              sizeof(VENC_ROI_ATTR_S));
     }
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return ret ? -RK_ERR_VENC_NOTREADY : RK_ERR_SYS_OK;
 }
@@ -3155,7 +3401,7 @@ RK_S32 RK_MPI_VENC_SetResolution(VENC_CHN VeChn,
     return -RK_ERR_VENC_NOT_SUPPORT;
   }
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   VideoResolutionCfg vid_cfg;
   vid_cfg.width = stResolutionParam.u32Width;
   vid_cfg.height = stResolutionParam.u32Height;
@@ -3174,7 +3420,7 @@ RK_S32 RK_MPI_VENC_SetResolution(VENC_CHN VeChn,
     g_venc_chns[VeChn].venc_attr.attr.stVencAttr.u32PicHeight =
         stResolutionParam.u32Height;
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -3183,7 +3429,9 @@ RK_S32 RK_MPI_VENC_DestroyChn(VENC_CHN VeChn) {
     return -RK_ERR_VENC_INVALID_CHNID;
 
   g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].status == CHN_STATUS_BIND) {
+    g_venc_chns[VeChn].chn_mtx.unlock();
     g_venc_mtx.unlock();
     return -RK_ERR_VENC_BUSY;
   }
@@ -3208,14 +3456,8 @@ RK_S32 RK_MPI_VENC_DestroyChn(VENC_CHN VeChn) {
   }
   RkmediaChnClearBuffer(&g_venc_chns[VeChn]);
   g_venc_chns[VeChn].status = CHN_STATUS_CLOSED;
-  if (g_venc_chns[VeChn].wake_fd[0] > 0) {
-    close(g_venc_chns[VeChn].wake_fd[0]);
-    g_venc_chns[VeChn].wake_fd[0] = 0;
-  }
-  if (g_venc_chns[VeChn].wake_fd[1] > 0) {
-    close(g_venc_chns[VeChn].wake_fd[1]);
-    g_venc_chns[VeChn].wake_fd[1] = 0;
-  }
+  RkmediaChnCloseWakeFd(&g_venc_chns[VeChn]);
+  g_venc_chns[VeChn].chn_mtx.unlock();
   g_venc_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Disable VENC[%d] End...\n", LOG_TAG, __func__, VeChn);
 
@@ -3227,28 +3469,28 @@ RK_S32 RK_MPI_VENC_GetFd(VENC_CHN VeChn) {
     return -RK_ERR_VENC_INVALID_CHNID;
 
   int rcv_fd = 0;
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if (g_venc_chns[VeChn].status < CHN_STATUS_OPEN) {
-    g_venc_mtx.unlock();
+    g_venc_chns[VeChn].chn_mtx.unlock();
     return -RK_ERR_VENC_NOTREADY;
   }
-  rcv_fd = g_venc_chns[VeChn].wake_fd[0];
-  g_venc_mtx.unlock();
+  rcv_fd = g_venc_chns[VeChn].wake_fd;
+  g_venc_chns[VeChn].chn_mtx.unlock();
 
   return rcv_fd;
 }
 
 RK_S32 RK_MPI_VENC_QueryStatus(VENC_CHN VeChn, VENC_CHN_STATUS_S *pstStatus) {
-  if ((VeChn < 0) || (VeChn > VENC_MAX_CHN_NUM))
+  if ((VeChn < 0) || (VeChn >= VENC_MAX_CHN_NUM))
     return -RK_ERR_VENC_INVALID_CHNID;
 
   if (!pstStatus)
     return -RK_ERR_VENC_ILLEGAL_PARAM;
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   if ((g_venc_chns[VeChn].status < CHN_STATUS_OPEN) ||
       (!g_venc_chns[VeChn].rkmedia_flow)) {
-    g_venc_mtx.unlock();
+    g_venc_chns[VeChn].chn_mtx.unlock();
     return -RK_ERR_VENC_NOTREADY;
   }
 
@@ -3256,14 +3498,12 @@ RK_S32 RK_MPI_VENC_QueryStatus(VENC_CHN VeChn, VENC_CHN_STATUS_S *pstStatus) {
   RK_U32 u32BufferUsedCnt = 0;
   g_venc_chns[VeChn].rkmedia_flow->GetCachedBufferNum(u32BufferTotalCnt,
                                                       u32BufferUsedCnt);
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   pstStatus->u32LeftFrames = u32BufferUsedCnt;
   pstStatus->u32TotalFrames = u32BufferTotalCnt;
 
-  g_venc_chns[VeChn].buffer_list_mtx.lock();
-  pstStatus->u32TotalPackets = RKMEDIA_CHNNAL_BUFFER_LIMIT;
-  pstStatus->u32LeftPackets = g_venc_chns[VeChn].buffer_list.size();
-  g_venc_chns[VeChn].buffer_list_mtx.unlock();
+  pstStatus->u32TotalPackets = g_venc_chns[VeChn].buffer_list.Capacity();
+  pstStatus->u32LeftPackets = g_venc_chns[VeChn].buffer_list.Size();
 
   return RK_ERR_SYS_OK;
 }
@@ -3299,14 +3539,14 @@ RK_S32 RK_MPI_VENC_SetGopMode(VENC_CHN VeChn, VENC_GOP_ATTR_S *pstGopModeAttr) {
     return -RK_ERR_VENC_ILLEGAL_PARAM;
   }
 
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   int ret = easymedia::video_encoder_set_gop_mode(
       g_venc_chns[VeChn].rkmedia_flow, &rkmedia_param);
   if (!ret) {
     memcpy(&g_venc_chns[VeChn].venc_attr.attr.stGopAttr, pstGopModeAttr,
            sizeof(VENC_GOP_ATTR_S));
   }
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return ret;
 }
 
@@ -3321,6 +3561,7 @@ RK_S32 RK_MPI_VENC_RGN_Init(VENC_CHN VeChn, VENC_COLOR_TBL_S *stColorTbl) {
 
   int ret = 0;
   const RK_U32 *pu32ArgbColorTbl = NULL;
+  RK_BOOL bDichotomy = RK_TRUE;
   RK_U32 u32AVUYColorTbl[VENC_RGN_COLOR_NUM] = {0};
   if (stColorTbl) {
     if (stColorTbl->bColorDichotomyEnable) {
@@ -3328,37 +3569,39 @@ RK_S32 RK_MPI_VENC_RGN_Init(VENC_CHN VeChn, VENC_COLOR_TBL_S *stColorTbl) {
                    LOG_TAG, __func__, VeChn);
       std::sort(stColorTbl->u32ArgbTbl,
                 stColorTbl->u32ArgbTbl + VENC_RGN_COLOR_NUM);
-      g_venc_chns[VeChn].bColorDichotomyEnable = RK_TRUE;
+      bDichotomy = RK_TRUE;
     } else {
       RKMEDIA_LOGI("%s %s: %d User define color tbl(Dichotomy:False)...\n",
                    LOG_TAG, __func__, VeChn);
-      g_venc_chns[VeChn].bColorDichotomyEnable = RK_FALSE;
+      bDichotomy = RK_FALSE;
     }
     pu32ArgbColorTbl = stColorTbl->u32ArgbTbl;
   } else {
     RKMEDIA_LOGI("%s %s: %d Default color tbl(Dichotomy:True)...\n", LOG_TAG,
                  __func__, VeChn);
-    g_venc_chns[VeChn].bColorDichotomyEnable = RK_TRUE;
+    bDichotomy = RK_TRUE;
     pu32ArgbColorTbl = u32DftARGB8888ColorTbl;
   }
 
   color_tbl_argb_to_avuy(pu32ArgbColorTbl, u32AVUYColorTbl);
-  g_venc_mtx.lock();
+  g_venc_chns[VeChn].chn_mtx.lock();
   ret = easymedia::video_encoder_set_osd_plt(g_venc_chns[VeChn].rkmedia_flow,
                                              u32AVUYColorTbl);
   if (ret) {
-    g_venc_mtx.unlock();
+    g_venc_chns[VeChn].chn_mtx.unlock();
     return -RK_ERR_VENC_ILLEGAL_PARAM;
   }
 
   memcpy(g_venc_chns[VeChn].u32ArgbColorTbl, pu32ArgbColorTbl,
          VENC_RGN_COLOR_NUM * 4);
+  g_venc_chns[VeChn].bColorDichotomyEnable = bDichotomy;
   g_venc_chns[VeChn].bColorTblInit = RK_TRUE;
-  g_venc_mtx.unlock();
+  g_venc_chns[VeChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
-static RK_VOID Argb8888_To_Region_Data(VENC_CHN VeChn,
+static RK_VOID Argb8888_To_Region_Data(const RK_U32 *pu32ArgbColorTbl,
+                                       RK_BOOL bDichotomy,
                                        const BITMAP_S *pstBitmap, RK_U8 *data,
                                        RK_U32 canvasWidth,
                                        RK_U32 canvasHeight) {
@@ -3380,7 +3623,7 @@ static RK_VOID Argb8888_To_Region_Data(VENC_CHN VeChn,
   if ((canvasWidth > pstBitmap->u32Width) ||
       (canvasHeight > pstBitmap->u32Height)) {
     RK_U8 TransColorId = find_argb_color_tbl_by_order(
-        g_venc_chns[VeChn].u32ArgbColorTbl, PALETTE_TABLE_LEN, 0x00000000);
+        pu32ArgbColorTbl, PALETTE_TABLE_LEN, 0x00000000);
     memset(data, TransColorId, canvasWidth * canvasHeight);
   }
 
@@ -3390,12 +3633,12 @@ static RK_VOID Argb8888_To_Region_Data(VENC_CHN VeChn,
     for (RK_U32 j = 0; j < TargetWidth; j++) {
       ColorValue = *(BitmapLineStart + j);
 
-      if (g_venc_chns[VeChn].bColorDichotomyEnable) {
+      if (bDichotomy) {
         *(CanvasLineStart + j) = find_argb_color_tbl_by_dichotomy(
-            g_venc_chns[VeChn].u32ArgbColorTbl, PALETTE_TABLE_LEN, ColorValue);
+            pu32ArgbColorTbl, PALETTE_TABLE_LEN, ColorValue);
       } else {
         *(CanvasLineStart + j) = find_argb_color_tbl_by_order(
-            g_venc_chns[VeChn].u32ArgbColorTbl, PALETTE_TABLE_LEN, ColorValue);
+            pu32ArgbColorTbl, PALETTE_TABLE_LEN, ColorValue);
       }
     }
   }
@@ -3420,8 +3663,10 @@ RK_S32 RK_MPI_VENC_RGN_SetBitMap(VENC_CHN VeChn,
     memset(&rkmedia_osd_rgn, 0, sizeof(rkmedia_osd_rgn));
     rkmedia_osd_rgn.region_id = pstRgnInfo->enRegionId;
     rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+    g_venc_chns[VeChn].chn_mtx.lock();
     ret = easymedia::video_encoder_set_osd_region(
         g_venc_chns[VeChn].rkmedia_flow, &rkmedia_osd_rgn);
+    g_venc_chns[VeChn].chn_mtx.unlock();
     if (ret)
       ret = -RK_ERR_VENC_NOT_PERM;
     return ret;
@@ -3449,10 +3694,21 @@ RK_S32 RK_MPI_VENC_RGN_SetBitMap(VENC_CHN VeChn,
     return -RK_ERR_VENC_NOMEM;
   }
 
+  // the bitmap is converted out of the channel lock, with a copy of the
+  // color table
+  RK_U32 u32ArgbColorTbl[VENC_RGN_COLOR_NUM];
+  RK_BOOL bDichotomy;
+  g_venc_chns[VeChn].chn_mtx.lock();
+  memcpy(u32ArgbColorTbl, g_venc_chns[VeChn].u32ArgbColorTbl,
+         sizeof(u32ArgbColorTbl));
+  bDichotomy = g_venc_chns[VeChn].bColorDichotomyEnable;
+  g_venc_chns[VeChn].chn_mtx.unlock();
+
   switch (pstBitmap->enPixelFormat) {
   case PIXEL_FORMAT_ARGB_8888:
-    Argb8888_To_Region_Data(VeChn, pstBitmap, rkmedia_osd_data,
-                            pstRgnInfo->u32Width, pstRgnInfo->u32Height);
+    Argb8888_To_Region_Data(u32ArgbColorTbl, bDichotomy, pstBitmap,
+                            rkmedia_osd_data, pstRgnInfo->u32Width,
+                            pstRgnInfo->u32Height);
     break;
   default:
     RKMEDIA_LOGE("Not support bitmap pixel format:%d\n",
@@ -3470,8 +3726,10 @@ RK_S32 RK_MPI_VENC_RGN_SetBitMap(VENC_CHN VeChn,
   rkmedia_osd_rgn.height = pstRgnInfo->u32Height;
   rkmedia_osd_rgn.inverse = pstRgnInfo->u8Inverse;
   rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+  g_venc_chns[VeChn].chn_mtx.lock();
   ret = easymedia::video_encoder_set_osd_region(g_venc_chns[VeChn].rkmedia_flow,
                                                 &rkmedia_osd_rgn);
+  g_venc_chns[VeChn].chn_mtx.unlock();
   if (ret)
     ret = -RK_ERR_VENC_NOT_PERM;
 
@@ -3501,8 +3759,10 @@ RK_S32 RK_MPI_VENC_RGN_SetCover(VENC_CHN VeChn,
     memset(&rkmedia_osd_rgn, 0, sizeof(rkmedia_osd_rgn));
     rkmedia_osd_rgn.region_id = pstRgnInfo->enRegionId;
     rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+    g_venc_chns[VeChn].chn_mtx.lock();
     ret = easymedia::video_encoder_set_osd_region(
         g_venc_chns[VeChn].rkmedia_flow, &rkmedia_osd_rgn);
+    g_venc_chns[VeChn].chn_mtx.unlock();
     if (ret)
       ret = -RK_ERR_VENC_NOT_PERM;
     return ret;
@@ -3536,9 +3796,11 @@ RK_S32 RK_MPI_VENC_RGN_SetCover(VENC_CHN VeChn,
   }
 
   // find and fill color
+  g_venc_chns[VeChn].chn_mtx.lock();
   color_id =
       find_argb_color_tbl_by_order(g_venc_chns[VeChn].u32ArgbColorTbl,
                                    PALETTE_TABLE_LEN, pstCoverInfo->u32Color);
+  g_venc_chns[VeChn].chn_mtx.unlock();
   memset(rkmedia_cover_data, color_id, total_pix_num);
 
   OsdRegionData rkmedia_osd_rgn;
@@ -3550,8 +3812,10 @@ RK_S32 RK_MPI_VENC_RGN_SetCover(VENC_CHN VeChn,
   rkmedia_osd_rgn.height = pstRgnInfo->u32Height;
   rkmedia_osd_rgn.inverse = pstRgnInfo->u8Inverse;
   rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+  g_venc_chns[VeChn].chn_mtx.lock();
   ret = easymedia::video_encoder_set_osd_region(g_venc_chns[VeChn].rkmedia_flow,
                                                 &rkmedia_osd_rgn);
+  g_venc_chns[VeChn].chn_mtx.unlock();
   if (ret)
     ret = -RK_ERR_VENC_NOT_PERM;
 
@@ -3579,8 +3843,10 @@ RK_MPI_VENC_RGN_SetPaletteId(VENC_CHN VeChn,
     memset(&rkmedia_osd_rgn, 0, sizeof(rkmedia_osd_rgn));
     rkmedia_osd_rgn.region_id = pstRgnInfo->enRegionId;
     rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+    g_venc_chns[VeChn].chn_mtx.lock();
     ret = easymedia::video_encoder_set_osd_region(
         g_venc_chns[VeChn].rkmedia_flow, &rkmedia_osd_rgn);
+    g_venc_chns[VeChn].chn_mtx.unlock();
     if (ret)
       ret = -RK_ERR_VENC_NOT_PERM;
     return ret;
@@ -3617,8 +3883,10 @@ RK_MPI_VENC_RGN_SetPaletteId(VENC_CHN VeChn,
   rkmedia_osd_rgn.height = pstRgnInfo->u32Height;
   rkmedia_osd_rgn.inverse = pstRgnInfo->u8Inverse;
   rkmedia_osd_rgn.enable = pstRgnInfo->u8Enable;
+  g_venc_chns[VeChn].chn_mtx.lock();
   ret = easymedia::video_encoder_set_osd_region(g_venc_chns[VeChn].rkmedia_flow,
                                                 &rkmedia_osd_rgn);
+  g_venc_chns[VeChn].chn_mtx.unlock();
   if (ret)
     ret = -RK_ERR_VENC_NOT_PERM;
 
@@ -3762,10 +4030,12 @@ RK_S32 RK_MPI_AI_SetChnAttr(AI_CHN AiChn, const AI_CHN_ATTR_S *pstAttr) {
     return -RK_ERR_AI_INVALID_CHNID;
 
   g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (!pstAttr || !pstAttr->pcAudioNode)
     return -RK_ERR_SYS_NOT_PERM;
 
   if (g_ai_chns[AiChn].status != CHN_STATUS_CLOSED) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -3773,6 +4043,7 @@ RK_S32 RK_MPI_AI_SetChnAttr(AI_CHN AiChn, const AI_CHN_ATTR_S *pstAttr) {
   memcpy(&g_ai_chns[AiChn].ai_attr.attr, pstAttr, sizeof(AI_CHN_ATTR_S));
   g_ai_chns[AiChn].status = CHN_STATUS_READY;
 
+  g_ai_chns[AiChn].chn_mtx.unlock();
   g_ai_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
@@ -3780,8 +4051,13 @@ RK_S32 RK_MPI_AI_SetChnAttr(AI_CHN AiChn, const AI_CHN_ATTR_S *pstAttr) {
 RK_S32 RK_MPI_AI_EnableChn(AI_CHN AiChn) {
   if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
+
+  easymedia::AutoMemOwner _amo(RK_ID_AI, AiChn);
+
   g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status != CHN_STATUS_READY) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return (g_ai_chns[AiChn].status > CHN_STATUS_READY) ? -RK_ERR_AI_EXIST
                                                         : -RK_ERR_AI_NOT_CONFIG;
@@ -3795,6 +4071,7 @@ RK_S32 RK_MPI_AI_EnableChn(AI_CHN AiChn) {
       create_alsa_flow(g_ai_chns[AiChn].ai_attr.attr.pcAudioNode, info, RK_TRUE,
                        g_ai_chns[AiChn].ai_attr.attr.enAiLayout);
   if (!g_ai_chns[AiChn].rkmedia_flow) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -3803,16 +4080,19 @@ RK_S32 RK_MPI_AI_EnableChn(AI_CHN AiChn) {
                                                    FlowOutputCallback);
   g_ai_chns[AiChn].status = CHN_STATUS_OPEN;
 
+  g_ai_chns[AiChn].chn_mtx.unlock();
   g_ai_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_DisableChn(AI_CHN AiChn) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
 
   g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status == CHN_STATUS_BIND) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -3820,93 +4100,98 @@ RK_S32 RK_MPI_AI_DisableChn(AI_CHN AiChn) {
   g_ai_chns[AiChn].rkmedia_flow.reset();
   RkmediaChnClearBuffer(&g_ai_chns[AiChn]);
   g_ai_chns[AiChn].status = CHN_STATUS_CLOSED;
+  g_ai_chns[AiChn].chn_mtx.unlock();
   g_ai_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_SetVolume(AI_CHN AiChn, RK_S32 s32Volume) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::S_ALSA_VOLUME, &s32Volume);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_GetVolume(AI_CHN AiChn, RK_S32 *ps32Volume) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::G_ALSA_VOLUME, ps32Volume);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_StartStream(AI_CHN AiChn) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return -RK_ERR_AI_INVALID_CHNID;
 
   g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status < CHN_STATUS_OPEN) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
 
   if (!g_ai_chns[AiChn].rkmedia_flow) {
+    g_ai_chns[AiChn].chn_mtx.unlock();
     g_ai_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
 
   g_ai_chns[AiChn].rkmedia_flow->StartStream();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   g_ai_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_EnableVqe(AI_CHN AiChn) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   RK_BOOL bEnable = RK_TRUE;
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::S_VQE_ENABLE, &bEnable);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_DisableVqe(AI_CHN AiChn) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   RK_BOOL bEnable = RK_FALSE;
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::S_VQE_ENABLE, &bEnable);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_SetTalkVqeAttr(AI_CHN AiChn,
                                 AI_TALKVQE_CONFIG_S *pstVqeConfig) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   VQE_CONFIG_S config;
@@ -3917,17 +4202,17 @@ RK_S32 RK_MPI_AI_SetTalkVqeAttr(AI_CHN AiChn,
   strncpy(config.stAiTalkConfig.aParamFilePath, pstVqeConfig->aParamFilePath,
           MAX_FILE_PATH_LEN - 1);
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::S_VQE_ATTR, &config);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_GetTalkVqeAttr(AI_CHN AiChn,
                                 AI_TALKVQE_CONFIG_S *pstVqeConfig) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   VQE_CONFIG_S config;
@@ -3937,17 +4222,17 @@ RK_S32 RK_MPI_AI_GetTalkVqeAttr(AI_CHN AiChn,
   pstVqeConfig->s32WorkSampleRate = config.stAiTalkConfig.s32WorkSampleRate;
   strncpy(pstVqeConfig->aParamFilePath, config.stAiTalkConfig.aParamFilePath,
           MAX_FILE_PATH_LEN - 1);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_SetRecordVqeAttr(AI_CHN AiChn,
                                   AI_RECORDVQE_CONFIG_S *pstVqeConfig) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   VQE_CONFIG_S config;
@@ -3961,17 +4246,17 @@ RK_S32 RK_MPI_AI_SetRecordVqeAttr(AI_CHN AiChn,
   config.stAiRecordConfig.stAnrConfig.fNoiseFactor =
       pstVqeConfig->stAnrConfig.fNoiseFactor;
   g_ai_chns[AiChn].rkmedia_flow->Control(easymedia::S_VQE_ATTR, &config);
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AI_GetRecordVqeAttr(AI_CHN AiChn,
                                   AI_RECORDVQE_CONFIG_S *pstVqeConfig) {
-  if ((AiChn < 0) || (AiChn > AI_MAX_CHN_NUM))
+  if ((AiChn < 0) || (AiChn >= AI_MAX_CHN_NUM))
     return RK_ERR_AI_INVALID_CHNID;
-  g_ai_mtx.lock();
+  g_ai_chns[AiChn].chn_mtx.lock();
   if (g_ai_chns[AiChn].status <= CHN_STATUS_READY) {
-    g_ai_mtx.unlock();
+    g_ai_chns[AiChn].chn_mtx.unlock();
     return -RK_ERR_AI_NOTOPEN;
   }
   VQE_CONFIG_S config;
@@ -3984,7 +4269,7 @@ RK_S32 RK_MPI_AI_GetRecordVqeAttr(AI_CHN AiChn,
   pstVqeConfig->stAnrConfig.fGmin = config.stAiRecordConfig.stAnrConfig.fGmin;
   pstVqeConfig->stAnrConfig.fNoiseFactor =
       config.stAiRecordConfig.stAnrConfig.fNoiseFactor;
-  g_ai_mtx.unlock();
+  g_ai_chns[AiChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 /********************************************************************
@@ -3995,10 +4280,12 @@ RK_S32 RK_MPI_AO_SetChnAttr(AO_CHN AoChn, const AO_CHN_ATTR_S *pstAttr) {
     return -RK_ERR_AO_INVALID_CHNID;
 
   g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (!pstAttr || !pstAttr->pcAudioNode)
     return -RK_ERR_SYS_NOT_PERM;
 
   if (g_ao_chns[AoChn].status != CHN_STATUS_CLOSED) {
+    g_ao_chns[AoChn].chn_mtx.unlock();
     g_ao_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -4006,6 +4293,7 @@ RK_S32 RK_MPI_AO_SetChnAttr(AO_CHN AoChn, const AO_CHN_ATTR_S *pstAttr) {
   memcpy(&g_ao_chns[AoChn].ao_attr.attr, pstAttr, sizeof(AO_CHN_ATTR_S));
   g_ao_chns[AoChn].status = CHN_STATUS_READY;
 
+  g_ao_chns[AoChn].chn_mtx.unlock();
   g_ao_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
@@ -4013,8 +4301,13 @@ RK_S32 RK_MPI_AO_SetChnAttr(AO_CHN AoChn, const AO_CHN_ATTR_S *pstAttr) {
 RK_S32 RK_MPI_AO_EnableChn(AO_CHN AoChn) {
   if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return -RK_ERR_AO_INVALID_CHNID;
+
+  easymedia::AutoMemOwner _amo(RK_ID_AO, AoChn);
+
   g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status != CHN_STATUS_READY) {
+    g_ao_chns[AoChn].chn_mtx.unlock();
     g_ao_mtx.unlock();
     return (g_ao_chns[AoChn].status > CHN_STATUS_READY) ? -RK_ERR_VO_EXIST
                                                         : -RK_ERR_VO_NOT_CONFIG;
@@ -4028,43 +4321,48 @@ RK_S32 RK_MPI_AO_EnableChn(AO_CHN AoChn) {
       create_alsa_flow(g_ao_chns[AoChn].ao_attr.attr.pcAudioNode, info,
                        RK_FALSE, AI_LAYOUT_NORMAL);
   if (!g_ao_chns[AoChn].rkmedia_flow) {
+    g_ao_chns[AoChn].chn_mtx.unlock();
     g_ao_mtx.unlock();
     return -RK_ERR_AO_BUSY;
   }
   g_ao_chns[AoChn].status = CHN_STATUS_OPEN;
   RkmediaChnInitBuffer(&g_ao_chns[AoChn]);
+  g_ao_chns[AoChn].chn_mtx.unlock();
   g_ao_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_DisableChn(AO_CHN AoChn) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return -RK_ERR_AO_INVALID_CHNID;
 
   g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status == CHN_STATUS_BIND) {
+    g_ao_chns[AoChn].chn_mtx.unlock();
     g_ao_mtx.unlock();
     return -RK_ERR_AO_BUSY;
   }
   g_ao_chns[AoChn].rkmedia_flow.reset();
   RkmediaChnClearBuffer(&g_ao_chns[AoChn]);
   g_ao_chns[AoChn].status = CHN_STATUS_CLOSED;
+  g_ao_chns[AoChn].chn_mtx.unlock();
   g_ao_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_QueryChnStat(AO_CHN AoChn, AO_CHN_STATE_S *pstStatus) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return -RK_ERR_AO_INVALID_CHNID;
 
   if (!pstStatus)
     return -RK_ERR_AO_ILLEGAL_PARAM;
 
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if ((g_ao_chns[AoChn].status < CHN_STATUS_OPEN) ||
       (!g_ao_chns[AoChn].rkmedia_flow)) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_BUSY;
   }
 
@@ -4073,7 +4371,7 @@ RK_S32 RK_MPI_AO_QueryChnStat(AO_CHN AoChn, AO_CHN_STATE_S *pstStatus) {
   RK_U32 u32BufferFreeCnt = 0;
   g_ao_chns[AoChn].rkmedia_flow->GetCachedBufferNum(u32BufferTotalCnt,
                                                     u32BufferUsedCnt);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
 
   u32BufferFreeCnt = u32BufferTotalCnt - u32BufferUsedCnt;
   pstStatus->u32ChnTotalNum = u32BufferTotalCnt;
@@ -4084,82 +4382,82 @@ RK_S32 RK_MPI_AO_QueryChnStat(AO_CHN AoChn, AO_CHN_STATE_S *pstStatus) {
 }
 
 RK_S32 RK_MPI_AO_ClearChnBuf(AO_CHN AoChn) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return -RK_ERR_AO_INVALID_CHNID;
 
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if ((g_ao_chns[AoChn].status < CHN_STATUS_OPEN) ||
       (!g_ao_chns[AoChn].rkmedia_flow)) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_BUSY;
   }
 
   g_ao_chns[AoChn].rkmedia_flow->ClearCachedBuffers();
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_SetVolume(AO_CHN AoChn, RK_S32 s32Volume) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
   g_ao_chns[AoChn].rkmedia_flow->Control(easymedia::S_ALSA_VOLUME, &s32Volume);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_GetVolume(AO_CHN AoChn, RK_S32 *ps32Volume) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
   g_ao_chns[AoChn].rkmedia_flow->Control(easymedia::G_ALSA_VOLUME, ps32Volume);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_EnableVqe(AO_CHN AoChn) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
   RK_BOOL bEnable = RK_TRUE;
   g_ao_chns[AoChn].rkmedia_flow->Control(easymedia::S_VQE_ENABLE, &bEnable);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_DisableVqe(AO_CHN AoChn) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
   RK_BOOL bEnable = RK_FALSE;
   g_ao_chns[AoChn].rkmedia_flow->Control(easymedia::S_VQE_ENABLE, &bEnable);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_SetVqeAttr(AO_CHN AoChn, AO_VQE_CONFIG_S *pstVqeConfig) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
   VQE_CONFIG_S config;
@@ -4170,16 +4468,16 @@ RK_S32 RK_MPI_AO_SetVqeAttr(AO_CHN AoChn, AO_VQE_CONFIG_S *pstVqeConfig) {
   strncpy(config.stAoConfig.aParamFilePath, pstVqeConfig->aParamFilePath,
           MAX_FILE_PATH_LEN - 1);
   g_ao_chns[AoChn].rkmedia_flow->Control(easymedia::S_VQE_ATTR, &config);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AO_GetVqeAttr(AO_CHN AoChn, AO_VQE_CONFIG_S *pstVqeConfig) {
-  if ((AoChn < 0) || (AoChn > AO_MAX_CHN_NUM))
+  if ((AoChn < 0) || (AoChn >= AO_MAX_CHN_NUM))
     return RK_ERR_AO_INVALID_CHNID;
-  g_ao_mtx.lock();
+  g_ao_chns[AoChn].chn_mtx.lock();
   if (g_ao_chns[AoChn].status <= CHN_STATUS_READY) {
-    g_ao_mtx.unlock();
+    g_ao_chns[AoChn].chn_mtx.unlock();
     return -RK_ERR_AO_NOTOPEN;
   }
 
@@ -4190,7 +4488,7 @@ RK_S32 RK_MPI_AO_GetVqeAttr(AO_CHN AoChn, AO_VQE_CONFIG_S *pstVqeConfig) {
   pstVqeConfig->s32WorkSampleRate = config.stAoConfig.s32WorkSampleRate;
   strncpy(pstVqeConfig->aParamFilePath, config.stAoConfig.aParamFilePath,
           MAX_FILE_PATH_LEN - 1);
-  g_ao_mtx.unlock();
+  g_ao_chns[AoChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -4201,11 +4499,15 @@ RK_S32 RK_MPI_AENC_CreateChn(AENC_CHN AencChn, const AENC_CHN_ATTR_S *pstAttr) {
   if ((AencChn < 0) || (AencChn >= AENC_MAX_CHN_NUM))
     return -RK_ERR_AENC_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_AENC, AencChn);
+
   if (!pstAttr)
     return -RK_ERR_SYS_NOT_PERM;
   g_aenc_mtx.lock();
+  g_aenc_chns[AencChn].chn_mtx.lock();
 
   if (g_aenc_chns[AencChn].status != CHN_STATUS_CLOSED) {
+    g_aenc_chns[AencChn].chn_mtx.unlock();
     g_aenc_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -4254,6 +4556,7 @@ RK_S32 RK_MPI_AENC_CreateChn(AENC_CHN AencChn, const AENC_CHN_ATTR_S *pstAttr) {
     sample_rate = g_aenc_chns[AencChn].aenc_attr.attr.stAencG726.u32SampleRate;
     break;
   default:
+    g_aenc_chns[AencChn].chn_mtx.unlock();
     g_aenc_mtx.unlock();
     return -RK_ERR_AENC_CODEC_NOT_SUPPORT;
   }
@@ -4276,30 +4579,29 @@ RK_S32 RK_MPI_AENC_CreateChn(AENC_CHN AencChn, const AENC_CHN_ATTR_S *pstAttr) {
   g_aenc_chns[AencChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), param.c_str());
   if (!g_aenc_chns[AencChn].rkmedia_flow) {
+    g_aenc_chns[AencChn].chn_mtx.unlock();
     g_aenc_mtx.unlock();
     return -RK_ERR_AENC_BUSY;
   }
   RkmediaChnInitBuffer(&g_aenc_chns[AencChn]);
+  RkmediaChnOpenWakeFd(&g_aenc_chns[AencChn]);
   g_aenc_chns[AencChn].rkmedia_flow->SetOutputCallBack(&g_aenc_chns[AencChn],
                                                        FlowOutputCallback);
 
-  if (pipe2(g_aenc_chns[AencChn].wake_fd, O_CLOEXEC) == -1) {
-    g_aenc_chns[AencChn].wake_fd[0] = 0;
-    g_aenc_chns[AencChn].wake_fd[1] = 0;
-    RKMEDIA_LOGW("Create pipe failed!\n");
-  }
-
   g_aenc_chns[AencChn].status = CHN_STATUS_OPEN;
+  g_aenc_chns[AencChn].chn_mtx.unlock();
   g_aenc_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_AENC_DestroyChn(AENC_CHN AencChn) {
-  if ((AencChn < 0) || (AencChn > AENC_MAX_CHN_NUM))
+  if ((AencChn < 0) || (AencChn >= AENC_MAX_CHN_NUM))
     return RK_ERR_AENC_INVALID_CHNID;
 
   g_aenc_mtx.lock();
+  g_aenc_chns[AencChn].chn_mtx.lock();
   if (g_aenc_chns[AencChn].status == CHN_STATUS_BIND) {
+    g_aenc_chns[AencChn].chn_mtx.unlock();
     g_aenc_mtx.unlock();
     return -RK_ERR_AENC_BUSY;
   }
@@ -4307,14 +4609,8 @@ RK_S32 RK_MPI_AENC_DestroyChn(AENC_CHN AencChn) {
   g_aenc_chns[AencChn].rkmedia_flow.reset();
   RkmediaChnClearBuffer(&g_aenc_chns[AencChn]);
   g_aenc_chns[AencChn].status = CHN_STATUS_CLOSED;
-  if (g_aenc_chns[AencChn].wake_fd[0] > 0) {
-    close(g_aenc_chns[AencChn].wake_fd[0]);
-    g_aenc_chns[AencChn].wake_fd[0] = 0;
-  }
-  if (g_aenc_chns[AencChn].wake_fd[1] > 0) {
-    close(g_aenc_chns[AencChn].wake_fd[1]);
-    g_aenc_chns[AencChn].wake_fd[1] = 0;
-  }
+  RkmediaChnCloseWakeFd(&g_aenc_chns[AencChn]);
+  g_aenc_chns[AencChn].chn_mtx.unlock();
   g_aenc_mtx.unlock();
 
   return RK_ERR_SYS_OK;
@@ -4325,13 +4621,13 @@ RK_S32 RK_MPI_AENC_GetFd(AENC_CHN AencChn) {
     return -RK_ERR_AENC_INVALID_CHNID;
 
   int rcv_fd = 0;
-  g_aenc_mtx.lock();
+  g_aenc_chns[AencChn].chn_mtx.lock();
   if (g_aenc_chns[AencChn].status < CHN_STATUS_OPEN) {
-    g_aenc_mtx.unlock();
+    g_aenc_chns[AencChn].chn_mtx.unlock();
     return -RK_ERR_AENC_NOTREADY;
   }
-  rcv_fd = g_aenc_chns[AencChn].wake_fd[0];
-  g_aenc_mtx.unlock();
+  rcv_fd = g_aenc_chns[AencChn].wake_fd;
+  g_aenc_chns[AencChn].chn_mtx.unlock();
 
   return rcv_fd;
 }
@@ -4341,9 +4637,11 @@ RK_S32 RK_MPI_AENC_GetFd(AENC_CHN AencChn) {
  ********************************************************************/
 RK_S32 RK_MPI_ALGO_MD_CreateChn(ALGO_MD_CHN MdChn,
                                 const ALGO_MD_ATTR_S *pstMDAttr) {
-  if ((MdChn < 0) || (MdChn > ALGO_MD_MAX_CHN_NUM))
+  if ((MdChn < 0) || (MdChn >= ALGO_MD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_MD_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_ALGO_MD, MdChn);
+
   if (!pstMDAttr)
     return -RK_ERR_ALGO_MD_ILLEGAL_PARAM;
 
@@ -4354,7 +4652,9 @@ RK_S32 RK_MPI_ALGO_MD_CreateChn(ALGO_MD_CHN MdChn,
   }
 
   g_algo_md_mtx.lock();
+  g_algo_md_chns[MdChn].chn_mtx.lock();
   if (g_algo_md_chns[MdChn].status != CHN_STATUS_CLOSED) {
+    g_algo_md_chns[MdChn].chn_mtx.unlock();
     g_algo_md_mtx.unlock();
     return -RK_ERR_ALGO_MD_EXIST;
   }
@@ -4367,6 +4667,7 @@ RK_S32 RK_MPI_ALGO_MD_CreateChn(ALGO_MD_CHN MdChn,
   PARAM_STRING_APPEND(flow_param, KEY_INPUTDATATYPE,
                       ImageTypeToString(pstMDAttr->imageType));
   PARAM_STRING_APPEND(flow_param, KEY_OUTPUTDATATYPE, "NULL");
+  ThreadAttrToFlowParam(&pstMDAttr->stThreadAttr, flow_param);
   std::string md_param = "";
   PARAM_STRING_APPEND_TO(md_param, KEY_MD_SINGLE_REF, 1);
   PARAM_STRING_APPEND_TO(md_param, KEY_MD_SENSITIVITY,
@@ -4394,11 +4695,13 @@ RK_S32 RK_MPI_ALGO_MD_CreateChn(ALGO_MD_CHN MdChn,
   g_algo_md_chns[MdChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), flow_param.c_str());
   if (!g_algo_md_chns[MdChn].rkmedia_flow) {
+    g_algo_md_chns[MdChn].chn_mtx.unlock();
     g_algo_md_mtx.unlock();
     return -RK_ERR_ALGO_MD_BUSY;
   }
   g_algo_md_chns[MdChn].status = CHN_STATUS_OPEN;
 
+  g_algo_md_chns[MdChn].chn_mtx.unlock();
   g_algo_md_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Enable MD[%d] END...\n", LOG_TAG, __func__, MdChn);
 
@@ -4406,11 +4709,13 @@ RK_S32 RK_MPI_ALGO_MD_CreateChn(ALGO_MD_CHN MdChn,
 }
 
 RK_S32 RK_MPI_ALGO_MD_DestroyChn(ALGO_MD_CHN MdChn) {
-  if ((MdChn < 0) || (MdChn > ALGO_MD_MAX_CHN_NUM))
+  if ((MdChn < 0) || (MdChn >= ALGO_MD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_MD_INVALID_CHNID;
 
   g_algo_md_mtx.lock();
+  g_algo_md_chns[MdChn].chn_mtx.lock();
   if (g_algo_md_chns[MdChn].status == CHN_STATUS_BIND) {
+    g_algo_md_chns[MdChn].chn_mtx.unlock();
     g_algo_md_mtx.unlock();
     return -RK_ERR_ALGO_MD_BUSY;
   }
@@ -4419,6 +4724,7 @@ RK_S32 RK_MPI_ALGO_MD_DestroyChn(ALGO_MD_CHN MdChn) {
   if (g_algo_md_chns[MdChn].rkmedia_flow)
     g_algo_md_chns[MdChn].rkmedia_flow.reset();
   g_algo_md_chns[MdChn].status = CHN_STATUS_CLOSED;
+  g_algo_md_chns[MdChn].chn_mtx.unlock();
   g_algo_md_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Disable MD[%d] End...\n", LOG_TAG, __func__, MdChn);
 
@@ -4426,12 +4732,12 @@ RK_S32 RK_MPI_ALGO_MD_DestroyChn(ALGO_MD_CHN MdChn) {
 }
 
 RK_S32 RK_MPI_ALGO_MD_EnableSwitch(ALGO_MD_CHN MdChn, RK_BOOL bEnable) {
-  if ((MdChn < 0) || (MdChn > ALGO_MD_MAX_CHN_NUM))
+  if ((MdChn < 0) || (MdChn >= ALGO_MD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_MD_INVALID_CHNID;
 
-  g_algo_md_mtx.lock();
+  g_algo_md_chns[MdChn].chn_mtx.lock();
   if (g_algo_md_chns[MdChn].status < CHN_STATUS_OPEN) {
-    g_algo_md_mtx.unlock();
+    g_algo_md_chns[MdChn].chn_mtx.unlock();
     return -RK_ERR_ALGO_MD_INVALID_CHNID;
   }
   RK_S32 s32Enable = bEnable ? 1 : 0;
@@ -4440,7 +4746,7 @@ RK_S32 RK_MPI_ALGO_MD_EnableSwitch(ALGO_MD_CHN MdChn, RK_BOOL bEnable) {
   if (g_algo_md_chns[MdChn].rkmedia_flow)
     g_algo_md_chns[MdChn].rkmedia_flow->Control(easymedia::S_MD_ROI_ENABLE,
                                                 s32Enable);
-  g_algo_md_mtx.unlock();
+  g_algo_md_chns[MdChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -4449,9 +4755,11 @@ RK_S32 RK_MPI_ALGO_MD_EnableSwitch(ALGO_MD_CHN MdChn, RK_BOOL bEnable) {
  ********************************************************************/
 RK_S32 RK_MPI_ALGO_OD_CreateChn(ALGO_OD_CHN OdChn,
                                 const ALGO_OD_ATTR_S *pstChnAttr) {
-  if ((OdChn < 0) || (OdChn > ALGO_MD_MAX_CHN_NUM))
+  if ((OdChn < 0) || (OdChn >= ALGO_MD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_OD_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_ALGO_OD, OdChn);
+
   if (!pstChnAttr || pstChnAttr->u16RoiCnt > ALGO_OD_ROI_RET_MAX)
     return -RK_ERR_ALGO_OD_ILLEGAL_PARAM;
 
@@ -4477,7 +4785,9 @@ RK_S32 RK_MPI_ALGO_OD_CreateChn(ALGO_OD_CHN OdChn,
   }
 
   g_algo_od_mtx.lock();
+  g_algo_od_chns[OdChn].chn_mtx.lock();
   if (g_algo_od_chns[OdChn].status != CHN_STATUS_CLOSED) {
+    g_algo_od_chns[OdChn].chn_mtx.unlock();
     g_algo_od_mtx.unlock();
     return -RK_ERR_ALGO_OD_EXIST;
   }
@@ -4490,6 +4800,7 @@ RK_S32 RK_MPI_ALGO_OD_CreateChn(ALGO_OD_CHN OdChn,
   PARAM_STRING_APPEND(flow_param, KEY_INPUTDATATYPE,
                       ImageTypeToString(pstChnAttr->enImageType));
   PARAM_STRING_APPEND(flow_param, KEY_OUTPUTDATATYPE, "NULL");
+  ThreadAttrToFlowParam(&pstChnAttr->stThreadAttr, flow_param);
   std::string od_param = "";
   PARAM_STRING_APPEND_TO(od_param, KEY_OD_SENSITIVITY,
                          pstChnAttr->u16Sensitivity);
@@ -4515,40 +4826,45 @@ RK_S32 RK_MPI_ALGO_OD_CreateChn(ALGO_OD_CHN OdChn,
   g_algo_od_chns[OdChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), flow_param.c_str());
   if (!g_algo_od_chns[OdChn].rkmedia_flow) {
+    g_algo_od_chns[OdChn].chn_mtx.unlock();
     g_algo_od_mtx.unlock();
     return -RK_ERR_ALGO_OD_BUSY;
   }
 
   g_algo_od_chns[OdChn].status = CHN_STATUS_OPEN;
+  g_algo_od_chns[OdChn].chn_mtx.unlock();
   g_algo_od_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_ALGO_OD_DestroyChn(ALGO_OD_CHN OdChn) {
-  if ((OdChn < 0) || (OdChn > ALGO_OD_MAX_CHN_NUM))
+  if ((OdChn < 0) || (OdChn >= ALGO_OD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_OD_INVALID_CHNID;
 
   g_algo_od_mtx.lock();
+  g_algo_od_chns[OdChn].chn_mtx.lock();
   if (g_algo_od_chns[OdChn].status == CHN_STATUS_BIND) {
+    g_algo_od_chns[OdChn].chn_mtx.unlock();
     g_algo_od_mtx.unlock();
     return -RK_ERR_ALGO_OD_BUSY;
   }
 
   g_algo_od_chns[OdChn].rkmedia_flow.reset();
   g_algo_od_chns[OdChn].status = CHN_STATUS_CLOSED;
+  g_algo_od_chns[OdChn].chn_mtx.unlock();
   g_algo_od_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_ALGO_OD_EnableSwitch(ALGO_OD_CHN OdChn, RK_BOOL bEnable) {
-  if ((OdChn < 0) || (OdChn > ALGO_OD_MAX_CHN_NUM))
+  if ((OdChn < 0) || (OdChn >= ALGO_OD_MAX_CHN_NUM))
     return -RK_ERR_ALGO_OD_INVALID_CHNID;
 
-  g_algo_od_mtx.lock();
+  g_algo_od_chns[OdChn].chn_mtx.lock();
   if (g_algo_od_chns[OdChn].status < CHN_STATUS_OPEN) {
-    g_algo_od_mtx.unlock();
+    g_algo_od_chns[OdChn].chn_mtx.unlock();
     return -RK_ERR_ALGO_OD_INVALID_CHNID;
   }
   RK_S32 s32Enable = bEnable ? 1 : 0;
@@ -4557,7 +4873,7 @@ RK_S32 RK_MPI_ALGO_OD_EnableSwitch(ALGO_OD_CHN OdChn, RK_BOOL bEnable) {
   if (g_algo_od_chns[OdChn].rkmedia_flow)
     g_algo_od_chns[OdChn].rkmedia_flow->Control(easymedia::S_OD_ROI_ENABLE,
                                                 s32Enable);
-  g_algo_od_mtx.unlock();
+  g_algo_od_chns[OdChn].chn_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
@@ -4565,9 +4881,11 @@ RK_S32 RK_MPI_ALGO_OD_EnableSwitch(ALGO_OD_CHN OdChn, RK_BOOL bEnable) {
  * Rga api
  ********************************************************************/
 RK_S32 RK_MPI_RGA_CreateChn(RGA_CHN RgaChn, RGA_ATTR_S *pstRgaAttr) {
-  if ((RgaChn < 0) || (RgaChn > RGA_MAX_CHN_NUM))
+  if ((RgaChn < 0) || (RgaChn >= RGA_MAX_CHN_NUM))
     return -RK_ERR_RGA_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_RGA, RgaChn);
+
   if (!pstRgaAttr)
     return -RK_ERR_RGA_ILLEGAL_PARAM;
 
@@ -4601,7 +4919,9 @@ RK_S32 RK_MPI_RGA_CreateChn(RGA_CHN RgaChn, RGA_ATTR_S *pstRgaAttr) {
   }
 
   g_rga_mtx.lock();
+  g_rga_chns[RgaChn].chn_mtx.lock();
   if (g_rga_chns[RgaChn].status != CHN_STATUS_CLOSED) {
+    g_rga_chns[RgaChn].chn_mtx.unlock();
     g_rga_mtx.unlock();
     return -RK_ERR_RGA_EXIST;
   }
@@ -4622,6 +4942,9 @@ RK_S32 RK_MPI_RGA_CreateChn(RGA_CHN RgaChn, RGA_ATTR_S *pstRgaAttr) {
     PARAM_STRING_APPEND(flow_param, KEY_MEM_TYPE, KEY_MEM_HARDWARE);
     PARAM_STRING_APPEND_TO(flow_param, KEY_MEM_CNT, u16BufPoolCnt);
   }
+  // a sync filter has no thread to schedule
+  if (ThreadAttrToFlowParam(&pstRgaAttr->stThreadAttr, flow_param))
+    PARAM_STRING_APPEND(flow_param, KEK_THREAD_SYNC_MODEL, KEY_ASYNCCOMMON);
 
   std::string filter_param = "";
   ImageRect src_rect = {(RK_S32)u32InX, (RK_S32)u32InY, (RK_S32)u32InWidth,
@@ -4639,12 +4962,14 @@ RK_S32 RK_MPI_RGA_CreateChn(RGA_CHN RgaChn, RGA_ATTR_S *pstRgaAttr) {
   g_rga_chns[RgaChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), flow_param.c_str());
   if (!g_rga_chns[RgaChn].rkmedia_flow) {
+    g_rga_chns[RgaChn].chn_mtx.unlock();
     g_rga_mtx.unlock();
     return -RK_ERR_RGA_BUSY;
   }
   g_rga_chns[RgaChn].rkmedia_flow->SetOutputCallBack(&g_rga_chns[RgaChn],
                                                      FlowOutputCallback);
   g_rga_chns[RgaChn].status = CHN_STATUS_OPEN;
+  g_rga_chns[RgaChn].chn_mtx.unlock();
   g_rga_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Enable RGA[%d], Rect<%d,%d,%d,%d> End...\n", LOG_TAG,
                __func__, RgaChn, pstRgaAttr->stImgIn.u32X,
@@ -4655,11 +4980,13 @@ RK_S32 RK_MPI_RGA_CreateChn(RGA_CHN RgaChn, RGA_ATTR_S *pstRgaAttr) {
 }
 
 RK_S32 RK_MPI_RGA_DestroyChn(RGA_CHN RgaChn) {
-  if ((RgaChn < 0) || (RgaChn > RGA_MAX_CHN_NUM))
+  if ((RgaChn < 0) || (RgaChn >= RGA_MAX_CHN_NUM))
     return -RK_ERR_RGA_INVALID_CHNID;
 
   g_rga_mtx.lock();
+  g_rga_chns[RgaChn].chn_mtx.lock();
   if (g_rga_chns[RgaChn].status == CHN_STATUS_BIND) {
+    g_rga_chns[RgaChn].chn_mtx.unlock();
     g_rga_mtx.unlock();
     return -RK_ERR_RGA_BUSY;
   }
@@ -4668,6 +4995,7 @@ RK_S32 RK_MPI_RGA_DestroyChn(RGA_CHN RgaChn) {
   RkmediaChnClearBuffer(&g_rga_chns[RgaChn]);
   g_rga_chns[RgaChn].rkmedia_flow.reset();
   g_rga_chns[RgaChn].status = CHN_STATUS_CLOSED;
+  g_rga_chns[RgaChn].chn_mtx.unlock();
   g_rga_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Disable RGA[%d] End...\n", LOG_TAG, __func__, RgaChn);
 
@@ -4681,11 +5009,15 @@ RK_S32 RK_MPI_ADEC_CreateChn(ADEC_CHN AdecChn, const ADEC_CHN_ATTR_S *pstAttr) {
   if ((AdecChn < 0) || (AdecChn >= ADEC_MAX_CHN_NUM))
     return -RK_ERR_ADEC_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_ADEC, AdecChn);
+
   if (!pstAttr)
     return -RK_ERR_SYS_NOT_PERM;
   g_adec_mtx.lock();
+  g_adec_chns[AdecChn].chn_mtx.lock();
 
   if (g_adec_chns[AdecChn].status != CHN_STATUS_CLOSED) {
+    g_adec_chns[AdecChn].chn_mtx.unlock();
     g_adec_mtx.unlock();
     return -RK_ERR_AI_BUSY;
   }
@@ -4713,6 +5045,7 @@ RK_S32 RK_MPI_ADEC_CreateChn(ADEC_CHN AdecChn, const ADEC_CHN_ATTR_S *pstAttr) {
   case CODEC_TYPE_G726:
     break;
   default:
+    g_adec_chns[AdecChn].chn_mtx.unlock();
     g_adec_mtx.unlock();
     return -RK_ERR_ADEC_CODEC_NOT_SUPPORT;
   }
@@ -4734,6 +5067,7 @@ RK_S32 RK_MPI_ADEC_CreateChn(ADEC_CHN AdecChn, const ADEC_CHN_ATTR_S *pstAttr) {
   g_adec_chns[AdecChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), flow_param.c_str());
   if (!g_adec_chns[AdecChn].rkmedia_flow) {
+    g_adec_chns[AdecChn].chn_mtx.unlock();
     g_adec_mtx.unlock();
     return -RK_ERR_ADEC_BUSY;
   }
@@ -4742,16 +5076,19 @@ RK_S32 RK_MPI_ADEC_CreateChn(ADEC_CHN AdecChn, const ADEC_CHN_ATTR_S *pstAttr) {
                                                        FlowOutputCallback);
   g_adec_chns[AdecChn].status = CHN_STATUS_OPEN;
 
+  g_adec_chns[AdecChn].chn_mtx.unlock();
   g_adec_mtx.unlock();
   return RK_ERR_SYS_OK;
 }
 
 RK_S32 RK_MPI_ADEC_DestroyChn(ADEC_CHN AdecChn) {
-  if ((AdecChn < 0) || (AdecChn > ADEC_MAX_CHN_NUM))
+  if ((AdecChn < 0) || (AdecChn >= ADEC_MAX_CHN_NUM))
     return RK_ERR_ADEC_INVALID_CHNID;
 
   g_adec_mtx.lock();
+  g_adec_chns[AdecChn].chn_mtx.lock();
   if (g_adec_chns[AdecChn].status == CHN_STATUS_BIND) {
+    g_adec_chns[AdecChn].chn_mtx.unlock();
     g_adec_mtx.unlock();
     return -RK_ERR_ADEC_BUSY;
   }
@@ -4759,6 +5096,7 @@ RK_S32 RK_MPI_ADEC_DestroyChn(ADEC_CHN AdecChn) {
   g_adec_chns[AdecChn].rkmedia_flow.reset();
   RkmediaChnClearBuffer(&g_adec_chns[AdecChn]);
   g_adec_chns[AdecChn].status = CHN_STATUS_CLOSED;
+  g_adec_chns[AdecChn].chn_mtx.unlock();
   g_adec_mtx.unlock();
 
   return RK_ERR_SYS_OK;
@@ -4774,6 +5112,8 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   if ((VoChn < 0) || (VoChn >= VO_MAX_CHN_NUM))
     return -RK_ERR_VO_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_VO, VoChn);
+
   if (!pstAttr)
     return -RK_ERR_VO_ILLEGAL_PARAM;
 
@@ -4795,7 +5135,9 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
     return -RK_ERR_VO_ILLEGAL_PARAM;
 
   g_vo_mtx.lock();
+  g_vo_chns[VoChn].chn_mtx.lock();
   if (g_vo_chns[VoChn].status != CHN_STATUS_CLOSED) {
+    g_vo_chns[VoChn].chn_mtx.unlock();
     g_vo_mtx.unlock();
     return -RK_ERR_VO_EXIST;
   }
@@ -4833,6 +5175,7 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   g_vo_chns[VoChn].rkmedia_flow = easymedia::REFLECTOR(
       Flow)::Create<easymedia::Flow>(flow_name.c_str(), flow_param.c_str());
   if (!g_vo_chns[VoChn].rkmedia_flow) {
+    g_vo_chns[VoChn].chn_mtx.unlock();
     g_vo_mtx.unlock();
     return -RK_ERR_VO_BUSY;
   }
@@ -4845,6 +5188,7 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
     if (g_vo_chns[VoChn].rkmedia_flow->Control(S_DESTINATION_RECT,
                                                &PlaneRect)) {
       g_vo_chns[VoChn].rkmedia_flow.reset();
+      g_vo_chns[VoChn].chn_mtx.unlock();
       g_vo_mtx.unlock();
       return -RK_ERR_VO_ILLEGAL_PARAM;
     }
@@ -4857,6 +5201,7 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
                          (int)pstAttr->stImgRect.u32Height};
     if (g_vo_chns[VoChn].rkmedia_flow->Control(S_SOURCE_RECT, &ImgRect)) {
       g_vo_chns[VoChn].rkmedia_flow.reset();
+      g_vo_chns[VoChn].chn_mtx.unlock();
       g_vo_mtx.unlock();
       return -RK_ERR_VO_ILLEGAL_PARAM;
     }
@@ -4881,6 +5226,7 @@ RK_S32 RK_MPI_VO_CreateChn(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   g_vo_chns[VoChn].vo_attr.stDispRect.u32Height = (RK_U32)ImageRectTotal[1].h;
 
   g_vo_chns[VoChn].status = CHN_STATUS_OPEN;
+  g_vo_chns[VoChn].chn_mtx.unlock();
   g_vo_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Enable VO[%d] End!\n", LOG_TAG, __func__, VoChn);
 
@@ -4894,14 +5240,14 @@ RK_S32 RK_MPI_VO_SetChnAttr(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   if (!pstAttr)
     return -RK_ERR_VO_ILLEGAL_PARAM;
 
-  g_vo_mtx.lock();
+  g_vo_chns[VoChn].chn_mtx.lock();
   if (g_vo_chns[VoChn].status < CHN_STATUS_OPEN) {
-    g_vo_mtx.unlock();
+    g_vo_chns[VoChn].chn_mtx.unlock();
     return -RK_ERR_VO_NOTREADY;
   }
 
   if (!g_vo_chns[VoChn].rkmedia_flow) {
-    g_vo_mtx.unlock();
+    g_vo_chns[VoChn].chn_mtx.unlock();
     return -RK_ERR_VO_BUSY;
   }
   ImageRect ImageRectTotal[2];
@@ -4916,7 +5262,7 @@ RK_S32 RK_MPI_VO_SetChnAttr(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   int ret =
       g_vo_chns[VoChn].rkmedia_flow->Control(S_SRC_DST_RECT, &ImageRectTotal);
   if (ret) {
-    g_vo_mtx.unlock();
+    g_vo_chns[VoChn].chn_mtx.unlock();
     return -RK_ERR_VO_ILLEGAL_PARAM;
   }
 
@@ -4928,7 +5274,7 @@ RK_S32 RK_MPI_VO_SetChnAttr(VO_CHN VoChn, const VO_CHN_ATTR_S *pstAttr) {
   g_vo_chns[VoChn].vo_attr.stDispRect.s32Y = ImageRectTotal[1].y;
   g_vo_chns[VoChn].vo_attr.stDispRect.u32Width = (RK_U32)ImageRectTotal[1].w;
   g_vo_chns[VoChn].vo_attr.stDispRect.u32Height = (RK_U32)ImageRectTotal[1].h;
-  g_vo_mtx.unlock();
+  g_vo_chns[VoChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -4940,14 +5286,14 @@ RK_S32 RK_MPI_VO_GetChnAttr(VO_CHN VoChn, VO_CHN_ATTR_S *pstAttr) {
   if (!pstAttr)
     return -RK_ERR_VO_ILLEGAL_PARAM;
 
-  g_vo_mtx.lock();
+  g_vo_chns[VoChn].chn_mtx.lock();
   if (g_vo_chns[VoChn].status < CHN_STATUS_OPEN) {
-    g_vo_mtx.unlock();
+    g_vo_chns[VoChn].chn_mtx.unlock();
     return -RK_ERR_VO_NOTREADY;
   }
 
   memcpy(pstAttr, &g_vo_chns[VoChn].vo_attr, sizeof(VO_CHN_ATTR_S));
-  g_vo_mtx.unlock();
+  g_vo_chns[VoChn].chn_mtx.unlock();
 
   return RK_ERR_SYS_OK;
 }
@@ -4957,13 +5303,16 @@ RK_S32 RK_MPI_VO_DestroyChn(VO_CHN VoChn) {
     return -RK_ERR_VO_INVALID_CHNID;
 
   g_vo_mtx.lock();
+  g_vo_chns[VoChn].chn_mtx.lock();
   if (g_vo_chns[VoChn].status == CHN_STATUS_BIND) {
+    g_vo_chns[VoChn].chn_mtx.unlock();
     g_vo_mtx.unlock();
     return -RK_ERR_VO_BUSY;
   }
 
   g_vo_chns[VoChn].rkmedia_flow.reset();
   g_vo_chns[VoChn].status = CHN_STATUS_CLOSED;
+  g_vo_chns[VoChn].chn_mtx.unlock();
   g_vo_mtx.unlock();
 
   return RK_ERR_SYS_OK;
@@ -4973,11 +5322,15 @@ RK_S32 RK_MPI_VDEC_CreateChn(VDEC_CHN VdChn, const VDEC_CHN_ATTR_S *pstAttr) {
   if ((VdChn < 0) || (VdChn >= VDEC_MAX_CHN_NUM))
     return -RK_ERR_VDEC_INVALID_CHNID;
 
+  easymedia::AutoMemOwner _amo(RK_ID_VDEC, VdChn);
+
   if (!pstAttr)
     return -RK_ERR_VDEC_ILLEGAL_PARAM;
 
   g_vdec_mtx.lock();
+  g_vdec_chns[VdChn].chn_mtx.lock();
   if (g_vdec_chns[VdChn].status != CHN_STATUS_CLOSED) {
+    g_vdec_chns[VdChn].chn_mtx.unlock();
     g_vdec_mtx.unlock();
     return -RK_ERR_VDEC_EXIST;
   }
@@ -5040,6 +5393,7 @@ RK_S32 RK_MPI_VDEC_CreateChn(VDEC_CHN VdChn, const VDEC_CHN_ATTR_S *pstAttr) {
       flow_name.c_str(), flow_param.c_str());
   if (!video_decoder_flow) {
     RKMEDIA_LOGE("[%s]: Create flow %s failed\n", __func__, flow_name.c_str());
+    g_vdec_chns[VdChn].chn_mtx.unlock();
     g_vdec_mtx.unlock();
     g_vdec_chns[VdChn].status = CHN_STATUS_CLOSED;
     return -RK_ERR_VDEC_ILLEGAL_PARAM;
@@ -5049,6 +5403,7 @@ RK_S32 RK_MPI_VDEC_CreateChn(VDEC_CHN VdChn, const VDEC_CHN_ATTR_S *pstAttr) {
   g_vdec_chns[VdChn].status = CHN_STATUS_OPEN;
   g_vdec_chns[VdChn].rkmedia_flow->SetOutputCallBack(&g_vdec_chns[VdChn],
                                                      FlowOutputCallback);
+  g_vdec_chns[VdChn].chn_mtx.unlock();
   g_vdec_mtx.unlock();
   RKMEDIA_LOGI("%s %s: Enable VDEC[%d] End!\n", LOG_TAG, __func__, VdChn);
   return RK_ERR_SYS_OK;
@@ -5059,7 +5414,9 @@ RK_S32 RK_MPI_VDEC_DestroyChn(VDEC_CHN VdChn) {
     return -RK_ERR_VDEC_INVALID_CHNID;
 
   g_vdec_mtx.lock();
+  g_vdec_chns[VdChn].chn_mtx.lock();
   if (g_vdec_chns[VdChn].status == CHN_STATUS_BIND) {
+    g_vdec_chns[VdChn].chn_mtx.unlock();
     g_vdec_mtx.unlock();
     return -RK_ERR_VDEC_BUSY;
   }
@@ -5067,6 +5424,7 @@ RK_S32 RK_MPI_VDEC_DestroyChn(VDEC_CHN VdChn) {
   g_vdec_chns[VdChn].rkmedia_flow.reset();
   RkmediaChnClearBuffer(&g_vdec_chns[VdChn]);
   g_vdec_chns[VdChn].status = CHN_STATUS_CLOSED;
+  g_vdec_chns[VdChn].chn_mtx.unlock();
   g_vdec_mtx.unlock();
 
   return RK_ERR_SYS_OK;
@@ -2,6 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
 #include "rkmedia_buffer.h"
 #include "image.h"
 #include "rkmedia_buffer_impl.h"
@@ -13,69 +21,303 @@
 #endif
 #define MOD_TAG 1
 
-void *RK_MPI_MB_GetPtr(MEDIA_BUFFER mb) {
+static RK_U32 RkmediaBufFlag(RK_U8 u8Flag) {
+  if (u8Flag == MB_FLAG_NOCACHED)
+    return 0;
+  else if (u8Flag == MB_FLAG_PHY_ADDR_CONSECUTIVE)
+    return 1;
+  return 2; // cached buffer type default
+}
+
+namespace {
+
+// A handle is the generation of the slot above its index, never 0 as the
+// generation skips 0. The slots come by chunks, allocated when the free
+// ones run out and never freed, so a lookup of any handle only reads
+// memory of the table, and the chunk table is all that is reserved for
+// the slots never used.
+// The free slots are linked in a stack whose head carries a tag bumped by
+// every change, so that a pop racing with a pop and a push of the same
+// slot fails its CAS.
+// held counts the slots reserved by acquirers or not pushed back yet by
+// releasers, so while it is not above slot_cnt a free slot is in the stack
+// or about to be, and no chunk is added for a pop racing with a push.
+const int kMbIndexBits = 18;
+const RK_U32 kMbSlotNum = 1 << kMbIndexBits;
+const RK_U32 kMbChunkSlots = 256;
+const RK_U32 kMbChunkNum = kMbSlotNum / kMbChunkSlots;
+const RK_U32 kMbGenMask = (RK_U32)(~0U) >> kMbIndexBits;
+
+struct MbSlot {
+  std::atomic<RK_U32> handle; // the live handle, 0 when free
+  RK_U32 gen;                 // last generation, owned by the acquirer
+  MOD_ID_E mod;
+  std::atomic<RK_U32> next_free; // index + 1 of the next free slot, 0 last
+  MEDIA_BUFFER_IMPLE impl;
+};
+
+class MbTable {
+public:
+  MbTable() {
+    held.store(0, std::memory_order_relaxed);
+    free_head.store(0, std::memory_order_relaxed);
+    for (RK_U32 i = 0; i < kMbChunkNum; i++)
+      chunks[i].store(NULL, std::memory_order_relaxed);
+    for (int i = 0; i < RK_ID_BUTT; i++)
+      live_cnt[i].store(0, std::memory_order_relaxed);
+  }
+  bool Grow(RK_U32 held_cnt, RK_U32 &index);
+  bool PopFree(RK_U32 &index);
+  void PushFree(RK_U32 index);
+
+  std::atomic<MbSlot *> chunks[kMbChunkNum];
+  RK_U32 slot_cnt = 0; // by grow_mtx
+  std::mutex grow_mtx;
+  std::atomic<RK_U32> held;
+  // tag << 32 | index + 1 of the top free slot, 0 if none
+  std::atomic<uint64_t> free_head;
+  std::atomic<int> live_cnt[RK_ID_BUTT];
+};
+
+} // namespace
+
+// Never destroyed, buffers may still be released by other static objects
+// after exit.
+static MbTable &GetMbTable() {
+  static MbTable *table = new MbTable();
+  return *table;
+}
+
+static MbSlot *MbSlotOf(MbTable &table, RK_U32 index) {
+  MbSlot *chunk = table.chunks[index / kMbChunkSlots].load(
+      std::memory_order_acquire);
+  return chunk ? &chunk[index % kMbChunkSlots] : NULL;
+}
+
+static uint64_t MbFreeHead(uint64_t old_head, RK_U32 top) {
+  return (((old_head >> 32) + 1) << 32) | top;
+}
+
+bool MbTable::PopFree(RK_U32 &index) {
+  uint64_t head = free_head.load(std::memory_order_acquire);
+  while ((RK_U32)head) {
+    // a stale next fails the CAS, as the tag has changed since
+    RK_U32 top = (RK_U32)head;
+    RK_U32 next =
+        MbSlotOf(*this, top - 1)->next_free.load(std::memory_order_relaxed);
+    if (free_head.compare_exchange_weak(head, MbFreeHead(head, next),
+                                        std::memory_order_acquire)) {
+      index = top - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void MbTable::PushFree(RK_U32 index) {
+  MbSlot *slot = MbSlotOf(*this, index);
+  uint64_t head = free_head.load(std::memory_order_relaxed);
+  do {
+    slot->next_free.store((RK_U32)head, std::memory_order_relaxed);
+  } while (!free_head.compare_exchange_weak(
+      head, MbFreeHead(head, index + 1), std::memory_order_release,
+      std::memory_order_relaxed));
+}
+
+// Add a chunk of slots if all are held, one is returned in index, the
+// others are freed. Return false if a free slot is to be popped instead.
+bool MbTable::Grow(RK_U32 held_cnt, RK_U32 &index) {
+  std::lock_guard<std::mutex> lg(grow_mtx);
+  // another thread may have grown the table meanwhile
+  if (PopFree(index))
+    return true;
+  if (held_cnt <= slot_cnt)
+    return false;
+  MbSlot *chunk = new MbSlot[kMbChunkSlots];
+  for (RK_U32 i = 0; i < kMbChunkSlots; i++) {
+    chunk[i].handle.store(0, std::memory_order_relaxed);
+    chunk[i].gen = 0;
+    chunk[i].mod = RK_ID_UNKNOW;
+    chunk[i].next_free.store(0, std::memory_order_relaxed);
+  }
+  RK_U32 base = slot_cnt;
+  chunks[base / kMbChunkSlots].store(chunk, std::memory_order_release);
+  slot_cnt += kMbChunkSlots;
+  index = base;
+  for (RK_U32 i = 1; i < kMbChunkSlots; i++)
+    PushFree(base + i);
+  return true;
+}
+
+// 0, never a live handle, if mb does not fit a handle
+static RK_U32 MbHandleValue(MEDIA_BUFFER mb) {
+  uintptr_t value = (uintptr_t)mb;
+  return (value == (RK_U32)value) ? (RK_U32)value : 0;
+}
+
+MEDIA_BUFFER_IMPLE *RkmediaMbAcquire(MOD_ID_E enModID) {
+  MbTable &table = GetMbTable();
+  RK_U32 held_cnt = table.held.fetch_add(1, std::memory_order_acq_rel) + 1;
+  if (held_cnt > kMbSlotNum) {
+    table.held.fetch_sub(1, std::memory_order_relaxed);
+    RKMEDIA_LOGE("%s: all the %u media buffer slots are held, leaked?\n",
+                 __func__, kMbSlotNum);
+    return NULL;
+  }
+  RK_U32 index;
+  while (!table.PopFree(index) && !table.Grow(held_cnt, index))
+    sched_yield();
+  if (enModID < RK_ID_UNKNOW || enModID >= RK_ID_BUTT)
+    enModID = RK_ID_UNKNOW;
+  MbSlot *slot = MbSlotOf(table, index);
+  slot->gen = (slot->gen + 1) & kMbGenMask;
+  if (!slot->gen)
+    slot->gen = 1;
+  slot->mod = enModID;
+  MEDIA_BUFFER_IMPLE *mb = &slot->impl;
+  mb->handle = (MEDIA_BUFFER)(uintptr_t)((slot->gen << kMbIndexBits) | index);
+  mb->type = MB_TYPE_COMMON;
+  mb->ptr = NULL;
+  mb->fd = 0;
+  mb->size = 0;
+  mb->mode_id = enModID;
+  mb->chn_id = 0;
+  mb->timestamp = 0;
+  mb->flag = 0;
+  mb->tsvc_level = 0;
+  memset(&mb->stImageInfo, 0, sizeof(mb->stImageInfo));
+  table.live_cnt[enModID].fetch_add(1, std::memory_order_relaxed);
+  slot->handle.store(MbHandleValue(mb->handle), std::memory_order_release);
+  return mb;
+}
+
+static MbSlot *MbLiveSlot(MbTable &table, RK_U32 handle) {
+  if (!handle)
+    return NULL;
+  MbSlot *slot = MbSlotOf(table, handle & (kMbSlotNum - 1));
+  if (!slot || slot->handle.load(std::memory_order_acquire) != handle)
+    return NULL;
+  return slot;
+}
+
+MEDIA_BUFFER_IMPLE *RkmediaMbLookup(MEDIA_BUFFER mb, const char *func) {
   if (!mb)
     return NULL;
+  MbSlot *slot = MbLiveSlot(GetMbTable(), MbHandleValue(mb));
+  if (!slot) {
+    RKMEDIA_LOGE("%s: invalid media buffer %p, released already?\n", func,
+                 mb);
+    return NULL;
+  }
+  return &slot->impl;
+}
+
+bool RkmediaMbRelease(MEDIA_BUFFER mb) {
+  MbTable &table = GetMbTable();
+  RK_U32 handle = MbHandleValue(mb);
+  MbSlot *slot = MbLiveSlot(table, handle);
+  // only one of concurrent releases of the same handle wins
+  if (!slot || !slot->handle.compare_exchange_strong(
+                   handle, 0, std::memory_order_acq_rel))
+    return false;
+  slot->impl.rkmedia_mb.reset();
+  slot->impl.pin.reset();
+  table.live_cnt[slot->mod].fetch_sub(1, std::memory_order_relaxed);
+  RK_U32 index = MbHandleValue(mb) & (kMbSlotNum - 1);
+  table.PushFree(index);
+  table.held.fetch_sub(1, std::memory_order_release);
+  return true;
+}
+
+RK_S32 RK_MPI_MB_GetLiveCount(MOD_ID_E enModID) {
+  MbTable &table = GetMbTable();
+  if (enModID == RK_ID_BUTT) {
+    RK_S32 total = 0;
+    for (int i = 0; i < RK_ID_BUTT; i++)
+      total += table.live_cnt[i].load(std::memory_order_relaxed);
+    return total;
+  }
+  if (enModID < RK_ID_UNKNOW || enModID >= RK_ID_BUTT)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+  return table.live_cnt[enModID].load(std::memory_order_relaxed);
+}
+
+void *RK_MPI_MB_GetPtr(MEDIA_BUFFER mb) {
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
+    return NULL;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->ptr;
 }
 
 int RK_MPI_MB_GetFD(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return 0;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->fd;
 }
 
 size_t RK_MPI_MB_GetSize(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return 0;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->size;
 }
 
 MOD_ID_E RK_MPI_MB_GetModeID(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return RK_ID_UNKNOW;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->mode_id;
 }
 
 RK_S16 RK_MPI_MB_GetChannelID(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->chn_id;
 }
 
 RK_U64 RK_MPI_MB_GetTimestamp(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return 0;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   return mb_impl->timestamp;
 }
 
 RK_S32 RK_MPI_MB_ReleaseBuffer(MEDIA_BUFFER mb) {
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   if (!mb)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  if (mb_impl->rkmedia_mb)
-    mb_impl->rkmedia_mb.reset();
-
-  delete mb_impl;
+  if (!RkmediaMbRelease(mb)) {
+    RKMEDIA_LOGE("%s: invalid media buffer %p, released already?\n",
+                 __func__, mb);
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+  }
   return RK_ERR_SYS_OK;
 }
 
+RK_S32 RK_MPI_MB_ReleaseBuffers(MEDIA_BUFFER *pMbs, RK_S32 s32Cnt) {
+  if (!pMbs || s32Cnt < 0)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  RK_S32 ret = RK_ERR_SYS_OK;
+  for (RK_S32 i = 0; i < s32Cnt; i++) {
+    if (RK_MPI_MB_ReleaseBuffer(pMbs[i]))
+      ret = -RK_ERR_SYS_ILLEGAL_PARAM;
+    pMbs[i] = NULL;
+  }
+  return ret;
+}
+
 RK_S32 RK_MPI_MB_BeginCPUAccess(MEDIA_BUFFER mb, RK_BOOL bReadonly) {
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
   if (mb_impl->rkmedia_mb)
@@ -85,8 +327,8 @@ RK_S32 RK_MPI_MB_BeginCPUAccess(MEDIA_BUFFER mb, RK_BOOL bReadonly) {
 }
 
 RK_S32 RK_MPI_MB_EndCPUAccess(MEDIA_BUFFER mb, RK_BOOL bReadonly) {
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
   if (mb_impl->rkmedia_mb)
@@ -99,21 +341,21 @@ MEDIA_BUFFER RK_MPI_MB_CreateAudioBuffer(RK_U32 u32BufferSize,
                                          RK_BOOL boolHardWare) {
   std::shared_ptr<easymedia::MediaBuffer> rkmedia_mb;
   if (u32BufferSize == 0) {
-    rkmedia_mb = std::make_shared<easymedia::MediaBuffer>();
+    rkmedia_mb = easymedia::MakePooled<easymedia::MediaBuffer>();
   } else {
     rkmedia_mb = easymedia::MediaBuffer::Alloc(
         u32BufferSize, boolHardWare
                            ? easymedia::MediaBuffer::MemType::MEM_HARD_WARE
                            : easymedia::MediaBuffer::MemType::MEM_COMMON);
   }
-  MEDIA_BUFFER_IMPLE *mb = new MEDIA_BUFFER_IMPLE;
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbAcquire(RK_ID_UNKNOW);
   if (!mb) {
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
 
   if (!rkmedia_mb) {
-    delete mb;
+    RkmediaMbRelease(mb->handle);
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
@@ -128,7 +370,7 @@ MEDIA_BUFFER RK_MPI_MB_CreateAudioBuffer(RK_U32 u32BufferSize,
   mb->flag = 0;
   mb->tsvc_level = 0;
 
-  return mb;
+  return mb->handle;
 }
 
 MEDIA_BUFFER RK_MPI_MB_CreateImageBuffer(MB_IMAGE_INFO_S *pstImageInfo,
@@ -148,24 +390,20 @@ MEDIA_BUFFER RK_MPI_MB_CreateImageBuffer(MB_IMAGE_INFO_S *pstImageInfo,
   if (buf_size == 0)
     return NULL;
 
-  MEDIA_BUFFER_IMPLE *mb = new MEDIA_BUFFER_IMPLE;
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbAcquire(RK_ID_UNKNOW);
   if (!mb) {
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
 
-  RK_U32 u32RkmediaBufFlag = 2; // cached buffer type default
-  if (u8Flag == MB_FLAG_NOCACHED)
-    u32RkmediaBufFlag = 0;
-  else if (u8Flag == MB_FLAG_PHY_ADDR_CONSECUTIVE)
-    u32RkmediaBufFlag = 1;
+  RK_U32 u32RkmediaBufFlag = RkmediaBufFlag(u8Flag);
 
   auto &&rkmedia_mb = easymedia::MediaBuffer::Alloc(
       buf_size, boolHardWare ? easymedia::MediaBuffer::MemType::MEM_HARD_WARE
                              : easymedia::MediaBuffer::MemType::MEM_COMMON,
       u32RkmediaBufFlag);
   if (!rkmedia_mb) {
-    delete mb;
+    RkmediaMbRelease(mb->handle);
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
@@ -174,8 +412,8 @@ MEDIA_BUFFER RK_MPI_MB_CreateImageBuffer(MB_IMAGE_INFO_S *pstImageInfo,
                                 (int)pstImageInfo->u32Height,
                                 (int)pstImageInfo->u32HorStride,
                                 (int)pstImageInfo->u32VerStride};
-  mb->rkmedia_mb = std::make_shared<easymedia::ImageBuffer>(*(rkmedia_mb.get()),
-                                                            rkmediaImageInfo);
+  mb->rkmedia_mb = easymedia::MakePooled<easymedia::ImageBuffer>(
+      *(rkmedia_mb.get()), rkmediaImageInfo);
   mb->ptr = mb->rkmedia_mb->GetPtr();
   mb->fd = mb->rkmedia_mb->GetFD();
   mb->size = 0;
@@ -187,11 +425,11 @@ MEDIA_BUFFER RK_MPI_MB_CreateImageBuffer(MB_IMAGE_INFO_S *pstImageInfo,
   mb->flag = 0;
   mb->tsvc_level = 0;
 
-  return mb;
+  return mb->handle;
 }
 
 RK_S32 RK_MPI_MB_SetSzie(MEDIA_BUFFER mb, RK_U32 size) {
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
   if (!mb_impl || !mb_impl->rkmedia_mb)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
@@ -203,10 +441,10 @@ RK_S32 RK_MPI_MB_SetSzie(MEDIA_BUFFER mb, RK_U32 size) {
 }
 
 RK_S32 RK_MPI_MB_SetTimestamp(MEDIA_BUFFER mb, RK_U64 timestamp) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   mb_impl->timestamp = timestamp;
   if (mb_impl->rkmedia_mb)
     mb_impl->rkmedia_mb->SetUSTimeStamp(timestamp);
@@ -215,28 +453,26 @@ RK_S32 RK_MPI_MB_SetTimestamp(MEDIA_BUFFER mb, RK_U64 timestamp) {
 }
 
 RK_S32 RK_MPI_MB_GetFlag(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
-
   return mb_impl->flag;
 }
 
 RK_S32 RK_MPI_MB_GetTsvcLevel(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
-
   return mb_impl->tsvc_level;
 }
 
 RK_BOOL RK_MPI_MB_IsViFrame(MEDIA_BUFFER mb) {
-  if (!mb)
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
     return RK_FALSE;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
   if ((mb_impl->type != MB_TYPE_H264) && (mb_impl->type != MB_TYPE_H265))
     return RK_FALSE;
 
@@ -253,24 +489,20 @@ MEDIA_BUFFER RK_MPI_MB_CreateBuffer(RK_U32 u32Size, RK_BOOL boolHardWare,
     return NULL;
   }
 
-  MEDIA_BUFFER_IMPLE *mb = new MEDIA_BUFFER_IMPLE;
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbAcquire(RK_ID_UNKNOW);
   if (!mb) {
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
 
-  RK_U32 u32RkmediaBufFlag = 2; // cached buffer type default
-  if (u8Flag == MB_FLAG_NOCACHED)
-    u32RkmediaBufFlag = 0;
-  else if (u8Flag == MB_FLAG_PHY_ADDR_CONSECUTIVE)
-    u32RkmediaBufFlag = 1;
+  RK_U32 u32RkmediaBufFlag = RkmediaBufFlag(u8Flag);
 
   mb->rkmedia_mb = easymedia::MediaBuffer::Alloc(
       u32Size, boolHardWare ? easymedia::MediaBuffer::MemType::MEM_HARD_WARE
                             : easymedia::MediaBuffer::MemType::MEM_COMMON,
       u32RkmediaBufFlag);
   if (!mb->rkmedia_mb) {
-    delete mb;
+    RkmediaMbRelease(mb->handle);
     RKMEDIA_LOGE("%s: no space left!\n", __func__);
     return NULL;
   }
@@ -285,7 +517,7 @@ MEDIA_BUFFER RK_MPI_MB_CreateBuffer(RK_U32 u32Size, RK_BOOL boolHardWare,
   mb->flag = 0;
   mb->tsvc_level = 0;
 
-  return mb;
+  return mb->handle;
 }
 
 MEDIA_BUFFER RK_MPI_MB_ConvertToImgBuffer(MEDIA_BUFFER mb,
@@ -297,7 +529,9 @@ MEDIA_BUFFER RK_MPI_MB_ConvertToImgBuffer(MEDIA_BUFFER mb,
     return NULL;
   }
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
+    return NULL;
   if (!mb_impl->rkmedia_mb) {
     RKMEDIA_LOGE("%s: mediabuffer not init yet!\n", __func__);
     return NULL;
@@ -324,11 +558,11 @@ MEDIA_BUFFER RK_MPI_MB_ConvertToImgBuffer(MEDIA_BUFFER mb,
                                 (int)pstImageInfo->u32Height,
                                 (int)pstImageInfo->u32HorStride,
                                 (int)pstImageInfo->u32VerStride};
-  mb_impl->rkmedia_mb = std::make_shared<easymedia::ImageBuffer>(
+  mb_impl->rkmedia_mb = easymedia::MakePooled<easymedia::ImageBuffer>(
       *(mb_impl->rkmedia_mb.get()), rkmediaImageInfo);
   mb_impl->type = MB_TYPE_IMAGE;
   mb_impl->stImageInfo = *pstImageInfo;
-  return mb_impl;
+  return mb;
 }
 
 MEDIA_BUFFER RK_MPI_MB_ConvertToAudBuffer(MEDIA_BUFFER mb) {
@@ -336,24 +570,156 @@ MEDIA_BUFFER RK_MPI_MB_ConvertToAudBuffer(MEDIA_BUFFER mb) {
     RKMEDIA_LOGE("%s: invalid args!\n", __func__);
     return NULL;
   }
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
+    return NULL;
   if (!mb_impl->rkmedia_mb) {
     RKMEDIA_LOGE("%s: mediabuffer not init yet!\n", __func__);
     return NULL;
   }
 
   mb_impl->type = MB_TYPE_AUDIO;
-  return mb_impl;
+  return mb;
 }
 
 RK_S32 RK_MPI_MB_GetImageInfo(MEDIA_BUFFER mb, MB_IMAGE_INFO_S *pstImageInfo) {
   if (!mb || !pstImageInfo)
     return -RK_ERR_SYS_ILLEGAL_PARAM;
 
-  MEDIA_BUFFER_IMPLE *mb_impl = (MEDIA_BUFFER_IMPLE *)mb;
+  MEDIA_BUFFER_IMPLE *mb_impl = RkmediaMbLookup(mb, __func__);
+  if (!mb_impl)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
   if (mb_impl->type != MB_TYPE_IMAGE)
     return -RK_ERR_SYS_NOT_PERM;
 
   *pstImageInfo = mb_impl->stImageInfo;
   return RK_ERR_SYS_OK;
 }
+
+namespace {
+// Keeps the pool until the buffer is back in it.
+struct PoolBufferRef {
+  std::shared_ptr<easymedia::BufferPool> pool;
+  std::shared_ptr<void> data;
+};
+} // namespace
+
+MEDIA_BUFFER_POOL RK_MPI_MB_POOL_Create(MB_POOL_PARAM_S *pstPoolParam) {
+  if (!pstPoolParam || !pstPoolParam->u32Cnt)
+    return NULL;
+
+  MEDIA_BUFFER_POOL_IMPLE *pool = new MEDIA_BUFFER_POOL_IMPLE;
+  if (!pool) {
+    RKMEDIA_LOGE("%s: no space left!\n", __func__);
+    return NULL;
+  }
+  pool->stPoolParam = *pstPoolParam;
+  memset(&pool->stImageInfo, 0, sizeof(pool->stImageInfo));
+
+  RK_U32 u32Size = pstPoolParam->u32Size;
+  switch (pstPoolParam->enMediaType) {
+  case MB_TYPE_IMAGE: {
+    MB_IMAGE_INFO_S *pstImageInfo = &pstPoolParam->stImageInfo;
+    std::string strPixFormat = ImageTypeToString(pstImageInfo->enImgType);
+    PixelFormat rkmediaPixFormat = StringToPixFmt(strPixFormat.c_str());
+    if (rkmediaPixFormat == PIX_FMT_NONE || !pstImageInfo->u32Width ||
+        !pstImageInfo->u32Height || !pstImageInfo->u32HorStride ||
+        !pstImageInfo->u32VerStride) {
+      RKMEDIA_LOGE("%s: invalid image info!\n", __func__);
+      delete pool;
+      return NULL;
+    }
+    pool->stImageInfo = {rkmediaPixFormat, (int)pstImageInfo->u32Width,
+                         (int)pstImageInfo->u32Height,
+                         (int)pstImageInfo->u32HorStride,
+                         (int)pstImageInfo->u32VerStride};
+    u32Size = CalPixFmtSize(rkmediaPixFormat, pstImageInfo->u32HorStride,
+                            pstImageInfo->u32VerStride, 16);
+    break;
+  }
+  case MB_TYPE_AUDIO:
+  case MB_TYPE_COMMON:
+    break;
+  default:
+    RKMEDIA_LOGE("%s: unsupport media type:%d!\n", __func__,
+                 pstPoolParam->enMediaType);
+    delete pool;
+    return NULL;
+  }
+  if (!u32Size) {
+    RKMEDIA_LOGE("%s: invalid buffer size!\n", __func__);
+    delete pool;
+    return NULL;
+  }
+  pool->stPoolParam.u32Size = u32Size;
+
+  easymedia::BufferPoolParam bp_param;
+  bp_param.min_cnt = pstPoolParam->u32Cnt;
+  bp_param.max_cnt = std::max(pstPoolParam->u32MaxCnt, pstPoolParam->u32Cnt);
+  bp_param.low_watermark = 0;
+  bp_param.high_watermark = pstPoolParam->u32Cnt;
+  bp_param.idle_ms = (bp_param.max_cnt > bp_param.min_cnt) ? 3000 : 0;
+  bp_param.grow_ms = 0;
+  pool->rkmedia_pool = std::make_shared<easymedia::BufferPool>(
+      bp_param, u32Size,
+      pstPoolParam->bHardWare ? easymedia::MediaBuffer::MemType::MEM_HARD_WARE
+                              : easymedia::MediaBuffer::MemType::MEM_COMMON,
+      RkmediaBufFlag(pstPoolParam->u8Flag));
+  easymedia::BufferPoolStats stats;
+  pool->rkmedia_pool->GetStats(stats);
+  if (stats.buf_cnt <= 0) {
+    RKMEDIA_LOGE("%s: no space left!\n", __func__);
+    delete pool;
+    return NULL;
+  }
+
+  return pool;
+}
+
+RK_S32 RK_MPI_MB_POOL_Destroy(MEDIA_BUFFER_POOL MBPHandle) {
+  if (!MBPHandle)
+    return -RK_ERR_SYS_ILLEGAL_PARAM;
+
+  // the buffers still out keep the pool until they are released
+  delete (MEDIA_BUFFER_POOL_IMPLE *)MBPHandle;
+  return RK_ERR_SYS_OK;
+}
+
+MEDIA_BUFFER RK_MPI_MB_POOL_GetBuffer(MEDIA_BUFFER_POOL MBPHandle,
+                                      RK_BOOL bIsBlock) {
+  MEDIA_BUFFER_POOL_IMPLE *pool = (MEDIA_BUFFER_POOL_IMPLE *)MBPHandle;
+  if (!pool)
+    return NULL;
+
+  auto rkmedia_mb = pool->rkmedia_pool->GetBuffer(bIsBlock ? true : false);
+  if (!rkmedia_mb)
+    return NULL;
+  auto ref = std::make_shared<PoolBufferRef>();
+  ref->pool = pool->rkmedia_pool;
+  ref->data = rkmedia_mb->GetUserData();
+  rkmedia_mb->SetUserData(std::shared_ptr<void>(ref, ref->data.get()));
+
+  MEDIA_BUFFER_IMPLE *mb = RkmediaMbAcquire(RK_ID_UNKNOW);
+  if (!mb) {
+    RKMEDIA_LOGE("%s: no space left!\n", __func__);
+    return NULL;
+  }
+  mb->type = pool->stPoolParam.enMediaType;
+  if (mb->type == MB_TYPE_IMAGE) {
+    mb->rkmedia_mb = easymedia::MakePooled<easymedia::ImageBuffer>(
+        *(rkmedia_mb.get()), pool->stImageInfo);
+    mb->stImageInfo = pool->stPoolParam.stImageInfo;
+  } else {
+    mb->rkmedia_mb = rkmedia_mb;
+  }
+  mb->ptr = mb->rkmedia_mb->GetPtr();
+  mb->fd = mb->rkmedia_mb->GetFD();
+  mb->size = 0;
+  mb->timestamp = 0;
+  mb->mode_id = RK_ID_UNKNOW;
+  mb->chn_id = 0;
+  mb->flag = 0;
+  mb->tsvc_level = 0;
+
+  return mb->handle;
+}
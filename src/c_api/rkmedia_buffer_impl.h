@@ -8,9 +8,11 @@
 #include "buffer.h"
 #include "flow.h"
 
+#include "rkmedia_buffer.h"
 #include "rkmedia_common.h"
 
 typedef struct _rkMEDIA_BUFFER_S {
+  MEDIA_BUFFER handle; // what the app gets, see RkmediaMbAcquire
   MB_TYPE_E type;
   void *ptr;         // Virtual address of buffer
   int fd;            // dma buffer fd
@@ -21,10 +23,31 @@ typedef struct _rkMEDIA_BUFFER_S {
   RK_U32 flag;       // buffer flag
   RK_U32 tsvc_level; // buffer level
   std::shared_ptr<easymedia::MediaBuffer> rkmedia_mb;
+  // keeps rkmedia_mb pinned while the app holds ptr and fd, see
+  // MediaBuffer::Pin
+  std::shared_ptr<void> pin;
   union {
     MB_IMAGE_INFO_S stImageInfo;
   };
 
 } MEDIA_BUFFER_IMPLE;
 
+// The MEDIA_BUFFERs are handles into a table of preallocated
+// MEDIA_BUFFER_IMPLEs, made of the slot index and its generation, which
+// changes on every release: a released or forged handle is rejected
+// instead of reaching freed memory.
+// Return a cleared MEDIA_BUFFER_IMPLE accounted to enModID, NULL if the
+// table is full.
+MEDIA_BUFFER_IMPLE *RkmediaMbAcquire(MOD_ID_E enModID);
+// NULL, and logged for func, if mb is not a live handle.
+MEDIA_BUFFER_IMPLE *RkmediaMbLookup(MEDIA_BUFFER mb, const char *func);
+// Return false if mb is not a live handle.
+bool RkmediaMbRelease(MEDIA_BUFFER mb);
+
+typedef struct _rkMEDIA_BUFFER_POOL_S {
+  MB_POOL_PARAM_S stPoolParam;
+  ImageInfo stImageInfo;
+  std::shared_ptr<easymedia::BufferPool> rkmedia_pool;
+} MEDIA_BUFFER_POOL_IMPLE;
+
 #endif // __RK_BUFFER_IMPL_
\ No newline at end of file
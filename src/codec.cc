@@ -26,7 +26,7 @@ std::shared_ptr<MediaBuffer> Codec::GetExtraData(void **data, size_t *size) {
 bool Codec::SetExtraData(void *data, size_t size, bool realloc) {
   if (!realloc) {
     if (!extra_data) {
-      extra_data = std::make_shared<MediaBuffer>();
+      extra_data = MakePooled<MediaBuffer>();
       if (!extra_data)
         return false;
     }
@@ -98,8 +98,22 @@ const uint8_t *find_nalu_startcode(const uint8_t *p, const uint8_t *end) {
   return out;
 }
 
-std::list<std::shared_ptr<MediaBuffer>>
-split_h264_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
+static bool is_h264_param_set(const uint8_t *nal) {
+  uint8_t nal_type = (*nal) & 0x1F;
+  return nal_type == 7 || nal_type == 8;
+}
+
+static bool is_h265_param_set(const uint8_t *nal) {
+  uint8_t nal_type = ((*nal) & 0x7E) >> 1;
+  return nal_type >= 32 && nal_type <= 34;
+}
+
+// The parameter set nalus at the head of the data, up to the first other
+// nalu. Views of parent if it is given, else copies.
+static std::list<std::shared_ptr<MediaBuffer>>
+split_separate(const std::shared_ptr<MediaBuffer> &parent,
+               const uint8_t *buffer, size_t length, int64_t timestamp,
+               bool (*is_param_set)(const uint8_t *)) {
   std::list<std::shared_ptr<MediaBuffer>> l;
   const uint8_t *p = buffer;
   const uint8_t *end = p + length;
@@ -113,30 +127,28 @@ split_h264_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
     nal_start += start_len;
     nal_end = find_nalu_startcode(nal_start, end);
     size_t size = nal_end - nal_start + start_len;
-    uint8_t nal_type = (*nal_start) & 0x1F;
-    uint32_t flag;
-    switch (nal_type) {
-    case 7:
-    case 8:
-      flag = MediaBuffer::kExtraIntra;
-      break;
-    default:
-      flag = 0;
-    }
 
     // not extraIntra?
-    if (!flag)
+    if (!is_param_set(nal_start))
       break;
 
-    auto sub_buffer = MediaBuffer::Alloc(size);
+    std::shared_ptr<MediaBuffer> sub_buffer;
+    if (parent) {
+      sub_buffer =
+          MediaBuffer::Slice(parent, nal_start - start_len - buffer, size);
+    } else {
+      sub_buffer = MediaBuffer::Alloc(size);
+      if (sub_buffer) {
+        memcpy(sub_buffer->GetPtr(), nal_start - start_len, size);
+        sub_buffer->SetValidSize(size);
+      }
+    }
     if (!sub_buffer) {
       LOG_NO_MEMORY(); // fatal error
       l.clear();
       return l;
     }
-    memcpy(sub_buffer->GetPtr(), nal_start - start_len, size);
-    sub_buffer->SetValidSize(size);
-    sub_buffer->SetUserFlag(flag);
+    sub_buffer->SetUserFlag(MediaBuffer::kExtraIntra);
     sub_buffer->SetUSTimeStamp(timestamp);
     sub_buffer->SetType(Type::Video);
     l.push_back(sub_buffer);
@@ -147,51 +159,29 @@ split_h264_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
 }
 
 std::list<std::shared_ptr<MediaBuffer>>
-split_h265_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
-  std::list<std::shared_ptr<MediaBuffer>> l;
-  const uint8_t *p = buffer;
-  const uint8_t *end = p + length;
-  const uint8_t *nal_start = nullptr, *nal_end = nullptr;
-  nal_start = find_nalu_startcode(p, end);
-  // 00 00 01 or 00 00 00 01
-  size_t start_len = (nal_start[2] == 1 ? 3 : 4);
-  for (;;) {
-    if (nal_start == end)
-      break;
-    nal_start += start_len;
-    nal_end = find_nalu_startcode(nal_start, end);
-    size_t size = nal_end - nal_start + start_len;
-    uint8_t nal_type = ((*nal_start) & 0x7E) >> 1;
-    uint32_t flag;
-    switch (nal_type) {
-    case 32:
-    case 33:
-    case 34:
-      flag = MediaBuffer::kExtraIntra;
-      break;
-    default:
-      flag = 0;
-    }
+split_h264_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
+  return split_separate(nullptr, buffer, length, timestamp,
+                        is_h264_param_set);
+}
 
-    // not extraIntra?
-    if (!flag)
-      break;
+std::list<std::shared_ptr<MediaBuffer>>
+split_h265_separate(const uint8_t *buffer, size_t length, int64_t timestamp) {
+  return split_separate(nullptr, buffer, length, timestamp,
+                        is_h265_param_set);
+}
 
-    auto sub_buffer = MediaBuffer::Alloc(size);
-    if (!sub_buffer) {
-      LOG_NO_MEMORY(); // fatal error
-      l.clear();
-      return l;
-    }
-    memcpy(sub_buffer->GetPtr(), nal_start - start_len, size);
-    sub_buffer->SetValidSize(size);
-    sub_buffer->SetUserFlag(flag);
-    sub_buffer->SetUSTimeStamp(timestamp);
-    l.push_back(sub_buffer);
+std::list<std::shared_ptr<MediaBuffer>>
+split_h264_separate(const std::shared_ptr<MediaBuffer> &buffer) {
+  return split_separate(buffer, (const uint8_t *)buffer->GetPtr(),
+                        buffer->GetValidSize(), buffer->GetUSTimeStamp(),
+                        is_h264_param_set);
+}
 
-    nal_start = nal_end;
-  }
-  return l;
+std::list<std::shared_ptr<MediaBuffer>>
+split_h265_separate(const std::shared_ptr<MediaBuffer> &buffer) {
+  return split_separate(buffer, (const uint8_t *)buffer->GetPtr(),
+                        buffer->GetValidSize(), buffer->GetUSTimeStamp(),
+                        is_h265_param_set);
 }
 
 static void *FindNaluByType(std::shared_ptr<MediaBuffer> &mb, int nal_type,
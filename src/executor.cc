@@ -0,0 +1,134 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "executor.h"
+
+#include <stdio.h>
+#include <sys/prctl.h>
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace easymedia {
+
+static thread_local const Executor *current_executor = nullptr;
+static thread_local int current_worker = -1;
+
+Executor::Executor(int thread_num)
+    : idle_num(0), task_num(0), next_worker(0), quit(false) {
+  if (thread_num <= 0)
+    thread_num = (int)std::thread::hardware_concurrency();
+  if (thread_num <= 0)
+    thread_num = 1;
+  for (int i = 0; i < thread_num; i++)
+    workers.emplace_back(new Worker());
+  for (int i = 0; i < thread_num; i++)
+    workers[i]->th = new std::thread(&Executor::WorkerRun, this, i);
+  RKMEDIA_LOGI("Executor: create %d workers\n", thread_num);
+}
+
+Executor::~Executor() {
+  idle_mtx.lock();
+  quit = true;
+  idle_mtx.notify();
+  idle_mtx.unlock();
+  for (auto &w : workers) {
+    if (w->th) {
+      w->th->join();
+      delete w->th;
+    }
+  }
+}
+
+const std::shared_ptr<Executor> &Executor::GetInstance() {
+  const static std::shared_ptr<Executor> executor =
+      std::make_shared<Executor>();
+  return executor;
+}
+
+int Executor::GetCurrentWorker() const {
+  return (current_executor == this) ? current_worker : -1;
+}
+
+void Executor::Submit(ExecutorTask *task) {
+  int index = GetCurrentWorker();
+  if (index < 0)
+    index = (int)(next_worker++ % workers.size());
+  auto &w = workers[index];
+  w->mtx.lock();
+  w->tasks.push_back(task);
+  w->mtx.unlock();
+  task_num++;
+  if (idle_num > 0) {
+    AutoLockMutex _alm(idle_mtx);
+    idle_mtx.notify_one();
+  }
+}
+
+bool Executor::Cancel(ExecutorTask *task) {
+  for (auto &w : workers) {
+    AutoLockMutex _alm(w->mtx);
+    auto it = std::find(w->tasks.begin(), w->tasks.end(), task);
+    if (it != w->tasks.end()) {
+      w->tasks.erase(it);
+      task_num--;
+      return true;
+    }
+  }
+  return false;
+}
+
+ExecutorTask *Executor::Pop(int index) {
+  ExecutorTask *task = nullptr;
+  auto &w = workers[index];
+  AutoLockMutex _alm(w->mtx);
+  if (!w->tasks.empty()) {
+    task = w->tasks.front();
+    w->tasks.pop_front();
+  }
+  return task;
+}
+
+ExecutorTask *Executor::Steal(int index) {
+  int num = (int)workers.size();
+  for (int i = 1; i < num; i++) {
+    ExecutorTask *task = nullptr;
+    auto &w = workers[(index + i) % num];
+    AutoLockMutex _alm(w->mtx);
+    if (!w->tasks.empty()) {
+      task = w->tasks.back();
+      w->tasks.pop_back();
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void Executor::WorkerRun(int index) {
+  char name[16];
+  snprintf(name, sizeof(name), "rkmedia_pool%d", index);
+  prctl(PR_SET_NAME, name);
+  current_executor = this;
+  current_worker = index;
+
+  while (!quit) {
+    ExecutorTask *task = Pop(index);
+    if (!task)
+      task = Steal(index);
+    if (task) {
+      task_num--;
+      task->Execute();
+      continue;
+    }
+    idle_mtx.lock();
+    idle_num++;
+    if (task_num == 0 && !quit)
+      idle_mtx.wait();
+    idle_num--;
+    idle_mtx.unlock();
+  }
+}
+
+} // namespace easymedia
@@ -191,7 +191,7 @@ std::shared_ptr<MediaBuffer> FFMPEGAudioDecoder::FetchOutput() {
   auto frame = av_frame_alloc();
   if (!frame)
     return nullptr;
-  std::shared_ptr<MediaBuffer> buffer = std::make_shared<MediaBuffer>(
+  std::shared_ptr<MediaBuffer> buffer = MakePooled<MediaBuffer>(
       frame->data, 0, -1, frame, __ffmpeg_frame_free);
   ret = avcodec_receive_frame(avctx, frame);
   if (ret < 0) {
@@ -227,7 +227,7 @@ std::shared_ptr<MediaBuffer> FFMPEGAudioDecoder::FetchOutput() {
                       av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) *
                       avctx->frame_size;
     std::shared_ptr<MediaBuffer> buffer_s16p =
-        std::make_shared<MediaBuffer>(MediaBuffer::Alloc2(buffer_size));
+        MakePooled<MediaBuffer>(MediaBuffer::Alloc2(buffer_size));
     uint8_t *pi = (uint8_t *)buffer->GetPtr();
     uint8_t *po = (uint8_t *)buffer_s16p->GetPtr();
     int os = av_get_bytes_per_sample(AV_SAMPLE_FMT_S16);
@@ -241,7 +241,7 @@ std::shared_ptr<MediaBuffer> FFMPEGAudioDecoder::FetchOutput() {
       sampleinfo.channels = avctx->channels;
       sampleinfo.nb_samples = avctx->frame_size;
       std::shared_ptr<MediaBuffer> buffer_s16 =
-          std::make_shared<MediaBuffer>(MediaBuffer::Alloc2(buffer_size));
+          MakePooled<MediaBuffer>(MediaBuffer::Alloc2(buffer_size));
       conv_planar_to_package((uint8_t *)buffer_s16->GetPtr(),
                              (uint8_t *)buffer_s16p->GetPtr(), sampleinfo);
       buffer_s16p = buffer_s16;
@@ -193,7 +193,7 @@ int FFMPEGAudioEncoder::SendInput(const std::shared_ptr<MediaBuffer> &input) {
       int buffer_size = avctx->channels *
                         av_get_bytes_per_sample(avctx->sample_fmt) *
                         avctx->frame_size;
-      auto buffer = std::make_shared<easymedia::SampleBuffer>(
+      auto buffer = easymedia::MakePooled<easymedia::SampleBuffer>(
           MediaBuffer::Alloc2(buffer_size), sampleinfo);
       uint8_t *po = (uint8_t *)buffer->GetPtr();
       uint8_t *pi = (uint8_t *)in->GetPtr();
@@ -205,7 +205,7 @@ int FFMPEGAudioEncoder::SendInput(const std::shared_ptr<MediaBuffer> &input) {
 
       if (avctx->channels > 1) {
         // from FLT to FLTP
-        auto fltp_buf = std::make_shared<easymedia::SampleBuffer>(
+        auto fltp_buf = easymedia::MakePooled<easymedia::SampleBuffer>(
             MediaBuffer::Alloc2(buffer_size), sampleinfo);
         conv_package_to_planar((uint8_t *)fltp_buf->GetPtr(),
                                (uint8_t *)buffer->GetPtr(), sampleinfo);
@@ -252,7 +252,7 @@ std::shared_ptr<MediaBuffer> FFMPEGAudioEncoder::FetchOutput() {
   auto pkt = av_packet_alloc();
   if (!pkt)
     return nullptr;
-  std::shared_ptr<MediaBuffer> buffer = std::make_shared<MediaBuffer>(
+  std::shared_ptr<MediaBuffer> buffer = MakePooled<MediaBuffer>(
       pkt->data, 0, -1, pkt, __ffmpeg_packet_free);
 
   int ret = avcodec_receive_packet(avctx, pkt);
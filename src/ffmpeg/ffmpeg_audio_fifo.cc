@@ -179,7 +179,7 @@ std::shared_ptr<MediaBuffer> AudioFifo::FetchOutput() {
     assert(size > 0);
 
     SampleInfo dst_info = {format, channels, sample_rate, dst_nb_samples};
-    auto dst = std::make_shared<easymedia::SampleBuffer>(
+    auto dst = easymedia::MakePooled<easymedia::SampleBuffer>(
         MediaBuffer::Alloc2(size), dst_info);
     assert(dst);
 
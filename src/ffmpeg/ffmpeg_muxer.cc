@@ -50,7 +50,7 @@ private:
 };
 
 std::shared_ptr<MediaBuffer> FFMPEGMuxer::empty =
-    std::make_shared<MediaBuffer>();
+    MakePooled<MediaBuffer>();
 
 static bool _convert_to_avdictionary(std::string avdictionary,
                                      AVDictionary **opt) {
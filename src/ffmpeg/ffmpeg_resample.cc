@@ -187,8 +187,8 @@ int ResampleFilter::Resample(std::shared_ptr<SampleBuffer> src,
   if (size < 0)
     return size;
 
-  dst = std::make_shared<easymedia::SampleBuffer>(MediaBuffer::Alloc2(size),
-                                                  dst_info);
+  dst = easymedia::MakePooled<easymedia::SampleBuffer>(
+      MediaBuffer::Alloc2(size), dst_info);
   if (!dst) {
     RKMEDIA_LOGI("Alloc audio frame buffer failed:%d!\n", size);
     return -1;
@@ -151,7 +151,7 @@ std::shared_ptr<MediaBuffer> FFMpegDecoder::FetchOutput() {
   image_info.vir_height = frame->height;
   image_info.pix_fmt = AVPixFmtToPixFmt((enum AVPixelFormat)frame->format);
   auto buffer_out =
-      std::make_shared<easymedia::ImageBuffer>(buffer, image_info);
+      easymedia::MakePooled<easymedia::ImageBuffer>(buffer, image_info);
   av_image_copy_to_buffer(
       (uint8_t *)buffer_out->GetPtr(), size,
       (const uint8_t *const *)frame->data, (const int *)frame->linesize,
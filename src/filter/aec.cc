@@ -128,7 +128,7 @@ int AECFilter::Process(std::shared_ptr<MediaBuffer> input,
 
   SampleInfo dst_info = {SAMPLE_FMT_S16, 1, sample_rate, nb_samples};
   int dst_size = GetSampleSize(dst_info) * nb_samples;
-  auto dst = std::make_shared<easymedia::SampleBuffer>(
+  auto dst = easymedia::MakePooled<easymedia::SampleBuffer>(
       MediaBuffer::Alloc2(dst_size), dst_info);
   assert(dst);
   assert(input->GetValidSize() == (dst_size * 2));
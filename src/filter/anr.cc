@@ -116,7 +116,7 @@ int ANRFilter::Process(std::shared_ptr<MediaBuffer> input,
 
   SampleInfo dst_info = {format, channels, sample_rate, nb_samples};
   int size = GetSampleSize(dst_info) * nb_samples;
-  auto dst = std::make_shared<easymedia::SampleBuffer>(
+  auto dst = easymedia::MakePooled<easymedia::SampleBuffer>(
       MediaBuffer::Alloc2(size), dst_info);
   assert(dst);
   assert(size == input->GetValidSize());
@@ -6,43 +6,70 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <string.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "buffer.h"
+#include "buffer_tracker.h"
+#include "executor.h"
 #include "key_string.h"
+#include "mem_account.h"
+#include "pacer.h"
 #include "utils.h"
 
 namespace easymedia {
 
-class FlowCoroutine {
+class FlowCoroutine : public ExecutorTask, public PacedTask {
 public:
   FlowCoroutine(Flow *f, Model sync_model, FunctionProcess func, float inter);
   ~FlowCoroutine();
 
   void Bind(std::vector<int> &in, std::vector<int> &out);
   bool Start();
+  void Stop();
   void RunOnce();
+  // Model::POOL, request one more RunOnce on the executor.
+  void Schedule();
+  virtual void Execute() override;
+  // Model::ASYNCATOMIC, wake up the thread if the previous run is over.
+  virtual void OnTick(int64_t late_us, int missed) override;
   int GetCachedBufferCnt();
   bool IsProcessing();
   void ClearCachedBuffers();
 
 private:
   void WhileRun();
-  void WhileRunSleep();
-  void SyncFetchInput(MediaBufferVector &in);
-  void ASyncFetchInputCommon(MediaBufferVector &in);
-  void ASyncFetchInputAtomic(MediaBufferVector &in);
+  // Model::ASYNCATOMIC, run once per pacer tick
+  void WhileRunPaced();
+  // return false if there is nothing to process
+  bool SyncFetchInput(MediaBufferVector &in);
+  bool ASyncFetchInputCommon(MediaBufferVector &in);
+  bool ASyncFetchInputAtomic(MediaBufferVector &in);
+  bool ASyncFetchInputPool(MediaBufferVector &in);
+  // ASYNCCOMMON with an InputSync policy
+  bool ASyncFetchInputSync(MediaBufferVector &in);
+  int64_t SyncTime(const std::shared_ptr<MediaBuffer> &mb) const;
+  // batch mode, drain more runs of inputs after the fetched one
+  bool PopBatchEntry(size_t base);
+  void FillBatch();
 
   void SendNullBufferDown(Flow::FlowMap &fm, const MediaBufferVector &in,
-                          std::list<Flow::FlowInputMap> &flows);
+                          const Flow::FlowMap::FlowList &flows);
   void SendBufferDown(Flow::FlowMap &fm, const MediaBufferVector &in,
-                      std::list<Flow::FlowInputMap> &flows, bool process_ret);
+                      const Flow::FlowMap::FlowList &flows, bool process_ret);
   void SendBufferDownFromDeque(Flow::FlowMap &fm, const MediaBufferVector &in,
-                               std::list<Flow::FlowInputMap> &flows,
+                               const Flow::FlowMap::FlowList &flows,
                                bool process_ret);
   size_t OutputHoldRelated(Flow::FlowMap &fm,
                            std::shared_ptr<MediaBuffer> &out_buffer,
                            const MediaBufferVector &input_vector);
+  void TakeShares(const std::shared_ptr<MediaBuffer> &buffer, size_t flow_num);
 
   Flow *flow;
   Model model;
@@ -54,31 +81,104 @@ private:
   bool is_processing;
   bool clear_buffers_enable;
   ConditionLockMutex clear_buffers_mtx;
+  std::shared_ptr<Executor> executor;
+  std::shared_ptr<Pacer> pacer;
+  // Model::POOL and ASYNCATOMIC, the number of schedule requests not yet
+  // executed, and closed once Stop is called, both under state_mtx.
+  // Only the request which brings it from 0 to 1 submits the task, so at most
+  // one worker runs this coroutine at any time, which keeps the order.
+  // ASYNCATOMIC has its own thread, which a tick wakes up by setting 1.
+  ConditionLockMutex state_mtx;
+  bool closed;
+  int pending;
 
   MediaBufferVector in_vector;
+  FunctionBatchProcess batch_run;
+  size_t batch_max;
+  int batch_latency; // ms
+  // reserved for batch_max runs at start, never reallocated
+  MediaBufferVector batch;
+  // inputs pinned during process
+  MediaBufferVector pinned;
+  InputSync input_sync;
+  int64_t sync_tolerance; // us
+  int64_t sync_timeout;   // us
+  bool sync_atomic_clock;
+  // the buffers taken out of the slots but not matched yet
+  MediaBufferVector sync_heads;
+  // the slots which timed out, not waited for until they deliver again
+  std::vector<bool> sync_stale;
+  // when the oldest of sync_heads was taken, 0 if none
+  int64_t sync_since;
   decltype(&FlowCoroutine::SyncFetchInput) fetch_input_func;
   decltype(&FlowCoroutine::SendBufferDown) send_down_func;
+  // a share of the output per down flow, if it has several consumers
+  MediaBufferVector shares;
 
 public:
   void SetMarkName(std::string s) { name = s; }
   void SetExpectProcessTime(int time) { expect_process_time = time; }
+  void SetSchedParam(const ThreadSchedParam &param) { sched = param; }
+  void SetBatch(FunctionBatchProcess f, int max_num, int latency) {
+    batch_run = f;
+    batch_max = max_num > 1 ? max_num : 1;
+    batch_latency = latency;
+  }
+  void SetInputSync(InputSync sync, int tolerance, int timeout,
+                    bool atomic_clock) {
+    input_sync = sync;
+    sync_tolerance = (int64_t)tolerance * 1000;
+    sync_timeout = (int64_t)timeout * 1000;
+    sync_atomic_clock = atomic_clock;
+  }
 
   std::string name;
   int expect_process_time; // ms
+  ThreadSchedParam sched;
 };
 
 FlowCoroutine::FlowCoroutine(Flow *f, Model sync_model, FunctionProcess func,
                              float inter)
     : flow(f), model(sync_model), interval(inter), th(nullptr), th_run(func),
-      is_processing(false), clear_buffers_enable(false),
-      expect_process_time(0) {}
+      is_processing(false), clear_buffers_enable(false), closed(false),
+      pending(0),
+      batch_run(nullptr), batch_max(1), batch_latency(0),
+      input_sync(InputSync::NONE), sync_tolerance(0), sync_timeout(0),
+      sync_atomic_clock(false), sync_since(0), expect_process_time(0) {}
 
 FlowCoroutine::~FlowCoroutine() {
+  Stop();
+  RKMEDIA_LOGI("%s quit\n", name.c_str());
+}
+
+// the coroutine run by the executor worker of the calling thread
+static thread_local FlowCoroutine *running_coroutine = nullptr;
+
+void FlowCoroutine::Stop() {
+  if (pacer)
+    pacer->Remove(this);
+  state_mtx.lock();
+  closed = true;
+  // wake up the paced thread
+  state_mtx.notify();
+  // A task still queued is taken back, the worker calling us may be the one
+  // which would have run it. A task already running ends soon, flow->quit is
+  // set, and Execute wakes us up.
+  if (executor) {
+    if (pending > 0 && executor->Cancel(this))
+      pending = 0;
+    if (running_coroutine == this)
+      RKMEDIA_LOGE("%s: stopped from its own process\n", name.c_str());
+    else
+      while (pending > 0)
+        state_mtx.wait();
+  }
+  state_mtx.unlock();
   if (th) {
     th->join();
     delete th;
+    th = nullptr;
   }
-  RKMEDIA_LOGI("%s quit\n", name.c_str());
 }
 
 void FlowCoroutine::Bind(std::vector<int> &in, std::vector<int> &out) {
@@ -96,22 +196,51 @@ bool FlowCoroutine::Start() {
     need_thread = true;
     fetch_input_func = &FlowCoroutine::ASyncFetchInputCommon;
     send_down_func = &FlowCoroutine::SendBufferDownFromDeque;
+    if (input_sync != InputSync::NONE && in_slots.size() > 1) {
+      fetch_input_func = &FlowCoroutine::ASyncFetchInputSync;
+      sync_heads.resize(in_slots.size());
+      sync_stale.assign(in_slots.size(), false);
+    }
     break;
   case Model::ASYNCATOMIC:
+    // Paced by the shared Pacer, processed on a thread of its own: the
+    // process of these flows may block, on a device write for instance,
+    // which must not hold a worker of the shared Executor.
     need_thread = true;
+    func = &FlowCoroutine::WhileRunPaced;
     fetch_input_func = &FlowCoroutine::ASyncFetchInputAtomic;
     send_down_func = &FlowCoroutine::SendBufferDown;
-    func = &FlowCoroutine::WhileRunSleep;
+    if (interval <= 0) {
+      RKMEDIA_LOGI("invalid interval %f for asyncatomic\n", interval);
+      errno = EINVAL;
+      return false;
+    }
+    pacer = Pacer::GetInstance();
+    if (!pacer) {
+      errno = ENOMEM;
+      return false;
+    }
     break;
   case Model::SYNC:
     fetch_input_func = &FlowCoroutine::SyncFetchInput;
     send_down_func = &FlowCoroutine::SendBufferDown;
     break;
+  case Model::POOL:
+    fetch_input_func = &FlowCoroutine::ASyncFetchInputPool;
+    send_down_func = &FlowCoroutine::SendBufferDownFromDeque;
+    executor = Executor::GetInstance();
+    if (!executor) {
+      errno = ENOMEM;
+      return false;
+    }
+    break;
   default:
     RKMEDIA_LOGI("invalid model %d\n", (int)model);
     return false;
   }
   in_vector.resize(in_slots.size());
+  if (batch_run)
+    batch.reserve(batch_max * in_slots.size());
   if (need_thread) {
     th = new std::thread(func, this);
     if (!th) {
@@ -119,97 +248,215 @@ bool FlowCoroutine::Start() {
       return false;
     }
   }
+  // interval is in ms
+  if (pacer && !pacer->Add(this, (int64_t)(interval * 1000000.0f))) {
+    RKMEDIA_LOGE("%s: fail to start pacing\n", name.c_str());
+    return false;
+  }
   return true;
 }
 
-#ifndef NDEBUG
-static void check_consume_time(const char *name, int expect, int exactly) {
+static bool check_consume_time(const char *name _UNUSED, int expect,
+                               int exactly) {
   if (exactly > expect) {
+#ifndef NDEBUG
     RKMEDIA_LOGI("%s, expect consume %d ms, however %d ms\n", name, expect,
                  exactly);
+#endif
+    return false;
   }
+  return true;
 }
-#endif
 
 void FlowCoroutine::RunOnce() {
   bool ret = true;
-  (this->*fetch_input_func)(in_vector);
+  if (!(this->*fetch_input_func)(in_vector))
+    return;
+
+  if (flow->credit_control && !flow->HasDownCredit()) {
+    flow->credit_skipped++;
+    for (auto &buffer : in_vector)
+      buffer.reset();
+    return;
+  }
+
+  if (batch_run)
+    FillBatch();
 
   if (flow->GetRunTimesRemaining()) {
-#ifndef NDEBUG
-    {
-      AutoDuration ad;
-#endif
-      is_processing = true;
-      ret = (*th_run)(flow, in_vector);
-      is_processing = false;
-#ifndef NDEBUG
-      if (expect_process_time > 0)
-        check_consume_time(name.c_str(), expect_process_time,
-                           (int)(ad.Get() / 1000));
+    // the thread may run flows of several channels, or be the one of an
+    // upstream flow with a SYNC input
+    AutoMemOwner _amo(flow->mem_mod, flow->mem_chn);
+    // keep the inputs in their memory while the flow reads them, process
+    // may replace them in the vector
+    for (auto &buffer : batch_run ? batch : in_vector) {
+      if (buffer) {
+        buffer->Pin();
+        pinned.push_back(buffer);
+      }
     }
-#endif // DEBUG
+    AutoDuration ad;
+    is_processing = true;
+    ret = batch_run ? (*batch_run)(flow, batch) : (*th_run)(flow, in_vector);
+    is_processing = false;
+    int64_t cost = ad.Get();
+    for (auto &buffer : pinned)
+      buffer->Unpin();
+    pinned.clear();
+    flow->process_hist.Add(cost);
+    if (expect_process_time > 0 &&
+        !check_consume_time(name.c_str(), expect_process_time,
+                            (int)(cost / 1000)))
+      flow->process_overrun++;
   }
 
   for (int idx : out_slots) {
     auto &fm = flow->downflowmap[idx];
-    std::list<Flow::FlowInputMap> flows;
-    fm.list_mtx.read_lock();
-    flows = fm.flows;
-    fm.list_mtx.unlock();
-    (this->*send_down_func)(fm, in_vector, flows, ret);
+    const Flow::FlowMap::FlowList *flows = fm.AcquireFlows();
+    if (flows)
+      (this->*send_down_func)(fm, in_vector, *flows, ret);
+    fm.ReleaseFlows();
   }
   for (auto &buffer : in_vector)
     buffer.reset();
+  // keep the capacity for the next batch
+  batch.clear();
 
-  pthread_yield();
+  // the workers of executor are shared, never yield them.
+  if (!executor)
+    pthread_yield();
+}
+
+bool FlowCoroutine::PopBatchEntry(size_t base) {
+  bool has_input = false;
+  for (size_t i = 0; i < in_slots.size(); i++) {
+    if (flow->v_input[in_slots[i]].Pop(batch[base + i]))
+      has_input = true;
+  }
+  return has_input;
+}
+
+void FlowCoroutine::FillBatch() {
+  const size_t num = in_slots.size();
+  // the fetched run is the first entry of the batch
+  for (auto &buffer : in_vector)
+    batch.push_back(std::move(buffer));
+  // start from the fetch, not the first arrival, the time already spent in
+  // the queue is not known here
+  AutoDuration ad;
+  while (batch.size() < batch_max * num && flow->enable && !flow->quit) {
+    size_t base = batch.size();
+    batch.resize(base + num);
+    if (PopBatchEntry(base))
+      continue;
+    batch.resize(base);
+    int64_t remain_us = (int64_t)batch_latency * 1000 - ad.Get();
+    if (model != Model::ASYNCCOMMON || remain_us <= 0)
+      break;
+    int key = flow->input_event.PrepareWait();
+    bool queued = false;
+    for (int idx : in_slots) {
+      if (flow->v_input[idx].Size() > 0) {
+        queued = true;
+        break;
+      }
+    }
+    if (queued)
+      flow->input_event.CancelWait();
+    else
+      flow->input_event.Wait(key, (int)((remain_us + 999) / 1000));
+  }
+}
+
+void FlowCoroutine::Schedule() {
+  AutoLockMutex _alm(state_mtx);
+  if (closed)
+    return;
+  if (pending++ == 0)
+    executor->Submit(this);
+}
+
+void FlowCoroutine::OnTick(int64_t late_us, int missed) {
+  flow->pace_late.Add(late_us);
+  state_mtx.lock();
+  // a run longer than the interval also misses the tick
+  if (pending > 0) {
+    missed++;
+  } else if (!closed) {
+    pending = 1;
+    state_mtx.notify();
+  }
+  state_mtx.unlock();
+  if (missed > 0)
+    flow->pace_missed += missed;
+}
+
+void FlowCoroutine::Execute() {
+  running_coroutine = this;
+  if (!flow->quit)
+    RunOnce();
+  running_coroutine = nullptr;
+  // Do not touch this after unlock once the last request is consumed,
+  // Stop() may return and the coroutine may be destroyed.
+  state_mtx.lock();
+  if (--pending > 0 && !closed) {
+    executor->Submit(this);
+  } else {
+    pending = 0;
+    state_mtx.notify();
+  }
+  state_mtx.unlock();
 }
 
 void FlowCoroutine::WhileRun() {
   prctl(PR_SET_NAME, this->name.c_str());
+  ApplyThreadSchedParam(sched, name.c_str());
   RKMEDIA_LOGD("flow-name %s\n", this->name.c_str());
   while (!flow->quit)
     RunOnce();
 }
 
-void FlowCoroutine::WhileRunSleep() {
-  int64_t times = 0;
-  AutoDuration ad;
-  assert(interval > 0);
+void FlowCoroutine::WhileRunPaced() {
   prctl(PR_SET_NAME, this->name.c_str());
+  ApplyThreadSchedParam(sched, name.c_str());
   RKMEDIA_LOGD("flow-name %s\n", this->name.c_str());
-
-  while (!flow->quit) {
-    if (times == 0)
-      ad.Reset();
-    RunOnce();
-    ++times;
-    int64_t remain = (interval * times - ad.Get()) / 1000;
-    if (remain > 0)
-      msleep((int)remain);
-    if (times >= 10000)
-      times = 0;
+  state_mtx.lock();
+  while (true) {
+    while (!pending && !closed)
+      state_mtx.wait();
+    if (closed)
+      break;
+    state_mtx.unlock();
+    if (!flow->quit)
+      RunOnce();
+    state_mtx.lock();
+    pending = 0;
   }
+  state_mtx.unlock();
 }
 
-void FlowCoroutine::SyncFetchInput(MediaBufferVector &in) {
+bool FlowCoroutine::SyncFetchInput(MediaBufferVector &in) {
   int i = 0;
   for (int idx : in_slots) {
     auto &buffer = flow->v_input[idx].cached_buffer;
     in[i++] = buffer;
     buffer.reset();
   }
+  return true;
 }
 
-void FlowCoroutine::ASyncFetchInputCommon(MediaBufferVector &in) {
-  flow->cond_mtx.lock();
+bool FlowCoroutine::ASyncFetchInputCommon(MediaBufferVector &in) {
+  // take the key before checking, a buffer queued after the check
+  // changes the key and the wait returns at once.
+  int key = flow->input_event.PrepareWait();
   bool empty = true;
   for (size_t i = 0; i < in_slots.size(); i++) {
     int idx = in_slots[i];
     auto &input = flow->v_input[idx];
-    auto &v = input.cached_buffers;
-    if (!v.empty())
+    if (input.Size() > 0) {
       empty = false;
+      break;
+    }
   }
 
   if (clear_buffers_enable) {
@@ -218,36 +465,30 @@ void FlowCoroutine::ASyncFetchInputCommon(MediaBufferVector &in) {
     for (size_t i = 0; i < in_slots.size(); i++) {
       int idx = in_slots[i];
       auto &input = flow->v_input[idx];
-      auto &v = input.cached_buffers;
-      v.clear();
+      input.Clear();
     }
     clear_buffers_mtx.unlock();
     empty = true;
   }
 
   if (empty && !flow->quit)
-    flow->cond_mtx.wait();
-  flow->cond_mtx.unlock();
+    flow->input_event.Wait(key);
+  else
+    flow->input_event.CancelWait();
 
   for (size_t i = 0; i < in_slots.size(); i++) {
     int idx = in_slots[i];
     auto &input = flow->v_input[idx];
-    auto &v = input.cached_buffers;
-    if (v.empty()) {
-      continue;
-    }
     if (!flow->enable) {
       in.assign(in_slots.size(), nullptr);
       break;
     }
-    AutoLockMutex _alm(input.mtx);
-    assert(!v.empty());
-    in[i] = v.front();
-    v.pop_front();
+    input.Pop(in[i]);
   }
+  return true;
 }
 
-void FlowCoroutine::ASyncFetchInputAtomic(MediaBufferVector &in) {
+bool FlowCoroutine::ASyncFetchInputAtomic(MediaBufferVector &in) {
   int i = 0;
   for (int idx : in_slots) {
     std::shared_ptr<MediaBuffer> buffer;
@@ -257,14 +498,133 @@ void FlowCoroutine::ASyncFetchInputAtomic(MediaBufferVector &in) {
     input.spin_mtx.unlock();
     in[i++] = buffer;
   }
+  return true;
+}
+
+int64_t
+FlowCoroutine::SyncTime(const std::shared_ptr<MediaBuffer> &mb) const {
+  return sync_atomic_clock ? mb->GetAtomicClock() : mb->GetUSTimeStamp();
+}
+
+bool FlowCoroutine::ASyncFetchInputSync(MediaBufferVector &in) {
+  const size_t num = in_slots.size();
+  while (true) {
+    // as ASyncFetchInputCommon, take the key before checking
+    int key = flow->input_event.PrepareWait();
+    if (clear_buffers_enable) {
+      clear_buffers_mtx.lock();
+      clear_buffers_enable = false;
+      for (size_t i = 0; i < num; i++) {
+        flow->v_input[in_slots[i]].Clear();
+        sync_heads[i].reset();
+        sync_stale[i] = false;
+      }
+      sync_since = 0;
+      clear_buffers_mtx.unlock();
+    }
+    if (flow->quit || !flow->enable) {
+      flow->input_event.CancelWait();
+      in.assign(num, nullptr);
+      return true;
+    }
+
+    size_t held = 0, stale = 0;
+    int64_t oldest = INT64_MAX, newest = INT64_MIN;
+    for (size_t i = 0; i < num; i++) {
+      auto &head = sync_heads[i];
+      if (!head)
+        flow->v_input[in_slots[i]].Pop(head);
+      if (!head) {
+        if (sync_stale[i])
+          stale++;
+        continue;
+      }
+      sync_stale[i] = false;
+      held++;
+      int64_t t = SyncTime(head);
+      oldest = std::min(oldest, t);
+      newest = std::max(newest, t);
+    }
+    if (held == 0) {
+      flow->input_event.Wait(key);
+      continue;
+    }
+    int64_t now = gettimeofday();
+    if (!sync_since)
+      sync_since = now;
+
+    if (held == num && input_sync == InputSync::PAIR &&
+        newest - oldest > sync_tolerance) {
+      // nothing queued behind can be older, so these never find a match
+      for (size_t i = 0; i < num; i++) {
+        if (SyncTime(sync_heads[i]) < newest - sync_tolerance) {
+          sync_heads[i].reset();
+          flow->v_input[in_slots[i]].counter.OnDropUnsynced();
+        }
+      }
+      sync_since = now;
+      flow->input_event.CancelWait();
+      continue;
+    }
+
+    int64_t waited = now - sync_since;
+    if (held + stale < num && waited < sync_timeout) {
+      flow->input_event.Wait(key, (int)((sync_timeout - waited + 999) / 1000));
+      continue;
+    }
+    flow->input_event.CancelWait();
+    if (held + stale < num) {
+      // an idle slot would cost every later run the whole timeout
+      flow->sync_timeouts++;
+      for (size_t i = 0; i < num; i++) {
+        if (!sync_heads[i])
+          sync_stale[i] = true;
+      }
+    }
+
+    // PAIR: all the held ones, they are within the tolerance.
+    // ORDER: the ones as old as the oldest, the others wait for their turn.
+    bool remain = false;
+    for (size_t i = 0; i < num; i++) {
+      auto &head = sync_heads[i];
+      if (head && (input_sync == InputSync::PAIR ||
+                   SyncTime(head) - oldest <= sync_tolerance))
+        in[i] = std::move(head);
+      remain |= !!head;
+    }
+    sync_since = remain ? now : 0;
+    return true;
+  }
+}
+
+bool FlowCoroutine::ASyncFetchInputPool(MediaBufferVector &in) {
+  if (clear_buffers_enable) {
+    clear_buffers_mtx.lock();
+    clear_buffers_enable = false;
+    for (int idx : in_slots)
+      flow->v_input[idx].Clear();
+    in.assign(in_slots.size(), nullptr);
+    clear_buffers_mtx.unlock();
+    return false;
+  }
+  if (!flow->enable)
+    return false;
+  // Process only once every slot has a buffer. The ones taken already stay
+  // in the vector until the others come, each input schedules another run.
+  bool ready = true;
+  for (size_t i = 0; i < in_slots.size(); i++) {
+    if (!in[i] && !flow->v_input[in_slots[i]].Pop(in[i]))
+      ready = false;
+  }
+  return ready;
 }
 
 void FlowCoroutine::SendNullBufferDown(Flow::FlowMap &fm,
                                        const MediaBufferVector &in,
-                                       std::list<Flow::FlowInputMap> &flows) {
+                                       const Flow::FlowMap::FlowList &flows) {
   std::shared_ptr<MediaBuffer> nullbuffer;
   if (fm.hold_input != HoldInputMode::NONE) {
-    auto empty_result = std::make_shared<easymedia::MediaBuffer>();
+    auto empty_result = easymedia::MakePooled<easymedia::MediaBuffer>();
     if (empty_result && OutputHoldRelated(fm, empty_result, in) > 0)
       nullbuffer = empty_result;
   }
@@ -272,24 +632,45 @@ void FlowCoroutine::SendNullBufferDown(Flow::FlowMap &fm,
     f.flow->SendInput(nullbuffer, f.index_of_in);
 }
 
+// Each consumer of a buffer sent to several gets a share of it, so that in
+// place writers copy it while another one holds it, see
+// MediaBuffer::MakeWritable. The output callback got its share in SetOutput.
+// All are taken before the first down flow may run.
+void FlowCoroutine::TakeShares(const std::shared_ptr<MediaBuffer> &buffer,
+                               size_t flow_num) {
+  shares.clear();
+  size_t consumers = flow_num + (flow->out_callback_ ? 1 : 0);
+  if (!buffer || consumers < 2)
+    return;
+  for (size_t i = 0; i < flow_num; i++)
+    shares.push_back(MediaBuffer::Share(buffer));
+}
+
 void FlowCoroutine::SendBufferDown(Flow::FlowMap &fm,
                                    const MediaBufferVector &in,
-                                   std::list<Flow::FlowInputMap> &flows,
+                                   const Flow::FlowMap::FlowList &flows,
                                    bool process_ret) {
   if (!process_ret) {
     SendNullBufferDown(fm, in, flows);
     return;
   }
+  TakeShares(fm.cached_buffer, flows.size());
+  size_t i = 0;
   for (auto &f : flows) {
     OutputHoldRelated(fm, fm.cached_buffer, in);
-    f.flow->SendInput(fm.cached_buffer, f.index_of_in);
+    if (shares.empty()) {
+      f.flow->SendInput(fm.cached_buffer, f.index_of_in);
+    } else {
+      f.flow->SendInput(shares[i], f.index_of_in);
+      shares[i++].reset();
+    }
   }
   fm.cached_buffer.reset();
 }
 
 void FlowCoroutine::SendBufferDownFromDeque(
     Flow::FlowMap &fm, const MediaBufferVector &in,
-    std::list<Flow::FlowInputMap> &flows, bool process_ret) {
+    const Flow::FlowMap::FlowList &flows, bool process_ret) {
   if (!process_ret) {
     SendNullBufferDown(fm, in, flows);
     return;
@@ -298,8 +679,16 @@ void FlowCoroutine::SendBufferDownFromDeque(
     return;
   for (auto &buffer : fm.cached_buffers) {
     OutputHoldRelated(fm, buffer, in);
-    for (auto &f : flows)
-      f.flow->SendInput(buffer, f.index_of_in);
+    TakeShares(buffer, flows.size());
+    size_t i = 0;
+    for (auto &f : flows) {
+      if (shares.empty()) {
+        f.flow->SendInput(buffer, f.index_of_in);
+      } else {
+        f.flow->SendInput(shares[i], f.index_of_in);
+        shares[i++].reset();
+      }
+    }
   }
   fm.cached_buffers.clear();
 }
@@ -321,6 +710,10 @@ int FlowCoroutine::GetCachedBufferCnt() {
     if (inv)
       cnt++;
   }
+  for (auto &head : sync_heads) {
+    if (head)
+      cnt++;
+  }
 
   return cnt;
 }
@@ -342,19 +735,25 @@ const FunctionProcess Flow::void_transaction00 = void_transaction<0, 0>;
 Flow::Flow()
     : out_slot_num(0), input_slot_num(0), down_flow_num(0),
       waite_down_flow(true), event_handler2_(nullptr), event_callback_(nullptr),
-      enable(true), quit(false), event_handler_(nullptr),
+      enable(true), quit(false), process_overrun(0), credit_control(false),
+      credit_skipped(0), accept_views(false), sync_timeouts(0), pace_missed(0),
+      event_handler_(nullptr),
       play_video_handler_(nullptr), play_audio_handler_(nullptr),
       user_handler_(nullptr), user_callback_(nullptr), out_handler_(nullptr),
-      out_callback_(nullptr), run_times(-1) {}
+      out_callback_(nullptr), run_times(-1) {
+  MemAccount::GetThreadOwner(mem_mod, mem_chn);
+}
 
 Flow::~Flow() { StopAllThread(); }
 
 void Flow::StopAllThread() {
-  cond_mtx.lock();
   enable = false;
   quit = true;
-  cond_mtx.notify();
-  cond_mtx.unlock();
+  input_event.Notify();
+  // Model::POOL coroutine is also referenced by its inputs,
+  // make sure it is not running before the child class deconstruct.
+  for (auto &coroutine : coroutines)
+    coroutine->Stop();
   for (auto &coroutine : coroutines)
     coroutine.reset();
   coroutines.clear();
@@ -366,7 +765,7 @@ bool Flow::IsAllBuffEmpty() {
 
   for (auto &input : v_input) {
     RKMEDIA_LOGI("#FLOW v_input-%d cached_buffers size:%zu\n", i,
-                 input.cached_buffers.size());
+                 input.Size());
     RKMEDIA_LOGI("#FLOW v_input-%d cached_buffer :%s\n", i++,
                  input.cached_buffer ? "NotNull" : "Null");
   }
@@ -387,7 +786,7 @@ bool Flow::IsAllBuffEmpty() {
 #endif
 
   for (auto &input : v_input) {
-    if (input.cached_buffers.size() || input.cached_buffer)
+    if (input.Size() || input.cached_buffer)
       return false;
   }
 
@@ -408,8 +807,9 @@ int Flow::GetCachedBufferNum(unsigned int &total, unsigned int &used) {
   unsigned int buf_used_cnt = 0;
   unsigned int buf_total_cnt = 0;
   for (auto &input : v_input) {
-    if (input.cached_buffers.size() > 0)
-      buf_used_cnt += input.cached_buffers.size();
+    size_t size = input.Size();
+    if (size > 0)
+      buf_used_cnt += size;
     else if (input.cached_buffer)
       buf_used_cnt += 1;
 
@@ -483,6 +883,8 @@ void Flow::DumpBase(std::string &dump_info) {
       sprintf(str_line, "    ThreadMode: ASYNCATOMIC\r\n");
     else if (input.thread_model == Model::SYNC)
       sprintf(str_line, "    ThreadMode: SYNC\r\n");
+    else if (input.thread_model == Model::POOL)
+      sprintf(str_line, "    ThreadMode: POOL\r\n");
     else
       sprintf(str_line, "    ThreadMode: NONE\r\n");
     dump_info.append(str_line);
@@ -498,8 +900,9 @@ void Flow::DumpBase(std::string &dump_info) {
     dump_info.append(str_line);
     memset(str_line, 0, sizeof(str_line));
     sprintf(str_line, "    BufferCnt: current:%zu, max:%d\r\n",
-            input.cached_buffers.size(), input.max_cache_num);
+            input.Size(), input.max_cache_num);
     dump_info.append(str_line);
+    idx++;
   }
 
   idx = 0;
@@ -515,12 +918,62 @@ void Flow::DumpBase(std::string &dump_info) {
     dump_info.append(str_line);
 
     dump_info.append("    NextFlow: ");
+    fm.list_mtx.read_lock();
     for (auto &nflow : fm.flows) {
       dump_info.append(nflow.flow->GetFlowTag());
       dump_info.append(" ");
     }
+    fm.list_mtx.unlock();
     dump_info.append("\r\n");
+    idx++;
   }
+
+  FlowStats stats;
+  GetStats(stats);
+  DumpFlowStats(stats, dump_info);
+}
+
+void Flow::GetStats(FlowStats &stats) {
+  stats.process_count = process_hist.Count();
+  stats.process_overrun = process_overrun;
+  stats.credit_skipped = credit_skipped;
+  stats.sync_timeouts = sync_timeouts;
+  stats.process_avg = process_hist.Average();
+  stats.process_p50 = process_hist.Percentile(50);
+  stats.process_p95 = process_hist.Percentile(95);
+  stats.process_p99 = process_hist.Percentile(99);
+  stats.process_max = process_hist.Max();
+  stats.pace_ticks = pace_late.Count();
+  stats.pace_missed = pace_missed;
+  stats.pace_late_p99 = pace_late.Percentile(99);
+  stats.pace_late_max = pace_late.Max();
+  stats.inputs.clear();
+  for (auto &input : v_input) {
+    auto &c = input.counter;
+    FlowInputStats in;
+    in.received = c.received;
+    in.blocked = c.blocked;
+    in.dropped_front = c.dropped_front;
+    in.dropped_current = c.dropped_current;
+    in.dropped_unsynced = c.dropped_unsynced;
+    in.depth = input.Size();
+    in.depth_hwm = c.depth_hwm;
+    in.max_cache_num = input.max_cache_num;
+    in.interval = c.last_interval;
+    in.jitter = c.jitter16 >> 4;
+    stats.inputs.push_back(in);
+  }
+}
+
+void Flow::ResetStats() {
+  process_hist.Reset();
+  process_overrun = 0;
+  credit_skipped = 0;
+  sync_timeouts = 0;
+  pace_late.Reset();
+  pace_missed = 0;
+  for (auto &input : v_input)
+    input.counter.Reset();
 }
 
 static bool check_slots(std::vector<int> &slots, const char *debugstr) {
@@ -540,17 +993,25 @@ static bool check_slots(std::vector<int> &slots, const char *debugstr) {
   return true;
 }
 
-Flow::FlowMap::FlowMap(FlowMap &&fm) {
+Flow::FlowMap::FlowMap(FlowMap &&fm)
+    : valid(false), hold_input(HoldInputMode::NONE), snapshot(nullptr),
+      readers(0), has_retired(false) {
   if (fm.valid) {
     RKMEDIA_LOGI("Flow::FlowMap is not copyable and moveable after inited\n");
     assert(0);
   }
 }
 
+Flow::FlowMap::~FlowMap() {
+  delete snapshot.load();
+  for (auto list : retired)
+    delete list;
+}
+
 void Flow::FlowMap::Init(Model m, HoldInputMode hold_in) {
   assert(!valid);
   valid = true;
-  if (m == Model::ASYNCCOMMON)
+  if (m == Model::ASYNCCOMMON || m == Model::POOL)
     set_output_behavior = &FlowMap::SetOutputToQueueBehavior;
   else
     set_output_behavior = &FlowMap::SetOutputBehavior;
@@ -593,24 +1054,73 @@ void Flow::Input::Init(Flow *f, Model m, int mcn, InputMode im, bool f_block,
     send_input_behavior = &Input::SyncSendInputBehavior;
     coroutine = fc;
     break;
+  case Model::POOL:
+    send_input_behavior = &Input::ASyncSendInputPoolBehavior;
+    coroutine = fc;
+    break;
   default:
     break;
   }
+  if ((m == Model::ASYNCCOMMON || m == Model::POOL) && mcn > 0)
+    ring.reset(new RingQueue<std::shared_ptr<MediaBuffer>>(mcn));
   switch (im) {
   case InputMode::BLOCKING:
-    async_full_behavior = &Input::ASyncFullBlockingBehavior;
+    async_full_behavior = ring ? &Input::RingFullBlockingBehavior
+                               : &Input::ASyncFullBlockingBehavior;
     break;
   case InputMode::DROPFRONT:
-    async_full_behavior = &Input::ASyncFullDropFrontBehavior;
+    async_full_behavior = ring ? &Input::RingFullDropFrontBehavior
+                               : &Input::ASyncFullDropFrontBehavior;
     break;
   case InputMode::DROPCURRENT:
-    async_full_behavior = &Input::ASyncFullDropCurrentBehavior;
+    async_full_behavior = ring ? &Input::RingFullDropCurrentBehavior
+                               : &Input::ASyncFullDropCurrentBehavior;
     break;
   default:
     break;
   }
 }
 
+bool Flow::Input::Pop(std::shared_ptr<MediaBuffer> &output) {
+  if (ring) {
+    if (!ring->TryPop(output))
+      return false;
+    space_event.Notify();
+    return true;
+  }
+  AutoLockMutex _alm(mtx);
+  if (cached_buffers.empty())
+    return false;
+  output = cached_buffers.front();
+  cached_buffers.pop_front();
+  return true;
+}
+
+size_t Flow::Input::Size() {
+  if (ring)
+    return ring->Size();
+  AutoLockMutex _alm(mtx);
+  return cached_buffers.size();
+}
+
+bool Flow::Input::HasRoom() {
+  if (thread_model != Model::ASYNCCOMMON && thread_model != Model::POOL)
+    return true;
+  return max_cache_num <= 0 || (int)Size() < max_cache_num;
+}
+
+void Flow::Input::Clear() {
+  if (ring) {
+    std::shared_ptr<MediaBuffer> buffer;
+    while (ring->TryPop(buffer))
+      buffer.reset();
+    space_event.Notify();
+    return;
+  }
+  AutoLockMutex _alm(mtx);
+  cached_buffers.clear();
+}
+
 bool Flow::SetAsSource(const std::vector<int> &output_slots, FunctionProcess f,
                        const std::string &mark) {
   source_start_cond_mtx = std::make_shared<ConditionLockMutex>();
@@ -679,15 +1189,13 @@ bool Flow::InstallSlotMap(SlotMap &map, const std::string &mark,
     int max_idx = in_slots[in_slots.size() - 1];
     if ((int)v_input.size() <= max_idx)
       v_input.resize(max_idx + 1);
+    bool queued = (map.thread_model == Model::ASYNCCOMMON ||
+                   map.thread_model == Model::POOL);
     for (size_t i = 0; i < in_slots.size(); i++) {
       v_input[in_slots[i]].Init(
-          this, map.thread_model,
-          (map.thread_model == Model::ASYNCCOMMON) ? map.input_maxcachenum[i]
-                                                   : 0,
+          this, map.thread_model, queued ? map.input_maxcachenum[i] : 0,
           map.mode_when_full,
-          (map.thread_model == Model::ASYNCCOMMON && map.fetch_block.size() > i)
-              ? map.fetch_block[i]
-              : true,
+          (queued && map.fetch_block.size() > i) ? map.fetch_block[i] : true,
           c);
       input_slot_num++;
     }
@@ -706,25 +1214,111 @@ bool Flow::InstallSlotMap(SlotMap &map, const std::string &mark,
 
   c->SetMarkName(mark);
   c->SetExpectProcessTime(exp_process_time);
+  if (!map.sched.Empty() && map.thread_model != Model::ASYNCCOMMON &&
+      map.thread_model != Model::ASYNCATOMIC)
+    RKMEDIA_LOGW("%s: thread scheduling params need asynccommon or "
+                 "asyncatomic, ignore\n",
+                 mark.c_str());
+  c->SetSchedParam(map.sched);
+  if (map.input_sync != InputSync::NONE) {
+    if (map.thread_model == Model::ASYNCCOMMON && in_slots.size() > 1)
+      c->SetInputSync(map.input_sync, map.sync_tolerance, map.sync_timeout,
+                      map.sync_atomic_clock);
+    else
+      RKMEDIA_LOGW("%s: input sync needs asynccommon and several inputs, "
+                   "ignore\n",
+                   mark.c_str());
+  }
+  if (map.batch_process) {
+    bool holding = false;
+    for (auto mode : map.hold_input)
+      holding |= (mode != HoldInputMode::NONE);
+    if ((map.thread_model == Model::ASYNCCOMMON ||
+         map.thread_model == Model::POOL) &&
+        !holding)
+      c->SetBatch(map.batch_process, map.batch_max, map.batch_latency);
+    else
+      RKMEDIA_LOGW("%s: batch process needs asynccommon or asyncpool, and no "
+                   "output holding input, ignore\n",
+                   mark.c_str());
+  }
   c->Start();
   return true;
 }
 
 void Flow::FlowMap::AddFlow(std::shared_ptr<Flow> flow, int index) {
-  AutoLockMutex _lg(list_mtx);
+  list_mtx.lock();
   auto i = std::find(flows.begin(), flows.end(), flow);
   if (i != flows.end()) {
     RKMEDIA_LOGI("repeatedly add, update index\n");
     i->index_of_in = index;
-    return;
+  } else {
+    // TODO: sort by sync type in downflow
+    flows.emplace_back(flow, index);
   }
-  // TODO: sort by sync type in downflow
-  flows.emplace_back(flow, index);
+  PublishFlows();
+  list_mtx.unlock();
+  ReclaimFlows();
 }
 
 void Flow::FlowMap::RemoveFlow(std::shared_ptr<Flow> flow) {
-  AutoLockMutex _lg(list_mtx);
+  list_mtx.lock();
   flows.remove_if([&flow](FlowInputMap &fm) { return fm == flow; });
+  PublishFlows();
+  list_mtx.unlock();
+  ReclaimFlows();
+}
+
+void Flow::FlowMap::PublishFlows() {
+  FlowList *list = new FlowList(flows.begin(), flows.end());
+  const FlowList *old = snapshot.exchange(list);
+  std::lock_guard<std::mutex> lg(retired_mtx);
+  retired.push_back(old);
+  has_retired.store(true, std::memory_order_release);
+}
+
+bool Flow::FlowMap::FreeRetired(bool block) {
+  std::unique_lock<std::mutex> lk(retired_mtx, std::defer_lock);
+  if (block)
+    lk.lock();
+  else if (!lk.try_lock())
+    return false;
+  // Nothing is retired while retired_mtx is locked, so if there is no
+  // reader, none of them can hold a retired list.
+  if (readers.load() != 0)
+    return false;
+  std::vector<const FlowList *> lists;
+  lists.swap(retired);
+  has_retired.store(false, std::memory_order_relaxed);
+  lk.unlock();
+  // may release the last reference to a removed flow, out of the lock
+  for (auto old : lists)
+    delete old;
+  return true;
+}
+
+void Flow::FlowMap::ReclaimFlows() {
+  // Readers which come now get the new list. The old ones are at most in the
+  // middle of sending one frame, wait for them so that a removed flow is
+  // released here as before, unless we are called from a reader itself.
+  AutoDuration ad;
+  while (true) {
+    int key = readers_event.PrepareWait();
+    if (readers.load() == 0) {
+      readers_event.CancelWait();
+      if (FreeRetired(true))
+        return;
+      continue;
+    }
+    int64_t remain = 200000 - ad.Get();
+    if (remain <= 0) {
+      readers_event.CancelWait();
+      RKMEDIA_LOGI("FlowMap: old down flow list is still in use, its last "
+                   "reader will release it\n");
+      return;
+    }
+    readers_event.Wait(key, (int)((remain + 999) / 1000));
+  }
 }
 
 bool Flow::AddDownFlow(std::shared_ptr<Flow> down, int out_slot_index,
@@ -769,6 +1363,41 @@ void Flow::RemoveDownFlow(std::shared_ptr<Flow> down) {
   }
 }
 
+bool Flow::HasCredit(int in_slot_index) {
+  if (in_slot_index < 0 || in_slot_index >= input_slot_num)
+    return false;
+  if (!enable || !v_input[in_slot_index].HasRoom())
+    return false;
+  return credit_control ? HasDownCredit() : true;
+}
+
+bool Flow::HasDownCredit() {
+  // the output callback always takes the buffers
+  if (out_callback_)
+    return true;
+  bool has_down = false;
+  for (auto &fm : downflowmap) {
+    if (!fm.valid)
+      continue;
+    bool credit = false;
+    const FlowMap::FlowList *flows = fm.AcquireFlows();
+    if (flows) {
+      for (auto &f : *flows) {
+        has_down = true;
+        if (f.flow->HasCredit(f.index_of_in)) {
+          credit = true;
+          break;
+        }
+      }
+    }
+    fm.ReleaseFlows();
+    if (credit)
+      return true;
+  }
+  // nobody to throttle us
+  return !has_down;
+}
+
 void Flow::SendInput(std::shared_ptr<MediaBuffer> &input, int in_slot_index) {
   if (in_slot_index < 0 || in_slot_index >= input_slot_num) {
     errno = EINVAL;
@@ -777,6 +1406,18 @@ void Flow::SendInput(std::shared_ptr<MediaBuffer> &input, int in_slot_index) {
   }
   if (enable) {
     auto &in = v_input[in_slot_index];
+    in.counter.OnArrival(gettimeofday());
+    if (input && BufferTracker::IsEnabled())
+      BufferTracker::SetHolder(input->GetPtr(), GetFlowTag(), mem_mod,
+                               mem_chn);
+    if (input && input->HasOrigin() && !accept_views) {
+      // it would read the image from GetPtr(), not from the origin
+      auto plain = ImageBuffer::Materialize(input);
+      if (!plain)
+        return;
+      CALL_MEMBER_FN(in, in.send_input_behavior)(plain);
+      return;
+    }
     CALL_MEMBER_FN(in, in.send_input_behavior)(input);
   }
 }
@@ -789,8 +1430,9 @@ bool Flow::SetOutput(const std::shared_ptr<MediaBuffer> &output,
     return false;
   }
 
+  // a share, the down flows may write into the buffer while it is held
   if (out_callback_ && output)
-    out_callback_(out_handler_, output);
+    out_callback_(out_handler_, MediaBuffer::Share(output));
 
   if (enable) {
     auto &out = downflowmap[out_slot_index];
@@ -809,6 +1451,8 @@ bool Flow::ParseWrapFlowParams(const char *param,
   if (!parse_media_param_map(sub_param_list.front().c_str(), flow_params))
     return false;
   sub_param_list.pop_front();
+  if (flow_params[KEY_FLOW_CONTROL] == KEY_CREDIT)
+    credit_control = true;
   if (flow_params[KEY_NAME].empty()) {
     RKMEDIA_LOGI("missing key name\n");
     return false;
@@ -870,23 +1514,44 @@ void Flow::Input::SyncSendInputBehavior(std::shared_ptr<MediaBuffer> &input) {
   cached_buffer.reset();
 }
 
-void Flow::Input::ASyncSendInputCommonBehavior(
-    std::shared_ptr<MediaBuffer> &input) {
+bool Flow::Input::Enqueue(std::shared_ptr<MediaBuffer> &input) {
+  if (ring) {
+    while (!ring->TryPush(input)) {
+      if (!(this->*async_full_behavior)(flow->enable))
+        return false;
+    }
+    counter.OnQueued(ring->Size());
+    return true;
+  }
   mtx.lock();
   if (max_cache_num > 0 && max_cache_num <= (int)cached_buffers.size()) {
     bool ret = (this->*async_full_behavior)(flow->enable);
     if (!ret) {
       mtx.unlock();
-      return;
+      return false;
     }
   }
   cached_buffers.push_back(input);
+  counter.OnQueued(cached_buffers.size());
   mtx.unlock();
-  AutoLockMutex _alm(flow->cond_mtx);
-  flow->cond_mtx.notify();
+  return true;
+}
+
+void Flow::Input::ASyncSendInputCommonBehavior(
+    std::shared_ptr<MediaBuffer> &input) {
+  if (!Enqueue(input))
+    return;
+  flow->input_event.Notify();
   pthread_yield();
 }
 
+void Flow::Input::ASyncSendInputPoolBehavior(
+    std::shared_ptr<MediaBuffer> &input) {
+  if (!Enqueue(input))
+    return;
+  coroutine->Schedule();
+}
+
 void Flow::Input::ASyncSendInputAtomicBehavior(
     std::shared_ptr<MediaBuffer> &input) {
   AutoLockMutex _alm(spin_mtx);
@@ -897,6 +1562,7 @@ bool Flow::Input::ASyncFullBlockingBehavior(volatile bool &pred) {
 #ifndef NDEBUG
   AutoDuration ad;
 #endif
+  counter.OnBlocked();
   do {
     mtx.unlock();
     msleep(5);
@@ -918,12 +1584,53 @@ bool Flow::Input::ASyncFullDropFrontBehavior(volatile bool &pred _UNUSED) {
   RKMEDIA_LOGW("Flow[%s]: Input: drop front buffer!\n",
                flow ? flow->GetFlowTag() : "Name is null");
   cached_buffers.pop_front();
+  counter.OnDropFront();
   return true;
 }
 
 bool Flow::Input::ASyncFullDropCurrentBehavior(volatile bool &pred _UNUSED) {
   RKMEDIA_LOGW("Flow[%s]: Input: drop current buffer!\n",
                flow ? flow->GetFlowTag() : "Name Is Null");
+  counter.OnDropCurrent();
+  return false;
+}
+
+bool Flow::Input::RingFullBlockingBehavior(volatile bool &pred) {
+#ifndef NDEBUG
+  AutoDuration ad;
+#endif
+  counter.OnBlocked();
+  while (pred) {
+    int key = space_event.PrepareWait();
+    if (ring->Size() < ring->Capacity()) {
+      space_event.CancelWait();
+      break;
+    }
+    // nobody signals when pred changes, so never sleep too long at once
+    space_event.Wait(key, 5);
+  }
+#ifndef NDEBUG
+  if (ad.Get() > 100000 /*ms*/)
+    RKMEDIA_LOGW("Flow[%s]: Input[block mode]: block too long(%.2fms) > 5ms\n",
+                 flow ? flow->GetFlowTag() : "Name is null", ad.Get() / 1000.0);
+#endif
+  return pred;
+}
+
+bool Flow::Input::RingFullDropFrontBehavior(volatile bool &pred _UNUSED) {
+  std::shared_ptr<MediaBuffer> front;
+  RKMEDIA_LOGW("Flow[%s]: Input: drop front buffer!\n",
+               flow ? flow->GetFlowTag() : "Name is null");
+  // may be empty if the consumer just took it, the push is retried anyway
+  if (ring->TryPop(front))
+    counter.OnDropFront();
+  return true;
+}
+
+bool Flow::Input::RingFullDropCurrentBehavior(volatile bool &pred _UNUSED) {
+  RKMEDIA_LOGW("Flow[%s]: Input: drop current buffer!\n",
+               flow ? flow->GetFlowTag() : "Name Is Null");
+  counter.OnDropCurrent();
   return false;
 }
 
@@ -941,7 +1648,8 @@ Model GetModelByString(const std::string &model) {
   static std::map<std::string, Model> model_map = {
       {KEY_ASYNCCOMMON, Model::ASYNCCOMMON},
       {KEY_ASYNCATOMIC, Model::ASYNCATOMIC},
-      {KEY_SYNC, Model::SYNC}};
+      {KEY_SYNC, Model::SYNC},
+      {KEY_ASYNCPOOL, Model::POOL}};
   auto it = model_map.find(model);
   if (it != model_map.end())
     return it->second;
@@ -959,25 +1667,157 @@ InputMode GetInputModelByString(const std::string &in_model) {
   return InputMode::NONE;
 }
 
-void ParseParamToSlotMap(std::map<std::string, std::string> &params,
+// The whole string must be a number within [min, max].
+static bool parse_int_param(const std::string &key, const std::string &str,
+                            int min, int max, int &value) {
+  char *end = nullptr;
+  errno = 0;
+  long v = strtol(str.c_str(), &end, 0);
+  if (str.empty() || errno || *end || v < min || v > max) {
+    RKMEDIA_LOGE("invalid %s: \"%s\", expect %d ~ %d\n", key.c_str(),
+                 str.c_str(), min, max);
+    return false;
+  }
+  value = (int)v;
+  return true;
+}
+
+bool ParseParamToSlotMap(std::map<std::string, std::string> &params,
                          SlotMap &sm, int &input_maxcachenum) {
-  float fps = 0.0f;
   std::string &fps_str = params[KEY_FPS];
   if (!fps_str.empty()) {
-    fps = std::stof(fps_str);
+    char *end = nullptr;
+    float fps = strtof(fps_str.c_str(), &end);
+    if (*end) {
+      RKMEDIA_LOGE("invalid %s: \"%s\"\n", KEY_FPS, fps_str.c_str());
+      return false;
+    }
     if (fps > 0.0f)
       sm.interval = 1000.0f / fps;
   }
   sm.thread_model = GetModelByString(params[KEK_THREAD_SYNC_MODEL]);
   sm.mode_when_full = GetInputModelByString(params[KEK_INPUT_MODEL]);
+  if (!ParseThreadSchedParam(params, sm.sched) || !ParseBatchParam(params, sm) ||
+      !ParseInputSyncParam(params, sm))
+    return false;
   std::string &cache_num_str = params[KEY_INPUT_CACHE_NUM];
   int cache_num = -1;
   if (!cache_num_str.empty()) {
-    cache_num = std::stoi(cache_num_str);
+    if (!parse_int_param(KEY_INPUT_CACHE_NUM, cache_num_str, INT_MIN, INT_MAX,
+                         cache_num))
+      return false;
     if (cache_num <= 0)
       RKMEDIA_LOGW("input cache num = %d\n", cache_num);
     input_maxcachenum = cache_num;
   }
+  return true;
+}
+
+bool ParseThreadSchedParam(std::map<std::string, std::string> &params,
+                           ThreadSchedParam &sched) {
+  const std::string &mask = params[KEY_CPU_AFFINITY];
+  if (!mask.empty()) {
+    char *end = nullptr;
+    errno = 0;
+    sched.cpu_mask = strtoull(mask.c_str(), &end, 0);
+    if (errno || *end) {
+      RKMEDIA_LOGE("invalid %s: \"%s\"\n", KEY_CPU_AFFINITY, mask.c_str());
+      return false;
+    }
+  }
+  const std::string &policy = params[KEY_SCHED_POLICY];
+  if (policy == KEY_SCHED_OTHER)
+    sched.policy = SCHED_OTHER;
+  else if (policy == KEY_SCHED_FIFO)
+    sched.policy = SCHED_FIFO;
+  else if (policy == KEY_SCHED_RR)
+    sched.policy = SCHED_RR;
+  else if (!policy.empty())
+    RKMEDIA_LOGW("unknown sched policy %s\n", policy.c_str());
+  const std::string &priority = params[KEY_SCHED_PRIORITY];
+  if (!priority.empty() &&
+      !parse_int_param(KEY_SCHED_PRIORITY, priority, 0, 99, sched.priority))
+    return false;
+  const std::string &nice = params[KEY_SCHED_NICE];
+  if (!nice.empty() &&
+      !parse_int_param(KEY_SCHED_NICE, nice, -20, 19, sched.nice))
+    return false;
+  return true;
+}
+
+bool ParseBatchParam(std::map<std::string, std::string> &params,
+                     SlotMap &sm) {
+  const std::string &max_num = params[KEY_BATCH_MAX];
+  if (!max_num.empty() &&
+      !parse_int_param(KEY_BATCH_MAX, max_num, 0, INT_MAX, sm.batch_max))
+    return false;
+  const std::string &latency = params[KEY_BATCH_LATENCY];
+  if (!latency.empty() &&
+      !parse_int_param(KEY_BATCH_LATENCY, latency, 0, INT_MAX,
+                       sm.batch_latency))
+    return false;
+  return true;
+}
+
+bool ParseInputSyncParam(std::map<std::string, std::string> &params,
+                         SlotMap &sm) {
+  const std::string &sync = params[KEY_INPUT_SYNC];
+  if (sync == KEY_SYNC_PAIR)
+    sm.input_sync = InputSync::PAIR;
+  else if (sync == KEY_SYNC_ORDER)
+    sm.input_sync = InputSync::ORDER;
+  else if (!sync.empty())
+    RKMEDIA_LOGW("unknown input sync %s\n", sync.c_str());
+  const std::string &tolerance = params[KEY_SYNC_TOLERANCE];
+  if (!tolerance.empty() &&
+      !parse_int_param(KEY_SYNC_TOLERANCE, tolerance, 0, INT_MAX,
+                       sm.sync_tolerance))
+    return false;
+  const std::string &timeout = params[KEY_SYNC_TIMEOUT];
+  if (!timeout.empty() &&
+      !parse_int_param(KEY_SYNC_TIMEOUT, timeout, 0, INT_MAX, sm.sync_timeout))
+    return false;
+  const std::string &clock = params[KEY_SYNC_CLOCK];
+  if (clock == KEY_SYNC_ATOMIC_CLOCK)
+    sm.sync_atomic_clock = true;
+  else if (clock == KEY_SYNC_TIMESTAMP)
+    sm.sync_atomic_clock = false;
+  else if (!clock.empty())
+    RKMEDIA_LOGW("unknown sync clock %s\n", clock.c_str());
+  return true;
+}
+
+void ApplyThreadSchedParam(const ThreadSchedParam &sched, const char *name) {
+  if (sched.cpu_mask) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+      if (sched.cpu_mask & (1ULL << i))
+        CPU_SET(i, &set);
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret)
+      RKMEDIA_LOGW("%s: set cpu affinity 0x%llx failed, %s\n", name,
+                   (unsigned long long)sched.cpu_mask, strerror(ret));
+  }
+  if (sched.policy >= 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (sched.policy != SCHED_OTHER) {
+      int min = sched_get_priority_min(sched.policy);
+      int max = sched_get_priority_max(sched.policy);
+      param.sched_priority = std::min(std::max(sched.priority, min), max);
+    }
+    int ret = pthread_setschedparam(pthread_self(), sched.policy, &param);
+    if (ret)
+      RKMEDIA_LOGW("%s: set sched policy %d priority %d failed, %s\n", name,
+                   sched.policy, param.sched_priority, strerror(ret));
+  }
+  // the nice value is per thread on linux
+  if (sched.nice &&
+      setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), sched.nice))
+    RKMEDIA_LOGW("%s: set nice %d failed, %s\n", name, sched.nice,
+                 strerror(errno));
 }
 
 size_t FlowOutputHoldInput(std::shared_ptr<MediaBuffer> &out_buffer,
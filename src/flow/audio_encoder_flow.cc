@@ -18,6 +18,7 @@
 namespace easymedia {
 
 static bool encode(Flow *f, MediaBufferVector &input_vector);
+static bool encode_batch(Flow *f, MediaBufferVector &batch);
 
 class AudioEncoderFlow : public Flow {
 public:
@@ -33,17 +34,31 @@ private:
   std::shared_ptr<AudioEncoder> enc;
   int input_size;
 
+  bool EncodeFrame(std::shared_ptr<MediaBuffer> &src);
+
   friend bool encode(Flow *f, MediaBufferVector &input_vector);
+  friend bool encode_batch(Flow *f, MediaBufferVector &batch);
 };
 
 bool encode(Flow *f, MediaBufferVector &input_vector) {
   AudioEncoderFlow *af = (AudioEncoderFlow *)f;
-  std::shared_ptr<AudioEncoder> enc = af->enc;
-  std::shared_ptr<MediaBuffer> &src = input_vector[0];
+  return af->EncodeFrame(input_vector[0]);
+}
+
+// one input slot, so the batch is just the frames in order
+bool encode_batch(Flow *f, MediaBufferVector &batch) {
+  AudioEncoderFlow *af = (AudioEncoderFlow *)f;
+  bool result = false;
+  for (auto &src : batch)
+    result |= af->EncodeFrame(src);
+  return result;
+}
+
+bool AudioEncoderFlow::EncodeFrame(std::shared_ptr<MediaBuffer> &src) {
   std::shared_ptr<MediaBuffer> dst;
   bool result = true;
   bool feed_null = false;
-  size_t limit_size = af->input_size;
+  size_t limit_size = input_size;
 
   if (!src)
     return false;
@@ -98,7 +113,7 @@ bool encode(Flow *f, MediaBufferVector &input_vector) {
     if (out_len == 0)
       break;
     RKMEDIA_LOGD("[Audio]: frame encoded, out %d bytes\n\n", (int)out_len);
-    result = af->SetOutput(dst, 0);
+    result = SetOutput(dst, 0);
     if (!result)
       break;
   }
@@ -169,7 +184,17 @@ AudioEncoderFlow::AudioEncoderFlow(const char *param) {
   sm.output_slots.push_back(0);
 
   sm.process = encode;
+  // drain the frames queued meanwhile in one wakeup, without waiting for more
+  sm.batch_process = encode_batch;
+  sm.batch_max = 4;
+  if (!ParseBatchParam(params, sm)) {
+    SetError(-EINVAL);
+    return;
+  }
   sm.thread_model = Model::ASYNCCOMMON;
+  // encoder may share the executor instead of owning a thread
+  if (GetModelByString(params[KEK_THREAD_SYNC_MODEL]) == Model::POOL)
+    sm.thread_model = Model::POOL;
   sm.mode_when_full = InputMode::DROPFRONT;
   sm.input_maxcachenum.push_back(3);
   if (!InstallSlotMap(sm, "AudioEncoderFlow", 40)) {
@@ -56,7 +56,10 @@ VideoDecoderFlow::VideoDecoderFlow(const char *param)
   }
   SlotMap sm;
   int input_maxcachenum = 2;
-  ParseParamToSlotMap(params, sm, input_maxcachenum);
+  if (!ParseParamToSlotMap(params, sm, input_maxcachenum)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (sm.thread_model == Model::NONE)
     sm.thread_model = Model::ASYNCCOMMON;
   thread_model = sm.thread_model;
@@ -127,7 +130,7 @@ bool do_decode(Flow *f, MediaBufferVector &input_vector) {
         break;
     } while (true);
   } else {
-    output = std::make_shared<ImageBuffer>();
+    output = MakePooled<ImageBuffer>();
     if (decoder->Process(in, output))
       return false;
     ret = flow->SetOutput(output, 0);
@@ -6,6 +6,7 @@
 
 #include "buffer.h"
 #include "flow.h"
+#include "mem_account.h"
 #include "stream.h"
 #include "utils.h"
 
@@ -23,6 +24,7 @@ private:
   std::shared_ptr<Stream> fstream;
   std::string path;
   MediaBuffer::MemType mtype;
+  unsigned int mflag;
   size_t read_size;
   ImageInfo info;
   int fps;
@@ -32,8 +34,8 @@ private:
 };
 
 FileReadFlow::FileReadFlow(const char *param)
-    : mtype(MediaBuffer::MemType::MEM_COMMON), read_size(0), fps(0),
-      loop_time(0), loop(false), read_thread(nullptr) {
+    : mtype(MediaBuffer::MemType::MEM_COMMON), mflag(ROCKCHIP_BO_CACHABLE),
+      read_size(0), fps(0), loop_time(0), loop(false), read_thread(nullptr) {
   memset(&info, 0, sizeof(info));
   info.pix_fmt = PIX_FMT_NONE;
   std::map<std::string, std::string> params;
@@ -57,6 +59,9 @@ FileReadFlow::FileReadFlow(const char *param)
   value = params[KEY_MEM_TYPE];
   if (!value.empty())
     mtype = StringToMemType(value.c_str());
+  value = params[KEY_MEM_HUGE_PAGE];
+  if (!value.empty() && std::stoi(value))
+    mflag |= MEM_FLAG_HUGE_PAGE;
   value = params[KEY_MEM_SIZE_PERTIME];
   if (value.empty()) {
     if (!ParseImageInfoFromMap(params, info)) {
@@ -105,6 +110,9 @@ void FileReadFlow::ReadThreadRun() {
     source_start_cond_mtx->wait();
   source_start_cond_mtx->unlock();
   AutoPrintLine apl(__func__);
+  int mod, chn;
+  GetMemOwner(mod, chn);
+  MemAccount::SetThreadOwner(mod, chn);
   size_t alloc_size = read_size;
   bool is_image = (info.pix_fmt != PIX_FMT_NONE);
   if (!alloc_size && is_image) {
@@ -119,13 +127,13 @@ void FileReadFlow::ReadThreadRun() {
         break;
       }
     }
-    auto buffer = MediaBuffer::Alloc(alloc_size, mtype);
+    auto buffer = MediaBuffer::Alloc(alloc_size, mtype, mflag);
     if (!buffer) {
       LOG_NO_MEMORY();
       continue;
     }
     if (is_image) {
-      auto imagebuffer = std::make_shared<ImageBuffer>(*(buffer.get()), info);
+      auto imagebuffer = MakePooled<ImageBuffer>(*(buffer.get()), info);
       if (!imagebuffer) {
         LOG_NO_MEMORY();
         continue;
@@ -73,7 +73,10 @@ FilterFlow::FilterFlow(const char *param)
   input_pix_fmt = StringToPixFmt(params[KEY_INPUTDATATYPE].c_str());
   SlotMap sm;
   int input_maxcachenum = 2;
-  ParseParamToSlotMap(params, sm, input_maxcachenum);
+  if (!ParseParamToSlotMap(params, sm, input_maxcachenum)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (sm.thread_model == Model::NONE)
     sm.thread_model =
         !params[KEY_FPS].empty() ? Model::ASYNCATOMIC : Model::SYNC;
@@ -95,6 +98,10 @@ FilterFlow::FilterFlow(const char *param)
     sm.input_maxcachenum.push_back(input_maxcachenum);
   }
   sm.output_slots.push_back(0);
+  bool views = true;
+  for (auto &filter : filters)
+    views = views && filter->AcceptImageViews();
+  SetAcceptImageViews(views);
   auto &hold = params[KEY_OUTPUT_HOLD_INPUT];
   if (!hold.empty())
     sm.hold_input.push_back((HoldInputMode)std::stoi(hold));
@@ -135,8 +142,29 @@ FilterFlow::FilterFlow(const char *param)
       }
       size_t m_size = CalPixFmtSize(out_img_info);
       MediaBuffer::MemType m_type = StringToMemType(mem_type.c_str());
+      const std::string &huge_page = params[KEY_MEM_HUGE_PAGE];
+      unsigned int m_flag = ROCKCHIP_BO_CACHABLE;
+      if (!huge_page.empty() && std::stoi(huge_page))
+        m_flag |= MEM_FLAG_HUGE_PAGE;
 
-      buffer_pool = std::make_shared<BufferPool>(m_cnt, m_size, m_type);
+      const std::string &max_cnt = params[KEY_MEM_MAX_CNT];
+      int m_max_cnt = max_cnt.empty() ? m_cnt : std::stoi(max_cnt);
+      if (m_max_cnt > m_cnt) {
+        const std::string &idle_ms = params[KEY_MEM_IDLE_MS];
+        const std::string &grow_ms = params[KEY_MEM_GROW_MS];
+        BufferPoolParam bp_param;
+        bp_param.min_cnt = m_cnt;
+        bp_param.max_cnt = m_max_cnt;
+        bp_param.low_watermark = 0;
+        bp_param.high_watermark = m_cnt;
+        bp_param.idle_ms = idle_ms.empty() ? 3000 : std::stoi(idle_ms);
+        bp_param.grow_ms = grow_ms.empty() ? 0 : std::stoi(grow_ms);
+        buffer_pool =
+            std::make_shared<BufferPool>(bp_param, m_size, m_type, m_flag);
+      } else {
+        buffer_pool =
+            std::make_shared<BufferPool>(m_cnt, m_size, m_type, m_flag);
+      }
     }
   } else {
     // support async mode (one input, multi output)
@@ -145,7 +173,7 @@ FilterFlow::FilterFlow(const char *param)
   }
 }
 
-// comparing timestamp as modification?
+// The inputs are aligned in time only if input_sync is set in the params.
 bool do_filters(Flow *f, MediaBufferVector &input_vector) {
   FilterFlow *flow = static_cast<FilterFlow *>(f);
   int i = 0;
@@ -164,7 +192,7 @@ bool do_filters(Flow *f, MediaBufferVector &input_vector) {
   if (!flow->support_async) {
     const auto &info = flow->out_img_info;
     if (info.pix_fmt == PIX_FMT_NONE) {
-      out_buffer = std::make_shared<MediaBuffer>();
+      out_buffer = MakePooled<MediaBuffer>();
     } else {
       if (info.vir_width > 0 && info.vir_height > 0) {
         if (flow->buffer_pool) {
@@ -174,15 +202,15 @@ bool do_filters(Flow *f, MediaBufferVector &input_vector) {
                          flow->GetFlowTag());
             return false;
           }
-          out_buffer = std::make_shared<ImageBuffer>(*(mb.get()), info);
+          out_buffer = MakePooled<ImageBuffer>(*(mb.get()), info);
         } else {
           size_t size = CalPixFmtSize(info);
           auto &&mb =
               MediaBuffer::Alloc2(size, MediaBuffer::MemType::MEM_HARD_WARE);
-          out_buffer = std::make_shared<ImageBuffer>(mb, info);
+          out_buffer = MakePooled<ImageBuffer>(mb, info);
         }
       } else {
-        auto ib = std::make_shared<ImageBuffer>();
+        auto ib = MakePooled<ImageBuffer>();
         if (ib) {
           ib->GetImageInfo().pix_fmt = info.pix_fmt;
           out_buffer = ib;
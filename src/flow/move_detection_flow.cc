@@ -422,6 +422,10 @@ MoveDetectionFlow::MoveDetectionFlow(const char *param) {
   sm.thread_model = Model::ASYNCCOMMON;
   sm.mode_when_full = InputMode::DROPFRONT;
   sm.input_maxcachenum.push_back(3);
+  if (!ParseThreadSchedParam(params, sm.sched)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (!InstallSlotMap(sm, "MDFlow", 20)) {
     RKMEDIA_LOGI("Fail to InstallSlotMap for MDFlow\n");
     SetError(-EINVAL);
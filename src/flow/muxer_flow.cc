@@ -160,6 +160,14 @@ MuxerFlow::MuxerFlow(const char *param)
   sm.fetch_block.push_back(false);
   sm.fetch_block.push_back(false);
   sm.process = save_buffer;
+  // input_sync=order writes audio and video interleaved in time, it only
+  // makes sense when both streams come in.
+  if (!ParseInputSyncParam(params, sm)) {
+    SetError(-EINVAL);
+    return;
+  }
+  if (!video_in || !audio_in)
+    sm.input_sync = InputSync::NONE;
 
   if (!InstallSlotMap(sm, "MuxerFlow", 0)) {
     RKMEDIA_LOGI("Fail to InstallSlotMap for MuxerFlow\n");
@@ -349,6 +349,10 @@ OcclusionDetectionFlow::OcclusionDetectionFlow(const char *param) {
   sm.thread_model = Model::ASYNCCOMMON;
   sm.mode_when_full = InputMode::DROPFRONT;
   sm.input_maxcachenum.push_back(3);
+  if (!ParseThreadSchedParam(params, sm.sched)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (!InstallSlotMap(sm, "ODFlow", 20)) {
     RKMEDIA_LOGI("Fail to InstallSlotMap for ODFlow\n");
     SetError(-EINVAL);
@@ -43,7 +43,10 @@ OutPutStreamFlow::OutPutStreamFlow(const char *param) {
   const char *stream_name = name.c_str();
   SlotMap sm;
   int input_maxcachenum = 10;
-  ParseParamToSlotMap(params, sm, input_maxcachenum);
+  if (!ParseParamToSlotMap(params, sm, input_maxcachenum)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (sm.thread_model == Model::NONE)
     sm.thread_model =
         !params[KEY_FPS].empty() ? Model::ASYNCATOMIC : Model::ASYNCCOMMON;
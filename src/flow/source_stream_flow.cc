@@ -5,6 +5,7 @@
 
 #include "buffer.h"
 #include "flow.h"
+#include "mem_account.h"
 #include "stream.h"
 #include "utils.h"
 
@@ -36,6 +37,7 @@ private:
   std::thread *read_thread;
   std::shared_ptr<Stream> stream;
   std::string tag;
+  ThreadSchedParam sched;
 };
 
 SourceStreamFlow::SourceStreamFlow(const char *param)
@@ -55,6 +57,10 @@ SourceStreamFlow::SourceStreamFlow(const char *param)
     SetError(-EINVAL);
     return;
   }
+  if (!ParseThreadSchedParam(params, sched)) {
+    SetError(-EINVAL);
+    return;
+  }
   tag = "SourceFlow:";
   tag.append(name);
   if (!SetAsSource(std::vector<int>({0}), void_transaction00, tag)) {
@@ -95,6 +101,10 @@ SourceStreamFlow::~SourceStreamFlow() {
 
 void SourceStreamFlow::ReadThreadRun() {
   prctl(PR_SET_NAME, this->tag.c_str());
+  ApplyThreadSchedParam(sched, tag.c_str());
+  int mod, chn;
+  GetMemOwner(mod, chn);
+  MemAccount::SetThreadOwner(mod, chn);
   source_start_cond_mtx->lock();
   if (waite_down_flow) {
     if (down_flow_num == 0 && IsEnable()) {
@@ -68,13 +68,13 @@ bool encode(Flow *f, MediaBufferVector &input_vector) {
   if (!src)
     return false;
 
-  dst = std::make_shared<MediaBuffer>(); // TODO: buffer pool
+  dst = MakePooled<MediaBuffer>();
   if (!dst) {
     LOG_NO_MEMORY();
     return false;
   }
   if (vf->extra_output) {
-    extra_dst = std::make_shared<MediaBuffer>();
+    extra_dst = MakePooled<MediaBuffer>();
     if (!extra_dst) {
       LOG_NO_MEMORY();
       return false;
@@ -264,7 +264,7 @@ VideoEncoderFlow::VideoEncoderFlow(const char *param)
 
   void *extra_data = nullptr;
   size_t extra_data_size = 0;
-  encoder->GetExtraData(&extra_data, &extra_data_size);
+  auto extra_mb = encoder->GetExtraData(&extra_data, &extra_data_size);
   // TODO: if not h264
   const std::string &output_dt = enc_params[KEY_OUTPUTDATATYPE];
 
@@ -279,8 +279,15 @@ VideoEncoderFlow::VideoEncoderFlow(const char *param)
   }
   sm.process = encode;
   sm.thread_model = Model::ASYNCCOMMON;
+  // encoder may share the executor instead of owning a thread
+  if (GetModelByString(params[KEK_THREAD_SYNC_MODEL]) == Model::POOL)
+    sm.thread_model = Model::POOL;
   sm.mode_when_full = InputMode::DROPFRONT;
   sm.input_maxcachenum.push_back(3);
+  if (!ParseThreadSchedParam(params, sm.sched)) {
+    SetError(-EINVAL);
+    return;
+  }
   if (!InstallSlotMap(sm, "VideoEncoderFlow", 40)) {
     RKMEDIA_LOGI("Fail to InstallSlotMap, %s\n", ccodec_name);
     SetError(-EINVAL);
@@ -291,21 +298,23 @@ VideoEncoderFlow::VideoEncoderFlow(const char *param)
   if (extra_data && extra_data_size > 0 &&
       (output_dt == VIDEO_H264 || output_dt == VIDEO_H265)) {
 
+    // views of the extra data, which stays valid even if the encoder
+    // replaces it
     if (extra_merge) {
-      std::shared_ptr<MediaBuffer> extra_buf = std::make_shared<MediaBuffer>();
-      extra_buf->SetPtr(extra_data);
-      extra_buf->SetValidSize(extra_data_size);
-      extra_buf->SetUserFlag(MediaBuffer::kExtraIntra);
-      SetOutput(extra_buf, 0);
+      auto extra_buf = MediaBuffer::Slice(extra_mb, 0, extra_data_size);
+      if (extra_buf) {
+        extra_buf->SetUserFlag(MediaBuffer::kExtraIntra);
+        SetOutput(extra_buf, 0);
+      }
     } else {
       if (output_dt == VIDEO_H264)
-        extra_buffer_list = split_h264_separate(
-            (const uint8_t *)extra_data, extra_data_size, gettimeofday());
+        extra_buffer_list = split_h264_separate(extra_mb);
       else
-        extra_buffer_list = split_h265_separate(
-            (const uint8_t *)extra_data, extra_data_size, gettimeofday());
+        extra_buffer_list = split_h265_separate(extra_mb);
+      int64_t now = gettimeofday();
       for (auto &extra_buffer : extra_buffer_list) {
         assert(extra_buffer->GetUserFlag() & MediaBuffer::kExtraIntra);
+        extra_buffer->SetUSTimeStamp(now);
         SetOutput(extra_buffer, 0);
       }
     }
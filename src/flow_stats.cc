@@ -0,0 +1,168 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flow_stats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace easymedia {
+
+template <typename T> static void atomic_max(std::atomic<T> &a, T value) {
+  T cur = a.load(std::memory_order_relaxed);
+  while (value > cur &&
+         !a.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+    ;
+}
+
+// Each power of 2 is split into 4 linear sub buckets, so the bound reported
+// for a percentile is at most 25% above the real value.
+static const int kSubBits = 2;
+static const int kSubNum = 1 << kSubBits;
+
+static int msb_of(uint64_t v) {
+  int n = 0;
+  while (v >>= 1)
+    n++;
+  return n;
+}
+
+static int bucket_of(int64_t us) {
+  if (us < kSubNum)
+    return (int)us;
+  int msb = msb_of(us);
+  int sub = (int)(us >> (msb - kSubBits)) & (kSubNum - 1);
+  int idx = kSubNum + (msb - kSubBits) * kSubNum + sub;
+  return idx < LatencyHistogram::kBucketNum ? idx
+                                            : LatencyHistogram::kBucketNum - 1;
+}
+
+// the largest value which falls in the bucket
+static int64_t bucket_bound(int idx) {
+  if (idx < kSubNum)
+    return idx;
+  int shift = (idx - kSubNum) / kSubNum;
+  int sub = (idx - kSubNum) % kSubNum;
+  return ((int64_t)(kSubNum + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Add(int64_t us) {
+  if (us < 0)
+    us = 0;
+  buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(us, std::memory_order_relaxed);
+  atomic_max(max, us);
+}
+
+void LatencyHistogram::Reset() {
+  for (int i = 0; i < kBucketNum; i++)
+    buckets[i].store(0, std::memory_order_relaxed);
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::Average() const {
+  uint64_t cnt = Count();
+  return cnt ? sum.load(std::memory_order_relaxed) / (int64_t)cnt : 0;
+}
+
+int64_t LatencyHistogram::Percentile(int percent) const {
+  uint32_t snapshot[kBucketNum];
+  uint64_t total = 0;
+  for (int i = 0; i < kBucketNum; i++) {
+    snapshot[i] = buckets[i].load(std::memory_order_relaxed);
+    total += snapshot[i];
+  }
+  if (total == 0)
+    return 0;
+  // rank of the wanted sample, rounded up
+  uint64_t rank = (total * percent + 99) / 100;
+  if (rank == 0)
+    rank = 1;
+  uint64_t acc = 0;
+  for (int i = 0; i < kBucketNum; i++) {
+    acc += snapshot[i];
+    if (acc >= rank) {
+      int64_t bound = bucket_bound(i);
+      // the max is exact, never report more than it
+      return bound < Max() ? bound : Max();
+    }
+  }
+  return Max();
+}
+
+void InputCounter::OnArrival(int64_t now_us) {
+  received.fetch_add(1, std::memory_order_relaxed);
+  int64_t last = last_arrival.exchange(now_us, std::memory_order_relaxed);
+  if (last <= 0)
+    return;
+  int64_t interval = now_us - last;
+  int64_t prev = last_interval.exchange(interval, std::memory_order_relaxed);
+  if (prev <= 0)
+    return;
+  // J += (|D| - J) / 16, kept scaled by 16 to stay in integers
+  int64_t d = llabs(interval - prev);
+  int64_t j = jitter16.load(std::memory_order_relaxed);
+  jitter16.store(j + d - (j >> 4), std::memory_order_relaxed);
+}
+
+void InputCounter::OnQueued(size_t depth) {
+  atomic_max(depth_hwm, (uint32_t)depth);
+}
+
+void InputCounter::Reset() {
+  received.store(0, std::memory_order_relaxed);
+  blocked.store(0, std::memory_order_relaxed);
+  dropped_front.store(0, std::memory_order_relaxed);
+  dropped_current.store(0, std::memory_order_relaxed);
+  dropped_unsynced.store(0, std::memory_order_relaxed);
+  depth_hwm.store(0, std::memory_order_relaxed);
+  last_arrival.store(0, std::memory_order_relaxed);
+  last_interval.store(0, std::memory_order_relaxed);
+  jitter16.store(0, std::memory_order_relaxed);
+}
+
+void DumpFlowStats(const FlowStats &stats, std::string &dump_info) {
+  char str_line[1024] = {0};
+
+  snprintf(str_line, sizeof(str_line),
+           "  Process: count:%" PRIu64 ", overrun:%" PRIu64
+           ", credit skipped:%" PRIu64 ", sync timeouts:%" PRIu64 "\r\n",
+           stats.process_count, stats.process_overrun, stats.credit_skipped,
+           stats.sync_timeouts);
+  dump_info.append(str_line);
+  snprintf(str_line, sizeof(str_line),
+           "    Time(us): avg:%" PRId64 ", p50:%" PRId64 ", p95:%" PRId64
+           ", p99:%" PRId64 ", max:%" PRId64 "\r\n",
+           stats.process_avg, stats.process_p50, stats.process_p95,
+           stats.process_p99, stats.process_max);
+  dump_info.append(str_line);
+  if (stats.pace_ticks > 0) {
+    snprintf(str_line, sizeof(str_line),
+             "  Pace: ticks:%" PRIu64 ", missed:%" PRIu64
+             ", late(us): p99:%" PRId64 ", max:%" PRId64 "\r\n",
+             stats.pace_ticks, stats.pace_missed, stats.pace_late_p99,
+             stats.pace_late_max);
+    dump_info.append(str_line);
+  }
+  for (size_t i = 0; i < stats.inputs.size(); i++) {
+    const FlowInputStats &in = stats.inputs[i];
+    snprintf(str_line, sizeof(str_line),
+             "  ->Input[%zu] stats:\r\n"
+             "    Received: %" PRIu64 ", Blocked: %" PRIu64
+             ", DropFront: %" PRIu64 ", DropCurrent: %" PRIu64
+             ", DropUnsynced: %" PRIu64 "\r\n"
+             "    Depth: current:%u, hwm:%u, max:%d\r\n"
+             "    Interval(us): %" PRId64 ", Jitter(us): %" PRId64 "\r\n",
+             i, in.received, in.blocked, in.dropped_front, in.dropped_current,
+             in.dropped_unsynced, in.depth, in.depth_hwm, in.max_cache_num,
+             in.interval, in.jitter);
+    dump_info.append(str_line);
+  }
+}
+
+} // namespace easymedia
@@ -72,6 +72,71 @@ int CalPixFmtSize(const PixelFormat &fmt, const int width, const int height,
   return (extra_hdr_size + pix_fmt_size);
 }
 
+int GetImagePlanes(const ImageInfo &ii, int x, int y,
+                   ImagePlane planes[MAX_IMAGE_PLANE_NUM]) {
+  size_t luma_size = (size_t)ii.vir_width * ii.vir_height;
+  int bpp = 0;
+  switch (ii.pix_fmt) {
+  case PIX_FMT_YUV420P:
+  case PIX_FMT_YUV422P: {
+    // 422p chroma planes have all the lines, 420p half of them
+    int ysub = (ii.pix_fmt == PIX_FMT_YUV420P) ? 2 : 1;
+    size_t chroma_size = luma_size / 2 / ysub;
+    x &= ~1;
+    y &= ~(ysub - 1);
+    planes[0].offset = (size_t)y * ii.vir_width + x;
+    planes[0].stride = ii.vir_width;
+    for (int i = 1; i < 3; i++) {
+      planes[i].offset = luma_size + chroma_size * (i - 1) +
+                         (size_t)(y / ysub) * (ii.vir_width / 2) + x / 2;
+      planes[i].stride = ii.vir_width / 2;
+    }
+    return 3;
+  }
+  case PIX_FMT_NV12:
+  case PIX_FMT_NV21:
+  case PIX_FMT_NV16:
+  case PIX_FMT_NV61: {
+    int ysub = (ii.pix_fmt == PIX_FMT_NV12 || ii.pix_fmt == PIX_FMT_NV21)
+                   ? 2
+                   : 1;
+    x &= ~1;
+    y &= ~(ysub - 1);
+    planes[0].offset = (size_t)y * ii.vir_width + x;
+    planes[0].stride = ii.vir_width;
+    // interleaved chroma, a pair of bytes per 2 pixels
+    planes[1].offset = luma_size + (size_t)(y / ysub) * ii.vir_width + x;
+    planes[1].stride = ii.vir_width;
+    return 2;
+  }
+  case PIX_FMT_YUYV422:
+  case PIX_FMT_UYVY422:
+    x &= ~1;
+    bpp = 2;
+    break;
+  case PIX_FMT_RGB332:
+    bpp = 1;
+    break;
+  case PIX_FMT_RGB565:
+  case PIX_FMT_BGR565:
+    bpp = 2;
+    break;
+  case PIX_FMT_RGB888:
+  case PIX_FMT_BGR888:
+    bpp = 3;
+    break;
+  case PIX_FMT_ARGB8888:
+  case PIX_FMT_ABGR8888:
+    bpp = 4;
+    break;
+  default:
+    return 0;
+  }
+  planes[0].offset = ((size_t)y * ii.vir_width + x) * bpp;
+  planes[0].stride = ii.vir_width * bpp;
+  return 1;
+}
+
 static const struct PixFmtStringEntry {
   PixelFormat fmt;
   const char *type_str;
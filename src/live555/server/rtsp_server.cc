@@ -72,15 +72,11 @@ bool SendMediaToServer(Flow *f, MediaBufferVector &input_vector) {
 
     if ((buffer->GetUserFlag() & MediaBuffer::kIntra)) {
       std::list<std::shared_ptr<easymedia::MediaBuffer>> spspps;
-      if (rtsp_flow->video_type == VIDEO_H264) {
-        spspps = split_h264_separate((const uint8_t *)buffer->GetPtr(),
-                                     buffer->GetValidSize(),
-                                     buffer->GetUSTimeStamp());
-      } else if (rtsp_flow->video_type == VIDEO_H265) {
-        spspps = split_h265_separate((const uint8_t *)buffer->GetPtr(),
-                                     buffer->GetValidSize(),
-                                     buffer->GetUSTimeStamp());
-      }
+      // views of the intra frame, which they keep alive, no copy
+      if (rtsp_flow->video_type == VIDEO_H264)
+        spspps = split_h264_separate(buffer);
+      else if (rtsp_flow->video_type == VIDEO_H265)
+        spspps = split_h265_separate(buffer);
       // Independently send vps, sps, pps packets to live555.
       for (auto &buf : spspps)
         rtsp_flow->server_input->PushNewVideo(buf);
@@ -160,6 +156,11 @@ RtspServerFlow::RtspServerFlow(const char *param) {
     server_input->SetStartAudioStreamCallback(
         std::bind(&RtspServerFlow::CallPlayAudioHandler, this));
     sm.process = SendMediaToServer;
+    // it handles any number of buffers, so it processes the batch directly
+    sm.batch_process = SendMediaToServer;
+    sm.batch_max = 8;
+    if (!ParseBatchParam(params, sm))
+      goto err;
     sm.thread_model = Model::ASYNCCOMMON;
     sm.mode_when_full = InputMode::BLOCKING;
     sm.input_maxcachenum.push_back(0); // no limit
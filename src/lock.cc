@@ -4,7 +4,13 @@
 
 #include "lock.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace easymedia {
 
@@ -41,6 +47,7 @@ void ConditionLockMutex::unlock() {
 }
 void ConditionLockMutex::wait() { cond.wait(mtx); }
 void ConditionLockMutex::notify() { cond.notify_all(); }
+void ConditionLockMutex::notify_one() { cond.notify_one(); }
 
 ReadWriteLockMutex::ReadWriteLockMutex() : valid(true) {
   int ret = pthread_rwlock_init(&rwlock, NULL);
@@ -81,4 +88,51 @@ void SpinLockMutex::unlock() {
   flag.clear(std::memory_order_release);
 }
 
+static inline long futex(std::atomic_int *uaddr, int op, int val,
+                         const struct timespec *timeout) {
+  return syscall(SYS_futex, reinterpret_cast<int *>(uaddr), op, val, timeout,
+                 nullptr, 0);
+}
+
+int FutexEvent::PrepareWait() {
+  waiters.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return seq.load(std::memory_order_acquire);
+}
+
+void FutexEvent::CancelWait() { waiters.fetch_sub(1); }
+
+bool FutexEvent::Wait(int key, int timeout_ms) {
+  struct timespec ts;
+  struct timespec *pts = nullptr;
+  if (timeout_ms >= 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    pts = &ts;
+  }
+  bool ret = true;
+  while (seq.load(std::memory_order_acquire) == key) {
+    if (futex(&seq, FUTEX_WAIT_PRIVATE, key, pts) && errno == ETIMEDOUT) {
+      ret = false;
+      break;
+    }
+    // EINTR or spurious wakeup with a relative timeout, just give up the
+    // rest of the time; the caller re-checks its condition anyway.
+    if (pts)
+      break;
+  }
+  waiters.fetch_sub(1);
+  return ret;
+}
+
+void FutexEvent::Notify() {
+  // pairs with the fence in PrepareWait, the state change done by the
+  // caller must be visible before we look at waiters.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters.load(std::memory_order_relaxed) > 0) {
+    seq.fetch_add(1, std::memory_order_release);
+    futex(&seq, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+  }
+}
+
 } // namespace easymedia
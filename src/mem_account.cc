@@ -0,0 +1,117 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mem_account.h"
+
+#include <atomic>
+
+#include "object_pool.h"
+
+namespace easymedia {
+
+namespace {
+
+struct Counter {
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint32_t> buffers;
+  std::atomic<uint64_t> peak_bytes;
+  std::atomic<uint64_t> alloc_cnt;
+  std::atomic<uint64_t> fail_cnt;
+  std::atomic<uint64_t> pool_wait_cnt;
+  std::atomic<uint64_t> pool_fail_cnt;
+};
+
+// keeps the memory, gives its bytes back to the owner when released
+class MemRecord {
+public:
+  MemRecord(const std::shared_ptr<void> &m, Counter *c, size_t s)
+      : mem(m), counter(c), size(s) {}
+  ~MemRecord() {
+    counter->bytes.fetch_sub(size, std::memory_order_relaxed);
+    counter->buffers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+private:
+  std::shared_ptr<void> mem;
+  Counter *counter;
+  size_t size;
+};
+
+} // namespace
+
+// zero initialized before any allocation, never destroyed
+static Counter counters[MemAccount::kModNum][MemAccount::kChnNum]
+                       [MemAccount::kTypeNum];
+
+static thread_local int owner_mod = 0;
+static thread_local int owner_chn = 0;
+
+static bool valid_owner(int mod, int chn) {
+  return mod >= 0 && mod < MemAccount::kModNum && chn >= 0 &&
+         chn < MemAccount::kChnNum;
+}
+
+static Counter &counter_of(int mod, int chn, int type) {
+  if (!valid_owner(mod, chn))
+    mod = chn = 0;
+  if (type < 0 || type >= MemAccount::kTypeNum)
+    type = 0;
+  return counters[mod][chn][type];
+}
+
+void MemAccount::SetThreadOwner(int mod, int chn) {
+  owner_mod = mod;
+  owner_chn = chn;
+}
+
+void MemAccount::GetThreadOwner(int &mod, int &chn) {
+  mod = owner_mod;
+  chn = owner_chn;
+}
+
+std::shared_ptr<void> MemAccount::Track(const std::shared_ptr<void> &mem,
+                                        int type, size_t size) {
+  Counter &c = counter_of(owner_mod, owner_chn, type);
+  auto record = MakePooled<MemRecord>(mem, &c, size);
+  c.alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+  c.buffers.fetch_add(1, std::memory_order_relaxed);
+  uint64_t bytes = c.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+  while (bytes > peak && !c.peak_bytes.compare_exchange_weak(
+                             peak, bytes, std::memory_order_relaxed))
+    ;
+  // the record owns the memory, users still see the original object
+  return std::shared_ptr<void>(record, mem.get());
+}
+
+void MemAccount::OnAllocFail(int type) {
+  counter_of(owner_mod, owner_chn, type)
+      .fail_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemAccount::OnPoolWait(int mod, int chn, int type) {
+  counter_of(mod, chn, type)
+      .pool_wait_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemAccount::OnPoolFail(int mod, int chn, int type) {
+  counter_of(mod, chn, type)
+      .pool_fail_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MemAccount::GetUsage(int mod, int chn, int type, MemUsage &usage) {
+  if (!valid_owner(mod, chn) || type < 0 || type >= kTypeNum)
+    return false;
+  Counter &c = counters[mod][chn][type];
+  usage.bytes = c.bytes.load(std::memory_order_relaxed);
+  usage.buffers = c.buffers.load(std::memory_order_relaxed);
+  usage.peak_bytes = c.peak_bytes.load(std::memory_order_relaxed);
+  usage.alloc_cnt = c.alloc_cnt.load(std::memory_order_relaxed);
+  usage.fail_cnt = c.fail_cnt.load(std::memory_order_relaxed);
+  usage.pool_wait_cnt = c.pool_wait_cnt.load(std::memory_order_relaxed);
+  usage.pool_fail_cnt = c.pool_fail_cnt.load(std::memory_order_relaxed);
+  return true;
+}
+
+} // namespace easymedia
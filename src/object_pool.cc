@@ -0,0 +1,123 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "object_pool.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include "lock.h"
+
+namespace easymedia {
+
+static const size_t kClassStep = 32;
+static const int kClassNum = ObjectPool::kMaxSize / kClassStep;
+static const size_t kChunkSize = 4096;
+
+namespace {
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+class SizeClass {
+public:
+  SizeClass() : head(nullptr), block_size(0) {}
+  void *Pop();
+  void Push(void *ptr);
+
+  SpinLockMutex mtx;
+  FreeBlock *head;
+  size_t block_size;
+};
+
+class Pools {
+public:
+  Pools() : allocs(0), heap_allocs(0), frees(0), reserved(0) {
+    for (int i = 0; i < kClassNum; i++)
+      classes[i].block_size = (i + 1) * kClassStep;
+  }
+
+  SizeClass classes[kClassNum];
+  std::atomic<uint64_t> allocs;
+  std::atomic<uint64_t> heap_allocs;
+  std::atomic<uint64_t> frees;
+  std::atomic<uint64_t> reserved;
+};
+
+} // namespace
+
+// Never destroyed, buffers may still be freed by other static objects
+// after exit.
+static Pools &GetPools() {
+  static Pools *pools = new Pools();
+  return *pools;
+}
+
+void *SizeClass::Pop() {
+  AutoLockMutex _alm(mtx);
+  if (!head) {
+    // carve a new chunk, most classes get several blocks per chunk
+    size_t num = kChunkSize / block_size;
+    char *chunk = static_cast<char *>(malloc(num * block_size));
+    if (!chunk)
+      return nullptr;
+    GetPools().heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    GetPools().reserved.fetch_add(num * block_size, std::memory_order_relaxed);
+    for (size_t i = 0; i < num; i++) {
+      FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + i * block_size);
+      block->next = head;
+      head = block;
+    }
+  }
+  FreeBlock *block = head;
+  head = block->next;
+  return block;
+}
+
+void SizeClass::Push(void *ptr) {
+  FreeBlock *block = static_cast<FreeBlock *>(ptr);
+  AutoLockMutex _alm(mtx);
+  block->next = head;
+  head = block;
+}
+
+void *ObjectPool::Allocate(size_t size) {
+  Pools &pools = GetPools();
+  pools.allocs.fetch_add(1, std::memory_order_relaxed);
+  void *ptr;
+  if (size == 0 || size > kMaxSize) {
+    pools.heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    ptr = malloc(size);
+  } else {
+    ptr = pools.classes[(size - 1) / kClassStep].Pop();
+  }
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void ObjectPool::Deallocate(void *ptr, size_t size) {
+  if (!ptr)
+    return;
+  Pools &pools = GetPools();
+  pools.frees.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0 || size > kMaxSize)
+    free(ptr);
+  else
+    pools.classes[(size - 1) / kClassStep].Push(ptr);
+}
+
+void ObjectPool::GetStats(ObjectPoolStats &stats) {
+  Pools &pools = GetPools();
+  stats.allocs = pools.allocs.load(std::memory_order_relaxed);
+  stats.heap_allocs = pools.heap_allocs.load(std::memory_order_relaxed);
+  stats.frees = pools.frees.load(std::memory_order_relaxed);
+  stats.in_use = stats.allocs - stats.frees;
+  stats.reserved = pools.reserved.load(std::memory_order_relaxed);
+}
+
+} // namespace easymedia
@@ -108,7 +108,7 @@ std::shared_ptr<MediaBuffer> OggVorbisDemuxer::Read(size_t request_size) {
   SampleInfo empty_info;
   memset(&empty_info, 0, sizeof(empty_info));
   std::shared_ptr<SampleBuffer> sb =
-      std::make_shared<SampleBuffer>(mb, empty_info);
+      MakePooled<SampleBuffer>(mb, empty_info);
   if (!sb) {
     LOG_NO_MEMORY();
     free(pcmout);
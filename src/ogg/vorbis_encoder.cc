@@ -166,8 +166,8 @@ int VorbisEncoder::SendInput(const std::shared_ptr<MediaBuffer> &input) {
         return -1;
       }
       std::shared_ptr<MediaBuffer> buffer =
-          std::make_shared<MediaBuffer>(new_packet->packet, new_packet->bytes,
-                                        -1, new_packet, __ogg_packet_free);
+          MakePooled<MediaBuffer>(new_packet->packet, new_packet->bytes, -1,
+                                  new_packet, __ogg_packet_free);
       if (!buffer) {
         errno = ENOMEM;
         return -1;
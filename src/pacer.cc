@@ -0,0 +1,125 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pacer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+namespace easymedia {
+
+static int64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+Pacer::Pacer() : th(nullptr), quit(false) {
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    RKMEDIA_LOGE("Pacer: timerfd_create failed, %s\n", strerror(errno));
+    return;
+  }
+  th = new std::thread(&Pacer::Run, this);
+}
+
+Pacer::~Pacer() {
+  if (th) {
+    mtx.lock();
+    quit = true;
+    // any past deadline fires at once
+    Arm(1);
+    mtx.unlock();
+    th->join();
+    delete th;
+  }
+  if (timer_fd >= 0)
+    close(timer_fd);
+}
+
+const std::shared_ptr<Pacer> &Pacer::GetInstance() {
+  const static std::shared_ptr<Pacer> pacer = std::make_shared<Pacer>();
+  return pacer;
+}
+
+bool Pacer::Add(PacedTask *task, int64_t interval_ns) {
+  if (!th || interval_ns <= 0)
+    return false;
+  Entry entry;
+  entry.task = task;
+  entry.start = monotonic_ns();
+  entry.interval = interval_ns;
+  entry.ticks = 1;
+  std::lock_guard<std::mutex> _lg(mtx);
+  entries.emplace(entry.start + interval_ns, entry);
+  ArmFirst();
+  return true;
+}
+
+void Pacer::Remove(PacedTask *task) {
+  std::lock_guard<std::mutex> _lg(mtx);
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->second.task == task)
+      it = entries.erase(it);
+    else
+      ++it;
+  }
+  ArmFirst();
+}
+
+void Pacer::Arm(int64_t deadline) {
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  // zero disarms the timer
+  its.it_value.tv_sec = deadline / 1000000000LL;
+  its.it_value.tv_nsec = deadline % 1000000000LL;
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, nullptr))
+    RKMEDIA_LOGE("Pacer: timerfd_settime failed, %s\n", strerror(errno));
+}
+
+void Pacer::ArmFirst() {
+  if (quit)
+    return;
+  Arm(entries.empty() ? 0 : entries.begin()->first);
+}
+
+void Pacer::Run() {
+  prctl(PR_SET_NAME, "rkmedia_pacer");
+  // the default 50us slack of normal threads is too much for pacing
+  prctl(PR_SET_TIMERSLACK, 1UL);
+
+  while (!quit) {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      RKMEDIA_LOGE("Pacer: read timerfd failed, %s\n", strerror(errno));
+      break;
+    }
+    std::lock_guard<std::mutex> _lg(mtx);
+    if (quit)
+      break;
+    int64_t now = monotonic_ns();
+    while (!entries.empty() && entries.begin()->first <= now) {
+      int64_t deadline = entries.begin()->first;
+      Entry entry = entries.begin()->second;
+      entries.erase(entries.begin());
+      // never burst to catch up, skip the ticks which are already past
+      int64_t next = (now - entry.start) / entry.interval + 1;
+      int missed = (int)(next - entry.ticks - 1);
+      entry.task->OnTick((now - deadline) / 1000, missed);
+      entry.ticks = next;
+      entries.emplace(entry.start + next * entry.interval, entry);
+    }
+    ArmFirst();
+  }
+}
+
+} // namespace easymedia
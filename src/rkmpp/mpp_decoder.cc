@@ -506,7 +506,7 @@ RETRY_GET_FRAME:
       goto RETRY_GET_FRAME;
 
     // return a zero size buffer, but contain image info
-    auto mb = std::make_shared<ImageBuffer>();
+    auto mb = MakePooled<ImageBuffer>();
     if (!mb) {
       errno = ENOMEM;
       goto out;
@@ -515,7 +515,7 @@ RETRY_GET_FRAME:
     return mb;
   } else if (mpp_frame_get_eos(mppframe)) {
     RKMEDIA_LOGI("Received EOS frame.\n");
-    auto mb = std::make_shared<ImageBuffer>();
+    auto mb = MakePooled<ImageBuffer>();
     if (!mb) {
       errno = ENOMEM;
       goto out;
@@ -531,7 +531,7 @@ RETRY_GET_FRAME:
     RKMEDIA_LOGI("Received a errinfo frame.\n");
     goto out;
   } else {
-    auto mb = std::make_shared<ImageBuffer>();
+    auto mb = MakePooled<ImageBuffer>();
     if (!mb) {
       errno = ENOMEM;
       goto out;
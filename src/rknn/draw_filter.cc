@@ -260,19 +260,24 @@ int DrawFilter::Process(std::shared_ptr<MediaBuffer> input,
     return 0;
 
   auto src = std::static_pointer_cast<easymedia::ImageBuffer>(input);
-  auto dst = std::static_pointer_cast<easymedia::ImageBuffer>(output);
 
   std::list<RknnResult> &written_list = src->GetRknnResult();
   if (written_list.empty())
     return 0;
   ConvertRect(written_list);
 
-  input->BeginCPUAccess(false);
-  if (draw_handler_ && need_hw_draw_)
+  bool hw_draw = draw_handler_ && need_hw_draw_;
+  // draw in place, on a copy if other consumers got the frame too
+  if (!hw_draw && !MediaBuffer::MakeWritable(output))
+    return -ENOMEM;
+  auto dst = std::static_pointer_cast<easymedia::ImageBuffer>(output);
+
+  output->BeginCPUAccess(false);
+  if (hw_draw)
     DoHwDraw(written_list);
   else
     DoDraw(dst, written_list);
-  input->EndCPUAccess(false);
+  output->EndCPUAccess(false);
   return 0;
 }
 
@@ -206,7 +206,7 @@ int FaceCapture::DoCrop(std::shared_ptr<MediaBuffer> src,
   }
 
   auto &&mb = MediaBuffer::Alloc2(size, MediaBuffer::MemType::MEM_HARD_WARE);
-  dst = std::make_shared<ImageBuffer>(mb, dst_info);
+  dst = MakePooled<ImageBuffer>(mb, dst_info);
   dst->SetValidSize(size);
 
   int ret = rga_->Process(src, dst);
@@ -229,7 +229,7 @@ int FaceCapture::DoEncode(std::shared_ptr<MediaBuffer> src,
     RKMEDIA_LOGI("FaceCapture Init config of encoder mjpeg failed\n");
     exit(EXIT_FAILURE);
   }
-  dst = std::make_shared<MediaBuffer>();
+  dst = MakePooled<MediaBuffer>();
   if (!dst) {
     LOG_NO_MEMORY();
     return -1;
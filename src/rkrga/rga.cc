@@ -154,14 +154,16 @@ int rga_blit(std::shared_ptr<ImageBuffer> src, std::shared_ptr<ImageBuffer> dst,
     src_info.rotation = 0;
     break;
   }
+  // rects are in the image, which starts at the origin for crop views
   if (src_rect)
-    rga_set_rect(&src_info.rect, src_rect->x, src_rect->y, src_rect->w,
-                 src_rect->h, src->GetVirWidth(), src->GetVirHeight(),
-                 get_rga_format(src->GetPixelFormat()));
-  else
-    rga_set_rect(&src_info.rect, 0, 0, src->GetWidth(), src->GetHeight(),
+    rga_set_rect(&src_info.rect, src->GetOriginX() + src_rect->x,
+                 src->GetOriginY() + src_rect->y, src_rect->w, src_rect->h,
                  src->GetVirWidth(), src->GetVirHeight(),
                  get_rga_format(src->GetPixelFormat()));
+  else
+    rga_set_rect(&src_info.rect, src->GetOriginX(), src->GetOriginY(),
+                 src->GetWidth(), src->GetHeight(), src->GetVirWidth(),
+                 src->GetVirHeight(), get_rga_format(src->GetPixelFormat()));
 
   memset(&dst_info, 0, sizeof(dst_info));
   dst_info.fd = dst->GetFD();
@@ -169,13 +171,14 @@ int rga_blit(std::shared_ptr<ImageBuffer> src, std::shared_ptr<ImageBuffer> dst,
     dst_info.virAddr = dst->GetPtr();
   dst_info.mmuFlag = 1;
   if (dst_rect)
-    rga_set_rect(&dst_info.rect, dst_rect->x, dst_rect->y, dst_rect->w,
-                 dst_rect->h, dst->GetVirWidth(), dst->GetVirHeight(),
-                 get_rga_format(dst->GetPixelFormat()));
-  else
-    rga_set_rect(&dst_info.rect, 0, 0, dst->GetWidth(), dst->GetHeight(),
+    rga_set_rect(&dst_info.rect, dst->GetOriginX() + dst_rect->x,
+                 dst->GetOriginY() + dst_rect->y, dst_rect->w, dst_rect->h,
                  dst->GetVirWidth(), dst->GetVirHeight(),
                  get_rga_format(dst->GetPixelFormat()));
+  else
+    rga_set_rect(&dst_info.rect, dst->GetOriginX(), dst->GetOriginY(),
+                 dst->GetWidth(), dst->GetHeight(), dst->GetVirWidth(),
+                 dst->GetVirHeight(), get_rga_format(dst->GetPixelFormat()));
 
 #ifndef NDEBUG
   dummp_rga_info(src_info, "SrcInfo");
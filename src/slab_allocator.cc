@@ -0,0 +1,504 @@
+// Copyright 2020 Fuzhou Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "slab_allocator.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "lock.h"
+
+namespace easymedia {
+
+// the header is part of the block, the classes are the block sizes
+static const size_t kMinClassSize = 256;
+static const size_t kMaxClassSize = 4 << 20;
+static const int kSubNum = 4;
+// 256, then 4 classes for each power of 2 up to 4M
+static const int kClassNum = 1 + 14 * kSubNum;
+static const size_t kMmapThreshold = 128 << 10;
+// thread caches only keep a few small blocks per class
+static const size_t kThreadCacheMaxBlock = 64 << 10;
+static const int kThreadCacheDepth = 4;
+static const size_t kDefaultCacheMax = 8 << 20;
+static const uint32_t kLargeClass = 0xFFFF;
+static const uint32_t kHugeClass = 0xFFFE;
+static const size_t kHugePageSize = 2 << 20;
+static const size_t kPageSize = 4 << 10;
+static const uint32_t kMagic = 0x534C4142;
+
+namespace {
+
+// 16 bytes on every arch, keeps the user pointer aligned as malloc does
+struct BlockHeader {
+  uint32_t cls;
+  uint32_t magic;
+  uint64_t size; // asked by the user
+};
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+class SizeClass {
+public:
+  SizeClass() : head(nullptr), block_size(0) {}
+
+  SpinLockMutex mtx;
+  FreeBlock *head;
+  size_t block_size;
+};
+
+class Slab {
+public:
+  Slab();
+  void *SysAlloc(size_t size);
+  void SysFree(void *block, size_t size);
+  bool Reserve(size_t size);
+  void Release(size_t size);
+  // push to the class, or free if the caches are full
+  void Recycle(int cls, FreeBlock *block);
+  void TrimClasses();
+
+  SizeClass classes[kClassNum];
+  std::atomic<uint64_t> alloc_cnt;
+  std::atomic<uint64_t> free_cnt;
+  std::atomic<uint64_t> cache_hit_cnt;
+  std::atomic<uint64_t> sys_alloc_cnt;
+  std::atomic<uint64_t> sys_free_cnt;
+  std::atomic<uint64_t> large_cnt;
+  std::atomic<uint64_t> hugetlb_cnt;
+  std::atomic<uint64_t> thp_cnt;
+  std::atomic<uint64_t> fail_cnt;
+  std::atomic<uint64_t> requested_bytes;
+  std::atomic<uint64_t> in_use_bytes;
+  std::atomic<uint64_t> cached_bytes;
+  // only the blocks in the size classes, thread caches are not bounded
+  std::atomic<uint64_t> class_cached_bytes;
+  std::atomic<uint64_t> reserved_bytes;
+  std::atomic<uint64_t> peak_reserved_bytes;
+  std::atomic<uint64_t> mem_cap;
+  std::atomic<uint64_t> cache_max;
+};
+
+class ThreadCache {
+public:
+  ThreadCache() {
+    for (int i = 0; i < kClassNum; i++) {
+      heads[i] = nullptr;
+      cnt[i] = 0;
+    }
+  }
+  ~ThreadCache() { Flush(); }
+  void Flush();
+
+  FreeBlock *heads[kClassNum];
+  int cnt[kClassNum];
+};
+
+} // namespace
+
+static size_t parse_size(const char *str) {
+  char *end = nullptr;
+  size_t size = strtoull(str, &end, 10);
+  if (end && (*end == 'k' || *end == 'K'))
+    size <<= 10;
+  else if (end && (*end == 'm' || *end == 'M'))
+    size <<= 20;
+  return size;
+}
+
+Slab::Slab()
+    : alloc_cnt(0), free_cnt(0), cache_hit_cnt(0), sys_alloc_cnt(0),
+      sys_free_cnt(0), large_cnt(0), hugetlb_cnt(0), thp_cnt(0), fail_cnt(0),
+      requested_bytes(0),
+      in_use_bytes(0), cached_bytes(0), class_cached_bytes(0),
+      reserved_bytes(0), peak_reserved_bytes(0), mem_cap(0),
+      cache_max(kDefaultCacheMax) {
+  classes[0].block_size = kMinClassSize;
+  int i = 1;
+  for (size_t base = kMinClassSize; base < kMaxClassSize; base <<= 1) {
+    for (int k = 1; k <= kSubNum; k++)
+      classes[i++].block_size = base + base / kSubNum * k;
+  }
+  const char *str = getenv("RKMEDIA_COMMON_MEM_CAP");
+  if (str)
+    mem_cap = parse_size(str);
+  str = getenv("RKMEDIA_COMMON_MEM_CACHE");
+  if (str)
+    cache_max = parse_size(str);
+}
+
+// Never destroyed, buffers may still be freed by other static objects
+// after exit.
+static Slab &GetSlab() {
+  static Slab *slab = new Slab();
+  return *slab;
+}
+
+static thread_local ThreadCache thread_cache;
+
+static int class_of(size_t size) {
+  Slab &slab = GetSlab();
+  int low = 0, high = kClassNum - 1;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (slab.classes[mid].block_size < size)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+static void atomic_max(std::atomic<uint64_t> &a, uint64_t value) {
+  uint64_t cur = a.load(std::memory_order_relaxed);
+  while (value > cur &&
+         !a.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+    ;
+}
+
+void *Slab::SysAlloc(size_t size) {
+  void *block;
+  if (size < kMmapThreshold) {
+    block = malloc(size);
+  } else {
+    block = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+      block = nullptr;
+  }
+  if (block)
+    sys_alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+  return block;
+}
+
+void Slab::SysFree(void *block, size_t size) {
+  sys_free_cnt.fetch_add(1, std::memory_order_relaxed);
+  if (size < kMmapThreshold)
+    free(block);
+  else
+    munmap(block, size);
+  Release(size);
+}
+
+bool Slab::Reserve(size_t size) {
+  uint64_t cap = mem_cap.load(std::memory_order_relaxed);
+  uint64_t reserved =
+      reserved_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  if (cap > 0 && reserved > cap) {
+    reserved_bytes.fetch_sub(size, std::memory_order_relaxed);
+    return false;
+  }
+  atomic_max(peak_reserved_bytes, reserved);
+  return true;
+}
+
+void Slab::Release(size_t size) {
+  reserved_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void Slab::Recycle(int cls, FreeBlock *block) {
+  SizeClass &sc = classes[cls];
+  uint64_t cached = class_cached_bytes.load(std::memory_order_relaxed);
+  if (cached + sc.block_size > cache_max.load(std::memory_order_relaxed)) {
+    cached_bytes.fetch_sub(sc.block_size, std::memory_order_relaxed);
+    SysFree(block, sc.block_size);
+    return;
+  }
+  class_cached_bytes.fetch_add(sc.block_size, std::memory_order_relaxed);
+  AutoLockMutex _alm(sc.mtx);
+  block->next = sc.head;
+  sc.head = block;
+}
+
+void Slab::TrimClasses() {
+  for (int i = 0; i < kClassNum; i++) {
+    SizeClass &sc = classes[i];
+    FreeBlock *head;
+    {
+      AutoLockMutex _alm(sc.mtx);
+      head = sc.head;
+      sc.head = nullptr;
+    }
+    while (head) {
+      FreeBlock *next = head->next;
+      class_cached_bytes.fetch_sub(sc.block_size, std::memory_order_relaxed);
+      cached_bytes.fetch_sub(sc.block_size, std::memory_order_relaxed);
+      SysFree(head, sc.block_size);
+      head = next;
+    }
+  }
+}
+
+void ThreadCache::Flush() {
+  Slab &slab = GetSlab();
+  for (int i = 0; i < kClassNum; i++) {
+    while (heads[i]) {
+      FreeBlock *block = heads[i];
+      heads[i] = block->next;
+      slab.Recycle(i, block);
+    }
+    cnt[i] = 0;
+  }
+}
+
+static void *alloc_large(Slab &slab, size_t size) {
+  size_t len = size + sizeof(BlockHeader);
+  if (!slab.Reserve(len)) {
+    thread_cache.Flush();
+    slab.TrimClasses();
+    if (!slab.Reserve(len))
+      return nullptr;
+  }
+  void *block = slab.SysAlloc(len);
+  if (!block) {
+    slab.Release(len);
+    return nullptr;
+  }
+  slab.large_cnt.fetch_add(1, std::memory_order_relaxed);
+  slab.in_use_bytes.fetch_add(len, std::memory_order_relaxed);
+  return block;
+}
+
+static size_t huge_len(size_t size) {
+  return (size + sizeof(BlockHeader) + kHugePageSize - 1) &
+         ~(kHugePageSize - 1);
+}
+
+// 2MB aligned anonymous mapping, so that the kernel can back it with
+// transparent huge pages
+static void *map_thp(size_t len) {
+  size_t map_len = len + kHugePageSize;
+  char *raw = static_cast<char *>(mmap(nullptr, map_len,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (raw == MAP_FAILED)
+    return nullptr;
+  uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+  char *block = reinterpret_cast<char *>((addr + kHugePageSize - 1) &
+                                         ~(kHugePageSize - 1));
+  if (block > raw)
+    munmap(raw, block - raw);
+  if (raw + map_len > block + len)
+    munmap(block + len, raw + map_len - (block + len));
+#ifdef MADV_HUGEPAGE
+  madvise(block, len, MADV_HUGEPAGE);
+#endif
+  // prefault now rather than on the first frame, one touch per huge page is
+  // enough when THP is on, the other ones cover the 4KB fallback
+  for (size_t off = 0; off < len; off += kPageSize)
+    block[off] = 0;
+  return block;
+}
+
+static void *alloc_huge(Slab &slab, size_t size) {
+  size_t len = huge_len(size);
+  if (!slab.Reserve(len)) {
+    thread_cache.Flush();
+    slab.TrimClasses();
+    if (!slab.Reserve(len))
+      return nullptr;
+  }
+  void *block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  block = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1,
+               0);
+#endif
+  if (block != MAP_FAILED) {
+    slab.hugetlb_cnt.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    block = map_thp(len);
+    if (!block) {
+      slab.Release(len);
+      return nullptr;
+    }
+    slab.thp_cnt.fetch_add(1, std::memory_order_relaxed);
+  }
+  slab.sys_alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+  slab.in_use_bytes.fetch_add(len, std::memory_order_relaxed);
+  return block;
+}
+
+static void *alloc_block(Slab &slab, int cls) {
+  SizeClass &sc = slab.classes[cls];
+  FreeBlock *block = thread_cache.heads[cls];
+  if (block) {
+    thread_cache.heads[cls] = block->next;
+    thread_cache.cnt[cls]--;
+  } else {
+    AutoLockMutex _alm(sc.mtx);
+    block = sc.head;
+    if (block) {
+      sc.head = block->next;
+      slab.class_cached_bytes.fetch_sub(sc.block_size,
+                                        std::memory_order_relaxed);
+    }
+  }
+  if (block) {
+    slab.cache_hit_cnt.fetch_add(1, std::memory_order_relaxed);
+    slab.cached_bytes.fetch_sub(sc.block_size, std::memory_order_relaxed);
+    slab.in_use_bytes.fetch_add(sc.block_size, std::memory_order_relaxed);
+    return block;
+  }
+  if (!slab.Reserve(sc.block_size)) {
+    // the cached blocks of the other sizes may make room
+    thread_cache.Flush();
+    slab.TrimClasses();
+    if (!slab.Reserve(sc.block_size))
+      return nullptr;
+  }
+  void *mem = slab.SysAlloc(sc.block_size);
+  if (!mem) {
+    slab.Release(sc.block_size);
+    return nullptr;
+  }
+  slab.in_use_bytes.fetch_add(sc.block_size, std::memory_order_relaxed);
+  return mem;
+}
+
+static void *init_block(Slab &slab, void *block, uint32_t cls, size_t size) {
+  if (!block) {
+    uint64_t fails = slab.fail_cnt.fetch_add(1, std::memory_order_relaxed);
+    // do not flood the log when the cap is hit for a while
+    if ((fails & (fails + 1)) == 0)
+      RKMEDIA_LOGW("SlabAllocator: fail to alloc %zu bytes, reserved:%llu, "
+                   "cap:%llu, failed %llu times\n",
+                   size, (unsigned long long)slab.reserved_bytes.load(),
+                   (unsigned long long)slab.mem_cap.load(),
+                   (unsigned long long)fails + 1);
+    return nullptr;
+  }
+  slab.alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+  slab.requested_bytes.fetch_add(size, std::memory_order_relaxed);
+  BlockHeader *hdr = static_cast<BlockHeader *>(block);
+  hdr->cls = cls;
+  hdr->magic = kMagic;
+  hdr->size = size;
+  return hdr + 1;
+}
+
+void *SlabAllocator::Allocate(size_t size) {
+  Slab &slab = GetSlab();
+  size_t need = size + sizeof(BlockHeader);
+  if (need > kMaxClassSize)
+    return init_block(slab, alloc_large(slab, size), kLargeClass, size);
+  int cls = class_of(need);
+  return init_block(slab, alloc_block(slab, cls), cls, size);
+}
+
+void *SlabAllocator::AllocateHuge(size_t size) {
+  if (size < kHugePageSize / 2)
+    return Allocate(size);
+  Slab &slab = GetSlab();
+  return init_block(slab, alloc_huge(slab, size), kHugeClass, size);
+}
+
+void SlabAllocator::Deallocate(void *ptr) {
+  if (!ptr)
+    return;
+  BlockHeader *hdr = static_cast<BlockHeader *>(ptr) - 1;
+  if (hdr->magic != kMagic) {
+    RKMEDIA_LOGE("SlabAllocator: free unknown or freed block %p\n", ptr);
+    return;
+  }
+  hdr->magic = 0;
+  Slab &slab = GetSlab();
+  slab.free_cnt.fetch_add(1, std::memory_order_relaxed);
+  slab.requested_bytes.fetch_sub(hdr->size, std::memory_order_relaxed);
+  if (hdr->cls == kLargeClass) {
+    size_t len = hdr->size + sizeof(BlockHeader);
+    slab.in_use_bytes.fetch_sub(len, std::memory_order_relaxed);
+    slab.SysFree(hdr, len);
+    return;
+  }
+  if (hdr->cls == kHugeClass) {
+    size_t len = huge_len(hdr->size);
+    slab.in_use_bytes.fetch_sub(len, std::memory_order_relaxed);
+    slab.sys_free_cnt.fetch_add(1, std::memory_order_relaxed);
+    munmap(hdr, len);
+    slab.Release(len);
+    return;
+  }
+  int cls = hdr->cls;
+  size_t block_size = slab.classes[cls].block_size;
+  FreeBlock *block = reinterpret_cast<FreeBlock *>(hdr);
+  slab.in_use_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+  slab.cached_bytes.fetch_add(block_size, std::memory_order_relaxed);
+  if (block_size <= kThreadCacheMaxBlock &&
+      thread_cache.cnt[cls] < kThreadCacheDepth) {
+    block->next = thread_cache.heads[cls];
+    thread_cache.heads[cls] = block;
+    thread_cache.cnt[cls]++;
+    return;
+  }
+  slab.Recycle(cls, block);
+}
+
+void SlabAllocator::SetMemCap(size_t bytes) {
+  GetSlab().mem_cap.store(bytes, std::memory_order_relaxed);
+}
+
+void SlabAllocator::SetCacheMax(size_t bytes) {
+  GetSlab().cache_max.store(bytes, std::memory_order_relaxed);
+}
+
+void SlabAllocator::Trim() {
+  thread_cache.Flush();
+  GetSlab().TrimClasses();
+}
+
+void SlabAllocator::GetStats(SlabStats &stats) {
+  Slab &slab = GetSlab();
+  stats.alloc_cnt = slab.alloc_cnt.load(std::memory_order_relaxed);
+  stats.free_cnt = slab.free_cnt.load(std::memory_order_relaxed);
+  stats.cache_hit_cnt = slab.cache_hit_cnt.load(std::memory_order_relaxed);
+  stats.sys_alloc_cnt = slab.sys_alloc_cnt.load(std::memory_order_relaxed);
+  stats.sys_free_cnt = slab.sys_free_cnt.load(std::memory_order_relaxed);
+  stats.large_cnt = slab.large_cnt.load(std::memory_order_relaxed);
+  stats.hugetlb_cnt = slab.hugetlb_cnt.load(std::memory_order_relaxed);
+  stats.thp_cnt = slab.thp_cnt.load(std::memory_order_relaxed);
+  stats.fail_cnt = slab.fail_cnt.load(std::memory_order_relaxed);
+  stats.requested_bytes = slab.requested_bytes.load(std::memory_order_relaxed);
+  stats.in_use_bytes = slab.in_use_bytes.load(std::memory_order_relaxed);
+  stats.cached_bytes = slab.cached_bytes.load(std::memory_order_relaxed);
+  stats.reserved_bytes = slab.reserved_bytes.load(std::memory_order_relaxed);
+  stats.peak_reserved_bytes =
+      slab.peak_reserved_bytes.load(std::memory_order_relaxed);
+  stats.mem_cap = slab.mem_cap.load(std::memory_order_relaxed);
+  stats.cache_max = slab.cache_max.load(std::memory_order_relaxed);
+}
+
+void SlabAllocator::DumpInfo() {
+  SlabStats st;
+  GetStats(st);
+  RKMEDIA_LOGI("##SlabAllocator DumpInfo\n");
+  RKMEDIA_LOGI("\talloc:%llu, free:%llu, cache hit:%llu, large:%llu, "
+               "fail:%llu\n",
+               (unsigned long long)st.alloc_cnt,
+               (unsigned long long)st.free_cnt,
+               (unsigned long long)st.cache_hit_cnt,
+               (unsigned long long)st.large_cnt,
+               (unsigned long long)st.fail_cnt);
+  RKMEDIA_LOGI("\tsystem alloc:%llu, free:%llu, hugetlb:%llu, thp:%llu\n",
+               (unsigned long long)st.sys_alloc_cnt,
+               (unsigned long long)st.sys_free_cnt,
+               (unsigned long long)st.hugetlb_cnt,
+               (unsigned long long)st.thp_cnt);
+  RKMEDIA_LOGI("\tbytes: requested:%llu, in use:%llu, cached:%llu\n",
+               (unsigned long long)st.requested_bytes,
+               (unsigned long long)st.in_use_bytes,
+               (unsigned long long)st.cached_bytes);
+  RKMEDIA_LOGI("\tbytes: reserved:%llu, peak:%llu, cap:%llu, cache max:%llu\n",
+               (unsigned long long)st.reserved_bytes,
+               (unsigned long long)st.peak_reserved_bytes,
+               (unsigned long long)st.mem_cap,
+               (unsigned long long)st.cache_max);
+}
+
+} // namespace easymedia
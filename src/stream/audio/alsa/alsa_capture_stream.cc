@@ -203,7 +203,7 @@ std::shared_ptr<MediaBuffer> AlsaCaptureStream::Read() {
   int read_cnt = -1;
   int output_frame_size = frame_size;
 
-  auto sample_buffer = std::make_shared<easymedia::SampleBuffer>(
+  auto sample_buffer = easymedia::MakePooled<easymedia::SampleBuffer>(
       MediaBuffer::Alloc2(buffer_size), alsa_sample_info);
 
   if (!sample_buffer) {
@@ -2,15 +2,22 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <sched.h>
 #include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
 #include <vector>
 
 #include "buffer.h"
+#include "buffer_tracker.h"
 #include "utils.h"
 #include "v4l2_stream.h"
 
 namespace easymedia {
 
+class V4L2AutoQBUF;
+
 class V4L2CaptureStream : public V4L2Stream {
 public:
   V4L2CaptureStream(const char *param);
@@ -25,6 +32,7 @@ public:
 
 private:
   int BufferExport(enum v4l2_buf_type bt, int index, int *dmafd);
+  void DetachHeldBuffers();
   enum v4l2_memory memory_type;
   std::string data_type;
   PixelFormat pix_fmt;
@@ -34,12 +42,26 @@ private:
   int quantization;
   std::vector<MediaBuffer> buffer_vec;
   bool started;
+
+  // Buffers held longer than detach_ms by the consumers are copied to
+  // detach_pool and given back to the driver, so that a slow consumer does
+  // not starve the capture. 0 to keep them until they are released.
+  int detach_ms;
+  std::shared_ptr<BufferPool> detach_pool;
+  struct HeldBuffer {
+    std::weak_ptr<MediaBuffer> buffer;
+    V4L2AutoQBUF *auto_qbuf; // in buffer
+    int64_t dq_time;         // us
+  };
+  // by v4l2 buffer index
+  std::vector<HeldBuffer> held;
+  uint64_t detach_cnt;
 };
 
 V4L2CaptureStream::V4L2CaptureStream(const char *param)
     : V4L2Stream(param), memory_type(V4L2_MEMORY_MMAP), data_type(IMAGE_NV12),
       pix_fmt(PIX_FMT_NONE), width(0), height(0), colorspace(-1), loop_num(2),
-      quantization(-1), started(false) {
+      quantization(-1), started(false), detach_ms(0), detach_cnt(0) {
   if (device.empty())
     return;
   std::map<std::string, std::string> params;
@@ -47,6 +69,7 @@ V4L2CaptureStream::V4L2CaptureStream(const char *param)
 
   std::string mem_type, str_loop_num;
   std::string str_width, str_height, str_color_space, str_quantization;
+  std::string str_detach_ms;
   req_list.push_back(
       std::pair<const std::string, std::string &>(KEY_V4L2_MEM_TYPE, mem_type));
   req_list.push_back(
@@ -61,6 +84,8 @@ V4L2CaptureStream::V4L2CaptureStream(const char *param)
       KEY_V4L2_COLORSPACE, str_color_space));
   req_list.push_back(std::pair<const std::string, std::string &>(
       KEY_V4L2_QUANTIZATION, str_quantization));
+  req_list.push_back(std::pair<const std::string, std::string &>(
+      KEY_V4L2_DETACH_MS, str_detach_ms));
   int ret = parse_media_param_match(param, params, req_list);
   if (ret == 0)
     return;
@@ -77,6 +102,8 @@ V4L2CaptureStream::V4L2CaptureStream(const char *param)
     colorspace = std::stoi(str_color_space);
   if (!str_quantization.empty())
     quantization = std::stoi(str_quantization);
+  if (!str_detach_ms.empty())
+    detach_ms = std::stoi(str_detach_ms);
 }
 
 int V4L2CaptureStream::BufferExport(enum v4l2_buf_type bt, int index,
@@ -277,28 +304,103 @@ int V4L2CaptureStream::Open() {
 }
 int V4L2CaptureStream::Close() {
   started = false;
+  if (detach_cnt > 0)
+    RKMEDIA_LOGI("%s: %llu buffers detached from slow consumers\n",
+                 device.c_str(), (unsigned long long)detach_cnt);
+  detach_cnt = 0;
+  held.clear();
   return V4L2Stream::Close();
 }
 
 class V4L2AutoQBUF {
 public:
-  V4L2AutoQBUF(std::shared_ptr<V4L2Context> ctx, struct v4l2_buffer buf)
-      : v4l2_ctx(ctx), v4l2_buf(buf) {}
-  ~V4L2AutoQBUF() {
+  V4L2AutoQBUF(std::shared_ptr<V4L2Context> ctx, struct v4l2_buffer buf,
+               const void *key)
+      : v4l2_ctx(ctx), v4l2_buf(buf), track_key(key), pins(0), queued(false) {
+  }
+  ~V4L2AutoQBUF() { Requeue(); }
+
+  void Pin() {
+    int p = pins.load(std::memory_order_relaxed);
+    do {
+      // -1 while Detach moves the buffer, for one frame copy at most
+      while (p < 0) {
+        sched_yield();
+        p = pins.load(std::memory_order_relaxed);
+      }
+    } while (!pins.compare_exchange_weak(p, p + 1, std::memory_order_acquire));
+  }
+  void Unpin() { pins.fetch_sub(1, std::memory_order_release); }
+  bool IsQueued() const { return queued.load(std::memory_order_acquire); }
+  // The userdata of the owner, through which the wrappers copied from it
+  // are counted.
+  std::shared_ptr<void> TrackCopies(const std::shared_ptr<void> &data) {
+    auto token = MakePooled<std::shared_ptr<void>>(data);
+    copies = token;
+    return std::shared_ptr<void>(token, data.get());
+  }
+  // Copy the data of owner to a buffer of pool, make owner use that buffer
+  // and queue the capture buffer back. False if owner is pinned, was copied
+  // by wrappers still alive, which would keep the old memory, or pool has
+  // no buffer ready.
+  bool Detach(MediaBuffer *owner, BufferPool *pool);
+
+private:
+  void Requeue() {
+    if (queued.load(std::memory_order_relaxed))
+      return;
+    queued.store(true, std::memory_order_release);
+    BufferTracker::Unregister(track_key);
     if (v4l2_ctx->IoCtrl(VIDIOC_QBUF, &v4l2_buf) < 0)
       RKMEDIA_LOGI("index=%d, ioctl(VIDIOC_QBUF): %m\n", v4l2_buf.index);
   }
 
-private:
   std::shared_ptr<V4L2Context> v4l2_ctx;
   struct v4l2_buffer v4l2_buf;
+  const void *track_key;
+  // readers of the memory, -1 while detaching
+  std::atomic<int> pins;
+  std::atomic<bool> queued;
+  std::weak_ptr<void> copies;
 };
 
+bool V4L2AutoQBUF::Detach(MediaBuffer *owner, BufferPool *pool) {
+  int idle = 0;
+  if (!pins.compare_exchange_strong(idle, -1, std::memory_order_acquire))
+    return false;
+  bool ret = false;
+  // no copy can start while pins is -1, the owner holds one count
+  bool copied = copies.use_count() > 1;
+  auto copy = IsQueued() || copied ? nullptr : pool->GetBuffer(false);
+  if (copy) {
+    size_t size = std::min(owner->GetValidSize(), copy->GetSize());
+    owner->BeginCPUAccess(true);
+    copy->BeginCPUAccess(false);
+    memcpy(copy->GetPtr(), owner->GetPtr(), size);
+    copy->EndCPUAccess(false);
+    owner->EndCPUAccess(true);
+    // the holders see the same buffer, in the memory of the pool
+    owner->SetPtr(copy->GetPtr());
+    owner->SetFD(copy->GetFD());
+    owner->SetSize(copy->GetSize());
+    owner->SetUserData(copy);
+    Requeue();
+    ret = true;
+  }
+  pins.store(0, std::memory_order_release);
+  return ret;
+}
+
 class AutoQBUFMediaBuffer : public MediaBuffer {
 public:
   AutoQBUFMediaBuffer(const MediaBuffer &mb, std::shared_ptr<V4L2Context> ctx,
                       struct v4l2_buffer buf)
-      : MediaBuffer(mb), auto_qbuf(ctx, buf) {}
+      : MediaBuffer(mb), auto_qbuf(ctx, buf, mb.GetPtr()) {
+    SetUserData(auto_qbuf.TrackCopies(GetUserData()));
+  }
+  virtual void Pin() override { auto_qbuf.Pin(); }
+  virtual void Unpin() override { auto_qbuf.Unpin(); }
+  V4L2AutoQBUF *GetAutoQBUF() { return &auto_qbuf; }
 
 private:
   V4L2AutoQBUF auto_qbuf;
@@ -308,17 +410,74 @@ class AutoQBUFImageBuffer : public ImageBuffer {
 public:
   AutoQBUFImageBuffer(const MediaBuffer &mb, const ImageInfo &info,
                       std::shared_ptr<V4L2Context> ctx, struct v4l2_buffer buf)
-      : ImageBuffer(mb, info), auto_qbuf(ctx, buf) {}
+      : ImageBuffer(mb, info), auto_qbuf(ctx, buf, mb.GetPtr()) {
+    SetUserData(auto_qbuf.TrackCopies(GetUserData()));
+  }
+  virtual void Pin() override { auto_qbuf.Pin(); }
+  virtual void Unpin() override { auto_qbuf.Unpin(); }
+  V4L2AutoQBUF *GetAutoQBUF() { return &auto_qbuf; }
 
 private:
   V4L2AutoQBUF auto_qbuf;
 };
 
+// Give the driver back the buffers held longer than detach_ms. If it has
+// none left, wait for the first one to be due instead of blocking in DQBUF
+// until a consumer lets one go.
+void V4L2CaptureStream::DetachHeldBuffers() {
+  if (!detach_pool) {
+    BufferPoolParam bp_param;
+    bp_param.min_cnt = 1;
+    // as many copies as capture buffers may be held besides them
+    bp_param.max_cnt = buffer_vec.size() * 2;
+    bp_param.low_watermark = 0;
+    bp_param.high_watermark = 1;
+    bp_param.idle_ms = 3000;
+    bp_param.grow_ms = 0;
+    // dma buffers, the consumers may hand them to the hardware
+    detach_pool = std::make_shared<BufferPool>(
+        bp_param, buffer_vec[0].GetSize(), MediaBuffer::MemType::MEM_HARD_WARE);
+  }
+  if (held.size() != buffer_vec.size())
+    held.resize(buffer_vec.size());
+  AutoDuration ad;
+  while (true) {
+    int64_t now = gettimeofday();
+    int64_t next_due = INT64_MAX;
+    int queued = 0;
+    for (auto &h : held) {
+      auto buffer = h.buffer.lock();
+      if (!buffer || h.auto_qbuf->IsQueued()) {
+        queued++;
+        continue;
+      }
+      int64_t due = h.dq_time + detach_ms * 1000LL;
+      if (due <= now && h.auto_qbuf->Detach(buffer.get(), detach_pool.get())) {
+        detach_cnt++;
+        queued++;
+        RKMEDIA_LOGD("%s: detach buffer held for %d ms\n", device.c_str(),
+                     (int)((now - h.dq_time) / 1000));
+        continue;
+      }
+      // pinned, copied or no buffer available, try again soon
+      next_due = std::min(next_due, std::max(due, now + 1000));
+    }
+    // give up after a while, the consumers may hold the copies too
+    if (queued > 0 || next_due == INT64_MAX ||
+        ad.Get() > detach_ms * 2000LL)
+      return;
+    usleep(next_due - now);
+  }
+}
+
 std::shared_ptr<MediaBuffer> V4L2CaptureStream::Read() {
   const char *dev = device.c_str();
   if (!started && v4l2_ctx->SetStarted(true))
     started = true;
 
+  if (detach_ms > 0 && !buffer_vec.empty())
+    DetachHeldBuffers();
+
   struct v4l2_buffer buf;
   memset(&buf, 0, sizeof(buf));
   buf.type = capture_type;
@@ -331,12 +490,22 @@ std::shared_ptr<MediaBuffer> V4L2CaptureStream::Read() {
   struct timeval buf_ts = buf.timestamp;
   MediaBuffer &mb = buffer_vec[buf.index];
   std::shared_ptr<MediaBuffer> ret_buf;
+  V4L2AutoQBUF *auto_qbuf = nullptr;
   if (buf.bytesused > 0) {
+    if (BufferTracker::IsEnabled()) {
+      char origin[48];
+      snprintf(origin, sizeof(origin), "%s#%d", dev, buf.index);
+      BufferTracker::Register(mb.GetPtr(), origin);
+    }
     if (pix_fmt != PIX_FMT_NONE) {
       ImageInfo info{pix_fmt, width, height, width, height};
-      ret_buf = std::make_shared<AutoQBUFImageBuffer>(mb, info, v4l2_ctx, buf);
+      auto ib = MakePooled<AutoQBUFImageBuffer>(mb, info, v4l2_ctx, buf);
+      auto_qbuf = ib->GetAutoQBUF();
+      ret_buf = ib;
     } else {
-      ret_buf = std::make_shared<AutoQBUFMediaBuffer>(mb, v4l2_ctx, buf);
+      auto qb = MakePooled<AutoQBUFMediaBuffer>(mb, v4l2_ctx, buf);
+      auto_qbuf = qb->GetAutoQBUF();
+      ret_buf = qb;
     }
   }
   if (ret_buf) {
@@ -347,6 +516,12 @@ std::shared_ptr<MediaBuffer> V4L2CaptureStream::Read() {
     ret_buf->SetAtomicTimeVal(buf_ts);
     ret_buf->SetTimeVal(buf_ts);
     ret_buf->SetValidSize(buf.bytesused);
+    if (detach_ms > 0 && buf.index < held.size()) {
+      HeldBuffer &h = held[buf.index];
+      h.buffer = ret_buf;
+      h.auto_qbuf = auto_qbuf;
+      h.dq_time = gettimeofday();
+    }
   } else {
     if (v4l2_ctx->IoCtrl(VIDIOC_QBUF, &buf) < 0)
       RKMEDIA_LOGI("%s, index=%d, ioctl(VIDIOC_QBUF): %m\n", dev, buf.index);